@@ -52,18 +52,28 @@ namespace process {
 
 namespace internal {
 
+// Delivers the dispatch event to the process it is addressed to,
+// unless that process is no longer valid.
+void dispatch(DispatchEvent* event);
+
+
 // The internal dispatch routine schedules a function to get invoked
 // within the context of the process associated with the specified pid
 // (first argument), unless that process is no longer valid. Note that
 // this routine does not expect anything in particular about the
 // specified function (second argument). The semantics are simple: the
 // function gets applied/invoked with the process as its first
-// argument. Currently we wrap the function in a shared_ptr but this
-// will probably change in the future to unique_ptr (or a variant).
+// argument. The function is stored in the (pooled) event itself so
+// that small functions require no additional allocations (see
+// `DispatchFunction`).
+template <typename F>
 void dispatch(
     const UPID& pid,
-    const std::shared_ptr<std::function<void(ProcessBase*)>>& f,
-    const Option<const std::type_info*>& functionType = None());
+    F&& f,
+    const Option<const std::type_info*>& functionType = None())
+{
+  dispatch(new DispatchEvent(pid, std::forward<F>(f), functionType));
+}
 
 } // namespace internal {
 
@@ -79,16 +89,15 @@ void dispatch(
 template <typename T>
 void dispatch(const PID<T>& pid, void (T::*method)())
 {
-  std::shared_ptr<std::function<void(ProcessBase*)>> f(
-      new std::function<void(ProcessBase*)>(
-          [=](ProcessBase* process) {
-            assert(process != NULL);
-            T* t = dynamic_cast<T*>(process);
-            assert(t != NULL);
-            (t->*method)();
-          }));
-
-  internal::dispatch(pid, f, &typeid(method));
+  internal::dispatch(
+      pid,
+      [=](ProcessBase* process) {
+        assert(process != NULL);
+        T* t = dynamic_cast<T*>(process);
+        assert(t != NULL);
+        (t->*method)();
+      },
+      &typeid(method));
 }
 
 template <typename T>
@@ -115,16 +124,15 @@ void dispatch(const Process<T>* process, void (T::*method)())
       void (T::*method)(ENUM_PARAMS(N, P)),                             \
       ENUM_BINARY_PARAMS(N, A, a))                                      \
   {                                                                     \
-    std::shared_ptr<std::function<void(ProcessBase*)>> f(               \
-        new std::function<void(ProcessBase*)>(                          \
-            [=](ProcessBase* process) {                                 \
-              assert(process != NULL);                                  \
-              T* t = dynamic_cast<T*>(process);                         \
-              assert(t != NULL);                                        \
-              (t->*method)(ENUM_PARAMS(N, a));                          \
-            }));                                                        \
-                                                                        \
-    internal::dispatch(pid, f, &typeid(method));                        \
+    internal::dispatch(                                                 \
+        pid,                                                            \
+        [=](ProcessBase* process) {                                     \
+          assert(process != NULL);                                      \
+          T* t = dynamic_cast<T*>(process);                             \
+          assert(t != NULL);                                            \
+          (t->*method)(ENUM_PARAMS(N, a));                              \
+        },                                                              \
+        &typeid(method));                                               \
   }                                                                     \
                                                                         \
   template <typename T,                                                 \
@@ -160,16 +168,15 @@ Future<R> dispatch(const PID<T>& pid, Future<R> (T::*method)())
 {
   std::shared_ptr<Promise<R>> promise(new Promise<R>());
 
-  std::shared_ptr<std::function<void(ProcessBase*)>> f(
-      new std::function<void(ProcessBase*)>(
-          [=](ProcessBase* process) {
-            assert(process != NULL);
-            T* t = dynamic_cast<T*>(process);
-            assert(t != NULL);
-            promise->associate((t->*method)());
-          }));
-
-  internal::dispatch(pid, f, &typeid(method));
+  internal::dispatch(
+      pid,
+      [=](ProcessBase* process) {
+        assert(process != NULL);
+        T* t = dynamic_cast<T*>(process);
+        assert(t != NULL);
+        promise->associate((t->*method)());
+      },
+      &typeid(method));
 
   return promise->future();
 }
@@ -198,16 +205,15 @@ Future<R> dispatch(const Process<T>* process, Future<R> (T::*method)())
   {                                                                     \
     std::shared_ptr<Promise<R>> promise(new Promise<R>());              \
                                                                         \
-    std::shared_ptr<std::function<void(ProcessBase*)>> f(               \
-        new std::function<void(ProcessBase*)>(                          \
-            [=](ProcessBase* process) {                                 \
-              assert(process != NULL);                                  \
-              T* t = dynamic_cast<T*>(process);                         \
-              assert(t != NULL);                                        \
-              promise->associate((t->*method)(ENUM_PARAMS(N, a)));      \
-            }));                                                        \
-                                                                        \
-    internal::dispatch(pid, f, &typeid(method));                        \
+    internal::dispatch(                                                 \
+        pid,                                                            \
+        [=](ProcessBase* process) {                                     \
+          assert(process != NULL);                                      \
+          T* t = dynamic_cast<T*>(process);                             \
+          assert(t != NULL);                                            \
+          promise->associate((t->*method)(ENUM_PARAMS(N, a)));          \
+        },                                                              \
+        &typeid(method));                                               \
                                                                         \
     return promise->future();                                           \
   }                                                                     \
@@ -247,16 +253,15 @@ Future<R> dispatch(const PID<T>& pid, R (T::*method)())
 {
   std::shared_ptr<Promise<R>> promise(new Promise<R>());
 
-  std::shared_ptr<std::function<void(ProcessBase*)>> f(
-      new std::function<void(ProcessBase*)>(
-          [=](ProcessBase* process) {
-            assert(process != NULL);
-            T* t = dynamic_cast<T*>(process);
-            assert(t != NULL);
-            promise->set((t->*method)());
-          }));
-
-  internal::dispatch(pid, f, &typeid(method));
+  internal::dispatch(
+      pid,
+      [=](ProcessBase* process) {
+        assert(process != NULL);
+        T* t = dynamic_cast<T*>(process);
+        assert(t != NULL);
+        promise->set((t->*method)());
+      },
+      &typeid(method));
 
   return promise->future();
 }
@@ -285,16 +290,15 @@ Future<R> dispatch(const Process<T>* process, R (T::*method)())
   {                                                                     \
     std::shared_ptr<Promise<R>> promise(new Promise<R>());              \
                                                                         \
-    std::shared_ptr<std::function<void(ProcessBase*)>> f(               \
-        new std::function<void(ProcessBase*)>(                          \
-            [=](ProcessBase* process) {                                 \
-              assert(process != NULL);                                  \
-              T* t = dynamic_cast<T*>(process);                         \
-              assert(t != NULL);                                        \
-              promise->set((t->*method)(ENUM_PARAMS(N, a)));            \
-            }));                                                        \
-                                                                        \
-    internal::dispatch(pid, f, &typeid(method));                        \
+    internal::dispatch(                                                 \
+        pid,                                                            \
+        [=](ProcessBase* process) {                                     \
+          assert(process != NULL);                                      \
+          T* t = dynamic_cast<T*>(process);                             \
+          assert(t != NULL);                                            \
+          promise->set((t->*method)(ENUM_PARAMS(N, a)));                \
+        },                                                              \
+        &typeid(method));                                               \
                                                                         \
     return promise->future();                                           \
   }                                                                     \
@@ -329,13 +333,11 @@ Future<R> dispatch(const Process<T>* process, R (T::*method)())
 
 inline void dispatch(const UPID& pid, const std::function<void()>& f)
 {
-  std::shared_ptr<std::function<void(ProcessBase*)>> f_(
-      new std::function<void(ProcessBase*)>(
-          [=](ProcessBase*) {
-            f();
-          }));
-
-  internal::dispatch(pid, f_);
+  internal::dispatch(
+      pid,
+      [=](ProcessBase*) {
+        f();
+      });
 }
 
 
@@ -344,13 +346,11 @@ Future<R> dispatch(const UPID& pid, const std::function<Future<R>()>& f)
 {
   std::shared_ptr<Promise<R>> promise(new Promise<R>());
 
-  std::shared_ptr<std::function<void(ProcessBase*)>> f_(
-      new std::function<void(ProcessBase*)>(
-          [=](ProcessBase*) {
-            promise->associate(f());
-          }));
-
-  internal::dispatch(pid, f_);
+  internal::dispatch(
+      pid,
+      [=](ProcessBase*) {
+        promise->associate(f());
+      });
 
   return promise->future();
 }
@@ -361,13 +361,11 @@ Future<R> dispatch(const UPID& pid, const std::function<R()>& f)
 {
   std::shared_ptr<Promise<R>> promise(new Promise<R>());
 
-  std::shared_ptr<std::function<void(ProcessBase*)>> f_(
-      new std::function<void(ProcessBase*)>(
-          [=](ProcessBase*) {
-            promise->set(f());
-          }));
-
-  internal::dispatch(pid, f_);
+  internal::dispatch(
+      pid,
+      [=](ProcessBase*) {
+        promise->set(f());
+      });
 
   return promise->future();
 }
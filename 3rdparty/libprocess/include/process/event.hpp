@@ -13,7 +13,13 @@
 #ifndef __PROCESS_EVENT_HPP__
 #define __PROCESS_EVENT_HPP__
 
+#include <stddef.h>
+
+#include <atomic>
 #include <memory> // TODO(benh): Replace shared_ptr with unique_ptr.
+#include <new>
+#include <type_traits>
+#include <utility>
 
 #include <process/future.hpp>
 #include <process/http.hpp>
@@ -26,6 +32,7 @@
 namespace process {
 
 // Forward declarations.
+class EventQueue;
 class ProcessBase;
 struct MessageEvent;
 struct DispatchEvent;
@@ -47,8 +54,22 @@ struct EventVisitor
 
 struct Event
 {
+  Event() : next(NULL) {}
+
+  // NOTE: The link to the next event in a queue is never copied.
+  Event(const Event&) : next(NULL) {}
+
   virtual ~Event() {}
 
+  // Events are allocated from a per-thread pool in order to avoid
+  // going to the heap for every event (see src/event_pool.cpp).
+  static void* operator new(size_t size);
+  static void operator delete(void* event, size_t size);
+
+  // Since the above hide the global placement forms.
+  static void* operator new(size_t, void* pointer) { return pointer; }
+  static void operator delete(void*, void*) {}
+
   virtual void visit(EventVisitor* visitor) const = 0;
 
   template <typename T>
@@ -81,6 +102,13 @@ struct Event
     }
     return *result;
   }
+
+private:
+  friend class EventQueue;
+
+  // Intrusive link to the next event in the queue of a process, which
+  // avoids an allocation per enqueued event (see `EventQueue`).
+  std::atomic<Event*> next;
 };
 
 
@@ -145,14 +173,89 @@ private:
 };
 
 
+// The function invoked with the process that receives a dispatch. The
+// function is stored inline when it fits in `INLINE_SIZE` bytes so
+// that dispatching does not require any allocation other than the
+// (pooled) event itself, and is otherwise stored on the heap.
+class DispatchFunction
+{
+public:
+  template <typename F>
+  explicit DispatchFunction(F&& f)
+  {
+    typedef Function<typename std::decay<F>::type> Type;
+
+    if (sizeof(Type) <= sizeof(storage) &&
+        std::alignment_of<Type>::value <=
+          std::alignment_of<Storage>::value) {
+      function = new (&storage) Type(std::forward<F>(f));
+    } else {
+      heapAllocated();
+      function = new Type(std::forward<F>(f));
+    }
+  }
+
+  ~DispatchFunction()
+  {
+    if (static_cast<void*>(function) == static_cast<void*>(&storage)) {
+      function->~Callable();
+    } else {
+      delete function;
+    }
+  }
+
+  void operator()(ProcessBase* process) const
+  {
+    (*function)(process);
+  }
+
+  // Maximum size of a function that is stored inline.
+  static const size_t INLINE_SIZE = 64;
+
+private:
+  struct Callable
+  {
+    virtual ~Callable() {}
+    virtual void operator()(ProcessBase* process) = 0;
+  };
+
+  template <typename F>
+  struct Function : Callable
+  {
+    template <typename G>
+    explicit Function(G&& g) : f(std::forward<G>(g)) {}
+
+    virtual void operator()(ProcessBase* process)
+    {
+      f(process);
+    }
+
+    F f;
+  };
+
+  // Counts the functions that did not fit inline.
+  static void heapAllocated();
+
+  // Not copyable, not assignable.
+  DispatchFunction(const DispatchFunction&);
+  DispatchFunction& operator=(const DispatchFunction&);
+
+  typedef std::aligned_storage<INLINE_SIZE>::type Storage;
+
+  Storage storage;
+  Callable* function;
+};
+
+
 struct DispatchEvent : Event
 {
+  template <typename F>
   DispatchEvent(
       const UPID& _pid,
-      const std::shared_ptr<lambda::function<void(ProcessBase*)>>& _f,
+      F&& _f,
       const Option<const std::type_info*>& _functionType)
     : pid(_pid),
-      f(_f),
+      f(std::forward<F>(_f)),
       functionType(_functionType)
   {}
 
@@ -165,7 +268,7 @@ struct DispatchEvent : Event
   const UPID pid;
 
   // Function to get invoked as a result of this dispatch event.
-  const std::shared_ptr<lambda::function<void(ProcessBase*)>> f;
+  const DispatchFunction f;
 
   const Option<const std::type_info*> functionType;
 
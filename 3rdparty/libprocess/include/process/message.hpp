@@ -13,6 +13,8 @@
 #ifndef __PROCESS_MESSAGE_HPP__
 #define __PROCESS_MESSAGE_HPP__
 
+#include <stddef.h>
+
 #include <string>
 
 #include <process/pid.hpp>
@@ -21,6 +23,15 @@ namespace process {
 
 struct Message
 {
+  // Messages are allocated from the same per-thread pool as events
+  // (see src/event_pool.cpp).
+  static void* operator new(size_t size);
+  static void operator delete(void* message, size_t size);
+
+  // Since the above hide the global placement forms.
+  static void* operator new(size_t, void* pointer) { return pointer; }
+  static void operator delete(void*, void*) {}
+
   std::string name;
   UPID from;
   UPID to;
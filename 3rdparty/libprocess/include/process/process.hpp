@@ -38,7 +38,8 @@
 
 namespace process {
 
-// Forward declaration.
+// Forward declarations.
+class EventQueue;
 class Sequence;
 
 namespace firewall {
@@ -315,16 +316,7 @@ protected:
    * queue.
    */
   template <typename T>
-  size_t eventCount()
-  {
-    size_t count = 0U;
-
-    synchronized (mutex) {
-      count = std::count_if(events.begin(), events.end(), isEventType<T>);
-    }
-
-    return count;
-  }
+  size_t eventCount();
 
 private:
   friend class SocketManager;
@@ -333,7 +325,7 @@ private:
   friend void* schedule(void*);
 
   // Process states.
-  enum
+  enum State
   {
     BOTTOM,
     READY,
@@ -341,17 +333,13 @@ private:
     BLOCKED,
     TERMINATING,
     TERMINATED
-  } state;
-
-  template <typename T>
-  static bool isEventType(const Event* event)
-  {
-    return event->is<T>();
-  }
+  };
 
-  // Mutex protecting internals.
-  // TODO(benh): Consider replacing with a spinlock, on multi-core systems.
-  std::recursive_mutex mutex;
+  // The state is updated without a lock: a process only transitions
+  // from BLOCKED to READY when an event is enqueued, and all other
+  // transitions are done by the thread running the process (see
+  // `ProcessManager::resume`).
+  std::atomic<State> state;
 
   // Enqueue the specified message, request, or function call.
   void enqueue(Event* event, bool inject = false);
@@ -402,12 +390,17 @@ private:
   // Static assets(s) to provide.
   std::map<std::string, Asset> assets;
 
-  // Queue of received events, requires lock()ed access!
-  std::deque<Event*> events;
+  // Queue of received events (see `EventQueue`).
+  Owned<EventQueue> events;
 
   // Active references.
   std::atomic_long refs;
 
+  // Index of the processing thread that last ran this process, or -1
+  // if it has not yet been run by a processing thread. Used by the
+  // ProcessManager to keep a process on the same thread's run queue.
+  std::atomic_long worker;
+
   // Process PID.
   UPID pid;
 };
@@ -245,6 +245,10 @@ private:
  * but before exec'ing. If the return value of 'setup' is non-zero
  * then that gets returned in 'status()' and we will not exec.
  *
+ * If neither 'setup' nor 'clone' are specified the subprocess is
+ * spawned (see `posix_spawn`) rather than forked where possible,
+ * which avoids copying the page tables of the current process.
+ *
  * @param path Relative or absolute path in the filesytem to the
  *     executable.
  * @param argv Argument vector to pass to exec.
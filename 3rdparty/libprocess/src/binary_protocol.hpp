@@ -0,0 +1,166 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+
+#ifndef __BINARY_PROTOCOL_HPP__
+#define __BINARY_PROTOCOL_HPP__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include <process/http.hpp>
+
+#include <stout/hashmap.hpp>
+
+namespace process {
+namespace binary {
+
+// A compact alternative to sending each message as an HTTP POST,
+// used on links between libprocess instances that both support it.
+//
+// Negotiation: after connecting a link the sender makes an HTTP
+// request for 'NEGOTIATION_PATH' with the 'PROTOCOL_HEADER' set to
+// 'PROTOCOL' and waits for the response before sending anything
+// else. A peer that supports the protocol responds with '200 OK' and
+// the same header, and decodes everything that follows the request
+// as frames. Older peers respond '404 Not Found', in which case the
+// sender keeps using HTTP.
+//
+// Framing: each frame is a 4 byte length (of the payload) and a 1
+// byte type, followed by the payload. All integers are unsigned and
+// in network byte order.
+//
+//   DEFINE:  [id:4][string]
+//   MESSAGE: [from:4][to:4][name:4][body]
+//
+// A DEFINE frame binds an id to a string for the remainder of the
+// connection (or until the id is defined again), which lets MESSAGE
+// frames refer to the sender, receiver and message name by id.
+const char PROTOCOL[] = "binary/1";
+const char PROTOCOL_HEADER[] = "Libprocess-Protocol";
+const char NEGOTIATION_PATH[] = "/__libprocess__/protocol";
+
+enum FrameType
+{
+  DEFINE = 1,
+  MESSAGE = 2
+};
+
+// Size of the length and type that precede each payload.
+const size_t FRAME_HEADER_SIZE = 5;
+
+// Maximum number of ids in use on a connection at any time, which
+// bounds the memory used by the receiver. Ids are in [1, MAX_IDS].
+const uint32_t MAX_IDS = 4096;
+
+
+inline void append(uint32_t value, std::string* out)
+{
+  const char bytes[] = {
+    static_cast<char>((value >> 24) & 0xff),
+    static_cast<char>((value >> 16) & 0xff),
+    static_cast<char>((value >> 8) & 0xff),
+    static_cast<char>(value & 0xff)
+  };
+
+  out->append(bytes, sizeof(bytes));
+}
+
+
+inline uint32_t read(const char* data)
+{
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+
+  return (static_cast<uint32_t>(bytes[0]) << 24) |
+         (static_cast<uint32_t>(bytes[1]) << 16) |
+         (static_cast<uint32_t>(bytes[2]) << 8) |
+         static_cast<uint32_t>(bytes[3]);
+}
+
+
+inline void append(FrameType type, size_t length, std::string* out)
+{
+  append(static_cast<uint32_t>(length), out);
+  out->push_back(static_cast<char>(type));
+}
+
+
+// The ids assigned to strings by the sender of a connection. Once
+// all of the ids are in use they get reassigned from the start.
+class Strings
+{
+public:
+  Strings() : next(1) {}
+
+  // Returns the id of the string, appending a DEFINE frame to 'out'
+  // if the string does not currently have an id.
+  uint32_t intern(const std::string& s, std::string* out)
+  {
+    hashmap<std::string, uint32_t>::const_iterator it = ids.find(s);
+    if (it != ids.end()) {
+      return it->second;
+    }
+
+    if (next > MAX_IDS) {
+      ids.clear();
+      next = 1;
+    }
+
+    const uint32_t id = next++;
+    ids[s] = id;
+
+    append(DEFINE, sizeof(uint32_t) + s.size(), out);
+    append(id, out);
+    out->append(s);
+
+    return id;
+  }
+
+private:
+  hashmap<std::string, uint32_t> ids;
+  uint32_t next;
+};
+
+
+// Returns true if this is a request to negotiate the protocol.
+inline bool negotiation(const http::Request& request)
+{
+  return request.method == "GET" &&
+    request.url.path == NEGOTIATION_PATH &&
+    request.headers.get(PROTOCOL_HEADER) == std::string(PROTOCOL);
+}
+
+
+// Returns the request that a sender uses to negotiate the protocol.
+inline std::string negotiation()
+{
+  return std::string("GET ") + NEGOTIATION_PATH + " HTTP/1.1\r\n" +
+    "Host: \r\n" +
+    "Connection: Keep-Alive\r\n" +
+    PROTOCOL_HEADER + ": " + PROTOCOL + "\r\n" +
+    "\r\n";
+}
+
+
+// Returns true if the response to the negotiation request means that
+// the peer will decode frames.
+inline bool negotiated(const http::Response& response)
+{
+  return response.code == 200 &&
+    response.headers.get(PROTOCOL_HEADER) == std::string(PROTOCOL);
+}
+
+} // namespace binary {
+} // namespace process {
+
+#endif // __BINARY_PROTOCOL_HPP__
@@ -31,6 +31,7 @@
 #include <stout/unreachable.hpp>
 
 #include "event_loop.hpp"
+#include "timer_wheel.hpp"
 
 using std::list;
 using std::map;
@@ -39,10 +40,9 @@ using std::set;
 
 namespace process {
 
-// We store the timers in a map of lists indexed by the timeout of the
-// timer so that we can have two timers that have the same timeout. We
-// exploit that the map is SORTED!
-static map<Time, list<Timer>>* timers = new map<Time, list<Timer>>();
+// We store the timers in a timing wheel, which keeps adding and
+// canceling timers O(1) regardless of how many are pending.
+static TimerWheel* timers = new TimerWheel();
 static recursive_mutex* timers_mutex = new recursive_mutex();
 
 
@@ -83,12 +83,15 @@ set<Time>* ticks = new set<Time>();
 // so that it's clear from the callsite that the use of 'timers' is
 // within a 'synchronized' block.
 //
-// TODO(benh): Create a generic 'Timers' abstraction which hides this
-// and more away (i.e., all manipulations of 'timers' below).
-Option<Time> next(const map<Time, list<Timer>>& timers)
+// NOTE: This may be earlier than when the next timer elapses if the
+// timers still need to be cascaded within the wheel, see
+// `TimerWheel::next`.
+Option<Time> next(TimerWheel& timers)
 {
-  if (!timers.empty()) {
-    Time first = timers.begin()->first;
+  const Option<Time> earliest = timers.next();
+
+  if (earliest.isSome()) {
+    Time first = earliest.get();
 
     // If the clock is paused and no timers are expired, the
     // timers cannot fire until the clock is advanced, so we
@@ -116,7 +119,7 @@ void tick(const Time& time);
 // a 'synchronized' block.
 // TODO(bmahler): Consider taking an optional 'now' to avoid
 // excessive syscalls via Clock::now(NULL).
-void scheduleTick(const map<Time, list<Timer>>& timers, set<Time>* ticks)
+void scheduleTick(TimerWheel& timers, set<Time>* ticks)
 {
   // Determine when the next 'tick' should fire.
   const Option<Time> next = clock::next(timers);
@@ -151,12 +154,10 @@ void tick(const Time& time)
 
     VLOG(3) << "Handling timers up to " << now;
 
-    foreachkey (const Time& timeout, *timers) {
-      if (timeout > now) {
-        break;
-      }
+    timedout = timers->advance(now);
 
-      VLOG(3) << "Have timeout(s) at " << timeout;
+    if (!timedout.empty()) {
+      VLOG(3) << "Have " << timedout.size() << " timeout(s)";
 
       // Need to toggle 'settling' so that we don't prematurely say
       // we're settled until after the timers are executed below,
@@ -164,17 +165,10 @@ void tick(const Time& time)
       if (clock::paused) {
         clock::settling = true;
       }
-
-      foreach (const Timer& timer, (*timers)[timeout]) {
-        timedout.push_back(timer);
-      }
     }
 
-    // Now erase the range of timers that timed out.
-    timers->erase(timers->begin(), timers->upper_bound(now));
-
     // Okay, so the timeout for the next timer should not have fired.
-    CHECK(timers->empty() || (timers->begin()->first > now));
+    CHECK(timers->empty() || (timers->next().get() > now));
 
     // Remove this tick from the scheduled 'ticks', it may have
     // been removed already if the clock was paused / manipulated
@@ -192,8 +186,8 @@ void tick(const Time& time)
   // executing expired timers.
   synchronized (timers_mutex) {
     if (clock::paused &&
-        (timers->size() == 0 ||
-         timers->begin()->first > *clock::current)) {
+        (timers->empty() ||
+         timers->next().get() > *clock::current)) {
       VLOG(3) << "Clock has settled";
       clock::settling = false;
     }
@@ -281,17 +275,20 @@ Timer Clock::timer(
 
   // Add the timer.
   synchronized (timers_mutex) {
-    if (timers->size() == 0 ||
-        timer.timeout().time() < timers->begin()->first) {
+    if (timers->empty()) {
+      timers->position(Clock::now(NULL));
+    }
+
+    if (timers->empty() ||
+        timer.timeout().time() < timers->next().get()) {
       // Need to interrupt the loop to update/set timer repeat.
-      (*timers)[timer.timeout().time()].push_back(timer);
+      timers->add(timer);
 
       // Schedule another "tick" if necessary.
       clock::scheduleTick(*timers, clock::ticks);
     } else {
       // Timer repeat is adequate, just add the timeout.
-      CHECK(timers->size() >= 1);
-      (*timers)[timer.timeout().time()].push_back(timer);
+      timers->add(timer);
     }
   }
 
@@ -303,17 +300,8 @@ bool Clock::cancel(const Timer& timer)
 {
   bool canceled = false;
   synchronized (timers_mutex) {
-    // Check if the timeout is still pending, and if so, erase it. In
-    // addition, erase an empty list if we just removed the last
-    // timeout.
-    Time time = timer.timeout().time();
-    if (timers->count(time) > 0) {
-      canceled = true;
-      (*timers)[time].remove(timer);
-      if ((*timers)[time].empty()) {
-        timers->erase(time);
-      }
-    }
+    // Check if the timeout is still pending, and if so, erase it.
+    canceled = timers->remove(timer);
   }
 
   return canceled;
@@ -460,8 +448,8 @@ bool Clock::settled()
     if (clock::settling) {
       VLOG(3) << "Clock still not settled";
       return false;
-    } else if (timers->size() == 0 ||
-               timers->begin()->first > *clock::current) {
+    } else if (timers->empty() ||
+               timers->next().get() > *clock::current) {
       VLOG(3) << "Clock is settled";
       return true;
     }
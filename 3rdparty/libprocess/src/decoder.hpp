@@ -17,24 +17,51 @@
 
 #include <glog/logging.h>
 
+#include <algorithm>
 #include <deque>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include <process/address.hpp>
 #include <process/http.hpp>
+#include <process/message.hpp>
+#include <process/pid.hpp>
 #include <process/socket.hpp>
 
 #include <stout/foreach.hpp>
 #include <stout/gzip.hpp>
+#include <stout/numify.hpp>
 #include <stout/option.hpp>
 #include <stout/try.hpp>
 
+#include "binary_protocol.hpp"
 
 // TODO(bmahler): Switch to joyent/http-parser now that it is no
 // longer being hosted under ry/http-parser.
 
 namespace process {
 
+// Maximum length of a body that the decoders reserve space for up
+// front, since the Content-Length header comes from the peer.
+const size_t MAXIMUM_RESERVED_BODY_LENGTH = 64 * 1024 * 1024;
+
+
+// Reserves space for the body of a request or response based on the
+// Content-Length header so that appending the body as it is received
+// does not repeatedly reallocate (and copy) it.
+inline void reserve(const http::Headers& headers, std::string* body)
+{
+  Option<std::string> value = headers.get("Content-Length");
+  if (value.isSome()) {
+    Try<size_t> length = numify<size_t>(value.get());
+    if (length.isSome()) {
+      body->reserve(std::min(length.get(), MAXIMUM_RESERVED_BODY_LENGTH));
+    }
+  }
+}
+
+
 // TODO(benh): Make DataDecoder abstract and make RequestDecoder a
 // concrete subclass.
 class DataDecoder
@@ -182,7 +209,7 @@ private:
     CHECK_NOTNULL(decoder->request);
 
     if (decoder->header != HEADER_FIELD) {
-      decoder->request->headers[decoder->field] = decoder->value;
+      decoder->request->headers[decoder->field] = std::move(decoder->value);
       decoder->field.clear();
       decoder->value.clear();
     }
@@ -209,7 +236,7 @@ private:
     CHECK_NOTNULL(decoder->request);
 
     // Add final header.
-    decoder->request->headers[decoder->field] = decoder->value;
+    decoder->request->headers[decoder->field] = std::move(decoder->value);
     decoder->field.clear();
     decoder->value.clear();
 
@@ -218,6 +245,8 @@ private:
 
     decoder->request->keepAlive = http_should_keep_alive(&decoder->parser);
 
+    reserve(decoder->request->headers, &decoder->request->body);
+
     return 0;
   }
 
@@ -253,7 +282,7 @@ private:
       if (decompressed.isError()) {
         return 1;
       }
-      decoder->request->body = decompressed.get();
+      decoder->request->body = std::move(decompressed.get());
       decoder->request->headers["Content-Length"] =
         decoder->request->body.length();
     }
@@ -386,7 +415,7 @@ private:
     CHECK_NOTNULL(decoder->response);
 
     if (decoder->header != HEADER_FIELD) {
-      decoder->response->headers[decoder->field] = decoder->value;
+      decoder->response->headers[decoder->field] = std::move(decoder->value);
       decoder->field.clear();
       decoder->value.clear();
     }
@@ -413,10 +442,12 @@ private:
     CHECK_NOTNULL(decoder->response);
 
     // Add final header.
-    decoder->response->headers[decoder->field] = decoder->value;
+    decoder->response->headers[decoder->field] = std::move(decoder->value);
     decoder->field.clear();
     decoder->value.clear();
 
+    reserve(decoder->response->headers, &decoder->response->body);
+
     return 0;
   }
 
@@ -454,7 +485,7 @@ private:
         decoder->failure = true;
         return 1;
       }
-      decoder->response->body = decompressed.get();
+      decoder->response->body = std::move(decompressed.get());
       decoder->response->headers["Content-Length"] =
         decoder->response->body.length();
     }
@@ -614,7 +645,7 @@ private:
     CHECK_NOTNULL(decoder->response);
 
     if (decoder->header != HEADER_FIELD) {
-      decoder->response->headers[decoder->field] = decoder->value;
+      decoder->response->headers[decoder->field] = std::move(decoder->value);
       decoder->field.clear();
       decoder->value.clear();
     }
@@ -643,7 +674,7 @@ private:
     CHECK_NOTNULL(decoder->response);
 
     // Add final header.
-    decoder->response->headers[decoder->field] = decoder->value;
+    decoder->response->headers[decoder->field] = std::move(decoder->value);
     decoder->field.clear();
     decoder->value.clear();
 
@@ -726,6 +757,142 @@ private:
   std::deque<http::Response*> responses;
 };
 
+
+// Decodes the frames of the binary protocol (see binary_protocol.hpp)
+// into messages. The receiver of each message is assumed to be at the
+// specified address (i.e., our own address).
+class BinaryDecoder
+{
+public:
+  BinaryDecoder(const network::Socket& _s, const network::Address& _address)
+    : s(_s), address(_address), failure(false), strings(1) {}
+
+  std::deque<Message*> decode(const char* data, size_t length)
+  {
+    std::deque<Message*> messages;
+
+    if (failure) {
+      return messages;
+    }
+
+    buffer.append(data, length);
+
+    size_t offset = 0;
+
+    while (buffer.size() - offset >= binary::FRAME_HEADER_SIZE) {
+      const size_t size = binary::read(buffer.data() + offset);
+      const char type = buffer[offset + sizeof(uint32_t)];
+
+      if (buffer.size() - offset - binary::FRAME_HEADER_SIZE < size) {
+        break; // Wait for the rest of the frame.
+      }
+
+      const char* payload = buffer.data() + offset + binary::FRAME_HEADER_SIZE;
+
+      offset += binary::FRAME_HEADER_SIZE + size;
+
+      if (type == binary::DEFINE) {
+        if (!define(payload, size)) {
+          failure = true;
+          break;
+        }
+      } else if (type == binary::MESSAGE) {
+        Message* message = parse(payload, size);
+        if (message == NULL) {
+          failure = true;
+          break;
+        }
+        messages.push_back(message);
+      } else {
+        failure = true;
+        break;
+      }
+    }
+
+    buffer.erase(0, offset);
+
+    return messages;
+  }
+
+  bool failed() const
+  {
+    return failure;
+  }
+
+  network::Socket socket() const
+  {
+    return s;
+  }
+
+private:
+  bool define(const char* payload, size_t size)
+  {
+    if (size < sizeof(uint32_t)) {
+      return false;
+    }
+
+    const uint32_t id = binary::read(payload);
+    if (id == 0 || id > binary::MAX_IDS) {
+      return false;
+    }
+
+    if (strings.size() <= id) {
+      strings.resize(id + 1);
+    }
+
+    strings[id] = std::string(
+        payload + sizeof(uint32_t),
+        size - sizeof(uint32_t));
+
+    return true;
+  }
+
+  Message* parse(const char* payload, size_t size)
+  {
+    if (size < 3 * sizeof(uint32_t)) {
+      return NULL;
+    }
+
+    Option<std::string> from = lookup(binary::read(payload));
+    Option<std::string> to = lookup(binary::read(payload + 4));
+    Option<std::string> name = lookup(binary::read(payload + 8));
+
+    if (from.isNone() || to.isNone() || name.isNone()) {
+      return NULL;
+    }
+
+    Message* message = new Message();
+    message->name = name.get();
+    message->from = UPID(from.get());
+    message->to = UPID(to.get(), address);
+    message->body.assign(
+        payload + (3 * sizeof(uint32_t)),
+        size - (3 * sizeof(uint32_t)));
+
+    return message;
+  }
+
+  Option<std::string> lookup(uint32_t id) const
+  {
+    if (id == 0 || id >= strings.size() || strings[id].isNone()) {
+      return None();
+    }
+
+    return strings[id];
+  }
+
+  const network::Socket s; // The socket this decoder is associated with.
+  const network::Address address;
+
+  bool failure;
+
+  // Data that has been received but not yet decoded.
+  std::string buffer;
+
+  // The strings defined by the sender, indexed by id.
+  std::vector<Option<std::string>> strings;
+};
+
 }  // namespace process {
 
 #endif // __DECODER_HPP__
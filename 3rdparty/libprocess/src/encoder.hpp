@@ -14,10 +14,12 @@
 #define __ENCODER_HPP__
 
 #include <stdint.h>
+#include <stdio.h>
 #include <time.h>
 
 #include <map>
-#include <sstream>
+#include <string>
+#include <utility>
 
 #include <process/http.hpp>
 #include <process/process.hpp>
@@ -28,6 +30,7 @@
 #include <stout/numify.hpp>
 #include <stout/os.hpp>
 
+#include "binary_protocol.hpp"
 
 namespace process {
 
@@ -98,8 +101,8 @@ public:
     return data.size() - index;
   }
 
-private:
-  const std::string data;
+protected:
+  std::string data;
   size_t index;
 };
 
@@ -107,57 +110,193 @@ private:
 class MessageEncoder : public DataEncoder
 {
 public:
-  MessageEncoder(const network::Socket& s, Message* _message)
-    : DataEncoder(s, encode(_message)), message(_message) {}
+  MessageEncoder(const network::Socket& s, Message* message)
+    : DataEncoder(s, encode(message)), count(1)
+  {
+    delete message;
+  }
+
+  virtual ~MessageEncoder() {}
 
-  virtual ~MessageEncoder()
+  // Appends another message to this encoder so that both messages
+  // get written to the socket together. This must only be done
+  // before any of the data of this encoder has been sent.
+  void append(Message* message)
   {
-    if (message != NULL) {
-      delete message;
-    }
+    CHECK_EQ(0u, index);
+    encode(message, &data);
+    count++;
+    delete message;
+  }
+
+  // Returns the number of messages in this encoder.
+  size_t messages() const
+  {
+    return count;
   }
 
   static std::string encode(Message* message)
   {
-    std::ostringstream out;
-
-    if (message != NULL) {
-      out << "POST ";
-      // Nothing keeps the 'id' component of a PID from being an empty
-      // string which would create a malformed path that has two
-      // '//' unless we check for it explicitly.
-      // TODO(benh): Make the 'id' part of a PID optional so when it's
-      // missing it's clear that we're simply addressing an ip:port.
-      if (message->to.id != "") {
-        out << "/" << message->to.id;
-      }
+    std::string out;
+    encode(message, &out);
+    return out;
+  }
 
-      out << "/" << message->name << " HTTP/1.1\r\n"
-          << "User-Agent: libprocess/" << message->from << "\r\n"
-          << "Libprocess-From: " << message->from << "\r\n"
-          << "Connection: Keep-Alive\r\n"
-          << "Host: \r\n";
-
-      if (message->body.size() > 0) {
-        out << "Transfer-Encoding: chunked\r\n\r\n"
-            << std::hex << message->body.size() << "\r\n";
-        out.write(message->body.data(), message->body.size());
-        out << "\r\n"
-            << "0\r\n"
-            << "\r\n";
-      } else {
-        out << "\r\n";
-      }
+  // Appends the HTTP request for the message to 'out'. The request
+  // is assembled from preformatted fragments, rather than using an
+  // output stream, since this is done for every message we send.
+  static void encode(const Message* message, std::string* out)
+  {
+    if (message == NULL) {
+      return;
+    }
+
+    static const std::string HEADERS_USER_AGENT =
+      " HTTP/1.1\r\n"
+      "User-Agent: libprocess/";
+
+    static const std::string HEADERS_FROM =
+      "\r\n"
+      "Libprocess-From: ";
+
+    static const std::string HEADERS_END =
+      "\r\n"
+      "Connection: Keep-Alive\r\n"
+      "Host: \r\n";
+
+    static const std::string HEADERS_CHUNKED =
+      "Transfer-Encoding: chunked\r\n\r\n";
+
+    static const std::string CHUNKED_END =
+      "\r\n"
+      "0\r\n"
+      "\r\n";
+
+    const std::string from = message->from;
+
+    // Reserve enough space up front to avoid reallocating while
+    // appending the fragments (the extra space is for the request
+    // line and the chunk size).
+    out->reserve(
+        out->size() +
+        message->to.id.size() +
+        message->name.size() +
+        (2 * from.size()) +
+        HEADERS_USER_AGENT.size() +
+        HEADERS_FROM.size() +
+        HEADERS_END.size() +
+        HEADERS_CHUNKED.size() +
+        CHUNKED_END.size() +
+        message->body.size() +
+        32);
+
+    out->append("POST ");
+
+    // Nothing keeps the 'id' component of a PID from being an empty
+    // string which would create a malformed path that has two
+    // '//' unless we check for it explicitly.
+    // TODO(benh): Make the 'id' part of a PID optional so when it's
+    // missing it's clear that we're simply addressing an ip:port.
+    if (message->to.id != "") {
+      out->append("/");
+      out->append(message->to.id);
+    }
+
+    out->append("/");
+    out->append(message->name);
+    out->append(HEADERS_USER_AGENT);
+    out->append(from);
+    out->append(HEADERS_FROM);
+    out->append(from);
+    out->append(HEADERS_END);
+
+    if (message->body.size() > 0) {
+      char size[32];
+      snprintf(size, sizeof(size), "%zx\r\n", message->body.size());
+
+      out->append(HEADERS_CHUNKED);
+      out->append(size);
+      out->append(message->body);
+      out->append(CHUNKED_END);
+    } else {
+      out->append("\r\n");
+    }
+  }
+
+private:
+  size_t count;
+};
+
+
+// Encodes messages as frames of the binary protocol (see
+// binary_protocol.hpp), interning the strings of each message using
+// the ids of the connection.
+class BinaryMessageEncoder : public DataEncoder
+{
+public:
+  BinaryMessageEncoder(
+      const network::Socket& s,
+      Message* message,
+      binary::Strings* _strings)
+    : DataEncoder(s, ""), strings(_strings), count(0)
+  {
+    append(message);
+  }
+
+  virtual ~BinaryMessageEncoder() {}
+
+  // See MessageEncoder::append. Messages must be appended to encoders
+  // in the order they are going to be sent on the connection since
+  // the ids get assigned as they are encoded.
+  void append(Message* message)
+  {
+    CHECK_EQ(0u, index);
+    encode(message, strings, &data);
+    count++;
+    delete message;
+  }
+
+  size_t messages() const
+  {
+    return count;
+  }
+
+  static void encode(
+      const Message* message,
+      binary::Strings* strings,
+      std::string* out)
+  {
+    if (message == NULL) {
+      return;
     }
 
-    return out.str();
+    // NOTE: Like with HTTP, only the 'id' of the receiver is sent
+    // since the receiver's address is the address of the peer.
+    const uint32_t from = strings->intern(message->from, out);
+    const uint32_t to = strings->intern(message->to.id, out);
+    const uint32_t name = strings->intern(message->name, out);
+
+    binary::append(
+        binary::MESSAGE,
+        (3 * sizeof(uint32_t)) + message->body.size(),
+        out);
+
+    binary::append(from, out);
+    binary::append(to, out);
+    binary::append(name, out);
+    out->append(message->body);
   }
 
 private:
-  Message* message;
+  binary::Strings* strings;
+  size_t count;
 };
 
 
+// Encodes a response as two segments, the headers and the body, so
+// that the body is sent without being copied in with the headers.
+// Bodies smaller than 'SEGMENT_MINIMUM_BODY_LENGTH' are appended to
+// the headers instead since a copy is cheaper than another send.
 class HttpResponseEncoder : public DataEncoder
 {
 public:
@@ -165,17 +304,64 @@ public:
       const network::Socket& s,
       const http::Response& response,
       const http::Request& request)
-    : DataEncoder(s, encode(response, request)) {}
+    : DataEncoder(s, "")
+  {
+    encode(response, request, &data, &body);
+
+    if (body.size() < SEGMENT_MINIMUM_BODY_LENGTH) {
+      data.append(body);
+      body.clear();
+    }
+  }
+
+  virtual ~HttpResponseEncoder() {}
+
+  // Returns the rest of the current segment.
+  virtual const char* next(size_t* length)
+  {
+    if (index < data.size()) {
+      const size_t temp = index;
+      index = data.size();
+      *length = data.size() - temp;
+      return data.data() + temp;
+    }
+
+    const size_t temp = index - data.size();
+    index = data.size() + body.size();
+    *length = body.size() - temp;
+    return body.data() + temp;
+  }
+
+  virtual size_t remaining() const
+  {
+    return data.size() + body.size() - index;
+  }
 
   static std::string encode(
       const http::Response& response,
       const http::Request& request)
   {
-    std::ostringstream out;
+    std::string headers;
+    std::string body;
+
+    encode(response, request, &headers, &body);
+
+    return headers + body;
+  }
 
+  // Encodes the status line and headers into 'out' and the body into
+  // 'body', which gets copied from the response at most once.
+  static void encode(
+      const http::Response& response,
+      const http::Request& request,
+      std::string* out,
+      std::string* body)
+  {
     // TODO(benh): Check version?
 
-    out << "HTTP/1.1 " << response.status << "\r\n";
+    out->append("HTTP/1.1 ");
+    out->append(response.status);
+    out->append("\r\n");
 
     auto headers = response.headers;
 
@@ -197,53 +383,59 @@ public:
     headers["Date"] = date;
 
     // Should we compress this response?
-    std::string body = response.body;
-
     if (response.type == http::Response::BODY &&
         response.body.length() >= GZIP_MINIMUM_BODY_LENGTH &&
         !headers.contains("Content-Encoding") &&
         request.acceptsEncoding("gzip")) {
-      Try<std::string> compressed = gzip::compress(body);
+      Try<std::string> compressed = gzip::compress(response.body);
       if (compressed.isError()) {
         LOG(WARNING) << "Failed to gzip response body: " << compressed.error();
+        *body = response.body;
       } else {
-        body = compressed.get();
-        headers["Content-Length"] = stringify(body.length());
+        *body = std::move(compressed.get());
+        headers["Content-Length"] = stringify(body->length());
         headers["Content-Encoding"] = "gzip";
       }
+    } else if (response.type == http::Response::BODY) {
+      *body = response.body;
     }
 
     foreachpair (const std::string& key, const std::string& value, headers) {
-      out << key << ": " << value << "\r\n";
+      out->append(key);
+      out->append(": ");
+      out->append(value);
+      out->append("\r\n");
     }
 
     // Add a Content-Length header if the response is of type "none"
     // or "body" and no Content-Length header has been supplied.
     if (response.type == http::Response::NONE &&
         !headers.contains("Content-Length")) {
-      out << "Content-Length: 0\r\n";
+      out->append("Content-Length: 0\r\n");
     } else if (response.type == http::Response::BODY &&
                !headers.contains("Content-Length")) {
-      out << "Content-Length: " << body.size() << "\r\n";
+      out->append("Content-Length: ");
+      out->append(stringify(body->size()));
+      out->append("\r\n");
     }
 
     // Use a CRLF to mark end of headers.
-    out << "\r\n";
+    out->append("\r\n");
 
-    // Add the body if necessary.
+    // If the Content-Length header was supplied, only write as much
+    // data as the length specifies.
     if (response.type == http::Response::BODY) {
-      // If the Content-Length header was supplied, only write as much data
-      // as the length specifies.
       Result<uint32_t> length = numify<uint32_t>(headers.get("Content-Length"));
-      if (length.isSome() && length.get() <= body.length()) {
-        out.write(body.data(), length.get());
-      } else {
-        out.write(body.data(), body.size());
+      if (length.isSome() && length.get() <= body->length()) {
+        body->resize(length.get());
       }
     }
-
-    return out.str();
   }
+
+private:
+  static const size_t SEGMENT_MINIMUM_BODY_LENGTH = 16 * 1024;
+
+  std::string body;
 };
 
 
@@ -0,0 +1,166 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <new>
+
+#include <process/event.hpp>
+#include <process/message.hpp>
+
+#include <stout/thread_local.hpp>
+
+#include "event_pool.hpp"
+
+namespace process {
+namespace event_pool {
+
+// Blocks are multiples of this size.
+static const size_t BLOCK_SIZE = 64;
+
+// Number of block sizes, i.e., the largest block is
+// `BLOCK_SIZE * BLOCK_SIZES` bytes.
+static const size_t BLOCK_SIZES = 8;
+
+// Maximum number of blocks of each size cached per thread.
+static const size_t MAX_CACHED_BLOCKS = 256;
+
+// Number of allocations a thread counts locally before publishing.
+static const uint64_t PUBLISH_INTERVAL = 256;
+
+
+// A free block, linked into the cache of a thread.
+struct Block
+{
+  Block* next;
+};
+
+
+// The per thread caches of free blocks, for each block size.
+//
+// NOTE: THREAD_LOCAL requires POD types, so the cached blocks of a
+// thread are not freed when it exits. This bounds the leak to
+// `MAX_CACHED_BLOCKS` blocks of each size per exited thread, while
+// the libprocess threads themselves never exit.
+static THREAD_LOCAL Block* cache[BLOCK_SIZES];
+static THREAD_LOCAL size_t cached[BLOCK_SIZES];
+static THREAD_LOCAL uint64_t unpublished = 0;
+
+
+static std::atomic<uint64_t> allocations(0);
+static std::atomic<uint64_t> heapAllocations(0);
+static std::atomic<uint64_t> heapDeallocations(0);
+static std::atomic<uint64_t> dispatchHeapAllocations(0);
+
+
+void* allocate(size_t size)
+{
+  if (++unpublished == PUBLISH_INTERVAL) {
+    allocations.fetch_add(unpublished, std::memory_order_relaxed);
+    unpublished = 0;
+  }
+
+  if (size == 0 || size > BLOCK_SIZE * BLOCK_SIZES) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    return ::operator new(size);
+  }
+
+  const size_t index = (size - 1) / BLOCK_SIZE;
+
+  Block* block = cache[index];
+  if (block != NULL) {
+    cache[index] = block->next;
+    cached[index]--;
+    return block;
+  }
+
+  heapAllocations.fetch_add(1, std::memory_order_relaxed);
+  return ::operator new((index + 1) * BLOCK_SIZE);
+}
+
+
+void deallocate(void* pointer, size_t size)
+{
+  if (pointer == NULL) {
+    return;
+  }
+
+  if (size == 0 || size > BLOCK_SIZE * BLOCK_SIZES) {
+    heapDeallocations.fetch_add(1, std::memory_order_relaxed);
+    ::operator delete(pointer);
+    return;
+  }
+
+  const size_t index = (size - 1) / BLOCK_SIZE;
+
+  if (cached[index] < MAX_CACHED_BLOCKS) {
+    Block* block = static_cast<Block*>(pointer);
+    block->next = cache[index];
+    cache[index] = block;
+    cached[index]++;
+    return;
+  }
+
+  heapDeallocations.fetch_add(1, std::memory_order_relaxed);
+  ::operator delete(pointer);
+}
+
+
+Statistics statistics()
+{
+  Statistics statistics;
+  statistics.allocations = allocations.load(std::memory_order_relaxed);
+  statistics.heapAllocations =
+    heapAllocations.load(std::memory_order_relaxed);
+  statistics.heapDeallocations =
+    heapDeallocations.load(std::memory_order_relaxed);
+  statistics.dispatchHeapAllocations =
+    dispatchHeapAllocations.load(std::memory_order_relaxed);
+  return statistics;
+}
+
+} // namespace event_pool {
+
+
+void* Event::operator new(size_t size)
+{
+  return event_pool::allocate(size);
+}
+
+
+void Event::operator delete(void* event, size_t size)
+{
+  event_pool::deallocate(event, size);
+}
+
+
+void* Message::operator new(size_t size)
+{
+  return event_pool::allocate(size);
+}
+
+
+void Message::operator delete(void* message, size_t size)
+{
+  event_pool::deallocate(message, size);
+}
+
+
+void DispatchFunction::heapAllocated()
+{
+  event_pool::dispatchHeapAllocations.fetch_add(
+      1, std::memory_order_relaxed);
+}
+
+} // namespace process {
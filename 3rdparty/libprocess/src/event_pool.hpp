@@ -0,0 +1,136 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+
+#ifndef __EVENT_POOL_HPP__
+#define __EVENT_POOL_HPP__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <process/defer.hpp>
+#include <process/future.hpp>
+#include <process/process.hpp>
+
+#include <process/metrics/gauge.hpp>
+#include <process/metrics/metrics.hpp>
+
+namespace process {
+namespace event_pool {
+
+// Allocates and deallocates memory for events and messages from a
+// per-thread cache of fixed size blocks, falling back to the heap
+// when the cache is empty (or full, on deallocation) or the size is
+// larger than the largest block.
+//
+// NOTE: A block can be deallocated by a different thread than the
+// one that allocated it (e.g., an event is usually allocated by the
+// sender and deallocated by the receiver), in which case it is cached
+// by the deallocating thread.
+void* allocate(size_t size);
+void deallocate(void* pointer, size_t size);
+
+
+// Counts of allocations since libprocess was initialized. Counts
+// from each thread are only published periodically, so these lag
+// behind slightly.
+struct Statistics
+{
+  // All event and message allocations.
+  uint64_t allocations;
+
+  // Allocations and deallocations that went to the heap.
+  uint64_t heapAllocations;
+  uint64_t heapDeallocations;
+
+  // Dispatch functions that were too large to be stored inline (see
+  // `DispatchFunction`).
+  uint64_t dispatchHeapAllocations;
+};
+
+
+Statistics statistics();
+
+} // namespace event_pool {
+
+
+// Exposes the event pool statistics as metrics. This is started by
+// default during the initialization of libprocess.
+class EventPoolMetrics : public Process<EventPoolMetrics>
+{
+public:
+  EventPoolMetrics()
+    : ProcessBase("event_pool"),
+      allocations(
+          self().id + "/allocations",
+          defer(self(), &EventPoolMetrics::_allocations)),
+      heap_allocations(
+          self().id + "/heap_allocations",
+          defer(self(), &EventPoolMetrics::_heap_allocations)),
+      heap_deallocations(
+          self().id + "/heap_deallocations",
+          defer(self(), &EventPoolMetrics::_heap_deallocations)),
+      dispatch_heap_allocations(
+          self().id + "/dispatch_heap_allocations",
+          defer(self(), &EventPoolMetrics::_dispatch_heap_allocations)) {}
+
+  virtual ~EventPoolMetrics() {}
+
+protected:
+  virtual void initialize()
+  {
+    // TODO(dhamon): Check return values.
+    metrics::add(allocations);
+    metrics::add(heap_allocations);
+    metrics::add(heap_deallocations);
+    metrics::add(dispatch_heap_allocations);
+  }
+
+  virtual void finalize()
+  {
+    metrics::remove(allocations);
+    metrics::remove(heap_allocations);
+    metrics::remove(heap_deallocations);
+    metrics::remove(dispatch_heap_allocations);
+  }
+
+private:
+  // Gauge handlers.
+  Future<double> _allocations()
+  {
+    return static_cast<double>(event_pool::statistics().allocations);
+  }
+
+  Future<double> _heap_allocations()
+  {
+    return static_cast<double>(event_pool::statistics().heapAllocations);
+  }
+
+  Future<double> _heap_deallocations()
+  {
+    return static_cast<double>(event_pool::statistics().heapDeallocations);
+  }
+
+  Future<double> _dispatch_heap_allocations()
+  {
+    return static_cast<double>(
+        event_pool::statistics().dispatchHeapAllocations);
+  }
+
+  metrics::Gauge allocations;
+  metrics::Gauge heap_allocations;
+  metrics::Gauge heap_deallocations;
+  metrics::Gauge dispatch_heap_allocations;
+};
+
+} // namespace process {
+
+#endif // __EVENT_POOL_HPP__
@@ -0,0 +1,287 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+
+#ifndef __EVENT_QUEUE_HPP__
+#define __EVENT_QUEUE_HPP__
+
+#include <atomic>
+#include <mutex>
+
+#include <process/event.hpp>
+
+#include <stout/synchronized.hpp>
+
+namespace process {
+
+// Multi-producer single-consumer queue of the events of a process.
+//
+// Producers (any thread) enqueue events without taking a lock using
+// the intrusive queue by Dmitry Vyukov: an enqueue is a single atomic
+// exchange followed by a store, and the events themselves are the
+// nodes of the queue (see `Event::next`).
+//
+// The consumer (the thread running the process) drains the queue in
+// batches of up to `BATCH_SIZE` events. The only lock is held by the
+// consumer while draining a batch, and is otherwise only contended
+// with `visit`, which is used for introspection.
+//
+// Injected events are kept on a separate queue that the consumer
+// drains before anything else, including the events of a batch that
+// have not yet been dequeued.
+class EventQueue
+{
+public:
+  EventQueue() : batchIndex(0), batchSize(0)
+  {
+    for (int i = 0; i < KINDS; i++) {
+      counts[i].store(0);
+    }
+  }
+
+  ~EventQueue()
+  {
+    // NOTE: There can no longer be any producers at this point.
+    Event* event = NULL;
+    while ((event = dequeue()) != NULL) {
+      delete event;
+    }
+  }
+
+  // Enqueues the event, at the front of the queue if `inject` is
+  // true. Can be called from any thread.
+  void enqueue(Event* event, bool inject = false)
+  {
+    // Count the event _before_ it becomes visible to the consumer so
+    // that the counts never go negative.
+    counts[kind(*event)].fetch_add(1);
+
+    if (inject) {
+      injected.push(event);
+    } else {
+      events.push(event);
+    }
+  }
+
+  // Returns the next event or NULL if there are none. May return NULL
+  // while a producer is in the middle of enqueueing an event, which
+  // can be detected using `empty`. Must only be called by the
+  // consumer.
+  Event* dequeue()
+  {
+    Event* event = NULL;
+
+    if (!injected.empty()) {
+      synchronized (mutex) {
+        event = injected.pop();
+      }
+    }
+
+    if (event == NULL) {
+      if (batchIndex == batchSize) {
+        batchIndex = 0;
+        batchSize = 0;
+
+        synchronized (mutex) {
+          while (batchSize < BATCH_SIZE) {
+            Event* next = events.pop();
+            if (next == NULL) {
+              break;
+            }
+            batch[batchSize++] = next;
+          }
+        }
+      }
+
+      if (batchIndex < batchSize) {
+        event = batch[batchIndex++];
+      }
+    }
+
+    if (event != NULL) {
+      counts[kind(*event)].fetch_sub(1);
+    }
+
+    return event;
+  }
+
+  // Returns true if there are no events, including events that a
+  // producer is in the middle of enqueueing. Must only be called by
+  // the consumer.
+  bool empty()
+  {
+    return batchIndex == batchSize && injected.empty() && events.empty();
+  }
+
+  // Returns the number of events of type `T` that have been enqueued
+  // but not yet dequeued. Can be called from any thread.
+  template <typename T>
+  size_t count() const
+  {
+    return counts[kind(static_cast<const T*>(NULL))].load();
+  }
+
+  // Visits the events that have not yet been dequeued. Can be called
+  // from any thread. Events that the consumer has already drained
+  // into its current batch are _not_ visited.
+  void visit(EventVisitor* visitor)
+  {
+    synchronized (mutex) {
+      injected.visit(visitor);
+      events.visit(visitor);
+    }
+  }
+
+private:
+  // Maximum number of events the consumer drains at a time.
+  static const size_t BATCH_SIZE = 32;
+
+  enum Kind
+  {
+    MESSAGE,
+    DISPATCH,
+    HTTP,
+    EXITED,
+    TERMINATE,
+    KINDS
+  };
+
+  static Kind kind(const MessageEvent*) { return MESSAGE; }
+  static Kind kind(const DispatchEvent*) { return DISPATCH; }
+  static Kind kind(const HttpEvent*) { return HTTP; }
+  static Kind kind(const ExitedEvent*) { return EXITED; }
+  static Kind kind(const TerminateEvent*) { return TERMINATE; }
+
+  static Kind kind(const Event& event)
+  {
+    struct KindVisitor : EventVisitor
+    {
+      explicit KindVisitor(Kind* _kind) : kind(_kind) {}
+
+      virtual void visit(const MessageEvent&) { *kind = MESSAGE; }
+      virtual void visit(const DispatchEvent&) { *kind = DISPATCH; }
+      virtual void visit(const HttpEvent&) { *kind = HTTP; }
+      virtual void visit(const ExitedEvent&) { *kind = EXITED; }
+      virtual void visit(const TerminateEvent&) { *kind = TERMINATE; }
+
+      Kind* kind;
+    };
+
+    Kind result = MESSAGE;
+    KindVisitor visitor(&result);
+    event.visit(&visitor);
+    return result;
+  }
+
+  // The intrusive multi-producer single-consumer queue. Producers
+  // swap themselves in at the `head` and then link the previous head
+  // to themselves, while the consumer follows the links from the
+  // `tail`. A stub event is used so that the queue is never without
+  // a node.
+  class Queue
+  {
+  public:
+    Queue() : head(&stub), tail(&stub) {}
+
+    void push(Event* event)
+    {
+      event->next.store(NULL, std::memory_order_relaxed);
+      Event* previous = head.exchange(event);
+      previous->next.store(event, std::memory_order_release);
+    }
+
+    // Returns NULL if the queue is empty or if the next event is
+    // still being pushed.
+    Event* pop()
+    {
+      Event* tail = this->tail;
+      Event* next = tail->next.load(std::memory_order_acquire);
+
+      if (tail == &stub) {
+        if (next == NULL) {
+          return NULL;
+        }
+        this->tail = next;
+        tail = next;
+        next = next->next.load(std::memory_order_acquire);
+      }
+
+      if (next != NULL) {
+        this->tail = next;
+        return tail;
+      }
+
+      // The tail is the last event unless a push is in progress.
+      if (tail != head.load()) {
+        return NULL;
+      }
+
+      // Push the stub so that we can remove the last event.
+      push(&stub);
+
+      next = tail->next.load(std::memory_order_acquire);
+      if (next != NULL) {
+        this->tail = next;
+        return tail;
+      }
+
+      return NULL;
+    }
+
+    bool empty()
+    {
+      return tail == &stub && head.load() == &stub;
+    }
+
+    void visit(EventVisitor* visitor)
+    {
+      Event* event = tail;
+      while (event != NULL) {
+        if (event != &stub) {
+          event->visit(visitor);
+        }
+        event = event->next.load(std::memory_order_acquire);
+      }
+    }
+
+  private:
+    struct Stub : Event
+    {
+      virtual void visit(EventVisitor* visitor) const {}
+    };
+
+    Stub stub;
+
+    // Last pushed event, written by the producers.
+    std::atomic<Event*> head;
+
+    // Next event to pop, only accessed by the consumer.
+    Event* tail;
+  };
+
+  Queue events;
+  Queue injected;
+
+  // Protects the queues from the consumer while visiting.
+  std::mutex mutex;
+
+  // Events drained by the consumer and not yet dequeued.
+  Event* batch[BATCH_SIZE];
+  size_t batchIndex;
+  size_t batchSize;
+
+  // Number of enqueued but not yet dequeued events of each kind.
+  std::atomic_long counts[KINDS];
+};
+
+} // namespace process {
+
+#endif // __EVENT_QUEUE_HPP__
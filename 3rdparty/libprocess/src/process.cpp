@@ -103,15 +103,19 @@
 #include <stout/unreachable.hpp>
 
 #include "authenticator_manager.hpp"
+#include "binary_protocol.hpp"
 #include "config.hpp"
 #include "decoder.hpp"
 #include "encoder.hpp"
 #include "event_loop.hpp"
+#include "event_pool.hpp"
+#include "event_queue.hpp"
 #include "gate.hpp"
 #ifdef USE_SSL_SOCKET
 #include "openssl.hpp"
 #endif
 #include "process_reference.hpp"
+#include "run_queue.hpp"
 
 namespace firewall = process::firewall;
 namespace metrics = process::metrics;
@@ -351,12 +355,39 @@ private:
       Socket* socket,
       const UPID& to);
 
+  // Helper function for link_connect() that receives the response to
+  // the request to use the binary protocol on a link.
+  void link_negotiate(
+      const Future<size_t>& length,
+      Socket* socket,
+      char* data,
+      size_t size,
+      ResponseDecoder* decoder);
+
+  // Helper function for link_connect() and link_negotiate() that
+  // starts sending the messages queued while connecting.
+  void link_established(Socket* socket);
+
   // Helper function for send().
   void send_connect(
       const Future<Nothing>& future,
       Socket* socket,
       Message* message);
 
+  // Returns a new encoder for the message using the protocol of the
+  // socket. Assumes the mutex is held.
+  Encoder* encode(const Socket& socket, Message* message);
+
+  // Adds the message to the outgoing queue of the socket, appending
+  // it to the last queued message encoder (if any) so that multiple
+  // messages get written to the socket together. Assumes the mutex
+  // is held.
+  void enqueue(const Socket& socket, Message* message);
+
+  // Starts sending the messages that were queued while delaying the
+  // send to a socket (see 'message_batch_latency').
+  void flush(int s);
+
   // Collection of all actice sockets.
   map<int, Socket*> sockets;
 
@@ -382,6 +413,17 @@ private:
   // Map from socket to outgoing queue.
   map<int, queue<Encoder*>> outgoing;
 
+  // Sockets with a delayed send waiting to be flushed.
+  set<int> delayed;
+
+  // Messages sent on links that are negotiating which protocol to
+  // use. These get encoded once the negotiation completes.
+  map<int, queue<Message*>> negotiating;
+
+  // Maps from socket to the ids of the strings sent on the socket for
+  // links using the binary protocol.
+  map<int, binary::Strings> interned;
+
   // HTTP proxies.
   map<int, HttpProxy*> proxies;
 
@@ -445,9 +487,9 @@ private:
   // Gates for waiting threads (protected by processes_mutex).
   map<ProcessBase*, Gate*> gates;
 
-  // Queue of runnable processes (implemented using list).
-  list<ProcessBase*> runq;
-  std::recursive_mutex runq_mutex;
+  // Queue of runnable processes, created in `init_threads` based on
+  // the LIBPROCESS_RUN_QUEUE environment variable.
+  Owned<RunQueue> runq;
 
   // Number of running processes, to support Clock::settle operation.
   std::atomic_long running;
@@ -503,6 +545,24 @@ THREAD_LOCAL ProcessBase* __process__ = NULL;
 // Per thread executor pointer.
 THREAD_LOCAL Executor* _executor_ = NULL;
 
+// Per thread index of the processing thread (-1 if the thread is not
+// one of the ProcessManager's processing threads).
+THREAD_LOCAL long __worker__ = -1;
+
+// Maximum number of messages that get coalesced into a single write
+// when messages are queued up for the same socket.
+static size_t message_batch_size = 64;
+
+// How long to hold back a message to an idle socket so that messages
+// sent in the meantime can be written together with it. By default
+// messages are only coalesced when a socket is already busy.
+static Duration message_batch_latency = Duration::zero();
+
+// Whether to request the binary protocol (see binary_protocol.hpp)
+// when establishing links. Requests to use the binary protocol are
+// always accepted.
+static bool binary_protocol = false;
+
 
 namespace http {
 namespace authentication {
@@ -631,6 +691,65 @@ static Message* parse(Request* request)
 
 namespace internal {
 
+void decode_recv_binary(
+    const Future<size_t>& length,
+    char* data,
+    size_t size,
+    Socket* socket,
+    BinaryDecoder* decoder)
+{
+  if (length.isDiscarded() || length.isFailed()) {
+    if (length.isFailed()) {
+      VLOG(1) << "Decode failure: " << length.failure();
+    }
+
+    socket_manager->close(*socket);
+    delete[] data;
+    delete decoder;
+    delete socket;
+    return;
+  }
+
+  if (length.get() == 0) {
+    socket_manager->close(*socket);
+    delete[] data;
+    delete decoder;
+    delete socket;
+    return;
+  }
+
+  // Decode as much of the data as possible into messages.
+  const deque<Message*> messages = decoder->decode(data, length.get());
+
+  foreach (Message* message, messages) {
+    VLOG(2) << "Decoded message name '" << message->name
+            << "' for " << message->to << " from " << message->from;
+
+    // TODO(benh): Use the sender PID when delivering in order to
+    // capture happens-before timing relationships for testing.
+    process_manager->deliver(message->to, new MessageEvent(message));
+  }
+
+  if (decoder->failed()) {
+    VLOG(1) << "Decoder error while receiving";
+    socket_manager->close(*socket);
+    delete[] data;
+    delete decoder;
+    delete socket;
+    return;
+  }
+
+  socket->recv(data, size)
+    .onAny(lambda::bind(
+        &decode_recv_binary,
+        lambda::_1,
+        data,
+        size,
+        socket,
+        decoder));
+}
+
+
 void decode_recv(
     const Future<size_t>& length,
     char* data,
@@ -684,10 +803,42 @@ void decode_recv(
       return;
     }
 
+    // The peer switches to the binary protocol right after asking
+    // to use it, so that must be the last request we've received.
+    bool negotiated = binary::negotiation(*requests.back());
+
+    foreach (Request* request, requests) {
+      if (request != requests.back() && binary::negotiation(*request)) {
+        VLOG(1) << "Received data after a request to use the "
+                << binary::PROTOCOL << " protocol";
+        socket_manager->close(*socket);
+        delete[] data;
+        delete decoder;
+        delete socket;
+        return;
+      }
+    }
+
     foreach (Request* request, requests) {
       request->client = address.get();
       process_manager->handle(decoder->socket(), request);
     }
+
+    if (negotiated) {
+      BinaryDecoder* binary = new BinaryDecoder(decoder->socket(), __address__);
+
+      delete decoder;
+
+      socket->recv(data, size)
+        .onAny(lambda::bind(
+            &decode_recv_binary,
+            lambda::_1,
+            data,
+            size,
+            socket,
+            binary));
+      return;
+    }
   }
 
   socket->recv(data, size)
@@ -920,6 +1071,33 @@ void initialize(const string& delegate)
     }
   }
 
+  // Check environment for outgoing message batching.
+  value = os::getenv("LIBPROCESS_MESSAGE_BATCH_SIZE");
+  if (value.isSome()) {
+    Try<size_t> result = numify<size_t>(value.get());
+    if (result.isSome() && result.get() > 0) {
+      message_batch_size = result.get();
+    } else {
+      LOG(FATAL) << "LIBPROCESS_MESSAGE_BATCH_SIZE=" << value.get()
+                 << " is not a valid batch size";
+    }
+  }
+
+  value = os::getenv("LIBPROCESS_MESSAGE_BATCH_LATENCY");
+  if (value.isSome()) {
+    Try<Duration> result = Duration::parse(value.get());
+    if (result.isError()) {
+      LOG(FATAL) << "Parsing LIBPROCESS_MESSAGE_BATCH_LATENCY=" << value.get()
+                 << " failed: " << result.error();
+    }
+    message_batch_latency = result.get();
+  }
+
+  value = os::getenv("LIBPROCESS_ENABLE_BINARY_PROTOCOL");
+  if (value.isSome() && value.get() == "1") {
+    binary_protocol = true;
+  }
+
   // Lookup hostname if missing ip or if ip is 0.0.0.0 in case we
   // actually have a valid external ip address. Note that we need only
   // one ip address, so that other processes can send and receive and
@@ -975,6 +1153,9 @@ void initialize(const string& delegate)
   // Create the global system statistics process.
   spawn(new System(), true);
 
+  // Create the global event pool statistics process.
+  spawn(new EventPoolMetrics(), true);
+
   // Create the global HTTP authentication router.
   authenticator_manager = new AuthenticatorManager();
 
@@ -1145,6 +1326,14 @@ bool HttpProxy::process(const Future<Response>& future, const Request& request)
     return true; // All done, can process next response.
   }
 
+  // Send responses that don't need to be modified directly from the
+  // future to avoid making a copy of (a potentially large) body.
+  if (future.get().type != Response::PATH &&
+      future.get().type != Response::PIPE) {
+    socket_manager->send(future.get(), request, socket);
+    return true; // All done, can process next response.
+  }
+
   Response response = future.get();
 
   // If the response specifies a path, try and perform a sendfile.
@@ -1223,8 +1412,6 @@ bool HttpProxy::process(const Future<Response>& future, const Request& request)
       .onAny(defer(self(), &Self::stream, request, lambda::_1));
 
     return false; // Streaming, don't process next response (yet)!
-  } else {
-    socket_manager->send(response, request, socket);
   }
 
   return true; // All done, can process next response.
@@ -1395,6 +1582,125 @@ void SocketManager::link_connect(
     return;
   }
 
+  bool negotiate = false;
+
+  synchronized (mutex) {
+    negotiate = negotiating.count(*socket) > 0;
+  }
+
+  if (!negotiate) {
+    link_established(socket);
+    return;
+  }
+
+  // Ask the peer to use the binary protocol. We don't send anything
+  // else until we've received the response since the peer switches
+  // protocols right after this request.
+  socket->send(binary::negotiation())
+    .onAny([=](const Future<Nothing>& future) {
+      if (!future.isReady()) {
+        VLOG(1) << "Failed to link, negotiate protocol: "
+                << (future.isFailed() ? future.failure() : "discarded");
+        socket_manager->close(*socket);
+        delete socket;
+        return;
+      }
+
+      size_t size = 4 * 1024;
+      char* data = new char[size];
+
+      socket->recv(data, size)
+        .onAny(lambda::bind(
+            &SocketManager::link_negotiate,
+            this,
+            lambda::_1,
+            socket,
+            data,
+            size,
+            new ResponseDecoder()));
+    });
+}
+
+
+void SocketManager::link_negotiate(
+    const Future<size_t>& length,
+    Socket* socket,
+    char* data,
+    size_t size,
+    ResponseDecoder* decoder)
+{
+  if (!length.isReady() || length.get() == 0) {
+    VLOG(1) << "Failed to link, negotiate protocol: "
+            << (length.isFailed() ? length.failure() : "connection closed");
+    socket_manager->close(*socket);
+    delete[] data;
+    delete decoder;
+    delete socket;
+    return;
+  }
+
+  deque<Response*> responses = decoder->decode(data, length.get());
+
+  if (responses.empty()) {
+    if (decoder->failed()) {
+      VLOG(1) << "Failed to link, negotiate protocol: failed to decode";
+      socket_manager->close(*socket);
+      delete[] data;
+      delete decoder;
+      delete socket;
+      return;
+    }
+
+    socket->recv(data, size)
+      .onAny(lambda::bind(
+          &SocketManager::link_negotiate,
+          this,
+          lambda::_1,
+          socket,
+          data,
+          size,
+          decoder));
+    return;
+  }
+
+  // Peers that don't support the binary protocol respond with
+  // '404 Not Found' and we keep using HTTP.
+  const bool binary = binary::negotiated(*responses.front());
+
+  VLOG(2) << "Using " << (binary ? binary::PROTOCOL : "HTTP")
+          << " protocol for link on socket " << socket->get();
+
+  foreach (Response* response, responses) {
+    delete response;
+  }
+
+  delete[] data;
+  delete decoder;
+
+  synchronized (mutex) {
+    // The socket might have been closed in the meantime, in which
+    // case the queued messages have already been deleted.
+    if (negotiating.count(*socket) > 0) {
+      if (binary) {
+        interned[*socket];
+      }
+
+      queue<Message*> messages = std::move(negotiating[*socket]);
+      negotiating.erase(*socket);
+
+      while (!messages.empty()) {
+        enqueue(*socket, messages.front());
+        messages.pop();
+      }
+    }
+  }
+
+  link_established(socket);
+}
+
+
+void SocketManager::link_established(Socket* socket)
+{
   size_t size = 80 * 1024;
   char* data = new char[size];
 
@@ -1470,6 +1776,12 @@ void SocketManager::link(
       // connected.
       outgoing[s];
 
+      // Hold on to the messages sent while connecting until we know
+      // which protocol the peer can receive.
+      if (binary_protocol) {
+        negotiating[s];
+      }
+
       connect = true;
     }
 
@@ -1747,7 +2059,9 @@ void SocketManager::send(Message* message, const Socket::Kind& kind)
   const Address& address = message->to.address;
 
   Option<Socket> socket = None();
+  Encoder* encoder = NULL;
   bool connect = false;
+  bool delay = false;
 
   synchronized (mutex) {
     // Check if there is already a socket.
@@ -1758,6 +2072,11 @@ void SocketManager::send(Message* message, const Socket::Kind& kind)
       CHECK(sockets.count(s) > 0);
       socket = *sockets[s];
 
+      if (negotiating.count(s) > 0) {
+        negotiating[s].push(message);
+        return;
+      }
+
       // Update whether or not this socket should get disposed after
       // there is no more data to send.
       if (!persist) {
@@ -1765,11 +2084,21 @@ void SocketManager::send(Message* message, const Socket::Kind& kind)
       }
 
       if (outgoing.count(socket.get()) > 0) {
-        outgoing[socket.get()].push(new MessageEncoder(socket.get(), message));
+        enqueue(socket.get(), message);
         return;
       } else {
         // Initialize the outgoing queue.
         outgoing[socket.get()];
+
+        // Hold back the message so that it can be written together
+        // with any messages sent before the delay expires.
+        if (message_batch_latency > Duration::zero()) {
+          enqueue(socket.get(), message);
+          delayed.insert(socket.get());
+          delay = true;
+        } else {
+          encoder = encode(socket.get(), message);
+        }
       }
 
     } else {
@@ -1809,12 +2138,72 @@ void SocketManager::send(Message* message, const Socket::Kind& kind)
           lambda::_1,
           new Socket(socket.get()),
           message));
+  } else if (delay) {
+    CHECK_SOME(socket);
+    Clock::timer(
+        message_batch_latency,
+        lambda::bind(&SocketManager::flush, this, socket.get().get()));
   } else {
     // If we're not connecting and we haven't added the encoder to
     // the 'outgoing' queue then schedule it to be sent.
-    internal::send(
-        new MessageEncoder(socket.get(), message),
-        new Socket(socket.get()));
+    CHECK_NOTNULL(encoder);
+    internal::send(encoder, new Socket(socket.get()));
+  }
+}
+
+
+Encoder* SocketManager::encode(const Socket& socket, Message* message)
+{
+  if (interned.count(socket) > 0) {
+    return new BinaryMessageEncoder(socket, message, &interned[socket]);
+  }
+
+  return new MessageEncoder(socket, message);
+}
+
+
+void SocketManager::enqueue(const Socket& socket, Message* message)
+{
+  queue<Encoder*>& encoders = outgoing[socket];
+
+  // Only message encoders that have not started to be sent can be
+  // appended to, which is true of everything in the outgoing queue.
+  if (!encoders.empty()) {
+    if (interned.count(socket) > 0) {
+      BinaryMessageEncoder* encoder =
+        dynamic_cast<BinaryMessageEncoder*>(encoders.back());
+
+      if (encoder != NULL && encoder->messages() < message_batch_size) {
+        encoder->append(message);
+        return;
+      }
+    } else {
+      MessageEncoder* encoder = dynamic_cast<MessageEncoder*>(encoders.back());
+
+      if (encoder != NULL && encoder->messages() < message_batch_size) {
+        encoder->append(message);
+        return;
+      }
+    }
+  }
+
+  encoders.push(encode(socket, message));
+}
+
+
+void SocketManager::flush(int s)
+{
+  Encoder* encoder = NULL;
+
+  synchronized (mutex) {
+    // The socket might have been closed while we were waiting.
+    if (delayed.erase(s) > 0) {
+      encoder = next(s);
+    }
+  }
+
+  if (encoder != NULL) {
+    internal::send(encoder, new Socket(encoder->socket()));
   }
 }
 
@@ -1866,6 +2255,7 @@ Encoder* SocketManager::next(int s)
           }
 
           dispose.erase(s);
+          interned.erase(s);
 
           auto iterator = sockets.find(s);
 
@@ -1946,7 +2336,19 @@ void SocketManager::close(int s)
         proxies.erase(s);
       }
 
+      // Clean up any messages waiting for the protocol negotiation.
+      if (negotiating.count(s) > 0) {
+        while (!negotiating[s].empty()) {
+          delete negotiating[s].front();
+          negotiating[s].pop();
+        }
+
+        negotiating.erase(s);
+      }
+
       dispose.erase(s);
+      delayed.erase(s);
+      interned.erase(s);
       auto iterator = sockets.find(s);
 
       // We need to stop any 'ignore_data' receivers as they may have
@@ -2141,6 +2543,18 @@ void SocketManager::swap_implementing_socket(const Socket& from, Socket* to)
     outgoing[to_fd] = std::move(outgoing[from_fd]);
     outgoing.erase(from_fd);
 
+    // Update the delayed set if a send is waiting to be flushed.
+    if (delayed.count(from_fd) > 0) {
+      delayed.insert(to_fd);
+      delayed.erase(from_fd);
+    }
+
+    // Move any messages waiting for the protocol negotiation.
+    if (negotiating.count(from_fd) > 0) {
+      negotiating[to_fd] = std::move(negotiating[from_fd]);
+      negotiating.erase(from_fd);
+    }
+
     // Update the fd any proxies are associated with.
     if (proxies.count(from_fd) > 0) {
       proxies[to_fd] = proxies[from_fd];
@@ -2207,6 +2621,20 @@ long ProcessManager::init_threads()
   long cpus = std::max(8L, os::cpu());
   threads.reserve(cpus+1);
 
+  // Determine the run queue implementation. The default is a single
+  // queue shared by all processing threads; 'work_stealing' gives
+  // each processing thread its own queue to reduce lock contention
+  // with many cores.
+  Option<string> value = os::getenv("LIBPROCESS_RUN_QUEUE");
+  if (value.isNone() || value.get() == "global") {
+    runq.reset(new GlobalRunQueue());
+  } else if (value.get() == "work_stealing") {
+    runq.reset(new WorkStealingRunQueue(cpus));
+  } else {
+    LOG(FATAL) << "Unknown LIBPROCESS_RUN_QUEUE=" << value.get()
+               << " (expecting 'global' or 'work_stealing')";
+  }
+
   // Create processing threads.
   for (long i = 0; i < cpus; i++) {
     // Retain the thread handles so that we can join when shutting down.
@@ -2214,7 +2642,9 @@ long ProcessManager::init_threads()
         // We pass a constant reference to `joining` to make it clear that this
         // value is only being tested (read), and not manipulated.
 
-        new std::thread([this]() {
+        new std::thread([this, i]() {
+          __worker__ = i;
+
           do {
             ProcessBase* process = process_manager->dequeue();
             if (process == NULL) {
@@ -2266,6 +2696,24 @@ void ProcessManager::handle(
 {
   CHECK(request != NULL);
 
+  // Check if this is a request to use the binary protocol for the
+  // rest of the connection, which is taken care of when receiving.
+  if (binary::negotiation(*request)) {
+    VLOG(2) << "Accepted request to use the " << binary::PROTOCOL
+            << " protocol from " << request->client;
+
+    OK response;
+    response.headers[binary::PROTOCOL_HEADER] = binary::PROTOCOL;
+
+    // Get the HttpProxy pid for this socket.
+    PID<HttpProxy> proxy = socket_manager->proxy(socket);
+
+    dispatch(proxy, &HttpProxy::enqueue, response, *request);
+
+    delete request;
+    return;
+  }
+
   // Check if this is a libprocess request (i.e., 'User-Agent:
   // libprocess/id@ip:port') and if so, parse as a message.
   if (libprocess(request)) {
@@ -2506,6 +2954,12 @@ void ProcessManager::resume(ProcessBase* process)
 {
   __process__ = process;
 
+  // Remember which processing thread ran this process so that it can
+  // be enqueued on the same thread's run queue (if supported).
+  if (__worker__ >= 0) {
+    process->worker.store(__worker__);
+  }
+
   VLOG(2) << "Resuming " << process->pid << " at " << Clock::now();
 
   bool terminate = false;
@@ -2521,20 +2975,32 @@ void ProcessManager::resume(ProcessBase* process)
   }
 
   while (!terminate && !blocked) {
-    Event* event = NULL;
+    Event* event = process->events->dequeue();
 
-    synchronized (process->mutex) {
-      if (process->events.size() > 0) {
-        event = process->events.front();
-        process->events.pop_front();
-        process->state = ProcessBase::RUNNING;
-      } else {
-        process->state = ProcessBase::BLOCKED;
+    if (event != NULL) {
+      process->state.store(ProcessBase::RUNNING);
+    } else {
+      // There are no events so block the process. An event may have
+      // been enqueued after we tried to dequeue but before we set the
+      // state to BLOCKED, in which case the producer did not see the
+      // process as blocked, so check the queue again afterwards.
+      process->state.store(ProcessBase::BLOCKED);
+
+      if (process->events->empty()) {
         blocked = true;
+      } else {
+        // Try and keep running the process unless a producer has
+        // already seen it as blocked and put it on the run queue,
+        // in which case another thread will resume it.
+        ProcessBase::State expected = ProcessBase::BLOCKED;
+        if (!process->state.compare_exchange_strong(
+                expected, ProcessBase::RUNNING)) {
+          blocked = true;
+        }
       }
     }
 
-    if (!blocked) {
+    if (event != NULL) {
       CHECK(event != NULL);
 
       // Determine if we should filter this event.
@@ -2623,21 +3089,18 @@ void ProcessManager::cleanup(ProcessBase* process)
   // the process we are cleaning up will get dropped (since it's
   // terminating) and eliminates the potential of enqueueing them on
   // another process that gets spawned with the same PID.
-  deque<Event*> events;
-
-  synchronized (process->mutex) {
-    process->state = ProcessBase::TERMINATING;
-    events = process->events;
-    process->events.clear();
-  }
+  process->state.store(ProcessBase::TERMINATING);
 
   // Delete pending events.
-  while (!events.empty()) {
-    Event* event = events.front();
-    events.pop_front();
+  Event* event = NULL;
+  while ((event = process->events->dequeue()) != NULL) {
     delete event;
   }
 
+  // Events enqueued by producers that raced with setting the
+  // terminating state (see below).
+  deque<Event*> events;
+
   // Remove help strings for all installed routes for this process.
   dispatch(help, &Help::remove, process->pid.id);
 
@@ -2653,23 +3116,28 @@ void ProcessManager::cleanup(ProcessBase* process)
 #endif
     }
 
-    synchronized (process->mutex) {
-      CHECK(process->events.empty());
-
-      processes.erase(process->pid.id);
+    // Now that there are no more references, collect any events that
+    // were enqueued by producers that saw the process before it was
+    // terminating. We delete them after releasing the processes lock
+    // for the same reason as above. Any events enqueued without a
+    // reference after this point are deleted along with the process.
+    while ((event = process->events->dequeue()) != NULL) {
+      events.push_back(event);
+    }
 
-      // Lookup gate to wake up waiting threads.
-      map<ProcessBase*, Gate*>::iterator it = gates.find(process);
-      if (it != gates.end()) {
-        gate = it->second;
-        // N.B. The last thread that leaves the gate also free's it.
-        gates.erase(it);
-      }
+    processes.erase(process->pid.id);
 
-      CHECK(process->refs.load() == 0);
-      process->state = ProcessBase::TERMINATED;
+    // Lookup gate to wake up waiting threads.
+    map<ProcessBase*, Gate*>::iterator it = gates.find(process);
+    if (it != gates.end()) {
+      gate = it->second;
+      // N.B. The last thread that leaves the gate also free's it.
+      gates.erase(it);
     }
 
+    CHECK(process->refs.load() == 0);
+    process->state.store(ProcessBase::TERMINATED);
+
     // Note that we don't remove the process from the clock during
     // cleanup, but rather the clock is reset for a process when it is
     // created (see ProcessBase::ProcessBase). We do this so that
@@ -2707,6 +3175,10 @@ void ProcessManager::cleanup(ProcessBase* process)
       gate->open();
     }
   }
+
+  foreach (Event* event, events) {
+    delete event;
+  }
 }
 
 
@@ -2781,23 +3253,22 @@ bool ProcessManager::wait(const UPID& pid)
       // Check if it is runnable in order to donate this thread.
       if (process->state == ProcessBase::BOTTOM ||
           process->state == ProcessBase::READY) {
-        synchronized (runq_mutex) {
-          list<ProcessBase*>::iterator it =
-            find(runq.begin(), runq.end(), process);
-          if (it != runq.end()) {
-            // Found it! Remove it from the run queue since we'll be
-            // donating our thread and also increment 'running' before
-            // leaving this 'runq' protected critical section so that
-            // everyone that is waiting for the processes to settle
-            // continue to wait (otherwise they could see nothing in
-            // 'runq' and 'running' equal to 0 between when we exit
-            // this critical section and increment 'running').
-            runq.erase(it);
-            running.fetch_add(1);
-          } else {
-            // Another thread has resumed the process ...
-            process = NULL;
-          }
+        // Increment 'running' before removing the process from the
+        // run queue so that everyone that is waiting for the
+        // processes to settle continue to wait (otherwise they could
+        // see nothing in 'runq' and 'running' equal to 0 between when
+        // we remove the process and increment 'running').
+        running.fetch_add(1);
+
+        Option<long> worker = None();
+        if (process->worker.load() >= 0) {
+          worker = process->worker.load();
+        }
+
+        if (!runq->remove(process, worker)) {
+          // Another thread has resumed the process ...
+          running.fetch_sub(1);
+          process = NULL;
         }
       } else {
         // Process is not runnable, so no need to donate ...
@@ -2884,16 +3355,18 @@ void ProcessManager::enqueue(ProcessBase* process)
     return;
   }
 
-  // TODO(benh): Check and see if this process has it's own thread. If
-  // it does, push it on that threads runq, and wake up that thread if
-  // it's not running. Otherwise, check and see which thread this
-  // process was last running on, and put it on that threads runq.
+  // Prefer the processing thread that last ran this process, then
+  // the current processing thread (if any).
+  Option<long> worker = None();
 
-  synchronized (runq_mutex) {
-    CHECK(find(runq.begin(), runq.end(), process) == runq.end());
-    runq.push_back(process);
+  if (process->worker.load() >= 0) {
+    worker = process->worker.load();
+  } else if (__worker__ >= 0) {
+    worker = __worker__;
   }
 
+  runq->enqueue(process, worker);
+
   // Wake up the processing thread if necessary.
   gate->open();
 }
@@ -2901,21 +3374,16 @@ void ProcessManager::enqueue(ProcessBase* process)
 
 ProcessBase* ProcessManager::dequeue()
 {
-  // TODO(benh): Remove a process from this thread's runq. If there
-  // are no processes to run, and this is not a dedicated thread, then
-  // steal one from another threads runq.
+  // Increment the running count of processes in order to support the
+  // Clock::settle() operation. This must be done _before_ removing
+  // the process from the run queue so that a process is never
+  // observed as neither queued nor running (see `settle`).
+  running.fetch_add(1);
 
-  ProcessBase* process = NULL;
+  ProcessBase* process = runq->dequeue(__worker__);
 
-  synchronized (runq_mutex) {
-    if (!runq.empty()) {
-      process = runq.front();
-      runq.pop_front();
-      // Increment the running count of processes in order to support
-      // the Clock::settle() operation (this must be done atomically
-      // with removing the process from the runq).
-      running.fetch_add(1);
-    }
+  if (process == NULL) {
+    running.fetch_sub(1);
   }
 
   return process;
@@ -2942,21 +3410,21 @@ void ProcessManager::settle()
 
     done = true; // Assume to start that we are settled.
 
-    synchronized (runq_mutex) {
-      if (!runq.empty()) {
-        done = false;
-        continue;
-      }
+    // NOTE: The run queue must be checked before 'running' since
+    // processes are counted as running before they are dequeued.
+    if (!runq->empty()) {
+      done = false;
+      continue;
+    }
 
-      if (running.load() > 0) {
-        done = false;
-        continue;
-      }
+    if (running.load() > 0) {
+      done = false;
+      continue;
+    }
 
-      if (!Clock::settled()) {
-        done = false;
-        continue;
-      }
+    if (!Clock::settled()) {
+      done = false;
+      continue;
     }
   } while (!done);
 }
@@ -3029,11 +3497,9 @@ Future<Response> ProcessManager::__processes__(const Request&)
         JSON::Array* events;
       } visitor(&events);
 
-      synchronized (process->mutex) {
-        foreach (Event* event, process->events) {
-          event->visit(&visitor);
-        }
-      }
+      // NOTE: This does not include events that the process has
+      // already drained from its queue but not yet served.
+      process->events->visit(&visitor);
 
       object.values["events"] = events;
       array.values.push_back(object);
@@ -3045,6 +3511,7 @@ Future<Response> ProcessManager::__processes__(const Request&)
 
 
 ProcessBase::ProcessBase(const string& id)
+  : events(new EventQueue())
 {
   process::initialize();
 
@@ -3052,6 +3519,8 @@ ProcessBase::ProcessBase(const string& id)
 
   refs = 0;
 
+  worker = -1;
+
   pid.id = id != "" ? id : ID::generate();
   pid.address = __address__;
 
@@ -3071,29 +3540,44 @@ void ProcessBase::enqueue(Event* event, bool inject)
 {
   CHECK(event != NULL);
 
-  synchronized (mutex) {
-    if (state != TERMINATING && state != TERMINATED) {
-      if (!inject) {
-        events.push_back(event);
-      } else {
-        events.push_front(event);
-      }
+  // Don't bother enqueueing events if the process is terminating.
+  // NOTE: An event can still get enqueued if we race with the process
+  // starting to terminate; see `ProcessManager::cleanup`.
+  State old = state.load();
+  if (old == TERMINATING || old == TERMINATED) {
+    delete event;
+    return;
+  }
 
-      if (state == BLOCKED) {
-        state = READY;
-        process_manager->enqueue(this);
-      }
+  events->enqueue(event, inject);
 
-      CHECK(state == BOTTOM ||
-            state == READY ||
-            state == RUNNING);
-    } else {
-      delete event;
-    }
+  // If the process is blocked waiting for events, make it ready and
+  // add it to the run queue. This must be done _after_ enqueueing the
+  // event since the thread running the process checks the queue again
+  // after setting the state to BLOCKED (see `ProcessManager::resume`).
+  old = BLOCKED;
+  if (state.compare_exchange_strong(old, READY)) {
+    process_manager->enqueue(this);
   }
 }
 
 
+template <typename T>
+size_t ProcessBase::eventCount()
+{
+  return events->count<T>();
+}
+
+
+// Explicit instantiations of `ProcessBase::eventCount` for each of the
+// event types.
+template size_t ProcessBase::eventCount<MessageEvent>();
+template size_t ProcessBase::eventCount<DispatchEvent>();
+template size_t ProcessBase::eventCount<HttpEvent>();
+template size_t ProcessBase::eventCount<ExitedEvent>();
+template size_t ProcessBase::eventCount<TerminateEvent>();
+
+
 void ProcessBase::inject(
     const UPID& from,
     const string& name,
@@ -3142,7 +3626,7 @@ void ProcessBase::visit(const MessageEvent& event)
 
 void ProcessBase::visit(const DispatchEvent& event)
 {
-  (*event.f)(this);
+  event.f(this);
 }
 
 
@@ -3490,15 +3974,13 @@ bool exited(const UPID& from, const UPID& to)
 
 namespace internal {
 
-void dispatch(
-    const UPID& pid,
-    const std::shared_ptr<lambda::function<void(ProcessBase*)>>& f,
-    const Option<const std::type_info*>& functionType)
+void dispatch(DispatchEvent* event)
 {
   process::initialize();
 
-  DispatchEvent* event = new DispatchEvent(pid, f, functionType);
-  process_manager->deliver(pid, event, __process__);
+  // NOTE: `deliver` does not use the pid after the event has been
+  // enqueued (or deleted), so we can pass the event's own pid.
+  process_manager->deliver(event->pid, event, __process__);
 }
 
 } // namespace internal {
@@ -12,32 +12,52 @@
 
 #include <glog/logging.h>
 
+#include <errno.h>
+
 #include <sys/types.h>
 #ifndef __WINDOWS__
 #include <sys/wait.h>
 #endif
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
 
+#include <process/defer.hpp>
 #include <process/delay.hpp>
 #include <process/future.hpp>
 #include <process/id.hpp>
+#include <process/io.hpp>
 #include <process/once.hpp>
 #include <process/owned.hpp>
 #include <process/reap.hpp>
 
 #include <stout/check.hpp>
 #include <stout/foreach.hpp>
+#include <stout/hashset.hpp>
+#include <stout/lambda.hpp>
 #include <stout/multihashmap.hpp>
 #include <stout/none.hpp>
 #include <stout/os.hpp>
 #include <stout/result.hpp>
 #include <stout/try.hpp>
 
+#if defined(__linux__) && !defined(SYS_pidfd_open)
+#define SYS_pidfd_open 434 // Since Linux 5.3.
+#endif
+
 namespace process {
 
 
-// TODO(bmahler): This can be optimized to use a thread per pid, where
-// each thread makes a blocking call to waitpid. This eliminates the
-// unfortunate poll delay.
+// Children are watched through a "pidfd" where available, which the
+// event loop notifies us about as soon as the child exits, so that it
+// can be reaped without delay. All other pids (i.e., pids that are
+// not our children, or children on systems without pidfds) are
+// polled, since we can't know when they get reaped by their parent.
+//
+// NOTE: We don't use SIGCHLD (or a signalfd) since a library can't
+// own the disposition of SIGCHLD without clashing with the program
+// (e.g., a JVM) it is part of, and a signalfd requires the signal to
+// be blocked in every thread.
 //
 // Simple bounded linear model for computing the poll interval.
 // Values were chosen such that at (50 pids, 100 ms) the CPU usage is
@@ -64,14 +84,23 @@ Duration MAX_REAP_INTERVAL() { return Seconds(1); }
 class ReaperProcess : public Process<ReaperProcess>
 {
 public:
-  ReaperProcess() : ProcessBase(ID::generate("reaper")) {}
+  ReaperProcess()
+    : ProcessBase(ID::generate("reaper")),
+      pidfds(true) {}
 
   Future<Option<int> > reap(pid_t pid)
   {
     // Check to see if this pid exists.
     if (os::exists(pid)) {
+      const bool watching = promises.contains(pid);
+
       Owned<Promise<Option<int> > > promise(new Promise<Option<int> >());
       promises.put(pid, promise);
+
+      if (!watching) {
+        watch(pid);
+      }
+
       return promise->future();
     } else {
       return None();
@@ -93,7 +122,15 @@ protected:
     // NOTE: A child can only be reaped by us, the parent. If a child exits
     // between waitpid and the (!exists) conditional it will still exist as a
     // zombie; it will be reaped by us on the next loop.
+    size_t polled = 0;
+
     foreach (pid_t pid, promises.keys()) {
+      if (watched.contains(pid)) {
+        continue;
+      }
+
+      polled++;
+
       int status;
       if (os::waitpid(pid, &status, WNOHANG) > 0) {
         // We have reaped a child.
@@ -104,7 +141,33 @@ protected:
       }
     }
 
-    delay(interval(), self(), &ReaperProcess::wait); // Reap forever!
+    delay(interval(polled), self(), &ReaperProcess::wait); // Reap forever!
+  }
+
+  // Invoked once a watched child has exited (or we failed to watch
+  // it, in which case we go back to polling it).
+  void exited(pid_t pid, int fd, const Future<short>& future)
+  {
+    os::close(fd);
+    watched.erase(pid);
+
+    if (!future.isReady()) {
+      LOG(WARNING) << "Failed to watch pid " << pid << " for exiting: "
+                   << (future.isFailed() ? future.failure() : "discarded")
+                   << "; falling back to polling";
+      return;
+    }
+
+    int status;
+    if (os::waitpid(pid, &status, WNOHANG) > 0) {
+      notify(pid, status);
+    } else if (!os::exists(pid)) {
+      // The child has been reaped by someone else (e.g., a call to
+      // waitpid outside of libprocess).
+      notify(pid, None());
+    }
+
+    // Otherwise the pid gets polled from now on.
   }
 
   void notify(pid_t pid, Result<int> status)
@@ -122,10 +185,46 @@ protected:
   }
 
 private:
-  const Duration interval()
+  // Starts watching the pid if it's our child and we can get a pidfd
+  // for it, otherwise leaves the pid to be polled.
+  void watch(pid_t pid)
   {
-    size_t count = promises.size();
+#ifdef __linux__
+    if (!pidfds) {
+      return;
+    }
 
+    // Check whether this is our child that has not exited yet.
+    int status;
+    const pid_t result = os::waitpid(pid, &status, WNOHANG);
+    if (result > 0) {
+      notify(pid, status);
+      return;
+    } else if (result < 0) {
+      return; // Not our child (or already reaped), poll it.
+    }
+
+    const int fd = ::syscall(SYS_pidfd_open, pid, 0);
+    if (fd < 0) {
+      if (errno == ENOSYS) {
+        LOG(INFO) << "The kernel does not support pidfds, "
+                  << "falling back to polling for reaping children";
+
+        pidfds = false;
+      }
+      return;
+    }
+
+    watched.insert(pid);
+
+    // The pidfd becomes readable once the child exits.
+    io::poll(fd, io::READ)
+      .onAny(defer(self(), &Self::exited, pid, fd, lambda::_1));
+#endif // __linux__
+  }
+
+  const Duration interval(size_t count)
+  {
     if (count <= LOW_PID_COUNT) {
       return MIN_REAP_INTERVAL();
     } else if (count >= HIGH_PID_COUNT) {
@@ -141,6 +240,12 @@ private:
   }
 
   multihashmap<pid_t, Owned<Promise<Option<int> > > > promises;
+
+  // Children that are watched through a pidfd rather than polled.
+  hashset<pid_t> watched;
+
+  // Whether the kernel supports pidfds.
+  bool pidfds;
 };
 
 
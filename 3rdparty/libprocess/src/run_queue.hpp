@@ -0,0 +1,279 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+
+#ifndef __RUN_QUEUE_HPP__
+#define __RUN_QUEUE_HPP__
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include <process/owned.hpp>
+#include <process/process.hpp>
+
+#include <stout/foreach.hpp>
+#include <stout/option.hpp>
+#include <stout/synchronized.hpp>
+
+namespace process {
+
+// Queue of runnable processes shared by the processing threads of the
+// ProcessManager. Workers are identified by their index in
+// [0, number of workers). Threads that are not workers (e.g., the
+// event loop thread or a thread donated in `ProcessManager::wait`)
+// enqueue processes without specifying a worker.
+//
+// NOTE: None of the implementations update the count of running
+// processes used by `Clock::settle`; the ProcessManager increments it
+// _before_ attempting to remove a process from the queue so that a
+// process is never observed as neither queued nor running.
+class RunQueue
+{
+public:
+  virtual ~RunQueue() {}
+
+  // Adds the process to the queue. If `worker` is set, implementations
+  // supporting affinity should prefer to run the process on that
+  // worker.
+  virtual void enqueue(ProcessBase* process, const Option<long>& worker) = 0;
+
+  // Removes and returns the next process the specified worker should
+  // run, or NULL if there is nothing to run.
+  virtual ProcessBase* dequeue(long worker) = 0;
+
+  // Removes the specified process from the queue, returning false if
+  // it was not queued (i.e., another thread has already dequeued it).
+  // The `worker` is a hint for where the process was last queued.
+  virtual bool remove(ProcessBase* process, const Option<long>& worker) = 0;
+
+  // Returns true if no process is queued.
+  virtual bool empty() = 0;
+};
+
+
+// A single queue of runnable processes protected by a mutex that is
+// shared by all of the workers.
+class GlobalRunQueue : public RunQueue
+{
+public:
+  virtual void enqueue(ProcessBase* process, const Option<long>& worker)
+  {
+    synchronized (mutex) {
+      CHECK(std::find(runq.begin(), runq.end(), process) == runq.end());
+      runq.push_back(process);
+    }
+  }
+
+  virtual ProcessBase* dequeue(long worker)
+  {
+    ProcessBase* process = NULL;
+
+    synchronized (mutex) {
+      if (!runq.empty()) {
+        process = runq.front();
+        runq.pop_front();
+      }
+    }
+
+    return process;
+  }
+
+  virtual bool remove(ProcessBase* process, const Option<long>& worker)
+  {
+    bool removed = false;
+
+    synchronized (mutex) {
+      std::list<ProcessBase*>::iterator it =
+        std::find(runq.begin(), runq.end(), process);
+
+      if (it != runq.end()) {
+        runq.erase(it);
+        removed = true;
+      }
+    }
+
+    return removed;
+  }
+
+  virtual bool empty()
+  {
+    bool empty = true;
+
+    synchronized (mutex) {
+      empty = runq.empty();
+    }
+
+    return empty;
+  }
+
+private:
+  std::list<ProcessBase*> runq;
+  std::mutex mutex;
+};
+
+
+// A run queue per worker. A worker runs processes from its own queue
+// in FIFO order and, when its queue is empty, steals from the back of
+// the other workers' queues. A process is enqueued on the queue of the
+// worker that last ran it (if known) so that it tends to stay on the
+// same worker (and CPU cache), otherwise on the queue of the enqueuing
+// worker, and otherwise the queues are assigned round-robin.
+//
+// Each queue is protected by its own mutex so the workers only contend
+// with each other when stealing.
+class WorkStealingRunQueue : public RunQueue
+{
+public:
+  explicit WorkStealingRunQueue(long workers)
+    : next(0)
+  {
+    CHECK_GT(workers, 0);
+
+    for (long i = 0; i < workers; i++) {
+      queues.push_back(Owned<Queue>(new Queue()));
+    }
+  }
+
+  virtual void enqueue(ProcessBase* process, const Option<long>& worker)
+  {
+    long index = worker.isSome() && worker.get() >= 0
+      ? worker.get() % static_cast<long>(queues.size())
+      : next.fetch_add(1) % static_cast<long>(queues.size());
+
+    Queue* queue = queues[index].get();
+
+    synchronized (queue->mutex) {
+      queue->processes.push_back(process);
+      queue->size.fetch_add(1);
+    }
+  }
+
+  virtual ProcessBase* dequeue(long worker)
+  {
+    const long workers = static_cast<long>(queues.size());
+
+    // NOTE: Non-worker threads (e.g., a thread that is donated while
+    // waiting) start looking at the first queue.
+    const long self = worker >= 0 ? worker % workers : 0;
+
+    // Try our own queue first.
+    ProcessBase* process = pop(queues[self].get(), true);
+
+    // Now try and steal from the other workers.
+    for (long i = 1; process == NULL && i < workers; i++) {
+      process = pop(queues[(self + i) % workers].get(), false);
+    }
+
+    return process;
+  }
+
+  virtual bool remove(ProcessBase* process, const Option<long>& worker)
+  {
+    const long workers = static_cast<long>(queues.size());
+
+    // Look at the hinted queue first since that is where the process
+    // was most likely enqueued.
+    const long start =
+      worker.isSome() && worker.get() >= 0 ? worker.get() % workers : 0;
+
+    bool removed = false;
+
+    for (long i = 0; !removed && i < workers; i++) {
+      Queue* queue = queues[(start + i) % workers].get();
+
+      synchronized (queue->mutex) {
+        std::deque<ProcessBase*>::iterator it = std::find(
+            queue->processes.begin(),
+            queue->processes.end(),
+            process);
+
+        if (it != queue->processes.end()) {
+          queue->processes.erase(it);
+          queue->size.fetch_sub(1);
+          removed = true;
+        }
+      }
+    }
+
+    return removed;
+  }
+
+  virtual bool empty()
+  {
+    bool empty = true;
+
+    foreach (const Owned<Queue>& queue, queues) {
+      synchronized (queue->mutex) {
+        empty = queue->processes.empty();
+      }
+
+      if (!empty) {
+        break;
+      }
+    }
+
+    return empty;
+  }
+
+private:
+  struct Queue
+  {
+    Queue() : size(0) {}
+
+    std::deque<ProcessBase*> processes;
+    std::mutex mutex;
+
+    // Number of queued processes, used to skip empty queues without
+    // taking their lock when stealing.
+    std::atomic_long size;
+  };
+
+  // Pops a process from the front of the queue (when it is our own)
+  // or the back of the queue (when stealing).
+  static ProcessBase* pop(Queue* queue, bool front)
+  {
+    if (queue->size.load() == 0) {
+      return NULL;
+    }
+
+    ProcessBase* process = NULL;
+
+    synchronized (queue->mutex) {
+      if (!queue->processes.empty()) {
+        if (front) {
+          process = queue->processes.front();
+          queue->processes.pop_front();
+        } else {
+          process = queue->processes.back();
+          queue->processes.pop_back();
+        }
+        queue->size.fetch_sub(1);
+      }
+    }
+
+    return process;
+  }
+
+  std::vector<Owned<Queue>> queues;
+
+  // Used to distribute processes enqueued without a worker.
+  std::atomic_long next;
+};
+
+} // namespace process {
+
+#endif // __RUN_QUEUE_HPP__
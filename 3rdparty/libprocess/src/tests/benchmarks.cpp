@@ -18,32 +18,53 @@
 
 #include <gmock/gmock.h>
 
+#include <atomic>
+#include <deque>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include <process/clock.hpp>
 #include <process/collect.hpp>
+#include <process/dispatch.hpp>
 #include <process/future.hpp>
 #include <process/gmock.hpp>
 #include <process/gtest.hpp>
+#include <process/http.hpp>
 #include <process/owned.hpp>
 #include <process/process.hpp>
+#include <process/subprocess.hpp>
+#include <process/timer.hpp>
 
 #include <stout/duration.hpp>
 #include <stout/gtest.hpp>
 #include <stout/hashset.hpp>
+#include <stout/os.hpp>
 #include <stout/stopwatch.hpp>
+#include <stout/stringify.hpp>
+
+#include "event_queue.hpp"
 
 namespace http = process::http;
 
+using process::Clock;
+using process::DispatchEvent;
+using process::Event;
+using process::EventQueue;
 using process::Future;
 using process::Owned;
 using process::Process;
 using process::ProcessBase;
 using process::Promise;
+using process::Subprocess;
+using process::Timer;
 using process::UPID;
 
+using process::subprocess;
+
 using std::cout;
 using std::endl;
 using std::list;
@@ -374,3 +395,356 @@ TEST(ProcessTest, Process_BENCHMARK_LargeNumberOfLinks)
     delete process;
   }
 }
+
+
+class CounterProcess : public Process<CounterProcess>
+{
+public:
+  CounterProcess() : count(0) {}
+
+  void increment()
+  {
+    ++count;
+  }
+
+  Future<size_t> get()
+  {
+    return count;
+  }
+
+private:
+  size_t count;
+};
+
+
+// Measures the throughput of dispatches from a varying number of
+// threads, each dispatching to a few processes of its own. This
+// mostly exercises the run queue of the ProcessManager, so it is
+// useful to compare the LIBPROCESS_RUN_QUEUE implementations.
+TEST(ProcessTest, Process_BENCHMARK_DispatchThroughput)
+{
+  const size_t dispatches = 100000;
+  const size_t processesPerThread = 4;
+
+  Option<string> runq = os::getenv("LIBPROCESS_RUN_QUEUE");
+
+  cout << "Run queue: " << (runq.isSome() ? runq.get() : "global") << endl;
+
+  foreach (size_t threads, vector<size_t>({1, 2, 4, 8, 16, 32})) {
+    vector<Owned<CounterProcess>> processes;
+    for (size_t i = 0; i < threads * processesPerThread; i++) {
+      processes.push_back(Owned<CounterProcess>(new CounterProcess()));
+      spawn(processes.back().get());
+    }
+
+    Stopwatch watch;
+    watch.start();
+
+    vector<std::thread> dispatchers;
+    for (size_t i = 0; i < threads; i++) {
+      dispatchers.emplace_back([&processes, i, processesPerThread]() {
+        for (size_t j = 0; j < dispatches; j++) {
+          const Owned<CounterProcess>& process =
+            processes[i * processesPerThread + j % processesPerThread];
+
+          dispatch(process.get(), &CounterProcess::increment);
+        }
+      });
+    }
+
+    foreach (std::thread& dispatcher, dispatchers) {
+      dispatcher.join();
+    }
+
+    // Wait for all of the dispatches to be processed.
+    list<Future<size_t>> counts;
+    foreach (const Owned<CounterProcess>& process, processes) {
+      counts.push_back(dispatch(process.get(), &CounterProcess::get));
+    }
+
+    Future<list<size_t>> collected = collect(counts);
+    AWAIT_READY(collected);
+
+    Duration elapsed = watch.elapsed();
+
+    size_t total = 0;
+    foreach (size_t count, collected.get()) {
+      total += count;
+    }
+
+    EXPECT_EQ(threads * dispatches, total);
+
+    cout << threads << " threads: "
+         << (threads * dispatches) / elapsed.secs() << " dispatches / sec"
+         << endl;
+
+    foreach (const Owned<CounterProcess>& process, processes) {
+      terminate(process.get());
+      wait(process.get());
+    }
+  }
+}
+
+
+// Measures the throughput of enqueueing events into, and dequeueing
+// events from, the queue of a process with a varying number of
+// producer threads. The lock-free `EventQueue` is compared to a
+// mutex protected `std::deque` like the one it replaced.
+TEST(ProcessTest, Process_BENCHMARK_EventQueueThroughput)
+{
+  const size_t eventsPerProducer = 1000000;
+
+  foreach (size_t producers, vector<size_t>({1, 2, 4, 8, 16})) {
+    const size_t total = producers * eventsPerProducer;
+
+    // Pre-allocate the events so that we only measure the queues.
+    vector<Event*> events;
+    events.reserve(total);
+    for (size_t i = 0; i < total; i++) {
+      events.push_back(new DispatchEvent(UPID(), [](ProcessBase*) {}, None()));
+    }
+
+    // Lock-free queue.
+    {
+      EventQueue queue;
+
+      Stopwatch watch;
+      watch.start();
+
+      vector<std::thread> threads;
+      for (size_t i = 0; i < producers; i++) {
+        threads.emplace_back([&queue, &events, i, eventsPerProducer]() {
+          for (size_t j = 0; j < eventsPerProducer; j++) {
+            queue.enqueue(events[i * eventsPerProducer + j]);
+          }
+        });
+      }
+
+      size_t dequeued = 0;
+      while (dequeued < total) {
+        if (queue.dequeue() != NULL) {
+          dequeued++;
+        }
+      }
+
+      foreach (std::thread& thread, threads) {
+        thread.join();
+      }
+
+      Duration elapsed = watch.elapsed();
+
+      EXPECT_TRUE(queue.empty());
+
+      cout << "EventQueue with " << producers << " producers: "
+           << total / elapsed.secs() << " events / sec" << endl;
+    }
+
+    // Mutex protected deque.
+    {
+      std::deque<Event*> queue;
+      std::mutex mutex;
+
+      Stopwatch watch;
+      watch.start();
+
+      vector<std::thread> threads;
+      for (size_t i = 0; i < producers; i++) {
+        threads.emplace_back(
+            [&queue, &mutex, &events, i, eventsPerProducer]() {
+          for (size_t j = 0; j < eventsPerProducer; j++) {
+            synchronized (mutex) {
+              queue.push_back(events[i * eventsPerProducer + j]);
+            }
+          }
+        });
+      }
+
+      size_t dequeued = 0;
+      while (dequeued < total) {
+        synchronized (mutex) {
+          if (!queue.empty()) {
+            queue.pop_front();
+            dequeued++;
+          }
+        }
+      }
+
+      foreach (std::thread& thread, threads) {
+        thread.join();
+      }
+
+      Duration elapsed = watch.elapsed();
+
+      cout << "std::deque with " << producers << " producers: "
+           << total / elapsed.secs() << " events / sec" << endl;
+    }
+
+    foreach (Event* event, events) {
+      delete event;
+    }
+  }
+}
+
+
+
+// Measures the cost of creating, canceling and expiring timers with a
+// large number of timers pending, as happens with many outstanding
+// offers or (status update) retries. Half of the timers are canceled
+// before the clock is advanced to expire the rest.
+TEST(ProcessTest, Process_BENCHMARK_Timers)
+{
+  Clock::pause();
+
+  foreach (size_t count, vector<size_t>({10000, 100000, 1000000})) {
+    std::atomic<size_t> expired(0);
+
+    vector<Timer> timers;
+    timers.reserve(count);
+
+    Stopwatch watch;
+    watch.start();
+
+    // Spread the timeouts over an hour, like (re)offer timeouts.
+    for (size_t i = 0; i < count; i++) {
+      timers.push_back(Clock::timer(
+          Milliseconds((i * 7919) % (60 * 60 * 1000)),
+          [&expired]() { expired++; }));
+    }
+
+    Duration created = watch.elapsed();
+
+    watch.start();
+
+    for (size_t i = 0; i < count; i += 2) {
+      EXPECT_TRUE(Clock::cancel(timers[i]));
+    }
+
+    Duration canceled = watch.elapsed();
+
+    watch.start();
+
+    Clock::advance(Hours(1));
+    Clock::settle();
+
+    Duration elapsed = watch.elapsed();
+
+    EXPECT_EQ(count / 2, expired.load());
+
+    cout << count << " timers: created in " << created
+         << " (" << created / count << " per timer), "
+         << "canceled half in " << canceled
+         << " (" << canceled / (count / 2) << " per timer), "
+         << "expired the rest in " << elapsed
+         << " (" << elapsed / (count / 2) << " per timer)" << endl;
+  }
+
+  Clock::resume();
+}
+
+
+// Measures the latency of launching a subprocess as the resident set
+// of the parent grows. A subprocess with a 'setup' function has to be
+// forked, which copies the page tables of the parent, while one
+// without is spawned.
+TEST(ProcessTest, Process_BENCHMARK_SubprocessLaunch)
+{
+  const size_t launches = 50;
+
+  foreach (size_t megabytes, vector<size_t>({0, 256, 1024, 4096})) {
+    // Grow (and touch) the resident set of this process.
+    const vector<char> memory(megabytes * 1024 * 1024, 1);
+
+    foreach (bool fork, vector<bool>({false, true})) {
+      Option<lambda::function<int()>> setup = None();
+      if (fork) {
+        setup = []() { return 0; };
+      }
+
+      Duration elapsed = Duration::zero();
+
+      for (size_t i = 0; i < launches; i++) {
+        Stopwatch watch;
+        watch.start();
+
+        Try<Subprocess> s = subprocess(
+            "true",
+            {"true"},
+            Subprocess::PATH("/dev/null"),
+            Subprocess::PATH("/dev/null"),
+            Subprocess::PATH("/dev/null"),
+            None(),
+            None(),
+            setup);
+
+        elapsed += watch.elapsed();
+
+        ASSERT_SOME(s);
+        AWAIT_READY(s.get().status());
+      }
+
+      cout << (fork ? "Forking" : "Spawning") << " with " << megabytes
+           << "MB resident took " << elapsed / launches
+           << " per subprocess" << endl;
+    }
+  }
+}
+
+class LargeResponseProcess : public Process<LargeResponseProcess>
+{
+public:
+  explicit LargeResponseProcess(size_t size) : body(size, 'a') {}
+
+protected:
+  virtual void initialize()
+  {
+    route("/body", None(), &LargeResponseProcess::_body);
+  }
+
+private:
+  Future<http::Response> _body(const http::Request&)
+  {
+    return http::OK(body);
+  }
+
+  const string body;
+};
+
+
+// Measures the throughput of serving multi-megabyte HTTP responses,
+// which is dominated by how many times the body gets copied between
+// the handler and the socket (e.g., for '/state' of large clusters).
+TEST(ProcessTest, Process_BENCHMARK_LargeHttpResponse)
+{
+  const size_t requests = 20;
+
+  // Don't let compression dominate the measurements.
+  http::Headers headers;
+  headers["Accept-Encoding"] = "identity";
+
+  foreach (size_t megabytes, vector<size_t>({1, 4, 16, 64})) {
+    const size_t size = megabytes * 1024 * 1024;
+
+    LargeResponseProcess process(size);
+    spawn(process);
+
+    Stopwatch watch;
+    watch.start();
+
+    for (size_t i = 0; i < requests; i++) {
+      Future<http::Response> response =
+        http::get(process.self(), "body", None(), headers);
+
+      AWAIT_READY(response);
+      ASSERT_EQ(size, response.get().body.size());
+    }
+
+    Duration elapsed = watch.elapsed();
+
+    cout << megabytes << "MB responses: "
+         << (requests * megabytes) / elapsed.secs() << " MB / sec"
+         << " (" << elapsed / requests << " per response)" << endl;
+
+    terminate(process);
+    wait(process);
+  }
+}
@@ -15,19 +15,30 @@
 #include <deque>
 #include <string>
 
+#include <process/message.hpp>
+#include <process/pid.hpp>
+#include <process/process.hpp>
 #include <process/socket.hpp>
 
 #include <stout/gtest.hpp>
 
+#include "binary_protocol.hpp"
 #include "decoder.hpp"
+#include "encoder.hpp"
 
+namespace binary = process::binary;
 namespace http = process::http;
 
+using process::BinaryDecoder;
+using process::BinaryMessageEncoder;
 using process::DataDecoder;
 using process::Future;
+using process::Message;
 using process::ResponseDecoder;
 using process::StreamingResponseDecoder;
+using process::UPID;
 
+using process::network::Address;
 using process::network::Socket;
 
 using std::deque;
@@ -253,3 +264,66 @@ TEST(DecoderTest, StreamingResponseFailure)
   EXPECT_TRUE(read.isFailed());
   EXPECT_EQ("failed to decode body", read.failure());
 }
+
+
+TEST(DecoderTest, Binary)
+{
+  Try<Socket> socket = Socket::create();
+  ASSERT_SOME(socket);
+
+  const Address address = process::address();
+
+  binary::Strings strings;
+  string data;
+
+  for (int i = 0; i < 3; i++) {
+    Message message;
+    message.name = "name" + stringify(i % 2);
+    message.from = UPID("from@127.0.0.1:5050");
+    message.to = UPID("to", address);
+    message.body = string(i * 1024, 'a');
+
+    BinaryMessageEncoder::encode(&message, &strings, &data);
+  }
+
+  // Decode the data a byte at a time to check that the decoder
+  // handles frames that are split across reads.
+  BinaryDecoder decoder(socket.get(), address);
+  deque<Message*> messages;
+
+  for (size_t i = 0; i < data.size(); i++) {
+    deque<Message*> decoded = decoder.decode(data.data() + i, 1);
+    ASSERT_FALSE(decoder.failed());
+    messages.insert(messages.end(), decoded.begin(), decoded.end());
+  }
+
+  ASSERT_EQ(3u, messages.size());
+
+  for (int i = 0; i < 3; i++) {
+    EXPECT_EQ("name" + stringify(i % 2), messages[i]->name);
+    EXPECT_EQ(UPID("from@127.0.0.1:5050"), messages[i]->from);
+    EXPECT_EQ(UPID("to", address), messages[i]->to);
+    EXPECT_EQ(string(i * 1024, 'a'), messages[i]->body);
+    delete messages[i];
+  }
+}
+
+
+TEST(DecoderTest, BinaryUndefinedId)
+{
+  Try<Socket> socket = Socket::create();
+  ASSERT_SOME(socket);
+
+  // A message referring to ids that were never defined.
+  string data;
+  binary::append(binary::MESSAGE, 3 * sizeof(uint32_t), &data);
+  binary::append(1, &data);
+  binary::append(2, &data);
+  binary::append(3, &data);
+
+  BinaryDecoder decoder(socket.get(), process::address());
+  deque<Message*> messages = decoder.decode(data.data(), data.size());
+
+  EXPECT_TRUE(messages.empty());
+  EXPECT_TRUE(decoder.failed());
+}
@@ -17,6 +17,8 @@
 #include <vector>
 
 #include <process/http.hpp>
+#include <process/message.hpp>
+#include <process/pid.hpp>
 #include <process/socket.hpp>
 
 #include <stout/gtest.hpp>
@@ -26,8 +28,14 @@
 
 namespace http = process::http;
 
+using process::DataDecoder;
 using process::HttpResponseEncoder;
+using process::Message;
+using process::MessageEncoder;
 using process::ResponseDecoder;
+using process::UPID;
+
+using process::network::Socket;
 
 using std::deque;
 using std::string;
@@ -63,6 +71,57 @@ TEST(EncoderTest, Response)
 }
 
 
+// Tests that a large body is sent as a separate segment from the
+// headers, and that the segments are resumed correctly after a
+// partial send.
+TEST(EncoderTest, ResponseSegments)
+{
+  Try<Socket> socket = Socket::create();
+  ASSERT_SOME(socket);
+
+  http::Request request;
+  const http::OK response(string(1024 * 1024, 'a'));
+
+  HttpResponseEncoder encoder(socket.get(), response, request);
+
+  string encoded;
+  size_t length = 0;
+  const char* data = NULL;
+
+  // The headers.
+  data = encoder.next(&length);
+  EXPECT_EQ(response.body.size(), encoder.remaining());
+  ASSERT_LT(length, response.body.size());
+  encoded.append(data, length);
+
+  // Half of the body, as if the send was partial.
+  data = encoder.next(&length);
+  ASSERT_EQ(response.body.size(), length);
+  encoder.backup(length / 2);
+  encoded.append(data, length / 2);
+
+  // The rest of the body.
+  data = encoder.next(&length);
+  ASSERT_EQ(response.body.size() - response.body.size() / 2, length);
+  encoded.append(data, length);
+
+  EXPECT_EQ(0u, encoder.remaining());
+
+  EXPECT_EQ(HttpResponseEncoder::encode(response, request).size(),
+            encoded.size());
+
+  ResponseDecoder decoder;
+  deque<http::Response*> responses =
+    decoder.decode(encoded.data(), encoded.length());
+
+  ASSERT_FALSE(decoder.failed());
+  ASSERT_EQ(1, responses.size());
+  EXPECT_EQ(response.body, responses[0]->body);
+
+  delete responses[0];
+}
+
+
 TEST(EncoderTest, AcceptableEncodings)
 {
   // Create requests that do not accept gzip encoding.
@@ -109,3 +168,90 @@ TEST(EncoderTest, AcceptableEncodings)
       << gzipRequest.headers.get("Accept-Encoding").get() << "'";
   }
 }
+
+
+TEST(EncoderTest, Message)
+{
+  Message message;
+  message.name = "name";
+  message.from = UPID("from@127.0.0.1:5050");
+  message.to = UPID("to@127.0.0.1:5051");
+  message.body = "body";
+
+  const string encoded = MessageEncoder::encode(&message);
+
+  EXPECT_EQ(
+      "POST /to/name HTTP/1.1\r\n"
+      "User-Agent: libprocess/" + stringify(message.from) + "\r\n"
+      "Libprocess-From: " + stringify(message.from) + "\r\n"
+      "Connection: Keep-Alive\r\n"
+      "Host: \r\n"
+      "Transfer-Encoding: chunked\r\n"
+      "\r\n"
+      "4\r\n"
+      "body\r\n"
+      "0\r\n"
+      "\r\n",
+      encoded);
+
+  // A message without a body is not chunked.
+  message.body.clear();
+
+  EXPECT_EQ(
+      "POST /to/name HTTP/1.1\r\n"
+      "User-Agent: libprocess/" + stringify(message.from) + "\r\n"
+      "Libprocess-From: " + stringify(message.from) + "\r\n"
+      "Connection: Keep-Alive\r\n"
+      "Host: \r\n"
+      "\r\n",
+      MessageEncoder::encode(&message));
+}
+
+
+// Tests that messages appended to a message encoder are written as
+// consecutive requests that decode back into the original messages.
+TEST(EncoderTest, MessageBatch)
+{
+  Try<Socket> socket = Socket::create();
+  ASSERT_SOME(socket);
+
+  const size_t count = 10;
+
+  Option<MessageEncoder> encoder;
+
+  for (size_t i = 0; i < count; i++) {
+    Message* message = new Message();
+    message->name = "name" + stringify(i);
+    message->from = UPID("from@127.0.0.1:5050");
+    message->to = UPID("to@127.0.0.1:5051");
+    message->body = string(i, 'a');
+
+    if (encoder.isNone()) {
+      encoder = MessageEncoder(socket.get(), message);
+    } else {
+      encoder.get().append(message);
+    }
+  }
+
+  ASSERT_SOME(encoder);
+  EXPECT_EQ(count, encoder.get().messages());
+
+  // All of the messages are returned at once.
+  size_t length;
+  const char* data = encoder.get().next(&length);
+
+  EXPECT_EQ(0u, encoder.get().remaining());
+
+  DataDecoder decoder(socket.get());
+  deque<http::Request*> requests = decoder.decode(data, length);
+
+  ASSERT_FALSE(decoder.failed());
+  ASSERT_EQ(count, requests.size());
+
+  for (size_t i = 0; i < count; i++) {
+    EXPECT_EQ("POST", requests[i]->method);
+    EXPECT_EQ("/to/name" + stringify(i), requests[i]->url.path);
+    EXPECT_EQ(string(i, 'a'), requests[i]->body);
+    delete requests[i];
+  }
+}
@@ -19,7 +19,10 @@
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 
+#include <array>
 #include <atomic>
+#include <deque>
+#include <mutex>
 #include <sstream>
 #include <string>
 #include <tuple>
@@ -42,6 +45,7 @@
 #include <process/run.hpp>
 #include <process/socket.hpp>
 #include <process/time.hpp>
+#include <process/timer.hpp>
 
 #include <stout/duration.hpp>
 #include <stout/gtest.hpp>
@@ -52,17 +56,25 @@
 #include <stout/os.hpp>
 #include <stout/stopwatch.hpp>
 #include <stout/stringify.hpp>
+#include <stout/synchronized.hpp>
 #include <stout/try.hpp>
 
+#include "binary_protocol.hpp"
+#include "decoder.hpp"
 #include "encoder.hpp"
+#include "event_pool.hpp"
 
+namespace binary = process::binary;
 namespace http = process::http;
 namespace inject = process::inject;
 
 using process::async;
+using process::BinaryMessageEncoder;
 using process::Clock;
 using process::defer;
 using process::Deferred;
+using process::DispatchEvent;
+using process::DispatchFunction;
 using process::Event;
 using process::Executor;
 using process::ExitedEvent;
@@ -76,9 +88,11 @@ using process::PID;
 using process::Process;
 using process::ProcessBase;
 using process::Promise;
+using process::ResponseDecoder;
 using process::run;
 using process::TerminateEvent;
 using process::Time;
+using process::Timer;
 using process::UPID;
 
 using process::firewall::DisabledEndpointsFirewallRule;
@@ -87,6 +101,7 @@ using process::firewall::FirewallRule;
 using process::network::Address;
 using process::network::Socket;
 
+using std::deque;
 using std::move;
 using std::string;
 using std::vector;
@@ -616,6 +631,48 @@ TEST(ProcessTest, Dispatch)
 }
 
 
+// Tests that small dispatch functions are stored inline in the event
+// while larger ones are stored on the heap, and that both get invoked.
+TEST(ProcessTest, DispatchFunctionInline)
+{
+  namespace event_pool = process::event_pool;
+
+  int invoked = 0;
+
+  uint64_t heapAllocations =
+    event_pool::statistics().dispatchHeapAllocations;
+
+  {
+    DispatchEvent event(
+        UPID(),
+        [&invoked](ProcessBase*) { invoked++; },
+        None());
+
+    event.f(NULL);
+  }
+
+  EXPECT_EQ(1, invoked);
+  EXPECT_EQ(heapAllocations,
+            event_pool::statistics().dispatchHeapAllocations);
+
+  {
+    std::array<char, DispatchFunction::INLINE_SIZE> large;
+    large.fill('a');
+
+    DispatchEvent event(
+        UPID(),
+        [&invoked, large](ProcessBase*) { invoked += large[0] == 'a'; },
+        None());
+
+    event.f(NULL);
+  }
+
+  EXPECT_EQ(2, invoked);
+  EXPECT_EQ(heapAllocations + 1,
+            event_pool::statistics().dispatchHeapAllocations);
+}
+
+
 TEST(ProcessTest, Defer1)
 {
   ASSERT_TRUE(GTEST_IS_THREADSAFE);
@@ -1016,6 +1073,45 @@ TEST(ProcessTest, Delay)
 }
 
 
+
+// Tests that canceled timers don't fire, and that the remaining
+// timers fire in order of their timeouts, including timers that are
+// further out than a slot of the timer wheel and share a timeout.
+TEST(ProcessTest, CancelTimers)
+{
+  Clock::pause();
+
+  std::mutex mutex;
+  vector<int> fired;
+
+  vector<Timer> timers;
+  foreach (int i, vector<int>({5, 1, 300, 3, 70000, 300, 2})) {
+    timers.push_back(Clock::timer(Milliseconds(i), [&mutex, &fired, i]() {
+      synchronized (mutex) {
+        fired.push_back(i);
+      }
+    }));
+  }
+
+  EXPECT_TRUE(Clock::cancel(timers[1]));
+  EXPECT_TRUE(Clock::cancel(timers[2]));
+
+  // A canceled timer can't be canceled again.
+  EXPECT_FALSE(Clock::cancel(timers[1]));
+
+  Clock::advance(Milliseconds(70000));
+  Clock::settle();
+
+  synchronized (mutex) {
+    EXPECT_EQ(vector<int>({2, 3, 5, 300, 70000}), fired);
+  }
+
+  // An expired timer can't be canceled.
+  EXPECT_FALSE(Clock::cancel(timers[0]));
+
+  Clock::resume();
+}
+
 class OrderProcess : public Process<OrderProcess>
 {
 public:
@@ -1379,6 +1475,69 @@ TEST(ProcessTest, Remote)
 }
 
 
+// Like the 'remote' test but switches the connection to the binary
+// protocol before sending the messages.
+TEST(ProcessTest, RemoteBinaryProtocol)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+
+  RemoteProcess process;
+  spawn(process);
+
+  Future<Nothing> handler1;
+  EXPECT_CALL(process, handler(_, "hello"))
+    .WillOnce(FutureSatisfy(&handler1));
+
+  Future<Nothing> handler2;
+  EXPECT_CALL(process, handler(_, "world"))
+    .WillOnce(FutureSatisfy(&handler2));
+
+  Try<Socket> create = Socket::create();
+  ASSERT_SOME(create);
+
+  Socket socket = create.get();
+
+  AWAIT_READY(socket.connect(process.self().address));
+
+  AWAIT_READY(socket.send(binary::negotiation()));
+
+  Future<string> received = socket.recv();
+  AWAIT_READY(received);
+
+  ResponseDecoder decoder;
+  deque<http::Response*> responses =
+    decoder.decode(received.get().data(), received.get().size());
+
+  ASSERT_EQ(1u, responses.size());
+  EXPECT_TRUE(binary::negotiated(*responses.front()));
+  delete responses.front();
+
+  Message message;
+  message.name = "handler";
+  message.from = UPID();
+  message.to = process.self();
+
+  // Both messages are sent together, with the strings of the second
+  // message referring to the ids defined by the first.
+  binary::Strings strings;
+  string data;
+
+  message.body = "hello";
+  BinaryMessageEncoder::encode(&message, &strings, &data);
+
+  message.body = "world";
+  BinaryMessageEncoder::encode(&message, &strings, &data);
+
+  AWAIT_READY(socket.send(data));
+
+  AWAIT_READY(handler1);
+  AWAIT_READY(handler2);
+
+  terminate(process);
+  wait(process);
+}
+
+
 // Like the 'remote' test but uses http::connect.
 TEST(ProcessTest, Http1)
 {
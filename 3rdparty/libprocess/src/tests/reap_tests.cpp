@@ -14,6 +14,9 @@
 #include <unistd.h>
 
 #include <sys/wait.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
 
 #include <gtest/gtest.h>
 
@@ -29,6 +32,10 @@
 #include <stout/os/pstree.hpp>
 #include <stout/try.hpp>
 
+#if defined(__linux__) && !defined(SYS_pidfd_open)
+#define SYS_pidfd_open 434 // Since Linux 5.3.
+#endif
+
 using process::Clock;
 using process::Future;
 using process::MAX_REAP_INTERVAL;
@@ -143,6 +150,51 @@ TEST(ReapTest, ChildProcess)
 }
 
 
+
+#ifdef __linux__
+// This test checks that a child process is reaped as soon as it exits
+// rather than when it's next polled (the clock is paused, so polling
+// never happens), on kernels that support pidfds.
+TEST(ReapTest, ChildProcessWithoutPolling)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+
+  const int pidfd = ::syscall(SYS_pidfd_open, getpid(), 0);
+  if (pidfd < 0) {
+    std::cerr << "Skipping test, pidfds are not supported: "
+              << os::strerror(errno) << std::endl;
+    return;
+  }
+
+  os::close(pidfd);
+
+  // The child process sleeps and will be killed by the parent.
+  Try<ProcessTree> tree = Fork(None(),
+                               Exec("sleep 10"))();
+
+  ASSERT_SOME(tree);
+  pid_t child = tree.get();
+
+  Clock::pause();
+
+  // Reap the child process.
+  Future<Option<int> > status = process::reap(child);
+
+  // Now kill the child.
+  EXPECT_EQ(0, kill(child, SIGKILL));
+
+  AWAIT_READY(status);
+
+  // Check if the status is correct.
+  ASSERT_SOME(status.get());
+  int status_ = status.get().get();
+  ASSERT_TRUE(WIFSIGNALED(status_));
+  ASSERT_EQ(SIGKILL, WTERMSIG(status_));
+
+  Clock::resume();
+}
+#endif // __linux__
+
 // Check that we can reap a child process that is already exited.
 TEST(ReapTest, TerminatedChildProcess)
 {
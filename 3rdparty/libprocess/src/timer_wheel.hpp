@@ -0,0 +1,509 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+
+#ifndef __TIMER_WHEEL_HPP__
+#define __TIMER_WHEEL_HPP__
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <list>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include <process/pid.hpp>
+#include <process/time.hpp>
+#include <process/timer.hpp>
+
+#include <stout/check.hpp>
+#include <stout/duration.hpp>
+#include <stout/foreach.hpp>
+#include <stout/hashmap.hpp>
+#include <stout/none.hpp>
+#include <stout/option.hpp>
+
+namespace process {
+
+// A hierarchical timing wheel of timers (see "Hashed and Hierarchical
+// Timing Wheels" by Varghese and Lauck).
+//
+// Time is divided into ticks of 'resolution'. The wheel has 'LEVELS'
+// levels of 'SLOTS' slots each: a slot on level 0 holds the timers
+// that expire during a single tick, a slot on level 1 the timers that
+// expire during 'SLOTS' ticks, and so on. As the wheel advances, the
+// timers in a slot on a higher level get "cascaded" to the lower
+// levels once the slot comes up. Timers further out than the last
+// level can hold are kept in its slot furthest out and cascaded
+// again until they come within range.
+//
+// Adding and removing a timer are O(1), and advancing the wheel only
+// looks at slots that have timers. Timers expire at exactly their
+// timeout, the ticks only determine which slot a timer is kept in.
+//
+// NOTE: This is not thread-safe, the Clock protects it with a mutex.
+class TimerWheel
+{
+public:
+  explicit TimerWheel(const Duration& _resolution = Milliseconds(1))
+    : resolution(_resolution.ns()), current(0), count(0)
+  {
+    CHECK_GT(resolution, 0);
+
+    for (size_t level = 0; level < LEVELS; level++) {
+      for (size_t slot = 0; slot < SLOTS; slot++) {
+        slots[level][slot].head = NULL;
+        slots[level][slot].tail = NULL;
+      }
+
+      for (size_t word = 0; word < WORDS; word++) {
+        occupied[level][word] = 0;
+      }
+    }
+  }
+
+  ~TimerWheel()
+  {
+    clear();
+  }
+
+  // Moves an empty wheel to 'now'. Timers are kept in slots relative
+  // to the tick the wheel is at, so this should be done before adding
+  // timers to an empty wheel to avoid cascading them needlessly.
+  void position(const Time& now)
+  {
+    CHECK_EQ(0u, count);
+    current = tick(now);
+  }
+
+  void add(const Timer& timer)
+  {
+    CHECK(!index.contains(timer.id));
+
+    Entry* entry = new Entry(timer, tick(timer.timeout().time()));
+    index[timer.id] = entry;
+    insert(entry);
+    count++;
+
+    if (earliest.isSome() && entry->time() < earliest.get()) {
+      earliest = entry->time();
+    }
+  }
+
+  // Removes the timer, returning false if it has already expired (or
+  // was never added).
+  bool remove(const Timer& timer)
+  {
+    hashmap<uint64_t, Entry*>::iterator it = index.find(timer.id);
+    if (it == index.end()) {
+      return false;
+    }
+
+    Entry* entry = it->second;
+    index.erase(it);
+    unlink(entry);
+    count--;
+
+    if (earliest.isSome() && entry->time() <= earliest.get()) {
+      earliest = None();
+    }
+
+    delete entry;
+    return true;
+  }
+
+  // Removes and returns the timers with a timeout at or before 'now',
+  // in order of their timeouts (and then of their creation).
+  std::list<Timer> advance(const Time& now)
+  {
+    std::vector<Entry*> expired;
+
+    const int64_t target = tick(now);
+
+    while (true) {
+      // The timers in the slot of the current tick are the only ones
+      // that can be due.
+      Slot* slot = &slots[0][current & MASK];
+      Entry* entry = slot->head;
+      while (entry != NULL) {
+        Entry* next = entry->next;
+        if (entry->time() <= now) {
+          unlink(entry);
+          expired.push_back(entry);
+        }
+        entry = next;
+      }
+
+      if (current >= target) {
+        break;
+      }
+
+      // Skip ahead to the next tick that has anything to do.
+      Option<Event> event = upcoming();
+      if (event.isNone() || event->tick > target) {
+        current = target;
+      } else {
+        current = event->tick;
+        cascade();
+      }
+    }
+
+    std::sort(expired.begin(), expired.end(), &Entry::before);
+
+    std::list<Timer> timers;
+    foreach (Entry* entry, expired) {
+      index.erase(entry->timer.id);
+      timers.push_back(entry->timer);
+      delete entry;
+    }
+
+    count -= expired.size();
+
+    // Cascading may have changed what is next even if nothing expired.
+    earliest = None();
+
+    return timers;
+  }
+
+  // Returns a time such that no timer expires before it (or None if
+  // there are no timers). This is exact unless the earliest timers
+  // still need to be cascaded, in which case it is the time they get
+  // cascaded; advancing the wheel to this time always makes progress.
+  Option<Time> next()
+  {
+    if (count == 0) {
+      return None();
+    }
+
+    if (earliest.isSome()) {
+      return earliest;
+    }
+
+    Option<Time> result = None();
+
+    // Timers in the slot of the current tick.
+    result = min(result, first(slots[0][current & MASK].head));
+
+    Option<Event> event = upcoming();
+    if (event.isSome()) {
+      if (event->level == 0) {
+        result = min(
+            result,
+            first(slots[0][event->tick & MASK].head));
+      } else {
+        result = min(result, time(event->tick));
+      }
+    }
+
+    CHECK_SOME(result);
+
+    earliest = result;
+    return earliest;
+  }
+
+  bool empty() const
+  {
+    return count == 0;
+  }
+
+  size_t size() const
+  {
+    return count;
+  }
+
+  void clear()
+  {
+    foreachvalue (Entry* entry, index) {
+      delete entry;
+    }
+
+    index.clear();
+
+    for (size_t level = 0; level < LEVELS; level++) {
+      for (size_t slot = 0; slot < SLOTS; slot++) {
+        slots[level][slot].head = NULL;
+        slots[level][slot].tail = NULL;
+      }
+
+      for (size_t word = 0; word < WORDS; word++) {
+        occupied[level][word] = 0;
+      }
+    }
+
+    count = 0;
+    earliest = None();
+  }
+
+private:
+  static const size_t LEVELS = 4;
+  static const size_t BITS = 8; // Per level.
+  static const size_t SLOTS = 1 << BITS;
+  static const int64_t MASK = SLOTS - 1;
+  static const size_t WORDS = SLOTS / 64;
+
+  struct Entry
+  {
+    Entry(const Timer& _timer, int64_t _tick)
+      : timer(_timer), tick(_tick), level(0), slot(0), prev(NULL), next(NULL)
+    {}
+
+    Time time() const
+    {
+      return timer.timeout().time();
+    }
+
+    static bool before(const Entry* left, const Entry* right)
+    {
+      if (left->time() != right->time()) {
+        return left->time() < right->time();
+      }
+
+      return left->timer.id < right->timer.id;
+    }
+
+    const Timer timer;
+    const int64_t tick;
+
+    // Where the entry is in the wheel.
+    size_t level;
+    size_t slot;
+    Entry* prev;
+    Entry* next;
+  };
+
+  struct Slot
+  {
+    Entry* head;
+    Entry* tail;
+  };
+
+  // The next tick at which there are timers to expire or cascade, on
+  // which level.
+  struct Event
+  {
+    int64_t tick;
+    size_t level;
+  };
+
+  int64_t tick(const Time& time) const
+  {
+    // NOTE: Ticks are floored so that a timer never ends up in a slot
+    // for a tick that starts after it expires.
+    const int64_t ns = time.duration().ns();
+    return ns >= 0 ? ns / resolution : ((ns + 1) / resolution) - 1;
+  }
+
+  Time time(int64_t tick) const
+  {
+    return Time::epoch() + Nanoseconds(tick * resolution);
+  }
+
+  static Option<Time> min(const Option<Time>& left, const Option<Time>& right)
+  {
+    if (left.isNone()) {
+      return right;
+    } else if (right.isNone()) {
+      return left;
+    }
+
+    return std::min(left.get(), right.get());
+  }
+
+  static Option<Time> first(const Entry* entry)
+  {
+    Option<Time> result = None();
+    for (; entry != NULL; entry = entry->next) {
+      result = min(result, entry->time());
+    }
+    return result;
+  }
+
+  // Puts the entry in the slot for its tick relative to the current
+  // tick of the wheel.
+  void insert(Entry* entry)
+  {
+    int64_t delta = entry->tick - current;
+
+    size_t level = 0;
+    int64_t tick = entry->tick;
+
+    if (delta < 0) {
+      // Already due, keep it with the timers of the current tick.
+      tick = current;
+    } else {
+      // Keep timers that are too far out in the slot furthest out of
+      // the last level, they get cascaded back to it until in range.
+      const int64_t range = int64_t(1) << (BITS * LEVELS);
+      if (delta >= range) {
+        delta = range - 1;
+        tick = current + delta;
+      }
+
+      while (level < LEVELS - 1 &&
+             delta >= (int64_t(1) << (BITS * (level + 1)))) {
+        level++;
+      }
+    }
+
+    const size_t slot = (tick >> (BITS * level)) & MASK;
+
+    entry->level = level;
+    entry->slot = slot;
+    entry->prev = slots[level][slot].tail;
+    entry->next = NULL;
+
+    if (entry->prev != NULL) {
+      entry->prev->next = entry;
+    } else {
+      slots[level][slot].head = entry;
+    }
+
+    slots[level][slot].tail = entry;
+    occupied[level][slot / 64] |= uint64_t(1) << (slot % 64);
+  }
+
+  void unlink(Entry* entry)
+  {
+    Slot* slot = &slots[entry->level][entry->slot];
+
+    if (entry->prev != NULL) {
+      entry->prev->next = entry->next;
+    } else {
+      slot->head = entry->next;
+    }
+
+    if (entry->next != NULL) {
+      entry->next->prev = entry->prev;
+    } else {
+      slot->tail = entry->prev;
+    }
+
+    if (slot->head == NULL) {
+      occupied[entry->level][entry->slot / 64] &=
+        ~(uint64_t(1) << (entry->slot % 64));
+    }
+
+    entry->prev = NULL;
+    entry->next = NULL;
+  }
+
+  // Moves the timers in the slots of the higher levels that start at
+  // the current tick down to the lower levels.
+  void cascade()
+  {
+    for (size_t level = LEVELS - 1; level > 0; level--) {
+      const int64_t span = int64_t(1) << (BITS * level);
+      if ((current & (span - 1)) != 0) {
+        continue;
+      }
+
+      Slot* slot = &slots[level][(current >> (BITS * level)) & MASK];
+
+      Entry* entry = slot->head;
+
+      slot->head = NULL;
+      slot->tail = NULL;
+      occupied[level][((current >> (BITS * level)) & MASK) / 64] &=
+        ~(uint64_t(1) << (((current >> (BITS * level)) & MASK) % 64));
+
+      while (entry != NULL) {
+        Entry* next = entry->next;
+        insert(entry);
+        entry = next;
+      }
+    }
+  }
+
+  // Returns the offset (in slots) from 'start' of the first occupied
+  // slot at or after 'start', wrapping around, or None.
+  Option<size_t> find(size_t level, size_t start) const
+  {
+    for (size_t i = 0; i <= WORDS; i++) {
+      const size_t word = ((start / 64) + i) % WORDS;
+
+      uint64_t bits = occupied[level][word];
+
+      if (i == 0) {
+        // Ignore the slots before 'start' in the first word.
+        bits &= ~uint64_t(0) << (start % 64);
+      } else if (i == WORDS) {
+        // Only the slots before 'start' are left in the last word.
+        bits &= (start % 64) == 0 ? 0 : ~(~uint64_t(0) << (start % 64));
+      }
+
+      if (bits != 0) {
+        size_t bit = 0;
+        while ((bits & 1) == 0) {
+          bits >>= 1;
+          bit++;
+        }
+
+        return ((word * 64) + bit - start) & MASK;
+      }
+    }
+
+    return None();
+  }
+
+  // Returns the next tick after the current one with timers to
+  // expire (on level 0) or cascade (on the higher levels).
+  Option<Event> upcoming() const
+  {
+    Option<Event> result = None();
+
+    for (size_t level = 0; level < LEVELS; level++) {
+      const int64_t block = current >> (BITS * level);
+
+      // On level 0 we look for the slots _after_ the current tick, on
+      // the higher levels the slot of the current tick has already
+      // been cascaded so a timer in it is a full rotation away.
+      Option<size_t> offset = find(level, (block + 1) & MASK);
+      if (offset.isNone()) {
+        continue;
+      }
+
+      const int64_t tick = (block + 1 + offset.get()) << (BITS * level);
+
+      if (result.isNone() || tick < result->tick) {
+        Event event;
+        event.tick = tick;
+        event.level = level;
+        result = event;
+      }
+    }
+
+    return result;
+  }
+
+  // Length of a tick in nanoseconds.
+  const int64_t resolution;
+
+  // The tick the wheel has been advanced to.
+  int64_t current;
+
+  Slot slots[LEVELS][SLOTS];
+
+  // Bitmaps of the slots that have timers, for each level.
+  uint64_t occupied[LEVELS][WORDS];
+
+  // The entries of the timers, for removing them.
+  hashmap<uint64_t, Entry*> index;
+
+  size_t count;
+
+  // Cached result of 'next()'.
+  Option<Time> earliest;
+};
+
+} // namespace process {
+
+#endif // __TIMER_WHEEL_HPP__
@@ -84,6 +84,16 @@ public:
    *     allocations from the frameworks.
    * @param weights Configured per-role weights. Any roles that do not
    *     appear in this map will be assigned the default weight of 1.
+   * @param allocationShards The number of shards the allocator may
+   *     partition the agents into in order to perform (parts of) an
+   *     allocation in parallel. An allocator may ignore this.
+   * @param minAllocationInterval The minimum amount of time between two
+   *     allocations that are triggered by events (as opposed to the batch
+   *     allocations every `allocationInterval`).
+   * @param agentOrdering The order in which the allocator should allocate
+   *     the resources of the agents, e.g., "random" or "binpack". See the
+   *     `--agent_ordering` master flag for the supported orderings. An
+   *     allocator may ignore this.
    */
   virtual void initialize(
       const Duration& allocationInterval,
@@ -94,7 +104,10 @@ public:
           void(const FrameworkID&,
                const hashmap<SlaveID, UnavailableResources>&)>&
         inverseOfferCallback,
-      const hashmap<std::string, double>& weights) = 0;
+      const hashmap<std::string, double>& weights,
+      size_t allocationShards,
+      const Duration& minAllocationInterval,
+      const std::string& agentOrdering) = 0;
 
   /**
    * Informs the allocator of the recovered state from the master.
@@ -0,0 +1,225 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+
+#include <stout/foreach.hpp>
+
+#include "common/resource_quantities.hpp"
+
+using std::ostream;
+using std::pair;
+using std::string;
+using std::vector;
+
+namespace mesos {
+
+ResourceQuantities ResourceQuantities::fromScalarResources(
+    const Resources& resources)
+{
+  ResourceQuantities result;
+
+  foreach (const Resource& resource, resources) {
+    if (resource.type() == Value::SCALAR) {
+      result.set(
+          resource.name(),
+          result.get(resource.name()) + resource.scalar().value());
+    }
+  }
+
+  return result;
+}
+
+
+Resources ResourceQuantities::toUnreservedResources() const
+{
+  Resources result;
+
+  foreach (const auto& quantity, quantities) {
+    Resource resource;
+    resource.set_name(quantity.first);
+    resource.set_type(Value::SCALAR);
+    resource.mutable_scalar()->set_value(quantity.second);
+    resource.set_role("*");
+
+    result += resource;
+  }
+
+  return result;
+}
+
+
+static bool compare(const pair<string, double>& left, const string& right)
+{
+  return left.first < right;
+}
+
+
+double ResourceQuantities::get(const string& name) const
+{
+  const_iterator it =
+    std::lower_bound(quantities.begin(), quantities.end(), name, compare);
+
+  if (it != quantities.end() && it->first == name) {
+    return it->second;
+  }
+
+  return 0.0;
+}
+
+
+void ResourceQuantities::set(const string& name, double quantity)
+{
+  vector<pair<string, double>>::iterator it =
+    std::lower_bound(quantities.begin(), quantities.end(), name, compare);
+
+  if (it != quantities.end() && it->first == name) {
+    if (quantity > 0.0) {
+      it->second = quantity;
+    } else {
+      quantities.erase(it);
+    }
+  } else if (quantity > 0.0) {
+    quantities.insert(it, std::make_pair(name, quantity));
+  }
+}
+
+
+bool ResourceQuantities::contains(const ResourceQuantities& that) const
+{
+  const_iterator it = quantities.begin();
+
+  foreach (const auto& quantity, that.quantities) {
+    while (it != quantities.end() && it->first < quantity.first) {
+      ++it;
+    }
+
+    if (it == quantities.end() ||
+        it->first != quantity.first ||
+        it->second < quantity.second) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+bool ResourceQuantities::operator==(const ResourceQuantities& that) const
+{
+  return quantities == that.quantities;
+}
+
+
+bool ResourceQuantities::operator!=(const ResourceQuantities& that) const
+{
+  return !(*this == that);
+}
+
+
+ResourceQuantities ResourceQuantities::operator+(
+    const ResourceQuantities& that) const
+{
+  ResourceQuantities result = *this;
+  result += that;
+  return result;
+}
+
+
+ResourceQuantities ResourceQuantities::operator-(
+    const ResourceQuantities& that) const
+{
+  ResourceQuantities result = *this;
+  result -= that;
+  return result;
+}
+
+
+ResourceQuantities& ResourceQuantities::operator+=(
+    const ResourceQuantities& that)
+{
+  // Merge the two sorted vectors.
+  vector<pair<string, double>> result;
+  result.reserve(quantities.size() + that.quantities.size());
+
+  const_iterator left = quantities.begin();
+  const_iterator right = that.quantities.begin();
+
+  while (left != quantities.end() || right != that.quantities.end()) {
+    if (right == that.quantities.end() ||
+        (left != quantities.end() && left->first < right->first)) {
+      result.push_back(*left++);
+    } else if (left == quantities.end() || right->first < left->first) {
+      result.push_back(*right++);
+    } else {
+      result.push_back(
+          std::make_pair(left->first, left->second + right->second));
+      ++left;
+      ++right;
+    }
+  }
+
+  quantities = std::move(result);
+  return *this;
+}
+
+
+ResourceQuantities& ResourceQuantities::operator-=(
+    const ResourceQuantities& that)
+{
+  vector<pair<string, double>>::iterator it = quantities.begin();
+
+  foreach (const auto& quantity, that.quantities) {
+    while (it != quantities.end() && it->first < quantity.first) {
+      ++it;
+    }
+
+    if (it != quantities.end() && it->first == quantity.first) {
+      it->second -= quantity.second;
+    }
+  }
+
+  // Remove the quantities that are all used up.
+  quantities.erase(
+      std::remove_if(
+          quantities.begin(),
+          quantities.end(),
+          [](const pair<string, double>& quantity) {
+            return quantity.second <= 0.0;
+          }),
+      quantities.end());
+
+  return *this;
+}
+
+
+ostream& operator<<(ostream& stream, const ResourceQuantities& quantities)
+{
+  bool first = true;
+
+  foreach (const auto& quantity, quantities) {
+    if (!first) {
+      stream << ";";
+    }
+
+    stream << quantity.first << ":" << quantity.second;
+    first = false;
+  }
+
+  return stream;
+}
+
+} // namespace mesos {
@@ -0,0 +1,99 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __COMMON_RESOURCE_QUANTITIES_HPP__
+#define __COMMON_RESOURCE_QUANTITIES_HPP__
+
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <mesos/resources.hpp>
+
+namespace mesos {
+
+// The quantities of scalar resources by name (e.g., "cpus:4;mem:1024"),
+// without any of the other information of the resources (e.g., roles,
+// reservations or disks). This is all that is needed for calculations
+// like shares and quota, and it's much cheaper than using `Resources`
+// for them: the quantities are kept as a vector of (name, quantity)
+// pairs sorted by name (there are usually only a handful of names),
+// so arithmetic is a merge of two short vectors of doubles rather
+// than a search and comparison of protobufs for each resource.
+//
+// Only positive quantities are kept: a name with a quantity of zero
+// (or less, after subtracting) is removed.
+class ResourceQuantities
+{
+public:
+  // NOTE: The quantities can only be iterated over, not modified
+  // through an iterator, as that could break the ordering.
+  typedef std::vector<std::pair<std::string, double>>::const_iterator
+    const_iterator;
+  typedef const_iterator iterator;
+
+  // Returns the quantities of the scalar resources in 'resources'.
+  // Resources that are not scalars are ignored.
+  static ResourceQuantities fromScalarResources(const Resources& resources);
+
+  ResourceQuantities() {}
+
+  // Returns the quantities as unreserved scalar resources (i.e., with
+  // the '*' role), for arithmetic with `Resources`.
+  Resources toUnreservedResources() const;
+
+  // Returns the quantity of the named resource, 0 if there is none.
+  double get(const std::string& name) const;
+
+  // Sets the quantity of the named resource.
+  void set(const std::string& name, double quantity);
+
+  // Returns true if there is at least as much of each resource in
+  // this as there is in 'that'.
+  bool contains(const ResourceQuantities& that) const;
+
+  bool empty() const { return quantities.empty(); }
+  size_t size() const { return quantities.size(); }
+
+  const_iterator begin() const { return quantities.begin(); }
+  const_iterator end() const { return quantities.end(); }
+
+  // These are needed for 'foreach'.
+  const_iterator begin() { return quantities.begin(); }
+  const_iterator end() { return quantities.end(); }
+
+  bool operator==(const ResourceQuantities& that) const;
+  bool operator!=(const ResourceQuantities& that) const;
+
+  ResourceQuantities operator+(const ResourceQuantities& that) const;
+  ResourceQuantities operator-(const ResourceQuantities& that) const;
+
+  ResourceQuantities& operator+=(const ResourceQuantities& that);
+  ResourceQuantities& operator-=(const ResourceQuantities& that);
+
+private:
+  std::vector<std::pair<std::string, double>> quantities;
+};
+
+
+std::ostream& operator<<(
+    std::ostream& stream,
+    const ResourceQuantities& quantities);
+
+} // namespace mesos {
+
+#endif // __COMMON_RESOURCE_QUANTITIES_HPP__
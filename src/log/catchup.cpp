@@ -16,9 +16,13 @@
 
 #include <stdint.h>
 
+#include <algorithm>
+#include <deque>
 #include <list>
+#include <set>
 
 #include <process/collect.hpp>
+#include <process/defer.hpp>
 #include <process/id.hpp>
 #include <process/process.hpp>
 #include <process/timer.hpp>
@@ -33,7 +37,9 @@
 
 using namespace process;
 
+using std::deque;
 using std::list;
+using std::set;
 
 namespace mesos {
 namespace internal {
@@ -166,9 +172,10 @@ static Future<uint64_t> catchup(
 
 
 // TODO(jieyu): Our current implementation catches-up each position in
-// the set sequentially. In the future, we may want to parallelize it
-// to improve the performance. Also, we may want to implement rate
-// control here so that we don't saturate the network or disk.
+// the set sequentially. Bulk catch-up of the positions that other
+// replicas have learned is done by 'transfer' (see below), so this is
+// typically only used to fill the few positions that are left. We may
+// still want to parallelize it to improve the performance.
 class BulkCatchUpProcess : public Process<BulkCatchUpProcess>
 {
 public:
@@ -308,6 +315,205 @@ static Future<Nothing> catchup(
 }
 
 
+class TransferProcess : public Process<TransferProcess>
+{
+public:
+  TransferProcess(
+      const Shared<Replica>& _replica,
+      const Shared<Network>& _network,
+      const IntervalSet<uint64_t>& _positions,
+      size_t _chunk,
+      size_t _window,
+      const Duration& _timeout)
+    : ProcessBase(ID::generate("log-transfer")),
+      replica(_replica),
+      network(_network),
+      positions(_positions),
+      chunk(_chunk),
+      window(_window),
+      timeout(_timeout),
+      outstanding(0),
+      transferred(0) {}
+
+  virtual ~TransferProcess() {}
+
+  Future<Nothing> future() { return promise.future(); }
+
+protected:
+  virtual void initialize()
+  {
+    CHECK_GT(chunk, 0u);
+    CHECK_GT(window, 0u);
+
+    // Stop when no one cares.
+    promise.future().onDiscard(lambda::bind(
+        static_cast<void(*)(const UPID&, bool)>(terminate), self(), true));
+
+    // Split the positions into the ranges that we request.
+    foreach (const Interval<uint64_t>& interval, positions) {
+      uint64_t lower = interval.lower();
+      while (lower < interval.upper()) {
+        const uint64_t upper =
+          lower + std::min<uint64_t>(chunk, interval.upper() - lower);
+
+        ranges.push_back(
+            (Bound<uint64_t>::closed(lower), Bound<uint64_t>::open(upper)));
+
+        lower = upper;
+      }
+    }
+
+    network->members()
+      .onAny(defer(self(), &Self::_initialize, lambda::_1));
+  }
+
+  virtual void finalize()
+  {
+    // TODO(jieyu): Discard the outstanding requests. They time out
+    // eventually in any case.
+    promise.discard();
+  }
+
+private:
+  void _initialize(const Future<set<UPID>>& members)
+  {
+    if (members.isReady()) {
+      foreach (const UPID& pid, members.get()) {
+        if (pid != replica->pid()) {
+          peers.push_back(pid);
+        }
+      }
+    }
+
+    transfer();
+  }
+
+  void transfer()
+  {
+    // Keep the window of requests to the current peer full.
+    while (outstanding < window && !ranges.empty() && !peers.empty()) {
+      const Interval<uint64_t> range = ranges.front();
+      ranges.pop_front();
+
+      const UPID peer = peers.front();
+
+      TransferRequest request;
+      request.set_from(range.lower());
+      request.set_to(range.upper() - 1);
+
+      outstanding++;
+
+      protocol::transfer(peer, request)
+        .after(timeout, [](Future<TransferResponse> future)
+                          -> Future<TransferResponse> {
+          future.discard();
+          return Failure("Timed out");
+        })
+        .onAny(defer(self(), &Self::received, peer, range, lambda::_1));
+    }
+
+    if (outstanding == 0) {
+      // Either all the positions have been transferred, or there are
+      // no more peers to transfer the rest from.
+      LOG(INFO) << "Transferred " << transferred << " learned action(s)"
+                << (ranges.empty() ? "" : ", leaving some positions to be"
+                                          " caught-up");
+
+      promise.set(Nothing());
+      terminate(self());
+    }
+  }
+
+  void received(
+      const UPID& peer,
+      const Interval<uint64_t>& range,
+      const Future<TransferResponse>& future)
+  {
+    if (!future.isReady() ||
+        future.get().status() != Metadata::VOTING ||
+        !future.get().has_end()) {
+      LOG(INFO) << "Unable to transfer positions " << range.lower()
+                << " -> " << range.upper() - 1 << " from " << peer << ": "
+                << (future.isFailed()
+                    ? future.failure()
+                    : future.isDiscarded()
+                      ? "discarded"
+                      : "replica is in " + stringify(future.get().status()) +
+                        " status");
+
+      // Request the range from the next peer. The other outstanding
+      // requests to this peer are likely to fail too, in which case
+      // the peer has already been moved on from.
+      ranges.push_front(range);
+
+      if (!peers.empty() && peers.front() == peer) {
+        peers.pop_front();
+      }
+
+      outstanding--;
+      transfer();
+      return;
+    }
+
+    const TransferResponse& response = future.get();
+
+    // Request the rest of the range if the response was cut short.
+    if (response.end() + 1 < range.upper()) {
+      ranges.push_front(
+          (Bound<uint64_t>::closed(response.end() + 1),
+           Bound<uint64_t>::open(range.upper())));
+    }
+
+    const list<Action> actions(
+        response.actions().begin(),
+        response.actions().end());
+
+    transferred += actions.size();
+
+    // The request remains outstanding until the actions are
+    // persisted, so that the window also bounds the number of
+    // actions that are held in memory.
+    replica->learn(actions)
+      .onAny(defer(self(), &Self::learned, lambda::_1));
+  }
+
+  void learned(const Future<Nothing>& future)
+  {
+    outstanding--;
+
+    if (!future.isReady()) {
+      promise.fail(
+          "Failed to persist transferred actions: " +
+          (future.isFailed() ? future.failure() : "discarded"));
+
+      terminate(self());
+      return;
+    }
+
+    transfer();
+  }
+
+  const Shared<Replica> replica;
+  const Shared<Network> network;
+  const IntervalSet<uint64_t> positions;
+  const size_t chunk;
+  const size_t window;
+  const Duration timeout;
+
+  // The ranges of positions that are left to be requested.
+  deque<Interval<uint64_t>> ranges;
+
+  // The peers to request the ranges from; the first one is used
+  // until it fails to respond.
+  deque<UPID> peers;
+
+  size_t outstanding;
+  size_t transferred;
+
+  process::Promise<Nothing> promise;
+};
+
+
 /////////////////////////////////////////////////
 // Public interfaces below.
 /////////////////////////////////////////////////
@@ -347,6 +553,29 @@ Future<Nothing> catchup(
   return future;
 }
 
+
+Future<Nothing> transfer(
+    const Shared<Replica>& replica,
+    const Shared<Network>& network,
+    const IntervalSet<uint64_t>& positions,
+    size_t chunk,
+    size_t window,
+    const Duration& timeout)
+{
+  TransferProcess* process =
+    new TransferProcess(
+        replica,
+        network,
+        positions,
+        chunk,
+        window,
+        timeout);
+
+  Future<Nothing> future = process->future();
+  spawn(process, true);
+  return future;
+}
+
 } // namespace log {
 } // namespace internal {
 } // namespace mesos {
@@ -50,6 +50,27 @@ extern process::Future<Nothing> catchup(
     const IntervalSet<uint64_t>& positions,
     const Duration& timeout = Seconds(10));
 
+
+// Transfers the actions learned in a set of log positions from the
+// other replicas in the network to the local replica in bulk, rather
+// than running a round of Paxos for each position. The positions are
+// requested in ranges of (at most) 'chunk' positions from one VOTING
+// replica at a time, with (at most) 'window' requests outstanding. If
+// a replica doesn't respond within 'timeout' (e.g., it is down or it
+// runs an older version which doesn't support transfers), or is not
+// VOTING, the outstanding ranges are requested from another replica.
+// Unlike 'catchup', this is best effort: the returned future is
+// satisfied once no more positions can be transferred, and the user
+// has to catch-up the positions that are still missing (e.g., the
+// ones that no replica has learned yet) using 'catchup'.
+extern process::Future<Nothing> transfer(
+    const process::Shared<Replica>& replica,
+    const process::Shared<Network>& network,
+    const IntervalSet<uint64_t>& positions,
+    size_t chunk = 1000,
+    size_t window = 4,
+    const Duration& timeout = Seconds(10));
+
 } // namespace log {
 } // namespace internal {
 } // namespace mesos {
@@ -17,14 +17,18 @@
 #include <stdint.h>
 
 #include <algorithm>
+#include <deque>
 
 #include <mesos/type_utils.hpp>
 
 #include <process/defer.hpp>
 #include <process/dispatch.hpp>
 #include <process/id.hpp>
+#include <process/owned.hpp>
 #include <process/process.hpp>
 
+#include <stout/foreach.hpp>
+#include <stout/lambda.hpp>
 #include <stout/none.hpp>
 
 #include "log/catchup.hpp"
@@ -35,6 +39,7 @@
 
 using namespace process;
 
+using std::deque;
 using std::string;
 
 namespace mesos {
@@ -47,11 +52,13 @@ public:
   CoordinatorProcess(
       size_t _quorum,
       const Shared<Replica>& _replica,
-      const Shared<Network>& _network)
+      const Shared<Network>& _network,
+      size_t _maxPendingWrites)
     : ProcessBase(ID::generate("log-coordinator")),
       quorum(_quorum),
       replica(_replica),
       network(_network),
+      maxPendingWrites(_maxPendingWrites),
       state(INITIAL),
       proposal(0),
       index(0) {}
@@ -68,7 +75,15 @@ protected:
   virtual void finalize()
   {
     electing.discard();
-    writing.discard();
+
+    foreach (const Owned<Write>& write, pending) {
+      write->future.discard();
+      write->promise.discard();
+    }
+
+    foreach (const Owned<Write>& write, queued) {
+      write->promise.discard();
+    }
   }
 
 private:
@@ -92,22 +107,42 @@ private:
   // Writing related functions.  //
   /////////////////////////////////
 
+  // An append or truncate, from the time it is requested until its
+  // result is returned.
+  struct Write
+  {
+    Action action;
+
+    // The result of the write and learn phases for the action; set
+    // once the write starts.
+    Future<Option<uint64_t> > future;
+
+    // The result returned to the caller, which is set in position
+    // order (see 'written' below).
+    process::Promise<Option<uint64_t> > promise;
+  };
+
   Future<Option<uint64_t> > write(const Action& action);
+  void flush();
   Future<WriteResponse> runWritePhase(const Action& action);
   Future<Option<uint64_t> > checkWritePhase(
       const Action& action,
       const WriteResponse& response);
   Future<Nothing> runLearnPhase(const Action& action);
   Future<bool> checkLearnPhase(const Action& action);
-  Future<Option<uint64_t> > updateIndexAfterWritten(bool missing);
-  void writingFinished();
-  void writingFailed();
+  Future<Option<uint64_t> > getWrittenPosition(
+      const Action& action,
+      bool missing);
+  void written();
   void writingAborted();
 
   const size_t quorum;
   const Shared<Replica> replica;
   const Shared<Network> network;
 
+  // The maximum number of writes in 'pending'.
+  const size_t maxPendingWrites;
+
   // The current state of the coordinator. A coordinator needs to be
   // elected first to perform append and truncate operations. If one
   // tries to do an append or a truncate while the coordinator is not
@@ -115,7 +150,8 @@ private:
   // coordinator does not declare itself as elected until it wins the
   // election and has filled all existing positions. A coordinator is
   // put in electing state after it decides to go for an election and
-  // before it is elected.
+  // before it is elected. An elected coordinator is in writing state
+  // while it has any pending or queued writes.
   enum
   {
     INITIAL,
@@ -131,7 +167,11 @@ private:
   uint64_t index;
 
   Future<Option<uint64_t> > electing;
-  Future<Option<uint64_t> > writing;
+
+  // The writes that have been started, in position order, and the
+  // writes that are waiting for one of those to finish.
+  deque<Owned<Write> > pending;
+  deque<Owned<Write> > queued;
 };
 
 
@@ -307,14 +347,9 @@ Future<Option<uint64_t> > CoordinatorProcess::append(const string& bytes)
 {
   if (state == INITIAL || state == ELECTING) {
     return None();
-  } else if (state == WRITING) {
-    return Failure("Coordinator is currently writing");
   }
 
   Action action;
-  action.set_position(index);
-  action.set_promised(proposal);
-  action.set_performed(proposal);
   action.set_type(Action::APPEND);
   Action::Append* append = action.mutable_append();
   append->set_bytes(bytes);
@@ -327,14 +362,9 @@ Future<Option<uint64_t> > CoordinatorProcess::truncate(uint64_t to)
 {
   if (state == INITIAL || state == ELECTING) {
     return None();
-  } else if (state == WRITING) {
-    return Failure("Coordinator is currently writing");
   }
 
   Action action;
-  action.set_position(index);
-  action.set_promised(proposal);
-  action.set_performed(proposal);
   action.set_type(Action::TRUNCATE);
   Action::Truncate* truncate = action.mutable_truncate();
   truncate->set_to(to);
@@ -345,21 +375,54 @@ Future<Option<uint64_t> > CoordinatorProcess::truncate(uint64_t to)
 
 Future<Option<uint64_t> > CoordinatorProcess::write(const Action& action)
 {
-  LOG(INFO) << "Coordinator attempting to write " << action.type()
-            << " action at position " << action.position();
-
-  CHECK_EQ(state, ELECTED);
-  CHECK(action.has_performed() && action.has_type());
+  CHECK(state == ELECTED || state == WRITING);
+  CHECK(action.has_type());
 
   state = WRITING;
 
-  writing = runWritePhase(action)
-    .then(defer(self(), &Self::checkWritePhase, action, lambda::_1))
-    .onReady(defer(self(), &Self::writingFinished))
-    .onFailed(defer(self(), &Self::writingFailed))
-    .onDiscarded(defer(self(), &Self::writingAborted));
+  Owned<Write> write(new Write());
+  write->action = action;
+
+  queued.push_back(write);
+
+  flush();
+
+  return write->promise.future();
+}
+
+
+void CoordinatorProcess::flush()
+{
+  CHECK_EQ(state, WRITING);
+
+  while (!queued.empty() && pending.size() < maxPendingWrites) {
+    Owned<Write> write = queued.front();
+    queued.pop_front();
+
+    // The position is only assigned once the write starts, so that
+    // the positions of the started writes are always consecutive.
+    write->action.set_position(index++);
+    write->action.set_promised(proposal);
+    write->action.set_performed(proposal);
+
+    LOG(INFO) << "Coordinator attempting to write " << write->action.type()
+              << " action at position " << write->action.position();
+
+    write->future = runWritePhase(write->action)
+      .then(defer(self(), &Self::checkWritePhase, write->action, lambda::_1));
+
+    // Discarding the returned future aborts the write (see
+    // 'writingAborted' below).
+    write->promise.future()
+      .onDiscard(lambda::bind(
+          &Future<Option<uint64_t> >::discard,
+          write->future));
+
+    write->future
+      .onAny(defer(self(), &Self::written));
 
-  return writing;
+    pending.push_back(write);
+  }
 }
 
 
@@ -374,16 +437,16 @@ Future<Option<uint64_t> > CoordinatorProcess::checkWritePhase(
     const WriteResponse& response)
 {
   if (!response.okay()) {
-    // Received a NACK. Save the proposal number.
-    CHECK_LE(proposal, response.proposal());
-    proposal = response.proposal();
+    // Received a NACK. Save the proposal number. Note that another
+    // pipelined write might have already saved a higher one.
+    proposal = std::max(proposal, response.proposal());
 
     return None();
   }
 
   return runLearnPhase(action)
     .then(defer(self(), &Self::checkLearnPhase, action))
-    .then(defer(self(), &Self::updateIndexAfterWritten, lambda::_1));
+    .then(defer(self(), &Self::getWrittenPosition, action, lambda::_1));
 }
 
 
@@ -402,27 +465,56 @@ Future<bool> CoordinatorProcess::checkLearnPhase(const Action& action)
 }
 
 
-Future<Option<uint64_t> > CoordinatorProcess::updateIndexAfterWritten(
+Future<Option<uint64_t> > CoordinatorProcess::getWrittenPosition(
+    const Action& action,
     bool missing)
 {
   CHECK(!missing) << "Not expecting local replica to be missing position "
-                  << index << " after the writing is done";
+                  << action.position() << " after the writing is done";
 
-  return index++;
+  return action.position();
 }
 
 
-void CoordinatorProcess::writingFinished()
+void CoordinatorProcess::written()
 {
-  CHECK_EQ(state, WRITING);
-  state = ELECTED;
-}
+  // Return the results of the finished writes in position order: a
+  // write that finishes before the writes at the preceding positions
+  // waits for them.
+  while (!pending.empty() && !pending.front()->future.isPending()) {
+    CHECK_EQ(state, WRITING);
+
+    Owned<Write> write = pending.front();
+    pending.pop_front();
+
+    const Future<Option<uint64_t> >& future = write->future;
+
+    if (future.isReady() && future.get().isSome()) {
+      write->promise.set(future.get());
+      continue;
+    }
+
+    // The write was NACKed, failed or was discarded, so the
+    // coordinator gets demoted.
+    if (future.isReady()) {
+      write->promise.set(Option<uint64_t>::none());
+    } else if (future.isFailed()) {
+      write->promise.fail(future.failure());
+    } else {
+      write->promise.discard();
+    }
+
+    writingAborted();
+    return;
+  }
 
+  if (state == WRITING) {
+    flush();
 
-void CoordinatorProcess::writingFailed()
-{
-  CHECK_EQ(state, WRITING);
-  state = INITIAL;
+    if (pending.empty()) {
+      state = ELECTED;
+    }
+  }
 }
 
 
@@ -430,11 +522,27 @@ void CoordinatorProcess::writingAborted()
 {
   CHECK_EQ(state, WRITING);
 
-  // Demote the coordinator if a write operation is discarded since we
-  // don't actually know the write was successful or not and we really
-  // need to "catch-up" that position before we try and do another
+  // Demote the coordinator if a write operation is not successful
+  // since we don't actually know the write was successful or not and
+  // we really need to "catch-up" that position (and all the positions
+  // after it that were being written) before we try and do another
   // write (see MESOS-1038 for more details).
   state = INITIAL;
+
+  // The writes after the aborted one might still be written (and
+  // learned later, during the next election), but they are returned
+  // as none just like any write after a demotion.
+  foreach (const Owned<Write>& write, pending) {
+    write->future.discard();
+    write->promise.set(Option<uint64_t>::none());
+  }
+
+  foreach (const Owned<Write>& write, queued) {
+    write->promise.set(Option<uint64_t>::none());
+  }
+
+  pending.clear();
+  queued.clear();
 }
 
 
@@ -446,9 +554,13 @@ void CoordinatorProcess::writingAborted()
 Coordinator::Coordinator(
     size_t quorum,
     const Shared<Replica>& replica,
-    const Shared<Network>& network)
+    const Shared<Network>& network,
+    size_t maxPendingWrites)
 {
-  process = new CoordinatorProcess(quorum, replica, network);
+  CHECK_GT(maxPendingWrites, 0u);
+
+  process = new CoordinatorProcess(
+      quorum, replica, network, maxPendingWrites);
   spawn(process);
 }
 
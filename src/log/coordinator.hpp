@@ -37,13 +37,26 @@ namespace log {
 class CoordinatorProcess;
 
 
+// The default maximum number of writes (appends and truncates) that a
+// coordinator keeps in flight at a time. See 'Coordinator' below.
+const size_t DEFAULT_MAX_PENDING_WRITES = 32;
+
+
+// A coordinator pipelines writes: up to 'maxPendingWrites' appends
+// and truncates are written to consecutive log positions at the same
+// time, each in its own Paxos write round, rather than one after the
+// other. Any further writes are queued until an earlier one is done.
+// The results of the writes are always returned in position order,
+// and once a write fails (or is discarded) the coordinator is demoted
+// and all writes after it return none.
 class Coordinator
 {
 public:
   Coordinator(
       size_t _quorum,
       const process::Shared<Replica>& _replica,
-      const process::Shared<Network>& _network);
+      const process::Shared<Network>& _network,
+      size_t _maxPendingWrites = DEFAULT_MAX_PENDING_WRITES);
 
   ~Coordinator();
 
@@ -55,12 +68,13 @@ public:
   // Handles coordinator demotion. Returns the last committed (a.k.a.,
   // learned) log position if the operation succeeds. One should only
   // call this function if the coordinator has been elected, and no
-  // write (append or truncate) is in progress.
+  // write (append or truncate) is in progress or queued.
   process::Future<uint64_t> demote();
 
   // Appends the specified bytes to the end of the log. Returns the
   // position of the appended entry if the operation succeeds or none
-  // if the coordinator was demoted.
+  // if the coordinator was demoted. This can be called again before
+  // the previous append (or truncate) is done, see above.
   process::Future<Option<uint64_t> > append(const std::string& bytes);
 
   // Removes all log entries preceding the log entry at the given
@@ -21,111 +21,56 @@
 #include <leveldb/comparator.h>
 #include <leveldb/write_batch.h>
 
+#include <list>
+
 #include <stdint.h>
 
 #include <stout/check.hpp>
 #include <stout/error.hpp>
-#include <stout/numify.hpp>
+#include <stout/foreach.hpp>
 #include <stout/stopwatch.hpp>
-#include <stout/strings.hpp>
-#include <stout/unreachable.hpp>
 
 #include "log/leveldb.hpp"
 
+using std::list;
 using std::string;
 
 namespace mesos {
 namespace internal {
 namespace log {
 
-class Varint64Comparator : public leveldb::Comparator
+// Returns the key for the specified position. Note that we adjust
+// the actual position by incrementing it by 1 because we reserve 0
+// for storing the promise record (Record::Promise, DEPRECATED!), or
+// the metadata (Record::Metadata).
+//
+// The key is the (adjusted) position as a fixed-width big-endian
+// integer, so that the default byte-wise comparator orders the keys
+// the same way as the positions. Logs written by older versions use
+// zero-padded decimal strings instead, which get migrated when the
+// log is restored (see LevelDBStorage::restore).
+static string encode(uint64_t position, bool adjust = true)
 {
-public:
-  virtual int Compare(
-      const leveldb::Slice& a,
-      const leveldb::Slice& b) const
-  {
-    // TODO(benh): Use varint comparator.
-    LOG(FATAL) << "Unimplemented";
-    // uint64_t left = position(a);
-    // uint64_t right = position(b);
-    // if (left < right) return -1;
-    // if (left == right) return 0;
-    // if (left > right) return 1;
-    UNREACHABLE();
-  }
-
-  virtual const char* Name() const
-  {
-    // Note that this name MUST NOT CHANGE across uses of this
-    // comparator with the same DB (the semantics of doing so are
-    // undefined if the database doesn't catch this first).
-    return "varint64";
-  }
-
-  virtual void FindShortestSeparator(
-      string* start,
-      const leveldb::Slice& limit) const
-  {
-    // Intentional no-op.
-  }
+  position = adjust ? position + 1 : position;
 
-  virtual void FindShortSuccessor(string* key) const
-  {
-    // Intentional no-op.
+  string key(sizeof(position), '\0');
+  for (size_t i = 0; i < sizeof(position); i++) {
+    key[sizeof(position) - 1 - i] = static_cast<char>(position & 0xff);
+    position >>= 8;
   }
-};
 
-
-// TODO(benh): Use varint comparator.
-// static Varint64Comparator comparator;
+  return key;
+}
 
 
-// Returns a string representing the specified position. Note that we
-// adjust the actual position by incrementing it by 1 because we
-// reserve 0 for storing the promise record (Record::Promise,
-// DEPRECATED!), or the metadata (Record::Metadata).
-static string encode(uint64_t position, bool adjust = true)
+// Returns true if the key is in the format used before positions
+// were encoded in binary (see 'encode' above).
+static bool legacy(const leveldb::Slice& key)
 {
-  // Adjusted stringified represenation is plus 1 of actual position.
-  position = adjust ? position + 1 : position;
-
-  // TODO(benh): Use varint encoding for VarInt64Comparator!
-  // string s;
-  // google::protobuf::io::StringOutputStream _stream(&s);
-  // google::protobuf::io::CodedOutputStream stream(&_stream);
-  // position = adjust ? position + 1 : position;
-  // stream.WriteVarint64(position);
-  // return s;
-
-  Try<string> s = strings::format("%.*d", 10, position);
-  CHECK_SOME(s);
-  return s.get();
+  return key.size() != sizeof(uint64_t);
 }
 
 
-// Returns the position as represented in the specified slice
-// (performing a decrement as necessary to determine the actual
-// position represented).
-// TODO(jieyu): This function is not used (see RB-18252). However, we
-// still want to keep this function in case we need it in the future.
-// We comment it out to silence the warning (unused static function)
-// from the compiler.
-// static uint64_t decode(const leveldb::Slice& s)
-// {
-//   // TODO(benh): Use varint decoding for VarInt64Comparator!
-//   // uint64_t position;
-//   // google::protobuf::io::ArrayInputStream _stream(s.data(), s.size());
-//   // google::protobuf::io::CodedInputStream stream(&_stream);
-//   // bool success = stream.ReadVarint64(&position);
-//   // CHECK(success);
-//   // return position - 1; // Actual position is less 1 of stringified.
-//   Try<uint64_t> position = numify<uint64_t>(string(s.data(), s.size()));
-//   CHECK_SOME(position);
-//   return position.get() - 1; // Actual position is less 1 of stringified.
-// }
-
-
 LevelDBStorage::LevelDBStorage()
   : db(NULL), first(None())
 {
@@ -144,22 +89,19 @@ Try<Storage::State> LevelDBStorage::restore(const string& path)
   leveldb::Options options;
   options.create_if_missing = true;
 
-  // TODO(benh): Can't use varint comparator until bug discussed at
-  // groups.google.com/group/leveldb/browse_thread/thread/17eac39168909ba7
-  // gets fixed. For now, we are using the default byte-wise
-  // comparator and *assuming* that the encoding from unsigned long to
-  // string produces a stable ordering. Checks below.
-  // options.comparator = &comparator;
-
+  // We use the default byte-wise comparator and rely on the encoding
+  // of positions producing a stable ordering. Checks below.
   const string& one = encode(1);
   const string& two = encode(2);
   const string& ten = encode(10);
+  const string& big = encode(256);
 
   CHECK(leveldb::BytewiseComparator()->Compare(one, two) < 0);
   CHECK(leveldb::BytewiseComparator()->Compare(two, one) > 0);
   CHECK(leveldb::BytewiseComparator()->Compare(one, ten) < 0);
   CHECK(leveldb::BytewiseComparator()->Compare(ten, two) > 0);
   CHECK(leveldb::BytewiseComparator()->Compare(ten, ten) == 0);
+  CHECK(leveldb::BytewiseComparator()->Compare(ten, big) < 0);
 
   Stopwatch stopwatch;
   stopwatch.start();
@@ -205,6 +147,14 @@ Try<Storage::State> LevelDBStorage::restore(const string& path)
 
   uint64_t keys = 0;
 
+  // The records still stored under legacy keys get rewritten to their
+  // new keys in batches as we go. Note that the iterator doesn't see
+  // these writes, and that a crash midway is harmless as each batch
+  // moves its records atomically.
+  leveldb::WriteBatch migration;
+  uint64_t migrating = 0;
+  uint64_t migrated = 0;
+
   while (iterator->Valid()) {
     keys++;
     const leveldb::Slice& slice = iterator->value();
@@ -261,10 +211,36 @@ Try<Storage::State> LevelDBStorage::restore(const string& path)
       }
 
       default: {
+        delete iterator;
         return Error("Bad record");
       }
     }
 
+    if (legacy(iterator->key())) {
+      const string key = record.type() == Record::ACTION
+        ? encode(record.action().position())
+        : encode(0, false);
+
+      migration.Put(key, slice);
+      migration.Delete(iterator->key());
+
+      if (++migrating == 1024) {
+        leveldb::WriteOptions options;
+        options.sync = true;
+
+        leveldb::Status status = db->Write(options, &migration);
+
+        if (!status.ok()) {
+          delete iterator;
+          return Error("Failed to migrate keys: " + status.ToString());
+        }
+
+        migration.Clear();
+        migrated += migrating;
+        migrating = 0;
+      }
+    }
+
     iterator->Next();
   }
 
@@ -273,133 +249,146 @@ Try<Storage::State> LevelDBStorage::restore(const string& path)
 
   delete iterator;
 
+  if (migrating > 0) {
+    leveldb::WriteOptions options;
+    options.sync = true;
+
+    leveldb::Status status = db->Write(options, &migration);
+
+    if (!status.ok()) {
+      return Error("Failed to migrate keys: " + status.ToString());
+    }
+
+    migrated += migrating;
+  }
+
+  if (migrated > 0) {
+    LOG(INFO) << "Migrated " << migrated << " keys to the binary encoding";
+  }
+
   return state;
 }
 
 
 Try<Nothing> LevelDBStorage::persist(const Metadata& metadata)
+{
+  return persist(metadata, list<Action>());
+}
+
+
+Try<Nothing> LevelDBStorage::persist(const Action& action)
+{
+  return persist(None(), list<Action>(1, action));
+}
+
+
+Try<Nothing> LevelDBStorage::persist(
+    const Option<Metadata>& metadata,
+    const list<Action>& actions)
 {
   Stopwatch stopwatch;
   stopwatch.start();
 
-  leveldb::WriteOptions options;
-  options.sync = true;
+  leveldb::WriteBatch batch;
 
-  Record record;
-  record.set_type(Record::METADATA);
-  record.mutable_metadata()->CopyFrom(metadata);
+  size_t bytes = 0;
 
-  string value;
+  if (metadata.isSome()) {
+    Record record;
+    record.set_type(Record::METADATA);
+    record.mutable_metadata()->CopyFrom(metadata.get());
 
-  if (!record.SerializeToString(&value)) {
-    return Error("Failed to serialize record");
-  }
+    string value;
 
-  leveldb::Status status = db->Put(options, encode(0, false), value);
+    if (!record.SerializeToString(&value)) {
+      return Error("Failed to serialize record");
+    }
 
-  if (!status.ok()) {
-    return Error(status.ToString());
+    batch.Put(encode(0, false), value);
+    bytes += value.size();
   }
 
-  LOG(INFO) << "Persisting metadata (" << value.size()
-            << " bytes) to leveldb took " << stopwatch.elapsed();
-
-  return Nothing();
-}
+  // The first position still in leveldb once the batch is written,
+  // which we only save if the write succeeds.
+  Option<uint64_t> first_ = first;
 
+  uint64_t deleted = 0;
 
-Try<Nothing> LevelDBStorage::persist(const Action& action)
-{
-  Stopwatch stopwatch;
-  stopwatch.start();
+  foreach (const Action& action, actions) {
+    Record record;
+    record.set_type(Record::ACTION);
+    record.mutable_action()->MergeFrom(action);
 
-  Record record;
-  record.set_type(Record::ACTION);
-  record.mutable_action()->MergeFrom(action);
+    string value;
 
-  string value;
+    if (!record.SerializeToString(&value)) {
+      return Error("Failed to serialize record");
+    }
 
-  if (!record.SerializeToString(&value)) {
-    return Error("Failed to serialize record");
+    batch.Put(encode(action.position()), value);
+    bytes += value.size();
+
+    // Update the first position. Notice that we use 'min' here
+    // instead of checking 'isNone()' because it's likely that log
+    // entries are written out of order during catch-up (e.g. if a
+    // random bulk catch-up policy is used).
+    first_ = min(first_, action.position());
+
+    // Delete positions if a truncate action has been *learned*.
+    if (action.has_type() && action.type() == Action::TRUNCATE &&
+        action.has_learned() && action.learned()) {
+      CHECK(action.has_truncate());
+
+      // To actually perform the truncation in leveldb we need to
+      // remove all the keys that represent positions no longer in the
+      // log. We do this by attempting to delete all keys that
+      // represent the first position we know is still in leveldb up
+      // to (but excluding) the truncate position. Note that this
+      // works because the semantics of WriteBatch are such that even
+      // if the position doesn't exist (which is possible because this
+      // replica has some holes), we can attempt to delete the key
+      // that represents it and it will just ignore that key. This is
+      // *much* cheaper than actually iterating through the entire
+      // database instead (which was, for posterity, the original
+      // implementation). In addition, caching the "first" position we
+      // know is in the database is cheaper than using an iterator to
+      // determine the first position (which was, for posterity, the
+      // second implementation).
+      //
+      // It's likely that the first position is greater than the
+      // truncate position (e.g., during catch-up). In that case, we
+      // do nothing because there is nothing we can truncate.
+      // TODO(jieyu): We might miss a truncation if we do random (i.e.,
+      // out of order) bulk catch-up and the truncate operation is
+      // caught up first.
+      CHECK_SOME(first_);
+
+      while (first_.get() < action.truncate().to()) {
+        batch.Delete(encode(first_.get()));
+        first_ = first_.get() + 1;
+        deleted++;
+      }
+    }
   }
 
   leveldb::WriteOptions options;
   options.sync = true;
 
-  leveldb::Status status = db->Put(options, encode(action.position()), value);
+  leveldb::Status status = db->Write(options, &batch);
 
   if (!status.ok()) {
     return Error(status.ToString());
   }
 
-  // Updated the first position. Notice that we use 'min' here instead
-  // of checking 'isNone()' because it's likely that log entries are
-  // written out of order during catch-up (e.g. if a random bulk
-  // catch-up policy is used).
-  first = min(first, action.position());
-
-  LOG(INFO) << "Persisting action (" << value.size()
-            << " bytes) to leveldb took " << stopwatch.elapsed();
-
-  // Delete positions if a truncate action has been *learned*. Note
-  // that we do this in a best-effort fashion (i.e., we ignore any
-  // failures to the database since we can always try again).
-  if (action.has_type() && action.type() == Action::TRUNCATE &&
-      action.has_learned() && action.learned()) {
-    CHECK(action.has_truncate());
-
-    stopwatch.start(); // Restart the stopwatch.
-
-    // To actually perform the truncation in leveldb we need to remove
-    // all the keys that represent positions no longer in the log. We
-    // do this by attempting to delete all keys that represent the
-    // first position we know is still in leveldb up to (but
-    // excluding) the truncate position. Note that this works because
-    // the semantics of WriteBatch are such that even if the position
-    // doesn't exist (which is possible because this replica has some
-    // holes), we can attempt to delete the key that represents it and
-    // it will just ignore that key. This is *much* cheaper than
-    // actually iterating through the entire database instead (which
-    // was, for posterity, the original implementation). In addition,
-    // caching the "first" position we know is in the database is
-    // cheaper than using an iterator to determine the first position
-    // (which was, for posterity, the second implementation).
-
-    leveldb::WriteBatch batch;
-
-    CHECK_SOME(first);
-
-    // Add positions up to (but excluding) the truncate position to
-    // the batch starting at the first position still in leveldb. It's
-    // likely that the first position is greater than the truncate
-    // position (e.g., during catch-up). In that case, we do nothing
-    // because there is nothing we can truncate.
-    // TODO(jieyu): We might miss a truncation if we do random (i.e.,
-    // out of order) bulk catch-up and the truncate operation is
-    // caught up first.
-    uint64_t index = 0;
-    while ((first.get() + index) < action.truncate().to()) {
-      batch.Delete(encode(first.get() + index));
-      index++;
-    }
+  first = first_;
 
-    // If we added any positions, attempt to delete them!
-    if (index > 0) {
-      // We do this write asynchronously (e.g., using default options).
-      leveldb::Status status = db->Write(leveldb::WriteOptions(), &batch);
-
-      if (!status.ok()) {
-        LOG(WARNING) << "Ignoring leveldb batch delete failure: "
-                     << status.ToString();
-      } else {
-        // Save the new first position!
-        CHECK_LT(first.get(), action.truncate().to());
-        first = action.truncate().to();
-
-        LOG(INFO) << "Deleting ~" << index
-                  << " keys from leveldb took " << stopwatch.elapsed();
-      }
-    }
+  LOG(INFO) << "Persisting " << actions.size() << " action(s)"
+            << (metadata.isSome() ? " and metadata" : "")
+            << " (" << bytes << " bytes) to leveldb took "
+            << stopwatch.elapsed();
+
+  if (deleted > 0) {
+    LOG(INFO) << "Deleted ~" << deleted << " truncated keys from leveldb";
   }
 
   return Nothing();
@@ -21,6 +21,8 @@
 
 #include <stdint.h>
 
+#include <list>
+
 #include <stout/option.hpp>
 
 #include "log/storage.hpp"
@@ -39,6 +41,9 @@ public:
   virtual Try<State> restore(const std::string& path);
   virtual Try<Nothing> persist(const Metadata& metadata);
   virtual Try<Nothing> persist(const Action& action);
+  virtual Try<Nothing> persist(
+      const Option<Metadata>& metadata,
+      const std::list<Action>& actions);
   virtual Try<Action> read(uint64_t position);
 
 private:
@@ -54,7 +54,8 @@ public:
       size_t _quorum,
       const string& path,
       const set<UPID>& pids,
-      bool _autoInitialize);
+      bool _autoInitialize,
+      bool asyncIO);
 
   LogProcess(
       size_t _quorum,
@@ -63,7 +64,8 @@ public:
       const Duration& timeout,
       const string& znode,
       const Option<zookeeper::Authentication>& auth,
-      bool _autoInitialize);
+      bool _autoInitialize,
+      bool asyncIO);
 
   // Recovers the log by catching up if needed. Returns a shared
   // pointer to the local replica if the recovery succeeds.
@@ -199,10 +201,11 @@ LogProcess::LogProcess(
     size_t _quorum,
     const string& path,
     const set<UPID>& pids,
-    bool _autoInitialize)
+    bool _autoInitialize,
+    bool asyncIO)
   : ProcessBase(ID::generate("log")),
     quorum(_quorum),
-    replica(new Replica(path)),
+    replica(new Replica(path, asyncIO)),
     network(new Network(pids + (UPID) replica->pid())),
     autoInitialize(_autoInitialize),
     group(NULL) {}
@@ -215,10 +218,11 @@ LogProcess::LogProcess(
     const Duration& timeout,
     const string& znode,
     const Option<zookeeper::Authentication>& auth,
-    bool _autoInitialize)
+    bool _autoInitialize,
+    bool asyncIO)
   : ProcessBase(ID::generate("log")),
     quorum(_quorum),
-    replica(new Replica(path)),
+    replica(new Replica(path, asyncIO)),
     network(new ZooKeeperNetwork(
         servers,
         timeout,
@@ -741,7 +745,8 @@ Log::Log(
     int quorum,
     const string& path,
     const set<UPID>& pids,
-    bool autoInitialize)
+    bool autoInitialize,
+    bool asyncIO)
 {
   GOOGLE_PROTOBUF_VERIFY_VERSION;
 
@@ -750,7 +755,8 @@ Log::Log(
         quorum,
         path,
         pids,
-        autoInitialize);
+        autoInitialize,
+        asyncIO);
 
   spawn(process);
 }
@@ -762,7 +768,8 @@ Log::Log(
     const Duration& timeout,
     const string& znode,
     const Option<zookeeper::Authentication>& auth,
-    bool autoInitialize)
+    bool autoInitialize,
+    bool asyncIO)
 {
   GOOGLE_PROTOBUF_VERIFY_VERSION;
 
@@ -774,7 +781,8 @@ Log::Log(
         timeout,
         znode,
         auth,
-        autoInitialize);
+        autoInitialize,
+        asyncIO);
 
   spawn(process);
 }
@@ -169,7 +169,10 @@ public:
     // Attempts to append the specified data to the log. Returns the
     // new ending position of the log or 'none' if this writer has
     // lost it's promise to exclusively write (which can be reacquired
-    // by invoking Writer::start).
+    // by invoking Writer::start). There is no need to wait for an
+    // append (or truncate) to finish before doing another one: they
+    // are written to the log in the order they were made, and their
+    // results are returned in that order too.
     process::Future<Option<Position> > append(const std::string& data);
 
     // Attempts to truncate the log up to but not including the
@@ -184,11 +187,14 @@ public:
 
   // Creates a new replicated log that assumes the specified quorum
   // size, is backed by a file at the specified path, and coordinates
-  // with other replicas via the set of process PIDs.
+  // with other replicas via the set of process PIDs. If 'asyncIO' is
+  // true, the local replica writes to the file from a separate
+  // process (see Replica).
   Log(int quorum,
       const std::string& path,
       const std::set<process::UPID>& pids,
-      bool autoInitialize = false);
+      bool autoInitialize = false,
+      bool asyncIO = false);
 
   // Creates a new replicated log that assumes the specified quorum
   // size, is backed by a file at the specified path, and coordinates
@@ -200,7 +206,8 @@ public:
       const Duration& timeout,
       const std::string& znode,
       const Option<zookeeper::Authentication>& auth = None(),
-      bool autoInitialize = false);
+      bool autoInitialize = false,
+      bool asyncIO = false);
 
   ~Log();
 
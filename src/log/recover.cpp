@@ -551,12 +551,33 @@ private:
     // not access the 'replica' field.
     Shared<Replica> shared = replica.share();
 
+    // Typically, most of the positions have already been learned by
+    // the other replicas, so we first transfer those in bulk, and then
+    // catch-up the positions that are still missing (e.g., the ones
+    // that are still being written) using Paxos.
+    return log::transfer(shared, network, positions)
+      .then(defer(self(), &Self::fill, shared, begin, end))
+      .then(defer(self(), &Self::getReplicaOwnership, shared))
+      .then(defer(self(), &Self::updateReplicaStatus, Metadata::VOTING));
+  }
+
+  Future<Nothing> fill(Shared<Replica> shared, uint64_t begin, uint64_t end)
+  {
+    return shared->missing(begin, end)
+      .then(defer(self(), &Self::_fill, shared, lambda::_1));
+  }
+
+  Future<Nothing> _fill(
+      Shared<Replica> shared,
+      const IntervalSet<uint64_t>& positions)
+  {
+    LOG(INFO) << "Catching-up " << positions.size()
+              << " position(s) that were not transferred";
+
     // Since we do not know what proposal number to use (the log is
     // empty), we use none and leave log::catchup to automatically
     // bump the proposal number.
-    return log::catchup(quorum, shared, network, None(), positions)
-      .then(defer(self(), &Self::getReplicaOwnership, shared))
-      .then(defer(self(), &Self::updateReplicaStatus, Metadata::VOTING));
+    return log::catchup(quorum, shared, network, None(), positions);
   }
 
   Future<Nothing> updateReplicaStatus(const Metadata::Status& status)
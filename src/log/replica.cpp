@@ -20,13 +20,17 @@
 
 #include <mesos/type_utils.hpp>
 
+#include <process/defer.hpp>
 #include <process/dispatch.hpp>
 #include <process/id.hpp>
+#include <process/owned.hpp>
 
+#include <stout/bytes.hpp>
 #include <stout/check.hpp>
 #include <stout/error.hpp>
 #include <stout/exit.hpp>
 #include <stout/foreach.hpp>
+#include <stout/lambda.hpp>
 #include <stout/none.hpp>
 #include <stout/nothing.hpp>
 #include <stout/result.hpp>
@@ -52,16 +56,55 @@ namespace protocol {
 Protocol<PromiseRequest, PromiseResponse> promise;
 Protocol<WriteRequest, WriteResponse> write;
 Protocol<RecoverRequest, RecoverResponse> recover;
+Protocol<TransferRequest, TransferResponse> transfer;
 
 } // namespace protocol {
 
 
+// The (approximate) maximum size of the actions in a response to a
+// transfer request, so that a response doesn't take too long to
+// read, send and persist. The requester asks for the rest of the
+// range in another request.
+static const Bytes MAX_TRANSFER_SIZE = Megabytes(4);
+
+
+// Writes to the storage of a replica which was constructed with
+// 'asyncIO' (see replica.hpp), so that the replica doesn't block
+// while the writes get synced to disk. Note that the replica still
+// reads from the storage directly, which is safe as reads don't
+// interfere with writes in leveldb.
+class StorageProcess : public Process<StorageProcess>
+{
+public:
+  explicit StorageProcess(Storage* _storage)
+    : ProcessBase(ID::generate("log-storage")),
+      storage(_storage) {}
+
+  Future<Nothing> persist(
+      const Option<Metadata>& metadata,
+      const list<Action>& actions)
+  {
+    Try<Nothing> persisted = storage->persist(metadata, actions);
+
+    if (persisted.isError()) {
+      return Failure(persisted.error());
+    }
+
+    return Nothing();
+  }
+
+private:
+  Storage* storage;
+};
+
+
 class ReplicaProcess : public ProtobufProcess<ReplicaProcess>
 {
 public:
   // Constructs a new replica process using specified path to a
-  // directory for storing the underlying log.
-  explicit ReplicaProcess(const string& path);
+  // directory for storing the underlying log. See replica.hpp for
+  // 'asyncIO'.
+  ReplicaProcess(const string& path, bool asyncIO);
 
   virtual ~ReplicaProcess();
 
@@ -98,8 +141,12 @@ public:
   uint64_t promised();
 
   // Updates the status of this replica. The update will be persisted
-  // to storage. Returns true on success and false otherwise.
-  bool update(const Metadata::Status& status);
+  // to storage. Returns true once the update is persisted.
+  Future<bool> update(const Metadata::Status& status);
+
+  // Persists the specified learned actions in a single batch (see
+  // replica.hpp).
+  Future<Nothing> learn(const list<Action>& actions);
 
 private:
   // Handles a request from a proposer to promise not to accept writes
@@ -112,17 +159,54 @@ private:
   // Handles a request from a recover process.
   void recover(const UPID& from, const RecoverRequest& request);
 
+  // Handles a request from a recovering replica to read the actions
+  // learned in a range of positions.
+  void transfer(const UPID& from, const TransferRequest& request);
+
   // Handles a message notifying of a learned action.
   void learned(const UPID& from, const Action& action);
 
-  // Persists the specified action to storage. Returns true on success
-  // and false otherwise.
-  bool persist(const Action& action);
+  // Persists the specified action to storage and applies it to the
+  // state of the replica. Returns a future that is satisfied once the
+  // action is persisted.
+  //
+  // The writes are batched: the actions (and metadata) persisted
+  // while the replica is handling a burst of requests, or while the
+  // previous batch is being written, all get written to storage with
+  // a single (synced) write. The state of the replica is updated
+  // right away so that the requests that follow see the action, but
+  // any response that depends on it must only be sent once the future
+  // is satisfied. If a batch fails to get written, the replica exits
+  // since its state no longer matches its storage (restarting it
+  // restores the state from storage).
+  Future<Nothing> persist(const Action& action);
+
+  // Persists the specified metadata to storage, batched like actions.
+  Future<Nothing> persist(const Metadata& metadata);
 
   // Updates the highest promise this replica has given. The update
-  // will be persisted to storage. Returns true on success and false
-  // otherwise.
-  bool updatePromised(uint64_t promised);
+  // will be persisted to storage. Returns a future that is satisfied
+  // once the update is persisted.
+  Future<Nothing> updatePromised(uint64_t promised);
+
+  // A batch of writes to storage.
+  struct Batch
+  {
+    Option<Metadata> metadata;
+    list<Action> actions;
+    process::Promise<Nothing> promise;
+  };
+
+  // Returns the batch that the next writes go into.
+  const Owned<Batch>& batch();
+
+  // Returns the latest action for this position that is still being
+  // persisted, if any.
+  Option<Action> persisting(uint64_t position);
+
+  // Writes the queued batch to storage.
+  void flush();
+  void _flush(const Future<Nothing>& future);
 
   // Helper routine to restore log (e.g., on restart).
   void restore(const string& path);
@@ -130,6 +214,15 @@ private:
   // Underlying storage for the log.
   Storage* storage;
 
+  // Performs the writes to storage when 'asyncIO' is used, otherwise
+  // NULL.
+  StorageProcess* io;
+
+  // The batch being written to storage, and the batch that will be
+  // written next, if any.
+  Owned<Batch> writing;
+  Owned<Batch> queued;
+
   // The cached metadata for this replica. It includes the current
   // status of the replica and the last promise it made.
   Metadata metadata;
@@ -148,8 +241,9 @@ private:
 };
 
 
-ReplicaProcess::ReplicaProcess(const string& path)
+ReplicaProcess::ReplicaProcess(const string& path, bool asyncIO)
   : ProcessBase(ID::generate("log-replica")),
+    io(NULL),
     begin(0),
     end(0)
 {
@@ -158,6 +252,11 @@ ReplicaProcess::ReplicaProcess(const string& path)
 
   restore(path);
 
+  if (asyncIO) {
+    io = new StorageProcess(storage);
+    spawn(io);
+  }
+
   // Install protobuf handlers.
   install<PromiseRequest>(
       &ReplicaProcess::promise);
@@ -168,6 +267,9 @@ ReplicaProcess::ReplicaProcess(const string& path)
   install<RecoverRequest>(
       &ReplicaProcess::recover);
 
+  install<TransferRequest>(
+      &ReplicaProcess::transfer);
+
   install<LearnedMessage>(
       &ReplicaProcess::learned,
       &LearnedMessage::action);
@@ -176,6 +278,12 @@ ReplicaProcess::ReplicaProcess(const string& path)
 
 ReplicaProcess::~ReplicaProcess()
 {
+  if (io != NULL) {
+    terminate(io);
+    process::wait(io);
+    delete io;
+  }
+
   delete storage;
 }
 
@@ -190,6 +298,12 @@ Result<Action> ReplicaProcess::read(uint64_t position)
     return None();
   }
 
+  // The storage might not have the latest action yet.
+  Option<Action> action_ = persisting(position);
+  if (action_.isSome()) {
+    return action_.get();
+  }
+
   // Must exist in storage ...
   Try<Action> action = storage->read(position);
 
@@ -304,47 +418,48 @@ uint64_t ReplicaProcess::promised()
 }
 
 
-bool ReplicaProcess::update(const Metadata::Status& status)
+Future<bool> ReplicaProcess::update(const Metadata::Status& status)
 {
   Metadata metadata_;
   metadata_.set_status(status);
   metadata_.set_promised(promised());
 
-  Try<Nothing> persisted = storage->persist(metadata_);
-
-  if (persisted.isError()) {
-    LOG(ERROR) << "Error writing to log: " << persisted.error();
-    return false;
-  }
+  LOG(INFO) << "Persisting replica status to " << status;
 
-  LOG(INFO) << "Persisted replica status to " << status;
-
-  // Update the cached metadata.
-  metadata.set_status(status);
-
-  return true;
+  return persist(metadata_)
+    .then([]() { return true; });
 }
 
 
-bool ReplicaProcess::updatePromised(uint64_t promised)
+Future<Nothing> ReplicaProcess::updatePromised(uint64_t promised)
 {
   Metadata metadata_;
   metadata_.set_status(status());
   metadata_.set_promised(promised);
 
-  Try<Nothing> persisted = storage->persist(metadata_);
+  LOG(INFO) << "Persisting promised to " << promised;
 
-  if (persisted.isError()) {
-    LOG(ERROR) << "Error writing to log: " << persisted.error();
-    return false;
-  }
+  return persist(metadata_);
+}
 
-  LOG(INFO) << "Persisted promised to " << promised;
 
-  // Update the cached metadata.
-  metadata.set_promised(promised);
+Future<Nothing> ReplicaProcess::learn(const list<Action>& actions)
+{
+  Future<Nothing> future = Nothing();
 
-  return true;
+  foreach (const Action& action, actions) {
+    CHECK(action.has_learned() && action.learned());
+
+    // Don't overwrite a position that we have learned in the meantime
+    // (e.g., from a coordinator), or that has since been truncated.
+    if (missing(action.position())) {
+      future = persist(action);
+    }
+  }
+
+  // All the actions go into the same batch, so this is satisfied once
+  // all of them are persisted.
+  return future;
 }
 
 // When handling replicated log protocol requests, we handle errors in
@@ -455,14 +570,16 @@ void ReplicaProcess::promise(const UPID& from, const PromiseRequest& request)
         action.set_position(request.position());
         action.set_promised(request.proposal());
 
-        if (persist(action)) {
-          PromiseResponse response;
-          response.set_type(PromiseResponse::ACCEPT);
-          response.set_okay(true);
-          response.set_proposal(request.proposal());
-          response.set_position(request.position());
-          reply(response);
-        }
+        PromiseResponse response;
+        response.set_type(PromiseResponse::ACCEPT);
+        response.set_okay(true);
+        response.set_proposal(request.proposal());
+        response.set_position(request.position());
+
+        persist(action)
+          .onReady(defer(self(), [=](const Nothing&) {
+            send(from, response);
+          }));
       }
     } else {
       CHECK_SOME(result);
@@ -479,14 +596,16 @@ void ReplicaProcess::promise(const UPID& from, const PromiseRequest& request)
         Action original = action;
         action.set_promised(request.proposal());
 
-        if (persist(action)) {
-          PromiseResponse response;
-          response.set_type(PromiseResponse::ACCEPT);
-          response.set_okay(true);
-          response.set_proposal(request.proposal());
-          response.mutable_action()->MergeFrom(original);
-          reply(response);
-        }
+        PromiseResponse response;
+        response.set_type(PromiseResponse::ACCEPT);
+        response.set_okay(true);
+        response.set_proposal(request.proposal());
+        response.mutable_action()->MergeFrom(original);
+
+        persist(action)
+          .onReady(defer(self(), [=](const Nothing&) {
+            send(from, response);
+          }));
       }
     }
   } else {
@@ -503,15 +622,17 @@ void ReplicaProcess::promise(const UPID& from, const PromiseRequest& request)
       response.set_proposal(promised());
       reply(response);
     } else {
-      if (updatePromised(request.proposal())) {
-        // Return the last position written.
-        PromiseResponse response;
-        response.set_type(PromiseResponse::ACCEPT);
-        response.set_okay(true);
-        response.set_proposal(request.proposal());
-        response.set_position(end);
-        reply(response);
-      }
+      // Return the last position written.
+      PromiseResponse response;
+      response.set_type(PromiseResponse::ACCEPT);
+      response.set_okay(true);
+      response.set_proposal(request.proposal());
+      response.set_position(end);
+
+      updatePromised(request.proposal())
+        .onReady(defer(self(), [=](const Nothing&) {
+          send(from, response);
+        }));
     }
   }
 }
@@ -575,14 +696,16 @@ void ReplicaProcess::write(const UPID& from, const WriteRequest& request)
           LOG(FATAL) << "Unknown Action::Type!";
       }
 
-      if (persist(action)) {
-        WriteResponse response;
-        response.set_type(WriteResponse::ACCEPT);
-        response.set_okay(true);
-        response.set_proposal(request.proposal());
-        response.set_position(request.position());
-        reply(response);
-      }
+      WriteResponse response;
+      response.set_type(WriteResponse::ACCEPT);
+      response.set_okay(true);
+      response.set_proposal(request.proposal());
+      response.set_position(request.position());
+
+      persist(action)
+        .onReady(defer(self(), [=](const Nothing&) {
+          send(from, response);
+        }));
     }
   } else if (result.isSome()) {
     Action action = result.get();
@@ -654,14 +777,16 @@ void ReplicaProcess::write(const UPID& from, const WriteRequest& request)
             LOG(FATAL) << "Unknown Action::Type!";
         }
 
-        if (persist(action)) {
-          WriteResponse response;
-          response.set_type(WriteResponse::ACCEPT);
-          response.set_okay(true);
-          response.set_proposal(request.proposal());
-          response.set_position(request.position());
-          reply(response);
-        }
+        WriteResponse response;
+        response.set_type(WriteResponse::ACCEPT);
+        response.set_okay(true);
+        response.set_proposal(request.proposal());
+        response.set_position(request.position());
+
+        persist(action)
+          .onReady(defer(self(), [=](const Nothing&) {
+            send(from, response);
+          }));
       }
     }
   }
@@ -686,6 +811,59 @@ void ReplicaProcess::recover(const UPID& from, const RecoverRequest& request)
 }
 
 
+void ReplicaProcess::transfer(
+    const UPID& from,
+    const TransferRequest& request)
+{
+  TransferResponse response;
+  response.set_status(status());
+
+  // Only a VOTING replica knows which of its actions are learned, so
+  // we just inform the requester, who will then try another replica.
+  if (status() != Metadata::VOTING) {
+    LOG(INFO) << "Replica ignoring transfer request from " << from
+              << " as it is in " << status() << " status";
+
+    reply(response);
+    return;
+  }
+
+  VLOG(2) << "Replica received transfer request from " << from
+          << " for positions " << request.from() << " -> " << request.to();
+
+  // Truncated positions and positions beyond our end are not sent
+  // (the requester fills them using Paxos).
+  uint64_t position = std::max(request.from(), begin);
+  const uint64_t to = std::min(request.to(), end);
+
+  Bytes size;
+
+  for (; position <= to && size < MAX_TRANSFER_SIZE; position++) {
+    if (missing(position)) {
+      continue;
+    }
+
+    Result<Action> action = read(position);
+
+    if (action.isError()) {
+      LOG(ERROR) << "Error getting log record at " << position
+                 << ": " << action.error();
+      return;
+    }
+
+    CHECK_SOME(action);
+
+    size += Bytes(action.get().ByteSize());
+    response.add_actions()->CopyFrom(action.get());
+  }
+
+  // Tell the requester how much of the range this response covers.
+  response.set_end(position <= to ? position - 1 : request.to());
+
+  reply(response);
+}
+
+
 void ReplicaProcess::learned(const UPID& from, const Action& action)
 {
   LOG(INFO) << "Replica received learned notice for position "
@@ -693,23 +871,16 @@ void ReplicaProcess::learned(const UPID& from, const Action& action)
 
   CHECK(action.learned());
 
-  if (persist(action)) {
-    LOG(INFO) << "Replica learned " << action.type()
-              << " action at position " << action.position();
-  }
+  persist(action);
+
+  LOG(INFO) << "Replica learned " << action.type()
+            << " action at position " << action.position();
 }
 
 
-bool ReplicaProcess::persist(const Action& action)
+Future<Nothing> ReplicaProcess::persist(const Action& action)
 {
-  Try<Nothing> persisted = storage->persist(action);
-
-  if (persisted.isError()) {
-    LOG(ERROR) << "Error writing to log: " << persisted.error();
-    return false;
-  }
-
-  LOG(INFO) << "Persisted action at " << action.position();
+  batch()->actions.push_back(action);
 
   // No longer a hole here (if there even was one).
   holes -= action.position();
@@ -746,7 +917,111 @@ bool ReplicaProcess::persist(const Action& action)
   // And update the end position.
   end = std::max(end, action.position());
 
-  return true;
+  return queued->promise.future();
+}
+
+
+Future<Nothing> ReplicaProcess::persist(const Metadata& metadata_)
+{
+  batch()->metadata = metadata_;
+
+  // Update the cached metadata.
+  metadata.CopyFrom(metadata_);
+
+  return queued->promise.future();
+}
+
+
+const Owned<ReplicaProcess::Batch>& ReplicaProcess::batch()
+{
+  if (queued.get() == NULL) {
+    queued.reset(new Batch());
+
+    // Unless a batch is being written (in which case this one gets
+    // written right after it), we write this batch after handling the
+    // messages that are already queued up for this process, so that
+    // the writes for all of them go into the batch.
+    if (writing.get() == NULL) {
+      dispatch(self(), &Self::flush);
+    }
+  }
+
+  return queued;
+}
+
+
+Option<Action> ReplicaProcess::persisting(uint64_t position)
+{
+  // Look through the queued batch first as it's the most recent one,
+  // and through the actions of each batch from the last one.
+  const Owned<Batch> batches[] = {queued, writing};
+
+  foreach (const Owned<Batch>& batch, batches) {
+    if (batch.get() != NULL) {
+      list<Action>::const_reverse_iterator action = batch->actions.rbegin();
+      for (; action != batch->actions.rend(); ++action) {
+        if (action->position() == position) {
+          return *action;
+        }
+      }
+    }
+  }
+
+  return None();
+}
+
+
+void ReplicaProcess::flush()
+{
+  CHECK(writing.get() == NULL);
+  CHECK(queued.get() != NULL);
+
+  writing = queued;
+  queued.reset();
+
+  Future<Nothing> future;
+
+  if (io != NULL) {
+    future = dispatch(
+        io,
+        &StorageProcess::persist,
+        writing->metadata,
+        writing->actions);
+  } else {
+    Try<Nothing> persisted =
+      storage->persist(writing->metadata, writing->actions);
+
+    if (persisted.isError()) {
+      future = Failure(persisted.error());
+    } else {
+      future = Nothing();
+    }
+  }
+
+  future.onAny(defer(self(), &Self::_flush, lambda::_1));
+}
+
+
+void ReplicaProcess::_flush(const Future<Nothing>& future)
+{
+  CHECK(writing.get() != NULL);
+
+  if (!future.isReady()) {
+    EXIT(EXIT_FAILURE)
+      << "Failed to write to the log: "
+      << (future.isFailed() ? future.failure() : "discarded");
+  }
+
+  LOG(INFO) << "Persisted " << writing->actions.size() << " action(s)"
+            << (writing->metadata.isSome() ? " and metadata" : "");
+
+  writing->promise.set(Nothing());
+  writing.reset();
+
+  // Write the batch that was queued up meanwhile, if any.
+  if (queued.get() != NULL) {
+    flush();
+  }
 }
 
 
@@ -783,9 +1058,9 @@ void ReplicaProcess::restore(const string& path)
 }
 
 
-Replica::Replica(const string& path)
+Replica::Replica(const string& path, bool asyncIO)
 {
-  process = new ReplicaProcess(path);
+  process = new ReplicaProcess(path, asyncIO);
   spawn(process);
 }
 
@@ -847,6 +1122,12 @@ Future<bool> Replica::update(const Metadata::Status& status)
 }
 
 
+Future<Nothing> Replica::learn(const list<Action>& actions) const
+{
+  return dispatch(process, &ReplicaProcess::learn, actions);
+}
+
+
 PID<ReplicaProcess> Replica::pid() const
 {
   return process->self();
@@ -27,6 +27,7 @@
 #include <process/protobuf.hpp>
 
 #include <stout/interval.hpp>
+#include <stout/nothing.hpp>
 
 #include "messages/log.hpp"
 
@@ -40,6 +41,7 @@ namespace protocol {
 extern Protocol<PromiseRequest, PromiseResponse> promise;
 extern Protocol<WriteRequest, WriteResponse> write;
 extern Protocol<RecoverRequest, RecoverResponse> recover;
+extern Protocol<TransferRequest, TransferResponse> transfer;
 
 } // namespace protocol {
 
@@ -57,7 +59,12 @@ public:
   // reply to any request except the recover request). The recover
   // process will later decide if this replica can be re-allowed to
   // vote depending on the status of other replicas.
-  explicit Replica(const std::string& path);
+  //
+  // The writes to the log are batched and synced to disk once per
+  // batch. If 'asyncIO' is true, they are done by a separate process
+  // so that the replica can keep handling requests (e.g., promise
+  // and read requests) while a batch is being synced.
+  explicit Replica(const std::string& path, bool asyncIO = false);
   virtual ~Replica();
 
   // Returns all the actions between the specified positions, unless
@@ -94,6 +101,12 @@ public:
   // mocking in tests.
   virtual process::Future<bool> update(const Metadata::Status& status);
 
+  // Persists the specified learned actions (e.g., transferred from
+  // another replica during recovery) in a single batch, skipping the
+  // positions that this replica has already learned or truncated.
+  // The future is satisfied once the actions are persisted.
+  process::Future<Nothing> learn(const std::list<Action>& actions) const;
+
   // Returns the PID associated with this replica.
   process::PID<ReplicaProcess> pid() const;
 
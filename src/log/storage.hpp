@@ -19,10 +19,12 @@
 
 #include <stdint.h>
 
+#include <list>
 #include <string>
 
 #include <stout/interval.hpp>
 #include <stout/nothing.hpp>
+#include <stout/option.hpp>
 #include <stout/try.hpp>
 
 #include "messages/log.hpp"
@@ -53,6 +55,13 @@ public:
   virtual Try<State> restore(const std::string& path) = 0;
   virtual Try<Nothing> persist(const Metadata& metadata) = 0;
   virtual Try<Nothing> persist(const Action& action) = 0;
+
+  // Persists the metadata (if any) and the actions (in order) with a
+  // single write, i.e., either all or none of them get persisted.
+  virtual Try<Nothing> persist(
+      const Option<Metadata>& metadata,
+      const std::list<Action>& actions) = 0;
+
   virtual Try<Action> read(uint64_t position) = 0;
 };
 
@@ -0,0 +1,268 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+
+#include <glog/logging.h>
+
+#include <stout/foreach.hpp>
+#include <stout/hashmap.hpp>
+#include <stout/hashset.hpp>
+#include <stout/option.hpp>
+#include <stout/stringify.hpp>
+#include <stout/strings.hpp>
+#include <stout/unreachable.hpp>
+
+#include "common/resource_quantities.hpp"
+
+#include "master/allocator/mesos/agent_ordering.hpp"
+
+using std::set;
+using std::string;
+using std::vector;
+
+namespace mesos {
+namespace internal {
+namespace master {
+namespace allocator {
+
+// Orders the agents randomly.
+class RandomAgentOrdering : public AgentOrdering
+{
+public:
+  virtual void add(
+      const SlaveID& slaveId,
+      const SlaveInfo& slaveInfo,
+      const Resources& total,
+      const Resources& allocated) {}
+
+  virtual void remove(const SlaveID& slaveId) {}
+
+  virtual void update(
+      const SlaveID& slaveId,
+      const Resources& total,
+      const Resources& allocated) {}
+
+  virtual void order(vector<SlaveID>* slaveIds)
+  {
+    std::random_shuffle(slaveIds->begin(), slaveIds->end());
+  }
+};
+
+
+// Orders the agents by their utilization, and optionally groups them
+// by the value of an attribute first.
+class IndexedAgentOrdering : public AgentOrdering
+{
+public:
+  enum Policy
+  {
+    SPREAD,   // Least utilized first.
+    BINPACK   // Most utilized first.
+  };
+
+  IndexedAgentOrdering(Policy _policy, const Option<string>& _attribute)
+    : policy(_policy), attribute(_attribute) {}
+
+  virtual void add(
+      const SlaveID& slaveId,
+      const SlaveInfo& slaveInfo,
+      const Resources& total,
+      const Resources& allocated)
+  {
+    CHECK(!keys.contains(slaveId)) << slaveId;
+
+    Key key;
+    key.slaveId = slaveId.value();
+    key.ungrouped = attribute.isSome();
+
+    if (attribute.isSome()) {
+      foreach (const Attribute& attribute_, slaveInfo.attributes()) {
+        if (attribute_.name() == attribute.get()) {
+          key.ungrouped = false;
+          key.group = value(attribute_);
+          break;
+        }
+      }
+    }
+
+    key.score = score(total, allocated);
+
+    keys[slaveId] = key;
+    index.insert(key);
+  }
+
+  virtual void remove(const SlaveID& slaveId)
+  {
+    CHECK(keys.contains(slaveId)) << slaveId;
+
+    index.erase(keys[slaveId]);
+    keys.erase(slaveId);
+  }
+
+  virtual void update(
+      const SlaveID& slaveId,
+      const Resources& total,
+      const Resources& allocated)
+  {
+    CHECK(keys.contains(slaveId)) << slaveId;
+
+    Key& key = keys[slaveId];
+
+    const double score_ = score(total, allocated);
+    if (score_ == key.score) {
+      return;
+    }
+
+    index.erase(key);
+    key.score = score_;
+    index.insert(key);
+  }
+
+  virtual void order(vector<SlaveID>* slaveIds)
+  {
+    // Walking the index takes time linear in the number of agents,
+    // while sorting the agents takes O(k log k) for k agents. So
+    // we only sort when few of the agents need to be ordered.
+    const double k = static_cast<double>(slaveIds->size());
+
+    if (k * std::log2(k + 1) < static_cast<double>(index.size())) {
+      std::sort(
+          slaveIds->begin(),
+          slaveIds->end(),
+          [this](const SlaveID& left, const SlaveID& right) {
+            return keys.at(left) < keys.at(right);
+          });
+
+      return;
+    }
+
+    hashset<string> candidates;
+    foreach (const SlaveID& slaveId, *slaveIds) {
+      candidates.insert(slaveId.value());
+    }
+
+    slaveIds->clear();
+
+    foreach (const Key& key, index) {
+      if (candidates.contains(key.slaveId)) {
+        SlaveID slaveId;
+        slaveId.set_value(key.slaveId);
+        slaveIds->push_back(slaveId);
+      }
+    }
+  }
+
+private:
+  struct Key
+  {
+    bool operator<(const Key& that) const
+    {
+      if (ungrouped != that.ungrouped) {
+        return !ungrouped;
+      }
+
+      if (group != that.group) {
+        return group < that.group;
+      }
+
+      if (score != that.score) {
+        return score < that.score;
+      }
+
+      return slaveId < that.slaveId;
+    }
+
+    // Whether the agent lacks the attribute to group by (if any),
+    // these agents come last.
+    bool ungrouped;
+    string group;
+
+    // Agents with a lower score come first.
+    double score;
+
+    string slaveId;
+  };
+
+  static string value(const Attribute& attribute)
+  {
+    switch (attribute.type()) {
+      case Value::SCALAR: return stringify(attribute.scalar());
+      case Value::RANGES: return stringify(attribute.ranges());
+      case Value::SET:    return stringify(attribute.set());
+      case Value::TEXT:   return attribute.text().value();
+      default:
+        LOG(FATAL) << "Unexpected attribute type " << attribute.type();
+    }
+
+    UNREACHABLE();
+  }
+
+  double score(const Resources& total, const Resources& allocated) const
+  {
+    // The utilization of the agent is the share of its dominant
+    // resource, i.e., the largest allocated fraction of any of its
+    // scalar resources.
+    const ResourceQuantities totalQuantities =
+      ResourceQuantities::fromScalarResources(total);
+    const ResourceQuantities allocatedQuantities =
+      ResourceQuantities::fromScalarResources(allocated);
+
+    double utilization = 0.0;
+    foreach (const auto& quantity, totalQuantities) {
+      utilization = std::max(
+          utilization,
+          allocatedQuantities.get(quantity.first) / quantity.second);
+    }
+
+    return policy == SPREAD ? utilization : -utilization;
+  }
+
+  const Policy policy;
+  const Option<string> attribute;
+
+  hashmap<SlaveID, Key> keys;
+  set<Key> index;
+};
+
+
+Try<AgentOrdering*> AgentOrdering::create(const string& name)
+{
+  if (name == "random") {
+    return new RandomAgentOrdering();
+  } else if (name == "spread") {
+    return new IndexedAgentOrdering(IndexedAgentOrdering::SPREAD, None());
+  } else if (name == "binpack") {
+    return new IndexedAgentOrdering(IndexedAgentOrdering::BINPACK, None());
+  } else if (strings::startsWith(name, "attribute:")) {
+    const string attribute = name.substr(string("attribute:").size());
+
+    if (attribute.empty()) {
+      return Error("Expected an attribute name after 'attribute:'");
+    }
+
+    return new IndexedAgentOrdering(IndexedAgentOrdering::BINPACK, attribute);
+  }
+
+  return Error("Unknown agent ordering '" + name + "'");
+}
+
+} // namespace allocator {
+} // namespace master {
+} // namespace internal {
+} // namespace mesos {
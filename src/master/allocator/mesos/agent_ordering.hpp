@@ -0,0 +1,86 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __MASTER_ALLOCATOR_MESOS_AGENT_ORDERING_HPP__
+#define __MASTER_ALLOCATOR_MESOS_AGENT_ORDERING_HPP__
+
+#include <string>
+#include <vector>
+
+#include <mesos/mesos.hpp>
+#include <mesos/resources.hpp>
+
+#include <stout/try.hpp>
+
+namespace mesos {
+namespace internal {
+namespace master {
+namespace allocator {
+
+// Determines the order in which the allocator allocates the resources
+// of the agents. The agent that comes first is offered first, so this
+// decides which agents the frameworks' tasks end up on:
+//
+//   * "random": A random order, every allocation (the default).
+//   * "spread": The least utilized agents first, which spreads the
+//     allocations evenly across the agents.
+//   * "binpack": The most utilized agents first, which packs the
+//     allocations onto as few agents as possible and keeps the other
+//     agents free for large tasks.
+//   * "attribute:<name>": The agents grouped by the value of the
+//     named attribute (e.g., a rack or zone), with the groups ordered
+//     by value and the agents within a group ordered as for
+//     "binpack". Agents without the attribute come last.
+//
+// The utilization of an agent is the largest fraction allocated of
+// any of its scalar resources, i.e., the share of its dominant
+// resource. The orderings other than "random" keep the agents in an
+// index by their utilization, so that an update costs O(log n) and
+// the agents can be ordered without sorting them every allocation.
+class AgentOrdering
+{
+public:
+  // Returns the ordering with the given name, see above.
+  static Try<AgentOrdering*> create(const std::string& name);
+
+  virtual ~AgentOrdering() {}
+
+  virtual void add(
+      const SlaveID& slaveId,
+      const SlaveInfo& slaveInfo,
+      const Resources& total,
+      const Resources& allocated) = 0;
+
+  virtual void remove(const SlaveID& slaveId) = 0;
+
+  // Must be called whenever the total or allocated resources of the
+  // agent change.
+  virtual void update(
+      const SlaveID& slaveId,
+      const Resources& total,
+      const Resources& allocated) = 0;
+
+  // Puts the agents, which must all have been added, in the order
+  // that their resources should be allocated.
+  virtual void order(std::vector<SlaveID>* slaveIds) = 0;
+};
+
+} // namespace allocator {
+} // namespace master {
+} // namespace internal {
+} // namespace mesos {
+
+#endif // __MASTER_ALLOCATOR_MESOS_AGENT_ORDERING_HPP__
@@ -55,7 +55,10 @@ public:
           void(const FrameworkID&,
                const hashmap<SlaveID, UnavailableResources>&)>&
         inverseOfferCallback,
-      const hashmap<std::string, double>& weights);
+      const hashmap<std::string, double>& weights,
+      size_t allocationShards,
+      const Duration& minAllocationInterval,
+      const std::string& agentOrdering);
 
   void recover(
       const int expectedAgentCount,
@@ -179,7 +182,10 @@ public:
           void(const FrameworkID&,
                const hashmap<SlaveID, UnavailableResources>&)>&
         inverseOfferCallback,
-      const hashmap<std::string, double>& weights) = 0;
+      const hashmap<std::string, double>& weights,
+      size_t allocationShards,
+      const Duration& minAllocationInterval,
+      const std::string& agentOrdering) = 0;
 
   virtual void recover(
       const int expectedAgentCount,
@@ -311,7 +317,10 @@ inline void MesosAllocator<AllocatorProcess>::initialize(
         void(const FrameworkID&,
               const hashmap<SlaveID, UnavailableResources>&)>&
       inverseOfferCallback,
-    const hashmap<std::string, double>& weights)
+    const hashmap<std::string, double>& weights,
+    size_t allocationShards,
+    const Duration& minAllocationInterval,
+    const std::string& agentOrdering)
 {
   process::dispatch(
       process,
@@ -319,7 +328,10 @@ inline void MesosAllocator<AllocatorProcess>::initialize(
       allocationInterval,
       offerCallback,
       inverseOfferCallback,
-      weights);
+      weights,
+      allocationShards,
+      minAllocationInterval,
+      agentOrdering);
 }
 
 
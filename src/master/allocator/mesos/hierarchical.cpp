@@ -17,28 +17,37 @@
 #include "master/allocator/mesos/hierarchical.hpp"
 
 #include <algorithm>
+#include <list>
 #include <vector>
 
 #include <mesos/resources.hpp>
 #include <mesos/type_utils.hpp>
 
-#include <process/event.hpp>
+#include <process/clock.hpp>
+#include <process/collect.hpp>
 #include <process/delay.hpp>
+#include <process/dispatch.hpp>
+#include <process/event.hpp>
 #include <process/id.hpp>
+#include <process/process.hpp>
 #include <process/timeout.hpp>
 
 #include <stout/check.hpp>
 #include <stout/hashset.hpp>
+#include <stout/nothing.hpp>
 #include <stout/stopwatch.hpp>
 #include <stout/stringify.hpp>
 
+using std::list;
 using std::string;
 using std::vector;
 
 using mesos::master::InverseOfferStatus;
 
+using process::Clock;
 using process::Failure;
 using process::Future;
+using process::Time;
 using process::Timeout;
 
 namespace mesos {
@@ -47,36 +56,6 @@ namespace master {
 namespace allocator {
 namespace internal {
 
-// Used to represent "filters" for resources unused in offers.
-class OfferFilter
-{
-public:
-  virtual ~OfferFilter() {}
-
-  virtual bool filter(const Resources& resources) = 0;
-};
-
-
-class RefusedOfferFilter : public OfferFilter
-{
-public:
-  RefusedOfferFilter(const Resources& _resources) : resources(_resources) {}
-
-  virtual bool filter(const Resources& _resources)
-  {
-    // TODO(jieyu): Consider separating the superset check for regular
-    // and revocable resources. For example, frameworks might want
-    // more revocable resources only or non-revocable resources only,
-    // but currently the filter only expires if there is more of both
-    // revocable and non-revocable resources.
-    return resources.contains(_resources); // Refused resources are superset.
-  }
-
-private:
-  const Resources resources;
-};
-
-
 // Used to represent "filters" for inverse offers.
 //
 // NOTE: Since this specific allocator implementation only sends inverse offers
@@ -114,6 +93,82 @@ private:
 };
 
 
+// Evaluates a shard of the slaves during an allocation, see
+// `HierarchicalAllocatorProcess::evaluate()`.
+class AllocationShardProcess : public process::Process<AllocationShardProcess>
+{
+public:
+  AllocationShardProcess()
+    : ProcessBase(process::ID::generate("allocation-shard")) {}
+
+  Nothing evaluate(const lambda::function<void()>& f)
+  {
+    f();
+    return Nothing();
+  }
+};
+
+
+// The resources a role would be offered on a slave in each stage of
+// an allocation, see `HierarchicalAllocatorProcess::allocate()`.
+struct Offerable
+{
+  Offerable() {}
+
+  Offerable(
+      const Resources& unreserved,
+      const Resources& reserved,
+      bool hasQuota)
+  {
+    // First stage: the non-revocable unreserved and reserved resources.
+    quota = (unreserved + reserved).nonRevocable();
+
+    // Second stage: the reserved resources, and the unreserved ones
+    // unless the role has quota.
+    fairShare = reserved;
+    if (!hasQuota) {
+      fairShare += unreserved;
+    }
+
+    fairShareNonRevocable = fairShare.nonRevocable();
+  }
+
+  Resources quota;
+  Resources fairShare;
+  Resources fairShareNonRevocable;
+};
+
+
+// The result of evaluating a slave for allocation, i.e., what would be
+// offered to each role and which frameworks filter those resources.
+// This is only valid as long as nothing has been allocated on the slave
+// since it was evaluated.
+struct AgentEvaluation
+{
+  const Offerable& offerable(const string& role, bool hasQuota) const
+  {
+    if (reserved.contains(role)) {
+      return reserved.at(role);
+    }
+
+    return hasQuota ? unreservedQuota : unreserved;
+  }
+
+  // The resources offerable to roles without reservations on the
+  // slave, depending on whether the role has quota.
+  Offerable unreserved;
+  Offerable unreservedQuota;
+
+  // The resources offerable to roles with reservations on the slave.
+  hashmap<string, Offerable> reserved;
+
+  // Frameworks that filter the resources they would be offered in
+  // the first and second stage.
+  hashset<FrameworkID> quotaFiltered;
+  hashset<FrameworkID> fairShareFiltered;
+};
+
+
 void HierarchicalAllocatorProcess::initialize(
     const Duration& _allocationInterval,
     const lambda::function<
@@ -123,12 +178,25 @@ void HierarchicalAllocatorProcess::initialize(
         void(const FrameworkID&,
              const hashmap<SlaveID, UnavailableResources>&)>&
       _inverseOfferCallback,
-    const hashmap<string, double>& _weights)
+    const hashmap<string, double>& _weights,
+    size_t _allocationShards,
+    const Duration& _minAllocationInterval,
+    const string& _agentOrdering)
 {
+  CHECK_GT(_allocationShards, 0u);
+  CHECK_GE(_minAllocationInterval, Duration::zero());
+
   allocationInterval = _allocationInterval;
   offerCallback = _offerCallback;
   inverseOfferCallback = _inverseOfferCallback;
   weights = _weights;
+  allocationShards = _allocationShards;
+  minAllocationInterval = _minAllocationInterval;
+
+  Try<AgentOrdering*> ordering = AgentOrdering::create(_agentOrdering);
+  CHECK_SOME(ordering) << "Invalid agent ordering '" << _agentOrdering << "'";
+  agentOrdering.reset(ordering.get());
+
   initialized = true;
   paused = false;
 
@@ -141,12 +209,34 @@ void HierarchicalAllocatorProcess::initialize(
   roleSorter = roleSorterFactory();
   quotaRoleSorter = roleSorterFactory();
 
-  VLOG(1) << "Initialized hierarchical allocator process";
+  if (allocationShards > 1) {
+    for (size_t i = 0; i < allocationShards; i++) {
+      AllocationShardProcess* shard = new AllocationShardProcess();
+      process::spawn(shard);
+      shards.push_back(shard);
+    }
+  }
+
+  VLOG(1) << "Initialized hierarchical allocator process"
+          << " with " << allocationShards << " allocation shard(s)"
+          << " and '" << _agentOrdering << "' agent ordering";
 
   delay(allocationInterval, self(), &Self::batch);
 }
 
 
+void HierarchicalAllocatorProcess::finalize()
+{
+  foreach (AllocationShardProcess* shard, shards) {
+    process::terminate(shard);
+    process::wait(shard);
+    delete shard;
+  }
+
+  shards.clear();
+}
+
+
 void HierarchicalAllocatorProcess::recover(
     const int _expectedAgentCount,
     const hashmap<string, Quota>& quotas)
@@ -317,8 +407,10 @@ void HierarchicalAllocatorProcess::removeFramework(
     frameworkSorters.erase(role);
   }
 
+  offerFilters.remove(frameworkId);
+
   // Do not delete the filters contained in this
-  // framework's `offerFilters` hashset yet, see comments in
+  // framework's `inverseOfferFilters` hashset yet, see comments in
   // HierarchicalAllocatorProcess::reviveOffers and
   // HierarchicalAllocatorProcess::expire.
   frameworks.erase(frameworkId);
@@ -362,10 +454,10 @@ void HierarchicalAllocatorProcess::deactivateFramework(
   // the added/removed and activated/deactivated in the future.
 
   // Do not delete the filters contained in this
-  // framework's `offerFilters` hashset yet, see comments in
+  // framework's `inverseOfferFilters` hashset yet, see comments in
   // HierarchicalAllocatorProcess::reviveOffers and
   // HierarchicalAllocatorProcess::expire.
-  frameworks[frameworkId].offerFilters.clear();
+  offerFilters.remove(frameworkId);
   frameworks[frameworkId].inverseOfferFilters.clear();
 
   // Clear the suppressed flag to make sure the framework can be offered
@@ -396,6 +488,9 @@ void HierarchicalAllocatorProcess::updateFramework(
       frameworks[frameworkId].revocable = true;
     }
   }
+
+  // The framework may now be offered (revocable) resources on any slave.
+  allocateAllSlaves = true;
 }
 
 
@@ -445,6 +540,9 @@ void HierarchicalAllocatorProcess::addSlave(
   slaves[slaveId].activated = true;
   slaves[slaveId].hostname = slaveInfo.hostname();
 
+  agentOrdering->add(
+      slaveId, slaveInfo, total, slaves[slaveId].allocated);
+
   // NOTE: We currently implement maintenance in the allocator to be able to
   // leverage state and features such as the FrameworkSorter and OfferFilter.
   if (unavailability.isSome()) {
@@ -496,10 +594,11 @@ void HierarchicalAllocatorProcess::removeSlave(
   quotaRoleSorter->remove(slaveId, slaves[slaveId].total.nonRevocable());
 
   slaves.erase(slaveId);
+  agentOrdering->remove(slaveId);
+  allocationCandidates.erase(slaveId);
 
   // Note that we DO NOT actually delete any filters associated with
-  // this slave, that will occur when the delayed
-  // HierarchicalAllocatorProcess::expire gets invoked (or the framework
+  // this slave, that will occur when they expire (or the framework
   // that applied the filters gets removed).
 
   LOG(INFO) << "Removed slave " << slaveId;
@@ -522,6 +621,9 @@ void HierarchicalAllocatorProcess::updateSlave(
   // add the new estimate of oversubscribed resources.
   slaves[slaveId].total = slaves[slaveId].total.nonRevocable() + oversubscribed;
 
+  agentOrdering->update(
+      slaveId, slaves[slaveId].total, slaves[slaveId].allocated);
+
   // Now, update the total resources in the role sorters.
   roleSorter->update(slaveId, slaves[slaveId].total);
 
@@ -544,6 +646,7 @@ void HierarchicalAllocatorProcess::activateSlave(
   CHECK(slaves.contains(slaveId));
 
   slaves[slaveId].activated = true;
+  allocationCandidates.insert(slaveId);
 
   LOG(INFO)<< "Slave " << slaveId << " reactivated";
 }
@@ -567,6 +670,7 @@ void HierarchicalAllocatorProcess::updateWhitelist(
   CHECK(initialized);
 
   whitelist = _whitelist;
+  allocateAllSlaves = true;
 
   if (whitelist.isSome()) {
     LOG(INFO) << "Updated slave whitelist: " << stringify(whitelist.get());
@@ -650,6 +754,9 @@ void HierarchicalAllocatorProcess::updateAllocation(
 
   slaves[slaveId].total = updatedTotal.get();
 
+  agentOrdering->update(
+      slaveId, slaves[slaveId].total, slaves[slaveId].allocated);
+
   LOG(INFO) << "Updated allocation of framework " << frameworkId
             << " on slave " << slaveId
             << " from " << frameworkAllocation
@@ -689,12 +796,17 @@ Future<Nothing> HierarchicalAllocatorProcess::updateAvailable(
 
   slaves[slaveId].total = updatedTotal.get();
 
+  agentOrdering->update(
+      slaveId, slaves[slaveId].total, slaves[slaveId].allocated);
+
   // Now, update the total resources in the role sorters.
   roleSorter->update(slaveId, slaves[slaveId].total);
 
   // See comment at `quotaRoleSorter` declaration regarding non-revocable.
   quotaRoleSorter->update(slaveId, slaves[slaveId].total.nonRevocable());
 
+  allocationCandidates.insert(slaveId);
+
   return Nothing();
 }
 
@@ -756,6 +868,7 @@ void HierarchicalAllocatorProcess::updateInverseOffer(
     // We always remove the outstanding offer so that we will send a new offer
     // out the next time we schedule inverse offers.
     maintenance.offersOutstanding.erase(frameworkId);
+    allocationCandidates.insert(slaveId);
 
     // If the response is `Some`, this means the framework responded. Otherwise
     // if it is `None` the inverse offer timed out or was rescinded.
@@ -889,6 +1002,14 @@ void HierarchicalAllocatorProcess::recoverResources(
 
     slaves[slaveId].allocated -= resources;
 
+    agentOrdering->update(
+        slaveId, slaves[slaveId].total, slaves[slaveId].allocated);
+
+    // NOTE: We don't trigger an allocation here but leave the slave
+    // for the next batch allocation, so that declined resources are
+    // not immediately offered again.
+    allocationCandidates.insert(slaveId);
+
     VLOG(1) << "Recovered " << resources
             << " (total: " << slaves[slaveId].total
             << ", allocated: " << slaves[slaveId].allocated
@@ -930,17 +1051,6 @@ void HierarchicalAllocatorProcess::recoverResources(
             << " filtered slave " << slaveId
             << " for " << timeout.get();
 
-    // Create a new filter.
-    OfferFilter* offerFilter = new RefusedOfferFilter(resources);
-    frameworks[frameworkId].offerFilters[slaveId].insert(offerFilter);
-
-    // We need to disambiguate the function call to pick the correct
-    // expire() overload.
-    void (Self::*expireOffer)(
-              const FrameworkID&,
-              const SlaveID&,
-              OfferFilter*) = &Self::expire;
-
     // Expire the filter after both an `allocationInterval` and the
     // `timeout` have elapsed. This ensures that the filter does not
     // expire before we perform the next allocation for this agent,
@@ -950,12 +1060,13 @@ void HierarchicalAllocatorProcess::recoverResources(
     // (MESOS-3078), we would not need to increase the timeout here.
     timeout = std::max(allocationInterval, timeout.get());
 
-    delay(timeout.get(),
-          self(),
-          expireOffer,
-          frameworkId,
-          slaveId,
-          offerFilter);
+    offerFilters.add(
+        frameworkId,
+        slaveId,
+        resources,
+        Clock::now() + timeout.get());
+
+    scheduleOfferFilterExpiration();
   }
 }
 
@@ -976,16 +1087,17 @@ void HierarchicalAllocatorProcess::reviveOffers(
 {
   CHECK(initialized);
 
-  frameworks[frameworkId].offerFilters.clear();
+  offerFilters.remove(frameworkId);
   frameworks[frameworkId].inverseOfferFilters.clear();
   frameworks[frameworkId].suppressed = false;
 
-  // We delete each actual `OfferFilter` when
+  // We delete each actual `InverseOfferFilter` when
   // `HierarchicalAllocatorProcess::expire` gets invoked. If we delete the
-  // `OfferFilter` here it's possible that the same `OfferFilter` (i.e., same
-  // address) could get reused and `HierarchicalAllocatorProcess::expire`
-  // would expire that filter too soon. Note that this only works
-  // right now because ALL Filter types "expire".
+  // `InverseOfferFilter` here it's possible that the same
+  // `InverseOfferFilter` (i.e., same address) could get reused and
+  // `HierarchicalAllocatorProcess::expire` would expire that filter too
+  // soon. Note that this only works right now because ALL Filter types
+  // "expire".
 
   LOG(INFO) << "Removed offer filters for framework " << frameworkId;
 
@@ -1008,6 +1120,8 @@ void HierarchicalAllocatorProcess::setQuota(
   // Persist quota in memory and add the role into the corresponding
   // allocation group.
   quotas[role] = quota;
+  quotaGuarantees[role] =
+    ResourceQuantities::fromScalarResources(quota.info.guarantee());
   quotaRoleSorter->add(role, roleWeight(role));
 
   // Copy allocation information for the quota'ed role.
@@ -1045,6 +1159,7 @@ void HierarchicalAllocatorProcess::removeQuota(
 
   // Remove the role from the quota'ed allocation group.
   quotas.erase(role);
+  quotaGuarantees.erase(role);
   quotaRoleSorter->remove(role);
 
   // Trigger the allocation explicitly in order to promptly react to the
@@ -1069,51 +1184,101 @@ void HierarchicalAllocatorProcess::resume()
     VLOG(1) << "Allocation resumed";
 
     paused = false;
+    allocateAllSlaves = true;
   }
 }
 
 
 void HierarchicalAllocatorProcess::batch()
 {
-  allocate();
+  if (allocateAllSlaves || !allocationCandidates.empty()) {
+    _allocate();
+  } else {
+    VLOG(1) << "Skipped allocation because there are no allocation candidates";
+
+    ++metrics.allocation_runs_skipped;
+  }
+
   delay(allocationInterval, self(), &Self::batch);
 }
 
 
 void HierarchicalAllocatorProcess::allocate()
 {
-  if (paused) {
-    VLOG(1) << "Skipped allocation because the allocator is paused";
+  allocateAllSlaves = true;
+  schedule();
+}
+
+
+void HierarchicalAllocatorProcess::allocate(
+    const SlaveID& slaveId)
+{
+  allocationCandidates.insert(slaveId);
+  schedule();
+}
+
 
+void HierarchicalAllocatorProcess::schedule()
+{
+  if (allocationScheduled) {
     return;
   }
 
-  Stopwatch stopwatch;
-  stopwatch.start();
+  allocationScheduled = true;
 
-  allocate(slaves.keys());
+  Duration wait = Duration::zero();
+  if (lastAllocation.isSome()) {
+    wait = minAllocationInterval -
+      (Clock::now() - lastAllocation.get());
+  }
 
-  VLOG(1) << "Performed allocation for " << slaves.size() << " slaves in "
-            << stopwatch.elapsed();
+  if (wait > Duration::zero()) {
+    delay(wait, self(), &Self::_allocate);
+  } else {
+    dispatch(self(), &Self::_allocate);
+  }
 }
 
 
-void HierarchicalAllocatorProcess::allocate(
-    const SlaveID& slaveId)
+void HierarchicalAllocatorProcess::_allocate()
 {
+  allocationScheduled = false;
+
   if (paused) {
     VLOG(1) << "Skipped allocation because the allocator is paused";
 
     return;
   }
 
+  // The candidates might have been allocated by a batch allocation
+  // since this allocation was scheduled.
+  if (!allocateAllSlaves && allocationCandidates.empty()) {
+    return;
+  }
+
+  hashset<SlaveID> slaveIds;
+  if (allocateAllSlaves) {
+    slaveIds = slaves.keys();
+  } else {
+    slaveIds.swap(allocationCandidates);
+  }
+
+  allocateAllSlaves = false;
+  allocationCandidates.clear();
+
   Stopwatch stopwatch;
   stopwatch.start();
 
-  hashset<SlaveID> slaves({slaveId});
-  allocate(slaves);
+  metrics.allocation_run.start();
+
+  allocate(slaveIds);
+
+  metrics.allocation_run.stop();
+  ++metrics.allocation_runs;
 
-  VLOG(1) << "Performed allocation for slave " << slaveId << " in "
+  lastAllocation = Clock::now();
+
+  VLOG(1) << "Performed allocation for " << slaveIds.size() << " slaves in "
           << stopwatch.elapsed();
 }
 
@@ -1144,64 +1309,103 @@ void HierarchicalAllocatorProcess::allocate(
     }
   }
 
-  // Randomize the order in which slaves' resources are allocated.
-  //
-  // TODO(vinod): Implement a smarter sorting algorithm.
-  std::random_shuffle(slaveIds.begin(), slaveIds.end());
-
-  // Returns the __amount__ of resources allocated to a quota role. Since we
-  // account for reservations and persistent volumes toward quota, we strip
-  // reservation and persistent volume related information for comparability.
-  // The result is used to determine whether a role's quota is satisfied, and
-  // also to determine how many resources the role would need in order to meet
-  // its quota.
-  //
-  // NOTE: Revocable resources are excluded in `quotaRoleSorter`.
-  auto getQuotaRoleAllocatedResources = [this](const string& role) {
-    CHECK(quotas.contains(role));
+  // Determine the order in which slaves' resources are allocated.
+  agentOrdering->order(&slaveIds);
 
-    // Strip the reservation and persistent volume info.
-    Resources resources;
+  // If we have shards, evaluate the slaves in parallel up front: the
+  // resources that would be offered to each role and the frameworks
+  // that filter them. The allocation decisions below are still made
+  // in order against the sorters (so that quota and fair share are
+  // respected), but use an evaluation instead of recomputing it as
+  // long as nothing has been allocated on the slave since.
+  vector<AgentEvaluation> evaluations;
+  hashmap<SlaveID, const AgentEvaluation*> evaluated;
 
-    foreach (Resource resource, quotaRoleSorter->allocationScalars(role)) {
-      resource.set_role("*");
-      resource.clear_reservation();
-      resource.clear_disk();
-      resources += resource;
+  if (!shards.empty()) {
+    evaluate(slaveIds, &evaluations);
+
+    for (size_t i = 0; i < slaveIds.size(); i++) {
+      evaluated[slaveIds[i]] = &evaluations[i];
     }
+  }
 
-    return resources;
-  };
+  // The quota'ed roles with active frameworks whose quota is not yet
+  // satisfied. A role's quota only becomes satisfied by allocating to
+  // it below, so we check it once up front and then again only after
+  // allocating to the role, rather than for every role on every slave.
+  // If all quotas are satisfied, the first stage is skipped entirely.
+  hashset<string> unsatisfiedQuotaRoles;
+  foreachkey (const string& role, quotas) {
+    if (activeRoles.contains(role) && !isQuotaSatisfied(role)) {
+      unsatisfiedQuotaRoles.insert(role);
+    }
+  }
 
   // Quota comes first and fair share second. Here we process only those
   // roles, for which quota is set (quota'ed roles). Such roles form a
   // special allocation group with a dedicated sorter.
   foreach (const SlaveID& slaveId, slaveIds) {
-    foreach (const string& role, quotaRoleSorter->sort()) {
-      CHECK(quotas.contains(role));
+    if (unsatisfiedQuotaRoles.empty()) {
+      break;
+    }
 
-      // If there are no active frameworks in this role, we do not
-      // need to do any allocations for this role.
-      if (!activeRoles.contains(role)) {
-        continue;
-      }
+    const AgentEvaluation* evaluation =
+      evaluated.contains(slaveId) ? evaluated.at(slaveId) : NULL;
 
-      // Get the total amount of resources allocated to a quota role.
-      Resources roleConsumedResources = getQuotaRoleAllocatedResources(role);
+    // Calculate the currently available resources on the slave, unless
+    // it has been evaluated. This only changes when we allocate some of
+    // them below, so we avoid the (expensive) arithmetic for every role
+    // and framework.
+    Resources available;
+    if (evaluation == NULL) {
+      available = slaves[slaveId].total - slaves[slaveId].allocated;
+    }
 
-      // If quota for the role is satisfied, we do not need to do any further
+    foreach (const string& role, quotaRoleSorter->sort()) {
+      CHECK(quotas.contains(role));
+
+      // If there are no active frameworks in this role, or quota for
+      // the role is satisfied, we do not need to do any further
       // allocations for this role, at least at this stage.
       //
-      // TODO(alexr): Skipping satisfied roles is pessimistic. Better
-      // alternatives are:
-      //   * A custom sorter that is aware of quotas and sorts accordingly.
-      //   * Removing satisfied roles from the sorter.
-      if (roleConsumedResources.contains(quotas[role].info.guarantee())) {
+      // TODO(alexr): Skipping satisfied roles is pessimistic. A better
+      // alternative is removing satisfied roles from the sorter.
+      if (!unsatisfiedQuotaRoles.contains(role)) {
         continue;
       }
 
+      // The resources we offer are the unreserved resources as well as the
+      // reserved resources for this particular role. This is necessary to
+      // ensure that we don't offer resources that are reserved for another
+      // role.
+      //
+      // NOTE: Currently, frameworks are allowed to have '*' role.
+      // Calling reserved('*') returns an empty Resources object.
+      //
+      // Quota is satisfied from the available non-revocable resources on the
+      // agent. It's important that we include reserved resources here since
+      // reserved resources are accounted towards the quota guarantee. If we
+      // were to rely on stage 2 to offer them out, they would not be checked
+      // against the quota guarantee.
+      //
+      // NOTE: See `Offerable` which calculates the same for an evaluation.
+      Resources resources = evaluation != NULL
+        ? evaluation->offerable(role, true).quota
+        : (available.unreserved() + available.reserved(role)).nonRevocable();
+
+      // NOTE: The resources may not be allocatable here, but they can be
+      // accepted by one of the frameworks during the second allocation
+      // stage.
+      bool allocatable_ = allocatable(resources);
+
+      bool allocated = false;
+
       // Fetch frameworks according to their fair share.
       foreach (const string& frameworkId_, frameworkSorters[role]->sort()) {
+        if (!allocatable_) {
+          break;
+        }
+
         FrameworkID frameworkId;
         frameworkId.set_value(frameworkId_);
 
@@ -1211,35 +1415,11 @@ void HierarchicalAllocatorProcess::allocate(
           continue;
         }
 
-        // Calculate the currently available resources on the slave.
-        Resources available = slaves[slaveId].total - slaves[slaveId].allocated;
-
-        // The resources we offer are the unreserved resources as well as the
-        // reserved resources for this particular role. This is necessary to
-        // ensure that we don't offer resources that are reserved for another
-        // role.
-        //
-        // NOTE: Currently, frameworks are allowed to have '*' role.
-        // Calling reserved('*') returns an empty Resources object.
-        //
-        // Quota is satisfied from the available non-revocable resources on the
-        // agent. It's important that we include reserved resources here since
-        // reserved resources are accounted towards the quota guarantee. If we
-        // were to rely on stage 2 to offer them out, they would not be checked
-        // against the quota guarantee.
-        Resources resources =
-          (available.unreserved() + available.reserved(role)).nonRevocable();
-
-        // NOTE: The resources may not be allocatable here, but they can be
-        // accepted by one of the frameworks during the second allocation
-        // stage.
-        if (!allocatable(resources)) {
-          continue;
-        }
-
         // If the framework filters these resources, ignore. The unallocated
         // part of the quota will not be allocated to other roles.
-        if (isFiltered(frameworkId, slaveId, resources)) {
+        if (evaluation != NULL
+              ? evaluation->quotaFiltered.contains(frameworkId)
+              : isFiltered(frameworkId, slaveId, resources)) {
           continue;
         }
 
@@ -1253,6 +1433,9 @@ void HierarchicalAllocatorProcess::allocate(
         offerable[frameworkId][slaveId] += resources;
         slaves[slaveId].allocated += resources;
 
+        agentOrdering->update(
+            slaveId, slaves[slaveId].total, slaves[slaveId].allocated);
+
         // Resources allocated as part of the quota count towards the
         // role's and the framework's fair share.
         //
@@ -1261,6 +1444,20 @@ void HierarchicalAllocatorProcess::allocate(
         frameworkSorters[role]->allocated(frameworkId_, slaveId, resources);
         roleSorter->allocated(role, slaveId, resources);
         quotaRoleSorter->allocated(role, slaveId, resources);
+        allocated = true;
+
+        // The evaluation of the slave is no longer valid.
+        evaluated.erase(slaveId);
+        evaluation = NULL;
+
+        available = slaves[slaveId].total - slaves[slaveId].allocated;
+        resources =
+          (available.unreserved() + available.reserved(role)).nonRevocable();
+        allocatable_ = allocatable(resources);
+      }
+
+      if (allocated && isQuotaSatisfied(role)) {
+        unsatisfiedQuotaRoles.erase(role);
       }
     }
   }
@@ -1280,17 +1477,23 @@ void HierarchicalAllocatorProcess::allocate(
 
   // Frameworks in a quota'ed role may temporarily reject resources by
   // filtering or suppressing offers. Hence quotas may not be fully allocated.
-  Resources unallocatedQuotaResources;
-  foreachpair (const string& name, const Quota& quota, quotas) {
+  ResourceQuantities unallocatedQuota;
+  foreachpair (const string& role,
+               const ResourceQuantities& guarantee,
+               quotaGuarantees) {
     // Compute the amount of quota that the role does not have allocated.
+    // Since we account for reservations and persistent volumes toward
+    // quota, only the quantities of the allocation are compared.
     //
     // NOTE: Revocable resources are excluded in `quotaRoleSorter`.
     // NOTE: Only scalars are considered for quota.
-    Resources allocated = getQuotaRoleAllocatedResources(name);
-    const Resources required = quota.info.guarantee();
-    unallocatedQuotaResources += (required - allocated);
+    unallocatedQuota +=
+      guarantee - quotaRoleSorter->allocationQuantities(role);
   }
 
+  const Resources unallocatedQuotaResources =
+    unallocatedQuota.toUnreservedResources();
+
   // Determine how many resources we may allocate during the next stage.
   //
   // NOTE: Resources for quota allocations are already accounted in
@@ -1307,15 +1510,69 @@ void HierarchicalAllocatorProcess::allocate(
   //     agent and continue to the next one.
   Resources allocatedStage2;
 
+  // Whether there are no resources available for the second stage.
+  bool exhausted = !allocatable(remainingClusterResources - allocatedStage2);
+
   // At this point resources for quotas are allocated or accounted for.
   // Proceed with allocating the remaining free pool.
   foreach (const SlaveID& slaveId, slaveIds) {
     // If there are no resources available for the second stage, stop.
-    if (!allocatable(remainingClusterResources - allocatedStage2)) {
-      break;
+    //
+    // NOTE: If that's because of unallocated quota, the slaves remain
+    // allocation candidates, since they may be offered once the quota
+    // is allocated (which is not otherwise tracked).
+    if (exhausted) {
+      if (unallocatedQuotaResources.empty()) {
+        break;
+      }
+
+      allocationCandidates.insert(slaveId);
+      continue;
+    }
+
+    const AgentEvaluation* evaluation =
+      evaluated.contains(slaveId) ? evaluated.at(slaveId) : NULL;
+
+    // Calculate the currently available resources on the slave, see
+    // the first stage.
+    Resources available;
+    if (evaluation == NULL) {
+      available = slaves[slaveId].total - slaves[slaveId].allocated;
     }
 
     foreach (const string& role, roleSorter->sort()) {
+      // The resources we offer are the unreserved resources as well as the
+      // reserved resources for this particular role. This is necessary to
+      // ensure that we don't offer resources that are reserved for another
+      // role.
+      //
+      // NOTE: Currently, frameworks are allowed to have '*' role.
+      // Calling reserved('*') returns an empty Resources object.
+      //
+      // NOTE: We do not offer roles with quota any more non-revocable
+      // resources once their quota is satisfied. However, note that this is
+      // not strictly true due to the coarse-grained nature (per agent) of the
+      // allocation algorithm in stage 1.
+      //
+      // NOTE: See `Offerable` which calculates the same for an evaluation.
+      //
+      // TODO(mpark): Offer unreserved resources as revocable beyond quota.
+      auto offerable_ = [this, &available, &role]() {
+        Resources resources = available.reserved(role);
+        if (!quotas.contains(role)) {
+          resources += available.unreserved();
+        }
+        return resources;
+      };
+
+      Resources roleResources = evaluation != NULL
+        ? evaluation->offerable(role, quotas.contains(role)).fairShare
+        : offerable_();
+
+      // The non-revocable resources for frameworks that have not opted
+      // for revocable resources, only calculated when needed.
+      Option<Resources> nonRevocableResources;
+
       foreach (const string& frameworkId_,
                frameworkSorters[role]->sort()) {
         FrameworkID frameworkId;
@@ -1326,41 +1583,29 @@ void HierarchicalAllocatorProcess::allocate(
           continue;
         }
 
-        // Calculate the currently available resources on the slave.
-        Resources available = slaves[slaveId].total - slaves[slaveId].allocated;
-
-        // The resources we offer are the unreserved resources as well as the
-        // reserved resources for this particular role. This is necessary to
-        // ensure that we don't offer resources that are reserved for another
-        // role.
-        //
-        // NOTE: Currently, frameworks are allowed to have '*' role.
-        // Calling reserved('*') returns an empty Resources object.
-        //
-        // NOTE: We do not offer roles with quota any more non-revocable
-        // resources once their quota is satisfied. However, note that this is
-        // not strictly true due to the coarse-grained nature (per agent) of the
-        // allocation algorithm in stage 1.
-        //
-        // TODO(mpark): Offer unreserved resources as revocable beyond quota.
-        Resources resources = available.reserved(role);
-        if (!quotas.contains(role)) {
-          resources += available.unreserved();
-        }
-
         // Remove revocable resources if the framework has not opted
         // for them.
-        if (!frameworks[frameworkId].revocable) {
-          resources = resources.nonRevocable();
+        if (!frameworks[frameworkId].revocable &&
+            nonRevocableResources.isNone()) {
+          nonRevocableResources = evaluation != NULL
+            ? evaluation->offerable(
+                  role, quotas.contains(role)).fairShareNonRevocable
+            : roleResources.nonRevocable();
         }
 
+        const Resources resources = frameworks[frameworkId].revocable
+          ? roleResources
+          : nonRevocableResources.get();
+
         // If the resources are not allocatable, ignore.
         if (!allocatable(resources)) {
           continue;
         }
 
         // If the framework filters these resources, ignore.
-        if (isFiltered(frameworkId, slaveId, resources)) {
+        if (evaluation != NULL
+              ? evaluation->fairShareFiltered.contains(frameworkId)
+              : isFiltered(frameworkId, slaveId, resources)) {
           continue;
         }
 
@@ -1371,6 +1616,7 @@ void HierarchicalAllocatorProcess::allocate(
         const Resources scalarResources = resources.scalars();
         if (!remainingClusterResources.contains(
                 allocatedStage2 + scalarResources)) {
+          allocationCandidates.insert(slaveId);
           continue;
         }
 
@@ -1386,6 +1632,11 @@ void HierarchicalAllocatorProcess::allocate(
         allocatedStage2 += scalarResources;
         slaves[slaveId].allocated += resources;
 
+        agentOrdering->update(
+            slaveId, slaves[slaveId].total, slaves[slaveId].allocated);
+
+        exhausted = !allocatable(remainingClusterResources - allocatedStage2);
+
         frameworkSorters[role]->add(slaveId, resources);
         frameworkSorters[role]->allocated(frameworkId_, slaveId, resources);
         roleSorter->allocated(role, slaveId, resources);
@@ -1395,6 +1646,14 @@ void HierarchicalAllocatorProcess::allocate(
           // non-revocable.
           quotaRoleSorter->allocated(role, slaveId, resources.nonRevocable());
         }
+
+        // The evaluation of the slave is no longer valid.
+        evaluated.erase(slaveId);
+        evaluation = NULL;
+
+        available = slaves[slaveId].total - slaves[slaveId].allocated;
+        roleResources = offerable_();
+        nonRevocableResources = None();
       }
     }
   }
@@ -1415,6 +1674,89 @@ void HierarchicalAllocatorProcess::allocate(
 }
 
 
+void HierarchicalAllocatorProcess::evaluate(
+    const vector<SlaveID>& slaveIds,
+    vector<AgentEvaluation>* evaluations)
+{
+  CHECK(!shards.empty());
+
+  evaluations->clear();
+  evaluations->resize(slaveIds.size());
+
+  // Partition the slaves into contiguous shards. Each shard only
+  // writes to its own range of `evaluations`.
+  const size_t size = (slaveIds.size() + shards.size() - 1) / shards.size();
+
+  list<Future<Nothing>> futures;
+
+  for (size_t i = 0; i < shards.size() && i * size < slaveIds.size(); i++) {
+    const size_t begin = i * size;
+    const size_t end = std::min(begin + size, slaveIds.size());
+
+    futures.push_back(process::dispatch(
+        shards[i]->self(),
+        &AllocationShardProcess::evaluate,
+        [this, begin, end, &slaveIds, evaluations]() {
+          for (size_t j = begin; j < end; j++) {
+            evaluate(slaveIds[j], &(*evaluations)[j]);
+          }
+        }));
+  }
+
+  // NOTE: We block until the shards are done rather than continuing
+  // the allocation asynchronously since the shards read our state
+  // (without copying it), which must not change in the meantime.
+  process::collect(futures).await();
+}
+
+
+void HierarchicalAllocatorProcess::evaluate(
+    const SlaveID& slaveId,
+    AgentEvaluation* evaluation) const
+{
+  const Slave& slave = slaves.at(slaveId);
+
+  const Resources available = slave.total - slave.allocated;
+  const Resources unreserved = available.unreserved();
+
+  evaluation->unreserved = Offerable(unreserved, Resources(), false);
+  evaluation->unreservedQuota = Offerable(unreserved, Resources(), true);
+
+  foreachpair (const string& role,
+               const Resources& reserved,
+               available.reserved()) {
+    evaluation->reserved[role] =
+      Offerable(unreserved, reserved, quotas.contains(role));
+  }
+
+  if (!offerFilters.contains(slaveId)) {
+    return;
+  }
+
+  // NOTE: We use `offerFilters` directly rather than `isFiltered()`,
+  // which is not safe to call concurrently.
+  foreach (const FrameworkID& frameworkId, offerFilters.frameworks(slaveId)) {
+    const Framework& framework = frameworks.at(frameworkId);
+
+    const Offerable& offerable =
+      evaluation->offerable(framework.role, quotas.contains(framework.role));
+
+    if (offerFilters.filtered(frameworkId, slaveId, offerable.quota)) {
+      evaluation->quotaFiltered.insert(frameworkId);
+    }
+
+    if (offerFilters.filtered(
+            frameworkId,
+            slaveId,
+            framework.revocable
+              ? offerable.fairShare
+              : offerable.fairShareNonRevocable)) {
+      evaluation->fairShareFiltered.insert(frameworkId);
+    }
+  }
+}
+
+
 void HierarchicalAllocatorProcess::deallocate(
     const hashset<SlaveID>& slaveIds_)
 {
@@ -1505,26 +1847,44 @@ void HierarchicalAllocatorProcess::deallocate(
 }
 
 
-void HierarchicalAllocatorProcess::expire(
-    const FrameworkID& frameworkId,
-    const SlaveID& slaveId,
-    OfferFilter* offerFilter)
+void HierarchicalAllocatorProcess::expireOfferFilters()
 {
-  // The filter might have already been removed (e.g., if the
-  // framework no longer exists or in
-  // HierarchicalAllocatorProcess::reviveOffers) but not yet deleted (to
-  // keep the address from getting reused possibly causing premature
-  // expiration).
-  if (frameworks.contains(frameworkId) &&
-      frameworks[frameworkId].offerFilters.contains(slaveId) &&
-      frameworks[frameworkId].offerFilters[slaveId].contains(offerFilter)) {
-    frameworks[frameworkId].offerFilters[slaveId].erase(offerFilter);
-    if (frameworks[frameworkId].offerFilters[slaveId].empty()) {
-      frameworks[frameworkId].offerFilters.erase(slaveId);
+  offerFilterTimer = None();
+
+  const size_t active = offerFilters.size();
+
+  foreach (const SlaveID& slaveId, offerFilters.expire(Clock::now())) {
+    if (slaves.contains(slaveId)) {
+      allocationCandidates.insert(slaveId);
+    }
+  }
+
+  metrics.offer_filters_expired += active - offerFilters.size();
+
+  scheduleOfferFilterExpiration();
+}
+
+
+void HierarchicalAllocatorProcess::scheduleOfferFilterExpiration()
+{
+  Option<Time> next = offerFilters.next();
+
+  if (next.isNone()) {
+    return;
+  }
+
+  // Keep the current timer if it expires no later than the next
+  // offer filter, `expireOfferFilters()` reschedules it anyway.
+  if (offerFilterTimer.isSome()) {
+    if (offerFilterTimer.get().timeout().time() <= next.get()) {
+      return;
     }
+
+    Clock::cancel(offerFilterTimer.get());
   }
 
-  delete offerFilter;
+  offerFilterTimer =
+    delay(next.get() - Clock::now(), self(), &Self::expireOfferFilters);
 }
 
 
@@ -1548,6 +1908,10 @@ void HierarchicalAllocatorProcess::expire(
     if(frameworks[frameworkId].inverseOfferFilters[slaveId].empty()) {
       frameworks[frameworkId].inverseOfferFilters.erase(slaveId);
     }
+
+    if (slaves.contains(slaveId)) {
+      allocationCandidates.insert(slaveId);
+    }
   }
 
   delete inverseOfferFilter;
@@ -1582,17 +1946,12 @@ bool HierarchicalAllocatorProcess::isFiltered(
   CHECK(frameworks.contains(frameworkId));
   CHECK(slaves.contains(slaveId));
 
-  if (frameworks[frameworkId].offerFilters.contains(slaveId)) {
-    foreach (
-      OfferFilter* offerFilter, frameworks[frameworkId].offerFilters[slaveId]) {
-      if (offerFilter->filter(resources)) {
-        VLOG(1) << "Filtered offer with " << resources
-                << " on slave " << slaveId
-                << " for framework " << frameworkId;
+  if (offerFilters.filtered(frameworkId, slaveId, resources)) {
+    VLOG(1) << "Filtered offer with " << resources
+            << " on slave " << slaveId
+            << " for framework " << frameworkId;
 
-        return true;
-      }
-    }
+    return true;
   }
 
   return false;
@@ -1624,7 +1983,7 @@ bool HierarchicalAllocatorProcess::isFiltered(
 
 
 bool HierarchicalAllocatorProcess::allocatable(
-    const Resources& resources)
+    const Resources& resources) const
 {
   Option<double> cpus = resources.cpus();
   Option<Bytes> mem = resources.mem();
@@ -1633,6 +1992,19 @@ bool HierarchicalAllocatorProcess::allocatable(
          (mem.isSome() && mem.get() >= MIN_MEM);
 }
 
+
+bool HierarchicalAllocatorProcess::isQuotaSatisfied(const string& role)
+{
+  CHECK(quotaGuarantees.contains(role));
+
+  // Since we account for reservations and persistent volumes toward
+  // quota, only the quantities of the role's allocation matter.
+  //
+  // NOTE: Revocable resources are excluded in `quotaRoleSorter`.
+  return quotaRoleSorter->allocationQuantities(role).contains(
+      quotaGuarantees.at(role));
+}
+
 } // namespace internal {
 } // namespace allocator {
 } // namespace master {
@@ -18,20 +18,31 @@
 #define __MASTER_ALLOCATOR_MESOS_HIERARCHICAL_HPP__
 
 #include <string>
+#include <vector>
 
 #include <mesos/mesos.hpp>
 
 #include <process/future.hpp>
 #include <process/id.hpp>
+#include <process/owned.hpp>
+#include <process/time.hpp>
+#include <process/timer.hpp>
+
+#include <process/metrics/counter.hpp>
 #include <process/metrics/gauge.hpp>
 #include <process/metrics/metrics.hpp>
+#include <process/metrics/timer.hpp>
 
 #include <stout/duration.hpp>
 #include <stout/hashmap.hpp>
 #include <stout/hashset.hpp>
 #include <stout/option.hpp>
 
+#include "common/resource_quantities.hpp"
+
+#include "master/allocator/mesos/agent_ordering.hpp"
 #include "master/allocator/mesos/allocator.hpp"
+#include "master/allocator/mesos/offer_filters.hpp"
 #include "master/allocator/sorter/drf/sorter.hpp"
 
 #include "master/constants.hpp"
@@ -56,8 +67,9 @@ HierarchicalDRFAllocator;
 namespace internal {
 
 // Forward declarations.
-class OfferFilter;
 class InverseOfferFilter;
+class AllocationShardProcess;
+struct AgentEvaluation;
 
 
 // Implements the basic allocator algorithm - first pick a role by
@@ -71,6 +83,9 @@ public:
     : ProcessBase(process::ID::generate("hierarchical-allocator")),
       initialized(false),
       paused(true),
+      allocationShards(1),
+      allocationScheduled(false),
+      allocateAllSlaves(false),
       metrics(*this),
       roleSorter(NULL),
       quotaRoleSorter(NULL),
@@ -93,7 +108,10 @@ public:
           void(const FrameworkID&,
                const hashmap<SlaveID, UnavailableResources>&)>&
         inverseOfferCallback,
-      const hashmap<std::string, double>& weights);
+      const hashmap<std::string, double>& weights,
+      size_t allocationShards,
+      const Duration& minAllocationInterval,
+      const std::string& agentOrdering);
 
   void recover(
       const int _expectedAgentCount,
@@ -192,30 +210,57 @@ protected:
   typedef HierarchicalAllocatorProcess Self;
   typedef HierarchicalAllocatorProcess This;
 
+  virtual void finalize();
+
   // Idempotent helpers for pausing and resuming allocation.
   void pause();
   void resume();
 
-  // Callback for doing batch allocations.
+  // Callback for doing batch allocations. Performs an allocation if
+  // there are any allocation candidates, otherwise skips it.
   void batch();
 
-  // Allocate any allocatable resources.
+  // Schedule an allocation of all slaves, see `schedule()`.
   void allocate();
 
-  // Allocate resources just from the specified slave.
+  // Schedule an allocation of the specified slave, see `schedule()`.
   void allocate(const SlaveID& slaveId);
 
+  // Schedules an allocation of the allocation candidates as soon as
+  // possible, but no sooner than `minAllocationInterval` after the
+  // previous allocation. Everything that happens until the allocation
+  // is performed is coalesced into it.
+  void schedule();
+
+  // Allocate any allocatable resources on the allocation candidates.
+  void _allocate();
+
   // Allocate resources from the specified slaves.
   void allocate(const hashset<SlaveID>& slaveIds);
 
+  // Evaluates the specified slaves for allocation, partitioned into
+  // `allocationShards` shards that are evaluated in parallel. The
+  // evaluation of `slaveIds[i]` is stored in `evaluations[i]`.
+  void evaluate(
+      const std::vector<SlaveID>& slaveIds,
+      std::vector<AgentEvaluation>* evaluations);
+
+  // Evaluates a single slave for allocation. This only reads the
+  // allocator's state, so that the shards can do it concurrently
+  // while `allocate()` waits for them.
+  void evaluate(
+      const SlaveID& slaveId,
+      AgentEvaluation* evaluation) const;
+
   // Send inverse offers from the specified slaves.
   void deallocate(const hashset<SlaveID>& slaveIds);
 
-  // Remove an offer filter for the specified framework.
-  void expire(
-      const FrameworkID& frameworkId,
-      const SlaveID& slaveId,
-      OfferFilter* offerFilter);
+  // Remove the offer filters that have expired.
+  void expireOfferFilters();
+
+  // Ensures that `expireOfferFilters()` is invoked when the next offer
+  // filter expires.
+  void scheduleOfferFilterExpiration();
 
   // Remove an inverse offer filter for the specified framework.
   void expire(
@@ -242,7 +287,11 @@ protected:
       const FrameworkID& frameworkID,
       const SlaveID& slaveID);
 
-  bool allocatable(const Resources& resources);
+  bool allocatable(const Resources& resources) const;
+
+  // Returns true if the resources allocated to the role (which must
+  // have quota set) satisfy its quota guarantee.
+  bool isQuotaSatisfied(const std::string& role);
 
   bool initialized;
   bool paused;
@@ -252,6 +301,37 @@ protected:
 
   Duration allocationInterval;
 
+  // Number of shards the slaves are partitioned into during an
+  // allocation, see `evaluate()`.
+  size_t allocationShards;
+
+  // The processes that evaluate the shards, only spawned if there
+  // is more than one shard.
+  std::vector<AllocationShardProcess*> shards;
+
+  // Minimum amount of time between event-triggered allocations.
+  Duration minAllocationInterval;
+
+  // Determines the order in which the slaves' resources are allocated,
+  // see `AgentOrdering`. It must be updated whenever the total or
+  // allocated resources of a slave change.
+  process::Owned<AgentOrdering> agentOrdering;
+
+  // When the last allocation was performed.
+  Option<process::Time> lastAllocation;
+
+  // Whether an event-triggered allocation has been scheduled.
+  bool allocationScheduled;
+
+  // The slaves to consider in the next allocation (the allocation
+  // candidates). A slave becomes a candidate when something changes
+  // that may allow (more of) its resources to be offered, e.g., when
+  // resources are recovered or an offer filter expires. When something
+  // changes that affects all slaves (e.g., a framework is added), all
+  // slaves become candidates.
+  hashset<SlaveID> allocationCandidates;
+  bool allocateAllSlaves;
+
   lambda::function<
       void(const FrameworkID&,
            const hashmap<SlaveID, Resources>&)> offerCallback;
@@ -265,17 +345,53 @@ protected:
     explicit Metrics(const Self& process)
       : event_queue_dispatches(
             "allocator/event_queue_dispatches",
-            process::defer(process.self(), &Self::_event_queue_dispatches))
+            process::defer(process.self(), &Self::_event_queue_dispatches)),
+        allocation_runs("allocator/allocation_runs"),
+        allocation_runs_skipped("allocator/allocation_runs_skipped"),
+        allocation_run("allocator/allocation_run", Hours(1)),
+        offer_filters_active(
+            "allocator/offer_filters/active",
+            process::defer(process.self(), &Self::_offer_filters_active)),
+        offer_filters_slaves(
+            "allocator/offer_filters/slaves",
+            process::defer(process.self(), &Self::_offer_filters_slaves)),
+        offer_filters_expired("allocator/offer_filters/expired")
     {
       process::metrics::add(event_queue_dispatches);
+      process::metrics::add(allocation_runs);
+      process::metrics::add(allocation_runs_skipped);
+      process::metrics::add(allocation_run);
+      process::metrics::add(offer_filters_active);
+      process::metrics::add(offer_filters_slaves);
+      process::metrics::add(offer_filters_expired);
     }
 
     ~Metrics()
     {
       process::metrics::remove(event_queue_dispatches);
+      process::metrics::remove(allocation_runs);
+      process::metrics::remove(allocation_runs_skipped);
+      process::metrics::remove(allocation_run);
+      process::metrics::remove(offer_filters_active);
+      process::metrics::remove(offer_filters_slaves);
+      process::metrics::remove(offer_filters_expired);
     }
 
     process::metrics::Gauge event_queue_dispatches;
+
+    // Number of allocations performed, and number of batch
+    // allocations skipped because there were no candidates.
+    process::metrics::Counter allocation_runs;
+    process::metrics::Counter allocation_runs_skipped;
+
+    // Time it took to perform an allocation.
+    process::metrics::Timer<Milliseconds> allocation_run;
+
+    // Number of active offer filters, number of slaves with active
+    // offer filters, and number of offer filters that have expired.
+    process::metrics::Gauge offer_filters_active;
+    process::metrics::Gauge offer_filters_slaves;
+    process::metrics::Counter offer_filters_expired;
   } metrics;
 
   struct Framework
@@ -288,8 +404,8 @@ protected:
     // Whether the framework desires revocable resources.
     bool revocable;
 
-    // Active offer and inverse offer filters for the framework.
-    hashmap<SlaveID, hashset<OfferFilter*>> offerFilters;
+    // Active inverse offer filters for the framework, the offer
+    // filters are kept in `offerFilters`.
     hashmap<SlaveID, hashset<InverseOfferFilter*>> inverseOfferFilters;
   };
 
@@ -298,8 +414,24 @@ protected:
     return static_cast<double>(eventCount<process::DispatchEvent>());
   }
 
+  double _offer_filters_active()
+  {
+    return static_cast<double>(offerFilters.size());
+  }
+
+  double _offer_filters_slaves()
+  {
+    return static_cast<double>(offerFilters.slaves());
+  }
+
   hashmap<FrameworkID, Framework> frameworks;
 
+  // Active offer filters of all frameworks.
+  OfferFilters offerFilters;
+
+  // The timer for the next expiration of an offer filter, if any.
+  Option<process::Timer> offerFilterTimer;
+
   struct Slave
   {
     // Total amount of regular *and* oversubscribed resources.
@@ -382,6 +514,12 @@ protected:
   // change in the future.
   hashmap<std::string, Quota> quotas;
 
+  // The quantities of the quota guarantee of each role in `quotas`.
+  // Comparing these against `quotaRoleSorter->allocationQuantities()`
+  // tells whether a role's quota is satisfied without having to strip
+  // and compare the role's allocated resources.
+  hashmap<std::string, ResourceQuantities> quotaGuarantees;
+
   // Slaves to send offers for.
   Option<hashset<std::string>> whitelist;
 
@@ -0,0 +1,190 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <glog/logging.h>
+
+#include <stout/foreach.hpp>
+
+#include "master/allocator/mesos/offer_filters.hpp"
+
+using process::Time;
+
+using std::vector;
+
+namespace mesos {
+namespace internal {
+namespace master {
+namespace allocator {
+
+void OfferFilters::add(
+    const FrameworkID& frameworkId,
+    const SlaveID& slaveId,
+    const Resources& resources,
+    const Time& expiration)
+{
+  const uint64_t id = nextId++;
+
+  filters[slaveId][frameworkId].push_back(Filter(id, resources));
+  frameworkSlaves[frameworkId].insert(slaveId);
+  expirations.push(Expiration(expiration, id, frameworkId, slaveId));
+
+  count++;
+}
+
+
+void OfferFilters::remove(const FrameworkID& frameworkId)
+{
+  if (!frameworkSlaves.contains(frameworkId)) {
+    return;
+  }
+
+  foreach (const SlaveID& slaveId, frameworkSlaves[frameworkId]) {
+    CHECK(filters.contains(slaveId));
+    CHECK(filters[slaveId].contains(frameworkId));
+
+    count -= filters[slaveId][frameworkId].size();
+
+    filters[slaveId].erase(frameworkId);
+    if (filters[slaveId].empty()) {
+      filters.erase(slaveId);
+    }
+  }
+
+  frameworkSlaves.erase(frameworkId);
+}
+
+
+bool OfferFilters::remove(
+    const FrameworkID& frameworkId,
+    const SlaveID& slaveId,
+    uint64_t id)
+{
+  if (!filters.contains(slaveId) || !filters[slaveId].contains(frameworkId)) {
+    return false;
+  }
+
+  vector<Filter>& filters_ = filters[slaveId][frameworkId];
+
+  // NOTE: The filters are in the order they were added in, and there
+  // are usually very few of them for the same framework and slave.
+  for (auto it = filters_.begin(); it != filters_.end(); ++it) {
+    if (it->id == id) {
+      filters_.erase(it);
+      count--;
+
+      if (filters_.empty()) {
+        filters[slaveId].erase(frameworkId);
+        if (filters[slaveId].empty()) {
+          filters.erase(slaveId);
+        }
+
+        frameworkSlaves[frameworkId].erase(slaveId);
+        if (frameworkSlaves[frameworkId].empty()) {
+          frameworkSlaves.erase(frameworkId);
+        }
+      }
+
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+hashset<SlaveID> OfferFilters::expire(const Time& now)
+{
+  hashset<SlaveID> slaveIds;
+
+  while (!expirations.empty() && expirations.top().time <= now) {
+    const Expiration& expiration = expirations.top();
+
+    // The filter might have already been removed, e.g., if the
+    // framework revived offers.
+    if (remove(expiration.frameworkId, expiration.slaveId, expiration.id)) {
+      slaveIds.insert(expiration.slaveId);
+    }
+
+    expirations.pop();
+  }
+
+  return slaveIds;
+}
+
+
+bool OfferFilters::filtered(
+    const FrameworkID& frameworkId,
+    const SlaveID& slaveId,
+    const Resources& resources) const
+{
+  if (!filters.contains(slaveId)) {
+    return false;
+  }
+
+  const hashmap<FrameworkID, vector<Filter>>& filters_ = filters.at(slaveId);
+
+  if (!filters_.contains(frameworkId)) {
+    return false;
+  }
+
+  foreach (const Filter& filter, filters_.at(frameworkId)) {
+    // TODO(jieyu): Consider separating the superset check for regular
+    // and revocable resources. For example, frameworks might want
+    // more revocable resources only or non-revocable resources only,
+    // but currently the filter only expires if there is more of both
+    // revocable and non-revocable resources.
+    if (filter.resources.contains(resources)) {
+      return true; // Refused resources are superset.
+    }
+  }
+
+  return false;
+}
+
+
+bool OfferFilters::contains(const SlaveID& slaveId) const
+{
+  return filters.contains(slaveId);
+}
+
+
+vector<FrameworkID> OfferFilters::frameworks(const SlaveID& slaveId) const
+{
+  vector<FrameworkID> frameworkIds;
+
+  if (filters.contains(slaveId)) {
+    foreachkey (const FrameworkID& frameworkId, filters.at(slaveId)) {
+      frameworkIds.push_back(frameworkId);
+    }
+  }
+
+  return frameworkIds;
+}
+
+
+Option<Time> OfferFilters::next() const
+{
+  if (expirations.empty()) {
+    return None();
+  }
+
+  return expirations.top().time;
+}
+
+} // namespace allocator {
+} // namespace master {
+} // namespace internal {
+} // namespace mesos {
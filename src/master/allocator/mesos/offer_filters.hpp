@@ -0,0 +1,161 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __MASTER_ALLOCATOR_MESOS_OFFER_FILTERS_HPP__
+#define __MASTER_ALLOCATOR_MESOS_OFFER_FILTERS_HPP__
+
+#include <stdint.h>
+
+#include <queue>
+#include <vector>
+
+#include <mesos/mesos.hpp>
+#include <mesos/resources.hpp>
+#include <mesos/type_utils.hpp>
+
+#include <process/time.hpp>
+
+#include <stout/hashmap.hpp>
+#include <stout/hashset.hpp>
+#include <stout/option.hpp>
+
+namespace mesos {
+namespace internal {
+namespace master {
+namespace allocator {
+
+// The offer filters of all frameworks, i.e., the resources that a
+// framework refused on a slave and does not want to be offered again
+// until the filter expires.
+//
+// The filters are indexed by slave and then by framework, since the
+// allocator considers one slave at a time: most slaves have no filters
+// at all, which takes a single lookup to determine, and those that do
+// usually only have filters for a few frameworks.
+//
+// Rather than each filter having its own timer, the expiration times
+// of all filters are kept in a single heap so that the filters that
+// expired can be removed in bulk, see `expire()`.
+class OfferFilters
+{
+public:
+  OfferFilters() : nextId(0), count(0) {}
+
+  // Filters the refused resources on the slave for the framework
+  // until the expiration time.
+  void add(
+      const FrameworkID& frameworkId,
+      const SlaveID& slaveId,
+      const Resources& resources,
+      const process::Time& expiration);
+
+  // Removes all filters of the framework, e.g., when the framework
+  // revives offers.
+  void remove(const FrameworkID& frameworkId);
+
+  // Removes the filters that expired at or before `now`, and returns
+  // the slaves on which they were.
+  hashset<SlaveID> expire(const process::Time& now);
+
+  // Returns true if a filter of the framework on the slave filters
+  // the resources, i.e., the resources are a subset of the refused
+  // resources of one of the filters.
+  //
+  // NOTE: This is safe to call concurrently with other const methods.
+  bool filtered(
+      const FrameworkID& frameworkId,
+      const SlaveID& slaveId,
+      const Resources& resources) const;
+
+  // Returns true if there are any filters on the slave.
+  bool contains(const SlaveID& slaveId) const;
+
+  // Returns the frameworks that have filters on the slave.
+  std::vector<FrameworkID> frameworks(const SlaveID& slaveId) const;
+
+  // Returns when the next filter expires, if any.
+  //
+  // NOTE: This might be earlier than the expiration time of any of
+  // the current filters, since removing filters does not remove their
+  // expiration times (they are skipped by `expire()` instead).
+  Option<process::Time> next() const;
+
+  // Returns the number of filters.
+  size_t size() const { return count; }
+
+  // Returns the number of slaves that have filters.
+  size_t slaves() const { return filters.size(); }
+
+private:
+  struct Filter
+  {
+    Filter(uint64_t _id, const Resources& _resources)
+      : id(_id), resources(_resources) {}
+
+    uint64_t id;
+    Resources resources;
+  };
+
+  struct Expiration
+  {
+    Expiration(
+        const process::Time& _time,
+        uint64_t _id,
+        const FrameworkID& _frameworkId,
+        const SlaveID& _slaveId)
+      : time(_time), id(_id), frameworkId(_frameworkId), slaveId(_slaveId) {}
+
+    // Orders the heap by the earliest expiration time (and the oldest
+    // filter for the same time).
+    bool operator<(const Expiration& that) const
+    {
+      if (time != that.time) {
+        return time > that.time;
+      }
+      return id > that.id;
+    }
+
+    process::Time time;
+    uint64_t id;
+    FrameworkID frameworkId;
+    SlaveID slaveId;
+  };
+
+  // Removes the filter from the index, returns false if it has
+  // already been removed.
+  bool remove(
+      const FrameworkID& frameworkId,
+      const SlaveID& slaveId,
+      uint64_t id);
+
+  uint64_t nextId;
+  size_t count;
+
+  hashmap<SlaveID, hashmap<FrameworkID, std::vector<Filter>>> filters;
+
+  // The slaves that each framework has filters on, so that the
+  // filters of a framework can be removed without a search.
+  hashmap<FrameworkID, hashset<SlaveID>> frameworkSlaves;
+
+  std::priority_queue<Expiration> expirations;
+};
+
+} // namespace allocator {
+} // namespace master {
+} // namespace internal {
+} // namespace mesos {
+
+#endif // __MASTER_ALLOCATOR_MESOS_OFFER_FILTERS_HPP__
@@ -21,6 +21,7 @@
 using std::list;
 using std::set;
 using std::string;
+using std::vector;
 
 namespace mesos {
 namespace internal {
@@ -42,7 +43,7 @@ bool DRFComparator::operator()(const Client& client1, const Client& client2)
 void DRFSorter::add(const string& name, double weight)
 {
   Client client(name, 0, 0);
-  clients.insert(client);
+  positions[name] = clients.insert(client).first;
 
   allocations[name] = Allocation();
   weights[name] = weight;
@@ -55,6 +56,7 @@ void DRFSorter::remove(const string& name)
 
   if (it != clients.end()) {
     clients.erase(it);
+    positions.erase(name);
   }
 
   allocations.erase(name);
@@ -66,8 +68,12 @@ void DRFSorter::activate(const string& name)
 {
   CHECK(allocations.contains(name));
 
+  if (positions.contains(name)) {
+    return; // Already active.
+  }
+
   Client client(name, calculateShare(name), 0);
-  clients.insert(client);
+  positions[name] = clients.insert(client).first;
 }
 
 
@@ -81,6 +87,7 @@ void DRFSorter::deactivate(const string& name)
     // for this client which means the fairness can be gamed by a
     // framework disconnecting and reconnecting.
     clients.erase(it);
+    positions.erase(name);
   }
 }
 
@@ -90,28 +97,23 @@ void DRFSorter::allocated(
     const SlaveID& slaveId,
     const Resources& resources)
 {
+  allocations[name].resources[slaveId] += resources;
+  allocations[name].scalars += resources.scalars();
+
+  updateAllocation(name);
+
   set<Client, DRFComparator>::iterator it = find(name);
 
   if (it != clients.end()) { // TODO(benh): This should really be a CHECK.
-    // TODO(benh): Refactor 'update' to be able to reuse it here.
     Client client(*it);
 
     // Update the 'allocations' to reflect the allocator decision.
     client.allocations++;
 
-    // Remove and reinsert it to update the ordering appropriately.
-    clients.erase(it);
-    clients.insert(client);
-  }
-
-  allocations[name].resources[slaveId] += resources;
-  allocations[name].scalars += resources.scalars();
+    // Update the 'share' to get proper sorting.
+    client.share = calculateShare(name);
 
-  // If the total resources have changed, we're going to
-  // recalculate all the shares, so don't bother just
-  // updating this client.
-  if (!dirty) {
-    update(name);
+    reinsert(it, client);
   }
 }
 
@@ -147,8 +149,13 @@ void DRFSorter::update(
   allocations[name].scalars -= oldAllocation.scalars();
   allocations[name].scalars += newAllocation.scalars();
 
-  // Just assume the total has changed, per the TODO above.
-  dirty = true;
+  // Only the quantities can affect the shares, so unless they changed
+  // (e.g., when reserving resources or creating volumes) the shares
+  // don't need to be recalculated.
+  updateTotal();
+  updateAllocation(name);
+
+  update(name);
 }
 
 
@@ -168,6 +175,14 @@ const Resources& DRFSorter::allocationScalars(const string& name)
 }
 
 
+const ResourceQuantities& DRFSorter::allocationQuantities(const string& name)
+{
+  CHECK(contains(name));
+
+  return allocations[name].quantities;
+}
+
+
 hashmap<string, Resources> DRFSorter::allocation(const SlaveID& slaveId)
 {
   // TODO(jmlvanre): We can index the allocation by slaveId to make this faster.
@@ -224,9 +239,9 @@ void DRFSorter::unallocated(
     allocations[name].resources.erase(slaveId);
   }
 
-  if (!dirty) {
-    update(name);
-  }
+  updateAllocation(name);
+
+  update(name);
 }
 
 
@@ -236,11 +251,11 @@ void DRFSorter::add(const SlaveID& slaveId, const Resources& resources)
     total_.resources[slaveId] += resources;
     total_.scalars += resources.scalars();
 
-    // We have to recalculate all shares when the total resources
-    // change, but we put it off until sort is called so that if
-    // something else changes before the next allocation we don't
-    // recalculate everything twice.
-    dirty = true;
+    // We have to recalculate the shares affected by the change of the
+    // total resources, but we put it off until sort is called so that
+    // if something else changes before the next allocation we don't
+    // recalculate the shares twice.
+    updateTotal();
   }
 }
 
@@ -257,7 +272,7 @@ void DRFSorter::remove(const SlaveID& slaveId, const Resources& resources)
       total_.resources.erase(slaveId);
     }
 
-    dirty = true;
+    updateTotal();
   }
 }
 
@@ -275,26 +290,34 @@ void DRFSorter::update(const SlaveID& slaveId, const Resources& resources)
     total_.resources.erase(slaveId);
   }
 
-  dirty = true;
+  updateTotal();
 }
 
 
 list<string> DRFSorter::sort()
 {
-  if (dirty) {
-    set<Client, DRFComparator> temp;
-
-    set<Client, DRFComparator>::iterator it;
-    for (it = clients.begin(); it != clients.end(); it++) {
-      Client client(*it);
-
-      // Update the 'share' to get proper sorting.
-      client.share = calculateShare(client.name);
+  if (!changed.empty()) {
+    // Only the shares of the clients that are allocated a resource
+    // whose total changed can have changed.
+    vector<string> affected;
+
+    foreach (const Client& client, clients) {
+      const ResourceQuantities& quantities =
+        allocations[client.name].quantities;
+
+      foreach (const string& resource, changed) {
+        if (quantities.get(resource) > 0.0) {
+          affected.push_back(client.name);
+          break;
+        }
+      }
+    }
 
-      temp.insert(client);
+    foreach (const string& name, affected) {
+      update(name);
     }
 
-    clients = temp;
+    changed.clear();
   }
 
   list<string> result;
@@ -325,14 +348,16 @@ void DRFSorter::update(const string& name)
   set<Client, DRFComparator>::iterator it = find(name);
 
   if (it != clients.end()) {
-    Client client(*it);
+    const double share = calculateShare(name);
 
-    // Update the 'share' to get proper sorting.
-    client.share = calculateShare(client.name);
+    if (share != it->share) {
+      Client client(*it);
 
-    // Remove and reinsert it to update the ordering appropriately.
-    clients.erase(it);
-    clients.insert(client);
+      // Update the 'share' to get proper sorting.
+      client.share = share;
+
+      reinsert(it, client);
+    }
   }
 }
 
@@ -345,33 +370,12 @@ double DRFSorter::calculateShare(const string& name)
   // currently does not take into account resources that are not
   // scalars.
 
-  foreach (const string& scalar, total_.scalars.names()) {
-    // We collect the scalar accumulated total value from the
-    // `Resources` object.
-    //
-    // NOTE: Scalar resources may be spread across multiple
-    // 'Resource' objects. E.g. persistent volumes.
-    Option<Value::Scalar> __total = total_.scalars.get<Value::Scalar>(scalar);
-    CHECK_SOME(__total);
-    const double _total = __total.get().value();
-
-    if (_total > 0.0) {
-      double allocation = 0.0;
-
-      // We collect the scalar accumulated allocation value from the
-      // `Resources` object.
-      //
-      // NOTE: Scalar resources may be spread across multiple
-      // 'Resource' objects. E.g. persistent volumes.
-      Option<Value::Scalar> _allocation =
-        allocations[name].scalars.get<Value::Scalar>(scalar);
-
-      if (_allocation.isSome()) {
-        allocation = _allocation.get().value();
-      }
+  const ResourceQuantities& quantities = allocations[name].quantities;
 
-      share = std::max(share, allocation / _total);
-    }
+  foreach (const auto& total, total_.quantities) {
+    // NOTE: Only positive quantities are kept, so 'total.second' is
+    // always greater than zero.
+    share = std::max(share, quantities.get(total.first) / total.second);
   }
 
   return share / weights[name];
@@ -380,14 +384,49 @@ double DRFSorter::calculateShare(const string& name)
 
 set<Client, DRFComparator>::iterator DRFSorter::find(const string& name)
 {
-  set<Client, DRFComparator>::iterator it;
-  for (it = clients.begin(); it != clients.end(); it++) {
-    if (name == (*it).name) {
-      break;
+  Option<set<Client, DRFComparator>::iterator> it = positions.get(name);
+
+  return it.isSome() ? it.get() : clients.end();
+}
+
+
+void DRFSorter::reinsert(
+    set<Client, DRFComparator>::iterator it,
+    const Client& client)
+{
+  // Remove and reinsert it to update the ordering appropriately.
+  clients.erase(it);
+  positions[client.name] = clients.insert(client).first;
+}
+
+
+void DRFSorter::updateTotal()
+{
+  // NOTE: Scalar resources may be spread across multiple 'Resource'
+  // objects. E.g. persistent volumes.
+  const ResourceQuantities quantities =
+    ResourceQuantities::fromScalarResources(total_.scalars);
+
+  foreach (const auto& quantity, quantities) {
+    if (total_.quantities.get(quantity.first) != quantity.second) {
+      changed.insert(quantity.first);
     }
   }
 
-  return it;
+  foreach (const auto& quantity, total_.quantities) {
+    if (quantities.get(quantity.first) == 0.0) {
+      changed.insert(quantity.first);
+    }
+  }
+
+  total_.quantities = quantities;
+}
+
+
+void DRFSorter::updateAllocation(const string& name)
+{
+  allocations[name].quantities =
+    ResourceQuantities::fromScalarResources(allocations[name].scalars);
 }
 
 } // namespace allocator {
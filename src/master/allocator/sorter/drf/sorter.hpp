@@ -23,6 +23,9 @@
 #include <mesos/resources.hpp>
 
 #include <stout/hashmap.hpp>
+#include <stout/hashset.hpp>
+
+#include "common/resource_quantities.hpp"
 
 #include "master/allocator/sorter/sorter.hpp"
 
@@ -92,6 +95,9 @@ public:
 
   virtual const Resources& allocationScalars(const std::string& name);
 
+  virtual const ResourceQuantities& allocationQuantities(
+      const std::string& name);
+
   virtual hashmap<std::string, Resources> allocation(const SlaveID& slaveId);
 
   virtual Resources allocation(const std::string& name, const SlaveID& slaveId);
@@ -124,12 +130,32 @@ private:
   // it exists in this Sorter.
   std::set<Client, DRFComparator>::iterator find(const std::string& name);
 
-  // If true, sort() will recalculate all shares.
-  bool dirty;
+  // Moves the client to its position in 'clients' after its share
+  // or number of allocations changed.
+  void reinsert(
+      std::set<Client, DRFComparator>::iterator it,
+      const Client& client);
+
+  // Updates the cached quantities of the total, remembering the
+  // names of the resources whose quantity changed.
+  void updateTotal();
+
+  // Updates the cached quantities of the allocation of the client.
+  void updateAllocation(const std::string& name);
+
+  // Names of the scalar resources whose total changed since the last
+  // sort(), which will recalculate the shares of the clients that
+  // are allocated any of them (the shares of other clients can't
+  // have changed).
+  hashset<std::string> changed;
 
   // A set of Clients (names and shares) sorted by share.
   std::set<Client, DRFComparator> clients;
 
+  // The position of each client in 'clients', so that we don't have
+  // to search for a client.
+  hashmap<std::string, std::set<Client, DRFComparator>::iterator> positions;
+
   // Maps client names to the weights that should be applied to their shares.
   hashmap<std::string, double> weights;
 
@@ -141,6 +167,10 @@ private:
     // that to speed up the calculation of shares. See MESOS-2891 for
     // the reasons why we want to do that.
     Resources scalars;
+
+    // The quantities of 'scalars', which is all that's needed to
+    // calculate shares.
+    ResourceQuantities quantities;
   } total_;
 
   // Allocation for a client.
@@ -149,6 +179,9 @@ private:
 
     // Similarly, we aggregated scalars across slaves. See note above.
     Resources scalars;
+
+    // Similarly, the quantities of 'scalars'.
+    ResourceQuantities quantities;
   };
 
   // Maps client names to the resources they have been allocated.
@@ -23,6 +23,8 @@
 #include <mesos/resources.hpp>
 #include <mesos/type_utils.hpp>
 
+#include "common/resource_quantities.hpp"
+
 namespace mesos {
 namespace internal {
 namespace master {
@@ -82,6 +84,14 @@ public:
   // Returns the sum of the scalar resources that are allocated to this client.
   virtual const Resources& allocationScalars(const std::string& client) = 0;
 
+  // Returns the quantities of the scalar resources that are allocated
+  // to this client, i.e., `allocationScalars` without any roles,
+  // reservations or disk information. This is kept up to date as
+  // resources are allocated and unallocated, so it is cheap to call
+  // (e.g., to check a role's allocation against its quota).
+  virtual const ResourceQuantities& allocationQuantities(
+      const std::string& client) = 0;
+
   // Returns the clients that have allocations on this slave.
   virtual hashmap<std::string, Resources> allocation(
       const SlaveID& slaveId) = 0;
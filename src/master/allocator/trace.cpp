@@ -0,0 +1,460 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <glog/logging.h>
+
+#include <process/clock.hpp>
+
+#include <stout/foreach.hpp>
+#include <stout/os.hpp>
+#include <stout/protobuf.hpp>
+#include <stout/synchronized.hpp>
+
+#include "master/allocator/trace.hpp"
+
+using mesos::master::InverseOfferStatus;
+
+using process::Clock;
+using process::Future;
+
+using std::string;
+using std::vector;
+
+namespace mesos {
+namespace internal {
+namespace master {
+namespace allocator {
+
+using mesos::master::allocator::Allocator;
+
+Try<Allocator*> TracingAllocator::create(
+    Allocator* allocator,
+    const string& path)
+{
+  CHECK_NOTNULL(allocator);
+
+  Try<int> fd = os::open(
+      path,
+      O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+      S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+
+  if (fd.isError()) {
+    return Error(
+        "Failed to open allocator trace '" + path + "': " + fd.error());
+  }
+
+  return new TracingAllocator(allocator, path, fd.get());
+}
+
+
+TracingAllocator::TracingAllocator(
+    Allocator* _allocator,
+    const string& _path,
+    int _fd)
+  : allocator(_allocator),
+    path(_path),
+    fd(_fd),
+    start(Clock::now()) {}
+
+
+TracingAllocator::~TracingAllocator()
+{
+  if (fd.isSome()) {
+    os::close(fd.get());
+  }
+
+  delete allocator;
+}
+
+
+void TracingAllocator::record(AllocatorTraceEvent* event)
+{
+  synchronized (mutex) {
+    if (fd.isNone()) {
+      return;
+    }
+
+    event->set_nanoseconds((Clock::now() - start).ns());
+
+    Try<Nothing> write = ::protobuf::write(fd.get(), *event);
+    if (write.isError()) {
+      LOG(ERROR) << "Stopped recording the allocator trace '" << path
+                 << "': " << write.error();
+
+      os::close(fd.get());
+      fd = None();
+    }
+  }
+}
+
+
+void TracingAllocator::initialize(
+    const Duration& allocationInterval,
+    const lambda::function<
+        void(const FrameworkID&,
+             const hashmap<SlaveID, Resources>&)>& offerCallback,
+    const lambda::function<
+        void(const FrameworkID&,
+             const hashmap<SlaveID, UnavailableResources>&)>&
+      inverseOfferCallback,
+    const hashmap<string, double>& weights,
+    size_t allocationShards,
+    const Duration& minAllocationInterval,
+    const string& agentOrdering)
+{
+  allocator->initialize(
+      allocationInterval,
+      offerCallback,
+      inverseOfferCallback,
+      weights,
+      allocationShards,
+      minAllocationInterval,
+      agentOrdering);
+}
+
+
+void TracingAllocator::recover(
+    const int expectedAgentCount,
+    const hashmap<string, Quota>& quotas)
+{
+  allocator->recover(expectedAgentCount, quotas);
+}
+
+
+void TracingAllocator::addFramework(
+    const FrameworkID& frameworkId,
+    const FrameworkInfo& frameworkInfo,
+    const hashmap<SlaveID, Resources>& used)
+{
+  AllocatorTraceEvent event;
+  event.set_type(AllocatorTraceEvent::ADD_FRAMEWORK);
+  event.mutable_framework_id()->CopyFrom(frameworkId);
+  event.mutable_framework_info()->CopyFrom(frameworkInfo);
+
+  foreachpair (const SlaveID& slaveId, const Resources& resources, used) {
+    AllocatorTraceEvent::Used* used_ = event.add_used();
+    used_->mutable_slave_id()->CopyFrom(slaveId);
+    used_->mutable_resources()->CopyFrom(resources);
+  }
+
+  record(&event);
+
+  allocator->addFramework(frameworkId, frameworkInfo, used);
+}
+
+
+void TracingAllocator::removeFramework(
+    const FrameworkID& frameworkId)
+{
+  AllocatorTraceEvent event;
+  event.set_type(AllocatorTraceEvent::REMOVE_FRAMEWORK);
+  event.mutable_framework_id()->CopyFrom(frameworkId);
+
+  record(&event);
+
+  allocator->removeFramework(frameworkId);
+}
+
+
+void TracingAllocator::activateFramework(
+    const FrameworkID& frameworkId)
+{
+  AllocatorTraceEvent event;
+  event.set_type(AllocatorTraceEvent::ACTIVATE_FRAMEWORK);
+  event.mutable_framework_id()->CopyFrom(frameworkId);
+
+  record(&event);
+
+  allocator->activateFramework(frameworkId);
+}
+
+
+void TracingAllocator::deactivateFramework(
+    const FrameworkID& frameworkId)
+{
+  AllocatorTraceEvent event;
+  event.set_type(AllocatorTraceEvent::DEACTIVATE_FRAMEWORK);
+  event.mutable_framework_id()->CopyFrom(frameworkId);
+
+  record(&event);
+
+  allocator->deactivateFramework(frameworkId);
+}
+
+
+void TracingAllocator::updateFramework(
+    const FrameworkID& frameworkId,
+    const FrameworkInfo& frameworkInfo)
+{
+  AllocatorTraceEvent event;
+  event.set_type(AllocatorTraceEvent::UPDATE_FRAMEWORK);
+  event.mutable_framework_id()->CopyFrom(frameworkId);
+  event.mutable_framework_info()->CopyFrom(frameworkInfo);
+
+  record(&event);
+
+  allocator->updateFramework(frameworkId, frameworkInfo);
+}
+
+
+void TracingAllocator::addSlave(
+    const SlaveID& slaveId,
+    const SlaveInfo& slaveInfo,
+    const Option<Unavailability>& unavailability,
+    const Resources& total,
+    const hashmap<FrameworkID, Resources>& used)
+{
+  AllocatorTraceEvent event;
+  event.set_type(AllocatorTraceEvent::ADD_SLAVE);
+  event.mutable_slave_id()->CopyFrom(slaveId);
+  event.mutable_slave_info()->CopyFrom(slaveInfo);
+  event.mutable_resources()->CopyFrom(total);
+
+  if (unavailability.isSome()) {
+    event.mutable_unavailability()->CopyFrom(unavailability.get());
+  }
+
+  foreachpair (const FrameworkID& frameworkId,
+               const Resources& resources,
+               used) {
+    AllocatorTraceEvent::Used* used_ = event.add_used();
+    used_->mutable_framework_id()->CopyFrom(frameworkId);
+    used_->mutable_resources()->CopyFrom(resources);
+  }
+
+  record(&event);
+
+  allocator->addSlave(slaveId, slaveInfo, unavailability, total, used);
+}
+
+
+void TracingAllocator::removeSlave(
+    const SlaveID& slaveId)
+{
+  AllocatorTraceEvent event;
+  event.set_type(AllocatorTraceEvent::REMOVE_SLAVE);
+  event.mutable_slave_id()->CopyFrom(slaveId);
+
+  record(&event);
+
+  allocator->removeSlave(slaveId);
+}
+
+
+void TracingAllocator::updateSlave(
+    const SlaveID& slaveId,
+    const Resources& oversubscribed)
+{
+  AllocatorTraceEvent event;
+  event.set_type(AllocatorTraceEvent::UPDATE_SLAVE);
+  event.mutable_slave_id()->CopyFrom(slaveId);
+  event.mutable_resources()->CopyFrom(oversubscribed);
+
+  record(&event);
+
+  allocator->updateSlave(slaveId, oversubscribed);
+}
+
+
+void TracingAllocator::activateSlave(
+    const SlaveID& slaveId)
+{
+  AllocatorTraceEvent event;
+  event.set_type(AllocatorTraceEvent::ACTIVATE_SLAVE);
+  event.mutable_slave_id()->CopyFrom(slaveId);
+
+  record(&event);
+
+  allocator->activateSlave(slaveId);
+}
+
+
+void TracingAllocator::deactivateSlave(
+    const SlaveID& slaveId)
+{
+  AllocatorTraceEvent event;
+  event.set_type(AllocatorTraceEvent::DEACTIVATE_SLAVE);
+  event.mutable_slave_id()->CopyFrom(slaveId);
+
+  record(&event);
+
+  allocator->deactivateSlave(slaveId);
+}
+
+
+void TracingAllocator::updateWhitelist(
+    const Option<hashset<string>>& whitelist)
+{
+  allocator->updateWhitelist(whitelist);
+}
+
+
+void TracingAllocator::requestResources(
+    const FrameworkID& frameworkId,
+    const vector<Request>& requests)
+{
+  allocator->requestResources(frameworkId, requests);
+}
+
+
+void TracingAllocator::updateAllocation(
+    const FrameworkID& frameworkId,
+    const SlaveID& slaveId,
+    const vector<Offer::Operation>& operations)
+{
+  AllocatorTraceEvent event;
+  event.set_type(AllocatorTraceEvent::UPDATE_ALLOCATION);
+  event.mutable_framework_id()->CopyFrom(frameworkId);
+  event.mutable_slave_id()->CopyFrom(slaveId);
+
+  foreach (const Offer::Operation& operation, operations) {
+    event.add_operations()->CopyFrom(operation);
+  }
+
+  record(&event);
+
+  allocator->updateAllocation(frameworkId, slaveId, operations);
+}
+
+
+Future<Nothing> TracingAllocator::updateAvailable(
+    const SlaveID& slaveId,
+    const vector<Offer::Operation>& operations)
+{
+  AllocatorTraceEvent event;
+  event.set_type(AllocatorTraceEvent::UPDATE_AVAILABLE);
+  event.mutable_slave_id()->CopyFrom(slaveId);
+
+  foreach (const Offer::Operation& operation, operations) {
+    event.add_operations()->CopyFrom(operation);
+  }
+
+  record(&event);
+
+  return allocator->updateAvailable(slaveId, operations);
+}
+
+
+void TracingAllocator::updateUnavailability(
+    const SlaveID& slaveId,
+    const Option<Unavailability>& unavailability)
+{
+  allocator->updateUnavailability(slaveId, unavailability);
+}
+
+
+void TracingAllocator::updateInverseOffer(
+    const SlaveID& slaveId,
+    const FrameworkID& frameworkId,
+    const Option<UnavailableResources>& unavailableResources,
+    const Option<InverseOfferStatus>& status,
+    const Option<Filters>& filters)
+{
+  allocator->updateInverseOffer(
+      slaveId,
+      frameworkId,
+      unavailableResources,
+      status,
+      filters);
+}
+
+
+Future<hashmap<SlaveID, hashmap<FrameworkID, InverseOfferStatus>>>
+TracingAllocator::getInverseOfferStatuses()
+{
+  return allocator->getInverseOfferStatuses();
+}
+
+
+void TracingAllocator::recoverResources(
+    const FrameworkID& frameworkId,
+    const SlaveID& slaveId,
+    const Resources& resources,
+    const Option<Filters>& filters)
+{
+  AllocatorTraceEvent event;
+  event.set_type(AllocatorTraceEvent::RECOVER_RESOURCES);
+  event.mutable_framework_id()->CopyFrom(frameworkId);
+  event.mutable_slave_id()->CopyFrom(slaveId);
+  event.mutable_resources()->CopyFrom(resources);
+
+  if (filters.isSome()) {
+    event.mutable_filters()->CopyFrom(filters.get());
+  }
+
+  record(&event);
+
+  allocator->recoverResources(frameworkId, slaveId, resources, filters);
+}
+
+
+void TracingAllocator::suppressOffers(
+    const FrameworkID& frameworkId)
+{
+  AllocatorTraceEvent event;
+  event.set_type(AllocatorTraceEvent::SUPPRESS_OFFERS);
+  event.mutable_framework_id()->CopyFrom(frameworkId);
+
+  record(&event);
+
+  allocator->suppressOffers(frameworkId);
+}
+
+
+void TracingAllocator::reviveOffers(
+    const FrameworkID& frameworkId)
+{
+  AllocatorTraceEvent event;
+  event.set_type(AllocatorTraceEvent::REVIVE_OFFERS);
+  event.mutable_framework_id()->CopyFrom(frameworkId);
+
+  record(&event);
+
+  allocator->reviveOffers(frameworkId);
+}
+
+
+void TracingAllocator::setQuota(
+    const string& role,
+    const Quota& quota)
+{
+  AllocatorTraceEvent event;
+  event.set_type(AllocatorTraceEvent::SET_QUOTA);
+  event.set_role(role);
+  event.mutable_quota()->CopyFrom(quota.info);
+
+  record(&event);
+
+  allocator->setQuota(role, quota);
+}
+
+
+void TracingAllocator::removeQuota(
+    const string& role)
+{
+  AllocatorTraceEvent event;
+  event.set_type(AllocatorTraceEvent::REMOVE_QUOTA);
+  event.set_role(role);
+
+  record(&event);
+
+  allocator->removeQuota(role);
+}
+
+} // namespace allocator {
+} // namespace master {
+} // namespace internal {
+} // namespace mesos {
@@ -0,0 +1,201 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __MASTER_ALLOCATOR_TRACE_HPP__
+#define __MASTER_ALLOCATOR_TRACE_HPP__
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <mesos/master/allocator.hpp>
+
+#include <mesos/quota/quota.hpp>
+
+#include <process/future.hpp>
+#include <process/time.hpp>
+
+#include <stout/hashmap.hpp>
+#include <stout/hashset.hpp>
+#include <stout/lambda.hpp>
+#include <stout/nothing.hpp>
+#include <stout/option.hpp>
+#include <stout/try.hpp>
+
+#include "master/allocator/trace.pb.h"
+
+namespace mesos {
+namespace internal {
+namespace master {
+namespace allocator {
+
+// An allocator that records the calls to another allocator, to which
+// it forwards them, to a trace file (see `AllocatorTraceEvent`). This
+// is used by the master when the `--allocator_trace` flag is set, so
+// that the calls made to the allocator in a (production) cluster can
+// be replayed later, e.g., in the allocator benchmarks.
+//
+// NOTE: Only the calls that affect allocations are recorded, i.e.,
+// not `initialize()`, `recover()`, `updateWhitelist()`,
+// `requestResources()` or the maintenance related calls.
+class TracingAllocator : public mesos::master::allocator::Allocator
+{
+public:
+  // Creates (or truncates) the trace file at the path. Takes
+  // ownership of the allocator.
+  static Try<mesos::master::allocator::Allocator*> create(
+      mesos::master::allocator::Allocator* allocator,
+      const std::string& path);
+
+  virtual ~TracingAllocator();
+
+  virtual void initialize(
+      const Duration& allocationInterval,
+      const lambda::function<
+          void(const FrameworkID&,
+               const hashmap<SlaveID, Resources>&)>& offerCallback,
+      const lambda::function<
+          void(const FrameworkID&,
+               const hashmap<SlaveID, UnavailableResources>&)>&
+        inverseOfferCallback,
+      const hashmap<std::string, double>& weights,
+      size_t allocationShards,
+      const Duration& minAllocationInterval,
+      const std::string& agentOrdering);
+
+  virtual void recover(
+      const int expectedAgentCount,
+      const hashmap<std::string, Quota>& quotas);
+
+  virtual void addFramework(
+      const FrameworkID& frameworkId,
+      const FrameworkInfo& frameworkInfo,
+      const hashmap<SlaveID, Resources>& used);
+
+  virtual void removeFramework(
+      const FrameworkID& frameworkId);
+
+  virtual void activateFramework(
+      const FrameworkID& frameworkId);
+
+  virtual void deactivateFramework(
+      const FrameworkID& frameworkId);
+
+  virtual void updateFramework(
+      const FrameworkID& frameworkId,
+      const FrameworkInfo& frameworkInfo);
+
+  virtual void addSlave(
+      const SlaveID& slaveId,
+      const SlaveInfo& slaveInfo,
+      const Option<Unavailability>& unavailability,
+      const Resources& total,
+      const hashmap<FrameworkID, Resources>& used);
+
+  virtual void removeSlave(
+      const SlaveID& slaveId);
+
+  virtual void updateSlave(
+      const SlaveID& slave,
+      const Resources& oversubscribed);
+
+  virtual void activateSlave(
+      const SlaveID& slaveId);
+
+  virtual void deactivateSlave(
+      const SlaveID& slaveId);
+
+  virtual void updateWhitelist(
+      const Option<hashset<std::string>>& whitelist);
+
+  virtual void requestResources(
+      const FrameworkID& frameworkId,
+      const std::vector<Request>& requests);
+
+  virtual void updateAllocation(
+      const FrameworkID& frameworkId,
+      const SlaveID& slaveId,
+      const std::vector<Offer::Operation>& operations);
+
+  virtual process::Future<Nothing> updateAvailable(
+      const SlaveID& slaveId,
+      const std::vector<Offer::Operation>& operations);
+
+  virtual void updateUnavailability(
+      const SlaveID& slaveId,
+      const Option<Unavailability>& unavailability);
+
+  virtual void updateInverseOffer(
+      const SlaveID& slaveId,
+      const FrameworkID& frameworkId,
+      const Option<UnavailableResources>& unavailableResources,
+      const Option<mesos::master::InverseOfferStatus>& status,
+      const Option<Filters>& filters);
+
+  virtual process::Future<
+      hashmap<SlaveID, hashmap<FrameworkID, mesos::master::InverseOfferStatus>>>
+    getInverseOfferStatuses();
+
+  virtual void recoverResources(
+      const FrameworkID& frameworkId,
+      const SlaveID& slaveId,
+      const Resources& resources,
+      const Option<Filters>& filters);
+
+  virtual void suppressOffers(
+      const FrameworkID& frameworkId);
+
+  virtual void reviveOffers(
+      const FrameworkID& frameworkId);
+
+  virtual void setQuota(
+      const std::string& role,
+      const Quota& quota);
+
+  virtual void removeQuota(
+      const std::string& role);
+
+private:
+  TracingAllocator(
+      mesos::master::allocator::Allocator* allocator,
+      const std::string& path,
+      int fd);
+
+  TracingAllocator(const TracingAllocator&); // Not copyable.
+  TracingAllocator& operator=(const TracingAllocator&); // Not assignable.
+
+  // Appends the event to the trace, setting its time.
+  void record(AllocatorTraceEvent* event);
+
+  mesos::master::allocator::Allocator* allocator;
+
+  const std::string path;
+
+  // The trace file, closed (and `None`) if writing to it failed.
+  Option<int> fd;
+
+  // When the trace was started.
+  const process::Time start;
+
+  std::mutex mutex;
+};
+
+} // namespace allocator {
+} // namespace master {
+} // namespace internal {
+} // namespace mesos {
+
+#endif // __MASTER_ALLOCATOR_TRACE_HPP__
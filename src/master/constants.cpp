@@ -46,6 +46,10 @@ const Duration ZOOKEEPER_SESSION_TIMEOUT = Seconds(10);
 const std::string DEFAULT_AUTHENTICATOR = "crammd5";
 const std::string DEFAULT_ALLOCATOR = "HierarchicalDRF";
 const Duration DEFAULT_ALLOCATION_INTERVAL = Seconds(1);
+const size_t DEFAULT_ALLOCATION_SHARDS = 1;
+const Duration DEFAULT_MIN_ALLOCATION_INTERVAL = Duration::zero();
+const std::string DEFAULT_AGENT_ORDERING = "random";
+const Duration DEFAULT_MAX_STATE_STALENESS = Duration::zero();
 const std::string DEFAULT_AUTHORIZER = "local";
 const std::string DEFAULT_HTTP_AUTHENTICATOR = "basic";
 const std::string DEFAULT_HTTP_AUTHENTICATION_REALM = "mesos";
@@ -127,6 +127,19 @@ extern const std::string DEFAULT_ALLOCATOR;
 // The default interval between allocations.
 extern const Duration DEFAULT_ALLOCATION_INTERVAL;
 
+// The default number of shards the agents are partitioned into
+// during an allocation.
+extern const size_t DEFAULT_ALLOCATION_SHARDS;
+
+// The default minimum interval between event-triggered allocations.
+extern const Duration DEFAULT_MIN_ALLOCATION_INTERVAL;
+
+// The default order in which the agents' resources are allocated.
+extern const std::string DEFAULT_AGENT_ORDERING;
+
+// The default maximum age of the state endpoints' snapshots.
+extern const Duration DEFAULT_MAX_STATE_STALENESS;
+
 // Name of the default, local authorizer.
 extern const std::string DEFAULT_AUTHORIZER;
 
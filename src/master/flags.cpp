@@ -22,6 +22,10 @@
 #include "master/constants.hpp"
 #include "master/flags.hpp"
 
+#include "master/allocator/mesos/agent_ordering.hpp"
+
+using mesos::internal::master::allocator::AgentOrdering;
+
 
 mesos::internal::master::Flags::Flags()
 {
@@ -96,6 +100,18 @@ mesos::internal::master::Flags::Flags()
       "after which the operation is considered a failure.",
       Seconds(60));
 
+  add(&Flags::registry_max_deltas,
+      "registry_max_deltas",
+      "Maximum number of changes to the registry that are stored as deltas\n"
+      "between storing snapshots of the whole registry. Storing deltas\n"
+      "avoids rewriting the whole registry (e.g., all the agents) for\n"
+      "every change. If zero, the whole registry is stored for every\n"
+      "change.\n"
+      "NOTE: Masters older than 0.28 ignore the deltas, so this must be\n"
+      "set to zero (and a change to the registry stored, e.g., by a\n"
+      "failover) before downgrading the masters.",
+      0);
+
   add(&Flags::registry_store_timeout,
       "registry_store_timeout",
       "Duration of time to wait in order to store data in the registry\n"
@@ -109,6 +125,13 @@ mesos::internal::master::Flags::Flags()
       "initialized when used for the very first time.",
       true);
 
+  add(&Flags::log_async_io,
+      "log_async_io",
+      "Whether the replica of the replicated log used for the registry\n"
+      "writes to disk from a separate process, so that it can keep serving\n"
+      "requests from the other replicas while its writes are being synced.",
+      false);
+
   add(&Flags::slave_reregister_timeout,
       "slave_reregister_timeout",
       "The timeout within which all slaves are expected to re-register\n"
@@ -179,6 +202,46 @@ mesos::internal::master::Flags::Flags()
       " (batch) allocations (e.g., 500ms, 1sec, etc).",
       DEFAULT_ALLOCATION_INTERVAL);
 
+  add(&Flags::allocation_shards,
+      "allocation_shards",
+      "Number of shards the agents are partitioned into when performing\n"
+      "an allocation. The shards are evaluated in parallel, which reduces\n"
+      "the time an allocation takes on large clusters; the allocation\n"
+      "decisions are the same regardless of the number of shards.",
+      DEFAULT_ALLOCATION_SHARDS);
+
+  add(&Flags::min_allocation_interval,
+      "min_allocation_interval",
+      "Minimum amount of time between allocations that are triggered by\n"
+      "events (e.g., an agent being added or a framework reviving offers),\n"
+      "which are otherwise performed as soon as possible. All events until\n"
+      "the allocation is performed are coalesced into that allocation.",
+      DEFAULT_MIN_ALLOCATION_INTERVAL);
+
+  add(&Flags::agent_ordering,
+      "agent_ordering",
+      "The order in which the resources of the agents are allocated:\n"
+      "`random`: A random order for every allocation.\n"
+      "`spread`: The least utilized agents first, which spreads tasks\n"
+      "evenly across the agents.\n"
+      "`binpack`: The most utilized agents first, which packs tasks onto\n"
+      "as few agents as possible.\n"
+      "`attribute:<name>`: The agents grouped by the value of the named\n"
+      "attribute (e.g., `attribute:rack`), and in `binpack` order within\n"
+      "each group. Agents without the attribute come last.\n"
+      "The utilization of an agent is the allocated fraction of its\n"
+      "dominant resource.",
+      DEFAULT_AGENT_ORDERING,
+      [](const std::string& value) -> Option<Error> {
+        Try<AgentOrdering*> ordering = AgentOrdering::create(value);
+        if (ordering.isError()) {
+          return Error(
+              "Invalid `--agent_ordering`: " + ordering.error());
+        }
+        delete ordering.get();
+        return None();
+      });
+
   add(&Flags::cluster,
       "cluster",
       "Human readable name for the cluster, displayed in the webui.");
@@ -404,6 +467,15 @@ mesos::internal::master::Flags::Flags()
       "load an alternate allocator module using `--modules`.",
       DEFAULT_ALLOCATOR);
 
+  add(&Flags::allocator_trace,
+      "allocator_trace",
+      "Path of a file to record the calls to the allocator to (the file is\n"
+      "truncated on startup). The recorded trace can be replayed against the\n"
+      "allocator in the allocator benchmarks, e.g., to analyze the allocation\n"
+      "performance of a production cluster. Recording a trace slows down the\n"
+      "master and the trace can grow large, so this is intended for debugging\n"
+      "only.");
+
   add(&Flags::hooks,
       "hooks",
       "A comma-separated list of hook modules to be\n"
@@ -473,4 +545,14 @@ mesos::internal::master::Flags::Flags()
       "max_completed_tasks_per_framework",
       "Maximum number of completed tasks per framework to store in memory.",
       DEFAULT_MAX_COMPLETED_TASKS_PER_FRAMEWORK);
+
+  add(&Flags::max_state_staleness,
+      "max_state_staleness",
+      "Maximum age of the snapshots of the master's state that the\n"
+      "`/state`, `/state-summary`, `/roles` and `/tasks` endpoints are\n"
+      "served from, which are taken (and served) without otherwise\n"
+      "involving the master. A request can bypass the snapshots with\n"
+      "the `fresh=true` query parameter. If zero, every request is\n"
+      "served from the master's current state.",
+      DEFAULT_MAX_STATE_STALENESS);
 }
@@ -51,8 +51,10 @@ public:
   Duration zk_session_timeout;
   bool registry_strict;
   Duration registry_fetch_timeout;
+  size_t registry_max_deltas;
   Duration registry_store_timeout;
   bool log_auto_initialize;
+  bool log_async_io;
   Duration slave_reregister_timeout;
   std::string recovery_slave_removal_limit;
   Option<std::string> slave_removal_rate_limit;
@@ -61,6 +63,9 @@ public:
   std::string user_sorter;
   std::string framework_sorter;
   Duration allocation_interval;
+  size_t allocation_shards;
+  Duration min_allocation_interval;
+  std::string agent_ordering;
   Option<std::string> cluster;
   Option<std::string> roles;
   Option<std::string> weights;
@@ -75,6 +80,7 @@ public:
   Option<Modules> modules;
   std::string authenticators;
   std::string allocator;
+  Option<std::string> allocator_trace;
   Option<std::string> hooks;
   Duration slave_ping_timeout;
   size_t max_slave_ping_timeouts;
@@ -82,6 +88,7 @@ public:
   std::string http_authenticators;
   size_t max_completed_frameworks;
   size_t max_completed_tasks_per_framework;
+  Duration max_state_staleness;
 
 #ifdef WITH_NETWORK_ISOLATOR
   Option<size_t> max_executors_per_slave;
@@ -33,11 +33,13 @@
 #include <mesos/maintenance/maintenance.hpp>
 
 #include <process/defer.hpp>
+#include <process/dispatch.hpp>
 #include <process/help.hpp>
 
 #include <process/metrics/metrics.hpp>
 
 #include <stout/base64.hpp>
+#include <stout/bytes.hpp>
 #include <stout/foreach.hpp>
 #include <stout/hashmap.hpp>
 #include <stout/hashset.hpp>
@@ -127,9 +129,6 @@ void json(JSON::ObjectWriter* writer, const Offer& offer)
 namespace internal {
 namespace master {
 
-// Pull in model overrides from common.
-using mesos::internal::model;
-
 // Pull in definitions from process.
 using process::http::Response;
 using process::http::Request;
@@ -307,195 +306,191 @@ void json(JSON::ObjectWriter* writer, const Full<Framework>& full)
 }
 
 
-// TODO(bmahler): Kill these in favor of automatic Proto->JSON Conversion (when
-// it becomes available).
-
-
-// Returns a JSON object modeled on an Offer.
-JSON::Object model(const Offer& offer)
+// Streams a JSON object as the body of a response using a "chunked"
+// 'Transfer-Encoding', rather than building all of it in memory before
+// sending it. The object is written in steps (e.g., one per framework),
+// which are run on the master in batches of about `CHUNK_SIZE` bytes.
+// Each batch is dispatched separately, so that the master processes
+// other events in between them. Since the master's state can change in
+// between the batches, the steps must look up what they write (e.g., a
+// framework by its ID) rather than hold on to pointers into it.
+//
+// NOTE: The steps capture the stream, so it must be created (and is
+// kept alive while streaming) through a `std::shared_ptr`.
+class ObjectStream : public std::enable_shared_from_this<ObjectStream>
 {
-  JSON::Object object;
-  object.values["id"] = offer.id().value();
-  object.values["framework_id"] = offer.framework_id().value();
-  object.values["slave_id"] = offer.slave_id().value();
-  object.values["resources"] = model(offer.resources());
-  return object;
-}
-
+public:
+  static std::shared_ptr<ObjectStream> create(const Option<string>& jsonp)
+  {
+    return std::shared_ptr<ObjectStream>(new ObjectStream(jsonp));
+  }
 
-// Returns a JSON object summarizing some important fields in a
-// Framework.
-JSON::Object summarize(const Framework& framework)
-{
-  JSON::Object object;
-  object.values["id"] = framework.id().value();
-  object.values["name"] = framework.info.name();
+  // Adds a step writing the fields that 'write' (a function taking a
+  // `JSON::ObjectWriter*`) writes to the object.
+  template <typename F>
+  void fields(const F& write)
+  {
+    steps.push_back([this, write]() {
+      const string json = jsonify(write);
 
-  // Omit pid for http frameworks.
-  if (framework.pid.isSome()) {
-    object.values["pid"] = string(framework.pid.get());
+      // Strip the braces to add the fields to the streamed object.
+      append(json.substr(1, json.size() - 2), &emptyObject);
+    });
   }
 
-  // TODO(bmahler): Use these in the webui.
-  object.values["used_resources"] = model(framework.totalUsedResources);
-  object.values["offered_resources"] = model(framework.totalOfferedResources);
-
+  // Adds an array field, with a step for each of the 'keys' writing
+  // its elements by calling 'write' with the key and a
+  // `JSON::ArrayWriter*`. A key can have any number of elements, e.g.,
+  // none if the framework it identifies has been removed since.
+  template <typename K, typename F>
+  void array(const string& name, const vector<K>& keys, const F& write)
   {
-      JSON::Array array;
-      array.values.reserve(framework.info.capabilities_size());
-      foreach (const FrameworkInfo::Capability& capability,
-               framework.info.capabilities()) {
-        array.values.push_back(
-              FrameworkInfo::Capability::Type_Name(capability.type()));
-      }
-      object.values["capabilities"] = std::move(array);
+    steps.push_back([this, name]() {
+      append(string(jsonify(name)) + ":[", &emptyObject);
+      emptyArray = true;
+    });
+
+    foreach (const K& key, keys) {
+      steps.push_back([this, key, write]() {
+        const string json = jsonify([&](JSON::ArrayWriter* writer) {
+          write(key, writer);
+        });
+
+        // Strip the brackets to add the elements to the streamed array.
+        append(json.substr(1, json.size() - 2), &emptyArray);
+      });
+    }
+
+    steps.push_back([this]() { chunk += "]"; });
   }
 
-  object.values["hostname"] = framework.info.hostname();
-  object.values["webui_url"] = framework.info.webui_url();
+  // Returns the response streaming the object, whose steps are run
+  // on the process 'pid' (i.e., the master). No steps can be added
+  // after the stream is started.
+  Response start(const process::UPID& pid)
+  {
+    Pipe pipe;
+    OK ok;
 
-  object.values["active"] = framework.active;
+    if (jsonp.isSome()) {
+      ok.headers["Content-Type"] = "text/javascript";
+      chunk = jsonp.get() + "({";
+    } else {
+      ok.headers["Content-Type"] = "application/json";
+      chunk = "{";
+    }
 
-  return object;
-}
+    steps.push_back([this]() { chunk += jsonp.isSome() ? "});" : "}"; });
 
+    ok.type = Response::PIPE;
+    ok.reader = pipe.reader();
 
-// Returns a JSON object modeled on a Framework.
-JSON::Object model(const Framework& framework)
-{
-  JSON::Object object = summarize(framework);
+    writer = pipe.writer();
 
-  // Add additional fields to those generated by 'summarize'.
-  object.values["user"] = framework.info.user();
-  object.values["failover_timeout"] = framework.info.failover_timeout();
-  object.values["checkpoint"] = framework.info.checkpoint();
-  object.values["role"] = framework.info.role();
-  object.values["registered_time"] = framework.registeredTime.secs();
-  object.values["unregistered_time"] = framework.unregisteredTime.secs();
-  object.values["active"] = framework.active;
+    std::shared_ptr<ObjectStream> self = shared_from_this();
+    process::dispatch(pid, [self, pid]() { self->run(pid); });
 
-  if (framework.info.has_principal()) {
-    object.values["principal"] = framework.info.principal();
+    return ok;
   }
 
-  // TODO(bmahler): Consider deprecating this in favor of the split
-  // used and offered resources added in 'summarize'.
-  object.values["resources"] =
-    model(framework.totalUsedResources + framework.totalOfferedResources);
+private:
+  static const Bytes CHUNK_SIZE;
 
-  // TODO(benh): Consider making reregisteredTime an Option.
-  if (framework.registeredTime != framework.reregisteredTime) {
-    object.values["reregistered_time"] = framework.reregisteredTime.secs();
-  }
+  explicit ObjectStream(const Option<string>& _jsonp)
+    : jsonp(_jsonp), next(0), emptyObject(true), emptyArray(true) {}
 
-  // Model all of the tasks associated with a framework.
+  // Appends the (comma separated) members 'json' to the current
+  // object or array, whose emptiness is tracked by 'empty'.
+  void append(const string& json, bool* empty)
   {
-    JSON::Array array;
-    array.values.reserve(
-        framework.pendingTasks.size() + framework.tasks.size()); // MESOS-2353.
-
-    foreachvalue (const TaskInfo& task, framework.pendingTasks) {
-      vector<TaskStatus> statuses;
-      array.values.push_back(
-          model(task, framework.id(), TASK_STAGING, statuses));
+    if (json.empty()) {
+      return;
     }
 
-    foreachvalue (Task* task, framework.tasks) {
-      array.values.push_back(model(*task));
+    if (!*empty) {
+      chunk += ",";
     }
 
-    object.values["tasks"] = std::move(array);
+    chunk += json;
+    *empty = false;
   }
 
-  // Model all of the completed tasks of a framework.
+  void run(const process::UPID& pid)
   {
-    JSON::Array array;
-    array.values.reserve(framework.completedTasks.size()); // MESOS-2353.
-
-    foreach (const std::shared_ptr<Task>& task, framework.completedTasks) {
-      array.values.push_back(model(*task));
+    while (next < steps.size() && chunk.size() < CHUNK_SIZE.bytes()) {
+      steps[next++]();
     }
 
-    object.values["completed_tasks"] = std::move(array);
-  }
+    // NOTE: An empty write would end the response, but `chunk` can
+    // only be empty here once all of the steps have been run.
+    if (!chunk.empty()) {
+      if (!writer->write(chunk)) {
+        VLOG(1) << "Stopped streaming a response as the reader was closed";
+        return;
+      }
 
-  // Model all of the offers associated with a framework.
-  {
-    JSON::Array array;
-    array.values.reserve(framework.offers.size()); // MESOS-2353.
+      chunk.clear();
+    }
 
-    foreach (Offer* offer, framework.offers) {
-      array.values.push_back(model(*offer));
+    if (next == steps.size()) {
+      writer->close();
+      return;
     }
 
-    object.values["offers"] = std::move(array);
+    std::shared_ptr<ObjectStream> self = shared_from_this();
+    process::dispatch(pid, [self, pid]() { self->run(pid); });
   }
 
-  // Model all of the executors of a framework.
-  {
-    JSON::Array executors;
-    int executorSize = 0;
-    foreachvalue (const auto& executorsMap,
-                  framework.executors) {
-      executorSize += executorsMap.size();
-    }
-    executors.values.reserve(executorSize); // MESOS-2353
-    foreachpair (const SlaveID& slaveId,
-                 const auto& executorsMap,
-                 framework.executors) {
-      foreachvalue (const ExecutorInfo& executor, executorsMap) {
-        JSON::Object executorJson = model(executor);
-        executorJson.values["slave_id"] = slaveId.value();
-        executors.values.push_back(executorJson);
-      }
-    }
+  const Option<string> jsonp;
 
-    object.values["executors"] = std::move(executors);
-  }
+  vector<std::function<void()>> steps;
+  size_t next; // The next step to run.
 
-  // Model all of the labels associated with a framework.
-  if (framework.info.has_labels()) {
-    object.values["labels"] = model(framework.info.labels());
-  }
+  string chunk; // The output of the current batch of steps.
+  bool emptyObject;
+  bool emptyArray;
 
-  return object;
-}
+  Option<Pipe::Writer> writer;
+};
 
 
-// Returns a JSON object summarizing some important fields in a Slave.
-JSON::Object summarize(const Slave& slave)
+const Bytes ObjectStream::CHUNK_SIZE = Kilobytes(64);
+
+
+Master::Http::Http(Master* _master)
+  : master(_master),
+    quotaHandler(_master),
+    snapshots(NULL)
 {
-  JSON::Object object;
-  object.values["id"] = slave.id.value();
-  object.values["pid"] = string(slave.pid);
-  object.values["hostname"] = slave.info.hostname();
-  object.values["registered_time"] = slave.registeredTime.secs();
+  if (master->flags.max_state_staleness > Duration::zero()) {
+    snapshots = new StateSnapshotProcess(
+        master->self(), master->flags.max_state_staleness);
 
-  if (slave.reregisteredTime.isSome()) {
-    object.values["reregistered_time"] = slave.reregisteredTime.get().secs();
+    process::spawn(snapshots);
   }
+}
 
-  const Resources& totalResources = slave.totalResources;
-  object.values["resources"] = model(totalResources);
-  object.values["used_resources"] = model(Resources::sum(slave.usedResources));
-  object.values["offered_resources"] = model(slave.offeredResources);
-  object.values["reserved_resources"] = model(totalResources.reserved());
-  object.values["unreserved_resources"] = model(totalResources.unreserved());
-
-  object.values["attributes"] = model(slave.info.attributes());
-  object.values["active"] = slave.active;
-  object.values["version"] = slave.version;
 
-  return object;
+Master::Http::~Http()
+{
+  if (snapshots != NULL) {
+    process::terminate(snapshots);
+    process::wait(snapshots);
+    delete snapshots;
+  }
 }
 
 
-// Returns a JSON object modeled after a Slave.
-// For now there are no additional fields being added to those
-// generated by 'summarize'.
-JSON::Object model(const Slave& slave)
+Future<Response> Master::Http::snapshot(
+    const Request& request,
+    const StateSnapshotProcess::Render& render) const
 {
-  return summarize(slave);
+  if (snapshots == NULL || request.url.query.get("fresh") == string("true")) {
+    return render(request);
+  }
+
+  return process::dispatch(
+      snapshots, &StateSnapshotProcess::get, request, render);
 }
 
 
@@ -897,52 +892,64 @@ string Master::Http::FRAMEWORKS()
 
 Future<Response> Master::Http::frameworks(const Request& request) const
 {
-  JSON::Object object;
+  std::shared_ptr<ObjectStream> stream =
+    ObjectStream::create(request.url.query.get("jsonp"));
 
   // Model all of the frameworks.
-  {
-    JSON::Array array;
-    array.values.reserve(master->frameworks.registered.size()); // MESOS-2353.
-
-    foreachvalue (Framework* framework, master->frameworks.registered) {
-      array.values.push_back(model(*framework));
-    }
-
-    object.values["frameworks"] = std::move(array);
-  }
+  vector<FrameworkID> frameworkIds;
+  frameworkIds.reserve(master->frameworks.registered.size());
+  foreachkey (const FrameworkID& frameworkId, master->frameworks.registered) {
+    frameworkIds.push_back(frameworkId);
+  }
+
+  stream->array(
+      "frameworks",
+      frameworkIds,
+      [this](const FrameworkID& frameworkId, JSON::ArrayWriter* writer) {
+        Framework* framework = master->getFramework(frameworkId);
+        if (framework != NULL) {
+          writer->element(Full<Framework>(*framework));
+        }
+      });
 
   // Model all of the completed frameworks.
-  {
-    JSON::Array array;
-    array.values.reserve(master->frameworks.completed.size()); // MESOS-2353.
-
-    foreach (const std::shared_ptr<Framework>& framework,
-             master->frameworks.completed) {
-      array.values.push_back(model(*framework));
-    }
-
-    object.values["completed_frameworks"] = std::move(array);
-  }
+  stream->array(
+      "completed_frameworks",
+      vector<std::shared_ptr<Framework>>(
+          master->frameworks.completed.begin(),
+          master->frameworks.completed.end()),
+      [](const std::shared_ptr<Framework>& framework,
+         JSON::ArrayWriter* writer) {
+        writer->element(Full<Framework>(*framework));
+      });
 
   // Model all currently unregistered frameworks.
   // This could happen when the framework has yet to re-register
   // after master failover.
-  {
-    JSON::Array array;
-
-    // Find unregistered frameworks.
-    foreachvalue (const Slave* slave, master->slaves.registered) {
-      foreachkey (const FrameworkID& frameworkId, slave->tasks) {
-        if (!master->frameworks.registered.contains(frameworkId)) {
-          array.values.push_back(frameworkId.value());
+  vector<SlaveID> slaveIds;
+  slaveIds.reserve(master->slaves.registered.size());
+  foreachkey (const SlaveID& slaveId, master->slaves.registered) {
+    slaveIds.push_back(slaveId);
+  }
+
+  stream->array(
+      "unregistered_frameworks",
+      slaveIds,
+      [this](const SlaveID& slaveId, JSON::ArrayWriter* writer) {
+        const Slave* slave = master->slaves.registered.get(slaveId);
+        if (slave == NULL) {
+          return;
         }
-      }
-    }
 
-    object.values["unregistered_frameworks"] = std::move(array);
-  }
+        // Find unregistered frameworks.
+        foreachkey (const FrameworkID& frameworkId, slave->tasks) {
+          if (!master->frameworks.registered.contains(frameworkId)) {
+            writer->element(frameworkId.value());
+          }
+        }
+      });
 
-  return OK(object, request.url.query.get("jsonp"));
+  return stream->start(master->self());
 }
 
 
@@ -1235,20 +1242,26 @@ string Master::Http::SLAVES_HELP()
 
 Future<Response> Master::Http::slaves(const Request& request) const
 {
-  JSON::Object object;
+  std::shared_ptr<ObjectStream> stream =
+    ObjectStream::create(request.url.query.get("jsonp"));
 
-  {
-    JSON::Array array;
-    array.values.reserve(master->slaves.registered.size()); // MESOS-2353.
-
-    foreachvalue (const Slave* slave, master->slaves.registered) {
-      array.values.push_back(model(*slave));
-    }
-
-    object.values["slaves"] = std::move(array);
+  vector<SlaveID> slaveIds;
+  slaveIds.reserve(master->slaves.registered.size());
+  foreachkey (const SlaveID& slaveId, master->slaves.registered) {
+    slaveIds.push_back(slaveId);
   }
 
-  return OK(object, request.url.query.get("jsonp"));
+  stream->array(
+      "slaves",
+      slaveIds,
+      [this](const SlaveID& slaveId, JSON::ArrayWriter* writer) {
+        const Slave* slave = master->slaves.registered.get(slaveId);
+        if (slave != NULL) {
+          writer->element(Full<Slave>(*slave));
+        }
+      });
+
+  return stream->start(master->self());
 }
 
 
@@ -1302,7 +1315,21 @@ string Master::Http::STATE_HELP()
 
 Future<Response> Master::Http::state(const Request& request) const
 {
-  auto state = [this](JSON::ObjectWriter* writer) {
+  return snapshot(request, [this](const Request& request) {
+    return _state(request);
+  });
+}
+
+
+Future<Response> Master::Http::_state(const Request& request) const
+{
+  // The state is streamed (see `ObjectStream`), so the master can
+  // process other events while writing large clusters' state, and
+  // the state never needs to be held in memory all at once.
+  std::shared_ptr<ObjectStream> stream =
+    ObjectStream::create(request.url.query.get("jsonp"));
+
+  stream->fields([this](JSON::ObjectWriter* writer) {
     writer->field("version", MESOS_VERSION);
 
     if (build::GIT_SHA.isSome()) {
@@ -1356,33 +1383,64 @@ Future<Response> Master::Http::state(const Request& request) const
         }
       }
     });
+  });
 
-    // Model all of the slaves.
-    writer->field("slaves", [this](JSON::ArrayWriter* writer) {
-      foreachvalue (Slave* slave, master->slaves.registered) {
-        writer->element(Full<Slave>(*slave));
-      }
-    });
+  vector<SlaveID> slaveIds;
+  slaveIds.reserve(master->slaves.registered.size());
+  foreachkey (const SlaveID& slaveId, master->slaves.registered) {
+    slaveIds.push_back(slaveId);
+  }
 
-    // Model all of the frameworks.
-    writer->field("frameworks", [this](JSON::ArrayWriter* writer) {
-      foreachvalue (Framework* framework, master->frameworks.registered) {
-        writer->element(Full<Framework>(*framework));
-      }
-    });
+  vector<FrameworkID> frameworkIds;
+  frameworkIds.reserve(master->frameworks.registered.size());
+  foreachkey (const FrameworkID& frameworkId, master->frameworks.registered) {
+    frameworkIds.push_back(frameworkId);
+  }
+
+  // Model all of the slaves.
+  stream->array(
+      "slaves",
+      slaveIds,
+      [this](const SlaveID& slaveId, JSON::ArrayWriter* writer) {
+        const Slave* slave = master->slaves.registered.get(slaveId);
+        if (slave != NULL) {
+          writer->element(Full<Slave>(*slave));
+        }
+      });
+
+  // Model all of the frameworks.
+  stream->array(
+      "frameworks",
+      frameworkIds,
+      [this](const FrameworkID& frameworkId, JSON::ArrayWriter* writer) {
+        Framework* framework = master->getFramework(frameworkId);
+        if (framework != NULL) {
+          writer->element(Full<Framework>(*framework));
+        }
+      });
 
-    // Model all of the completed frameworks.
-    writer->field("completed_frameworks", [this](JSON::ArrayWriter* writer) {
-      foreach (const std::shared_ptr<Framework>& framework,
-               master->frameworks.completed) {
+  // Model all of the completed frameworks.
+  stream->array(
+      "completed_frameworks",
+      vector<std::shared_ptr<Framework>>(
+          master->frameworks.completed.begin(),
+          master->frameworks.completed.end()),
+      [](const std::shared_ptr<Framework>& framework,
+         JSON::ArrayWriter* writer) {
         writer->element(Full<Framework>(*framework));
-      }
-    });
+      });
+
+  // Model all of the orphan tasks.
+  stream->array(
+      "orphan_tasks",
+      slaveIds,
+      [this](const SlaveID& slaveId, JSON::ArrayWriter* writer) {
+        const Slave* slave = master->slaves.registered.get(slaveId);
+        if (slave == NULL) {
+          return;
+        }
 
-    // Model all of the orphan tasks.
-    writer->field("orphan_tasks", [this](JSON::ArrayWriter* writer) {
-      // Find those orphan tasks.
-      foreachvalue (const Slave* slave, master->slaves.registered) {
+        // Find those orphan tasks.
         typedef hashmap<TaskID, Task*> TaskMap;
         foreachvalue (const TaskMap& tasks, slave->tasks) {
           foreachvalue (const Task* task, tasks) {
@@ -1392,25 +1450,29 @@ Future<Response> Master::Http::state(const Request& request) const
             }
           }
         }
-      }
-    });
+      });
+
+  // Model all currently unregistered frameworks.
+  // This could happen when the framework has yet to re-register
+  // after master failover.
+  stream->array(
+      "unregistered_frameworks",
+      slaveIds,
+      [this](const SlaveID& slaveId, JSON::ArrayWriter* writer) {
+        const Slave* slave = master->slaves.registered.get(slaveId);
+        if (slave == NULL) {
+          return;
+        }
 
-    // Model all currently unregistered frameworks.
-    // This could happen when the framework has yet to re-register
-    // after master failover.
-    writer->field("unregistered_frameworks", [this](JSON::ArrayWriter* writer) {
-      // Find unregistered frameworks.
-      foreachvalue (const Slave* slave, master->slaves.registered) {
+        // Find unregistered frameworks.
         foreachkey (const FrameworkID& frameworkId, slave->tasks) {
           if (!master->frameworks.registered.contains(frameworkId)) {
             writer->element(frameworkId.value());
           }
         }
-      }
-    });
-  };
+      });
 
-  return OK(jsonify(state), request.url.query.get("jsonp"));
+  return stream->start(master->self());
 }
 
 
@@ -1572,6 +1634,14 @@ string Master::Http::STATESUMMARY_HELP()
 
 
 Future<Response> Master::Http::stateSummary(const Request& request) const
+{
+  return snapshot(request, [this](const Request& request) {
+    return _stateSummary(request);
+  });
+}
+
+
+Future<Response> Master::Http::_stateSummary(const Request& request) const
 {
   auto stateSummary = [this](JSON::ObjectWriter* writer) {
     writer->field("hostname", master->info().hostname());
@@ -1689,48 +1759,48 @@ string Master::Http::ROLES_HELP()
 }
 
 
-// Returns a JSON object modeled after a role.
-JSON::Object model(
-    const string& name,
-    Option<double> weight,
-    Option<Role*> _role)
+// The representation of a role, with its weight (if any) and its
+// allocations (if it is active), for the `/roles` endpoint.
+struct RoleInfo
 {
-  JSON::Object object;
-  object.values["name"] = name;
+  string name;
+  Option<double> weight;
+  Option<Role*> role;
+};
 
-  if (weight.isSome()) {
-    object.values["weight"] = weight.get();
-  } else {
-    object.values["weight"] = 1.0; // Default weight.
-  }
 
-  if (_role.isNone()) {
-    object.values["resources"] = model(Resources());
-    object.values["frameworks"] = JSON::Array();
-  } else {
-    Role* role = _role.get();
+void json(JSON::ObjectWriter* writer, const RoleInfo& info)
+{
+  writer->field("name", info.name);
+  writer->field("weight", info.weight.getOrElse(1.0)); // Default weight.
 
-    object.values["resources"] = model(role->resources());
+  if (info.role.isNone()) {
+    writer->field("resources", Resources());
+    writer->field("frameworks", std::initializer_list<string>{});
+  } else {
+    Role* role = info.role.get();
 
-    {
-      JSON::Array array;
+    writer->field("resources", role->resources());
 
+    writer->field("frameworks", [role](JSON::ArrayWriter* writer) {
       foreachkey (const FrameworkID& frameworkId, role->frameworks) {
-        array.values.push_back(frameworkId.value());
+        writer->element(frameworkId.value());
       }
-
-      object.values["frameworks"] = std::move(array);
-    }
+    });
   }
-
-  return object;
 }
 
 
 Future<Response> Master::Http::roles(const Request& request) const
 {
-  JSON::Object object;
+  return snapshot(request, [this](const Request& request) {
+    return _roles(request);
+  });
+}
 
+
+Future<Response> Master::Http::_roles(const Request& request) const
+{
   // Compute the role names to return results for. When an explicit
   // role whitelist has been configured, we use that list of names.
   // When using implicit roles, the right behavior is a bit more
@@ -1758,27 +1828,18 @@ Future<Response> Master::Http::roles(const Request& request) const
         master->quotas.keys().end());
   }
 
-  {
-    JSON::Array array;
-
-    foreach (const string& name, roleList) {
-      Option<double> weight = None();
-      if (master->weights.contains(name)) {
-        weight = master->weights[name];
+  auto roles = [this, &roleList](JSON::ObjectWriter* writer) {
+    writer->field("roles", [this, &roleList](JSON::ArrayWriter* writer) {
+      foreach (const string& name, roleList) {
+        writer->element(RoleInfo{
+            name,
+            master->weights.get(name),
+            master->activeRoles.get(name)});
       }
+    });
+  };
 
-      Option<Role*> role = None();
-      if (master->activeRoles.contains(name)) {
-        role = master->activeRoles[name];
-      }
-
-      array.values.push_back(model(name, weight, role));
-    }
-
-    object.values["roles"] = std::move(array);
-  }
-
-  return OK(object, request.url.query.get("jsonp"));
+  return OK(jsonify(roles), request.url.query.get("jsonp"));
 }
 
 
@@ -1937,6 +1998,14 @@ struct TaskComparator
 
 
 Future<Response> Master::Http::tasks(const Request& request) const
+{
+  return snapshot(request, [this](const Request& request) {
+    return _tasks(request);
+  });
+}
+
+
+Future<Response> Master::Http::_tasks(const Request& request) const
 {
   // Get list options (limit and offset).
   Result<int> result = numify<int>(request.url.query.get("limit"));
@@ -1979,20 +2048,25 @@ Future<Response> Master::Http::tasks(const Request& request) const
     sort(tasks.begin(), tasks.end(), TaskComparator::descending);
   }
 
-  JSON::Object object;
+  // NOTE: The selected tasks are copied, as they can be removed
+  // (e.g., by completed frameworks being pruned) while streaming.
+  vector<Task> selected;
+  size_t end = std::min(offset + limit, tasks.size());
+  for (size_t i = offset; i < end; i++) {
+    selected.push_back(*tasks[i]);
+  }
 
-  {
-    JSON::Array array;
-    size_t end = std::min(offset + limit, tasks.size());
-    for (size_t i = offset; i < end; i++) {
-      const Task* task = tasks[i];
-      array.values.push_back(model(*task));
-    }
+  std::shared_ptr<ObjectStream> stream =
+    ObjectStream::create(request.url.query.get("jsonp"));
 
-    object.values["tasks"] = std::move(array);
-  }
+  stream->array(
+      "tasks",
+      selected,
+      [](const Task& task, JSON::ArrayWriter* writer) {
+        writer->element(task);
+      });
 
-  return OK(object, request.url.query.get("jsonp"));
+  return stream->start(master->self());
 }
 
 
@@ -61,6 +61,8 @@
 #include "master/registrar.hpp"
 #include "master/repairer.hpp"
 
+#include "master/allocator/trace.hpp"
+
 #include "master/allocator/mesos/hierarchical.hpp"
 
 #include "module/manager.hpp"
@@ -82,6 +84,8 @@ using namespace zookeeper;
 using mesos::Authorizer;
 using mesos::MasterInfo;
 
+using mesos::internal::master::allocator::TracingAllocator;
+
 using mesos::master::allocator::Allocator;
 
 using mesos::modules::Anonymous;
@@ -259,6 +263,19 @@ int main(int argc, char** argv)
   CHECK_NOTNULL(allocator.get());
   LOG(INFO) << "Using '" << allocatorName << "' allocator";
 
+  if (flags.allocator_trace.isSome()) {
+    allocator = TracingAllocator::create(
+        allocator.get(), flags.allocator_trace.get());
+
+    if (allocator.isError()) {
+      EXIT(EXIT_FAILURE)
+        << "Failed to record the allocator trace: " << allocator.error();
+    }
+
+    LOG(INFO) << "Recording the allocator trace to '"
+              << flags.allocator_trace.get() << "'";
+  }
+
   state::Storage* storage = NULL;
   Log* log = NULL;
 
@@ -305,14 +322,16 @@ int main(int argc, char** argv)
           flags.zk_session_timeout,
           path::join(url.get().path, "log_replicas"),
           url.get().authentication,
-          flags.log_auto_initialize);
+          flags.log_auto_initialize,
+          flags.log_async_io);
     } else {
       // Use replicated log without ZooKeeper.
       log = new Log(
           1,
           path::join(flags.work_dir.get(), "replicated_log"),
           set<UPID>(),
-          flags.log_auto_initialize);
+          flags.log_auto_initialize,
+          flags.log_async_io);
     }
     storage = new state::LogStorage(log);
   } else {
@@ -299,6 +299,7 @@ Master::Master(
     detector(_detector),
     authorizer(_authorizer),
     frameworks(flags),
+    offersBytes(0),
     authenticator(None()),
     metrics(new Metrics(*this)),
     electedTime(None())
@@ -688,6 +689,11 @@ void Master::initialize()
             << "for --offer_timeout: Must be greater than zero.";
   }
 
+  if (flags.allocation_shards == 0) {
+    EXIT(1) << "Invalid value '" << flags.allocation_shards << "' "
+            << "for --allocation_shards: Must be greater than zero.";
+  }
+
   // Initialize the allocator.
   allocator->initialize(
       flags.allocation_interval,
@@ -697,7 +703,10 @@ void Master::initialize()
       defer(self(), &Master::inverseOffer, lambda::_1, lambda::_2).operator lambda::function<
 	  void(const FrameworkID&,
 		  const hashmap<SlaveID, UnavailableResources>&)>(),
-      weights);
+      weights,
+      flags.allocation_shards,
+      flags.min_allocation_interval,
+      flags.agent_ordering);
 
   // Parse the whitelist. Passing Allocator::updateWhitelist()
   // callback is safe because we shut down the whitelistWatcher in
@@ -4436,6 +4445,9 @@ void Master::reregisterSlave(
     slave->pid = from;
     link(slave->pid);
 
+    // The URL in the offers changes with the pid.
+    slave->offerInfo = Shared<Offer>();
+
     // Reconcile tasks between master and the slave.
     // NOTE: This sends the re-registered message, including tasks
     // that need to be reconciled by the slave.
@@ -5238,6 +5250,11 @@ void Master::offer(const FrameworkID& frameworkId,
   // Create an offer for each slave and add it to the message.
   ResourceOffersMessage message;
 
+  // All of the offers expire at the same time, if at all.
+  const Time expiration = flags.offer_timeout.isSome()
+    ? Clock::now() + flags.offer_timeout.get()
+    : Time::max();
+
   Framework* framework = CHECK_NOTNULL(frameworks.registered[frameworkId]);
   foreachpair (const SlaveID& slaveId, const Resources& offered, resources) {
     if (!slaves.registered.contains(slaveId)) {
@@ -5291,22 +5308,30 @@ void Master::offer(const FrameworkID& frameworkId,
     // separate offers, so that rescinding offers with revocable
     // resources does not affect offers with regular resources.
 
-    // TODO(bmahler): Set "https" if only "https" is supported.
-    mesos::URL url;
-    url.set_scheme("http");
-    url.mutable_address()->set_hostname(slave->info.hostname());
-    url.mutable_address()->set_ip(stringify(slave->pid.address.ip));
-    url.mutable_address()->set_port(slave->pid.address.port);
-    url.set_path("/" + slave->pid.id);
+    // The URL and attributes of the slave are shared by all of the
+    // offers on the slave, see `Slave::offerInfo`.
+    if (slave->offerInfo.get() == NULL) {
+      // TODO(bmahler): Set "https" if only "https" is supported.
+      mesos::URL url;
+      url.set_scheme("http");
+      url.mutable_address()->set_hostname(slave->info.hostname());
+      url.mutable_address()->set_ip(stringify(slave->pid.address.ip));
+      url.mutable_address()->set_port(slave->pid.address.port);
+      url.set_path("/" + slave->pid.id);
+
+      Offer* offerInfo = new Offer();
+      offerInfo->mutable_url()->MergeFrom(url);
+      offerInfo->mutable_attributes()->MergeFrom(slave->info.attributes());
+
+      slave->offerInfo = Shared<Offer>(offerInfo);
+    }
 
     Offer* offer = new Offer();
     offer->mutable_id()->MergeFrom(newOfferId());
     offer->mutable_framework_id()->MergeFrom(framework->id());
     offer->mutable_slave_id()->MergeFrom(slave->id);
     offer->set_hostname(slave->info.hostname());
-    offer->mutable_url()->MergeFrom(url);
     offer->mutable_resources()->MergeFrom(offered);
-    offer->mutable_attributes()->MergeFrom(slave->info.attributes());
 
     // Add all framework's executors running on this slave.
     if (slave->executors.contains(framework->id())) {
@@ -5326,17 +5351,14 @@ void Master::offer(const FrameworkID& frameworkId,
     }
 
     offers[offer->id()] = offer;
+    offersBytes += offer->SpaceUsed();
 
     framework->addOffer(offer);
     slave->addOffer(offer);
 
     if (flags.offer_timeout.isSome()) {
       // Rescind the offer after the timeout elapses.
-      offerTimers[offer->id()] =
-        delay(flags.offer_timeout.get(),
-              self(),
-              &Self::offerTimeout,
-              offer->id());
+      offerExpirations[expiration].push_back(offer->id());
     }
 
     // TODO(jieyu): For now, we strip 'ephemeral_ports' resource from
@@ -5344,6 +5366,8 @@ void Master::offer(const FrameworkID& frameworkId,
     // short term workaround. Revisit this once we resolve MESOS-1654.
     Offer offer_ = *offer;
     offer_.clear_resources();
+    offer_.mutable_url()->CopyFrom(slave->offerInfo->url());
+    offer_.mutable_attributes()->CopyFrom(slave->offerInfo->attributes());
 
     foreach (const Resource& resource, offered) {
       if (resource.name() != "ephemeral_ports") {
@@ -5356,6 +5380,8 @@ void Master::offer(const FrameworkID& frameworkId,
     message.add_pids(slave->pid);
   }
 
+  scheduleOfferExpiration();
+
   if (message.offers().size() == 0) {
     return;
   }
@@ -6616,6 +6642,49 @@ void Master::offerTimeout(const OfferID& offerId)
 }
 
 
+void Master::expireOffers()
+{
+  offerExpirationTimer = None();
+
+  const Time now = Clock::now();
+
+  while (!offerExpirations.empty() &&
+         offerExpirations.begin()->first <= now) {
+    // NOTE: The offers that have already been removed are not found.
+    foreach (const OfferID& offerId, offerExpirations.begin()->second) {
+      offerTimeout(offerId);
+    }
+
+    offerExpirations.erase(offerExpirations.begin());
+  }
+
+  scheduleOfferExpiration();
+}
+
+
+void Master::scheduleOfferExpiration()
+{
+  if (offerExpirations.empty()) {
+    return;
+  }
+
+  const Time next = offerExpirations.begin()->first;
+
+  // Keep the current timer if it expires no later than the earliest
+  // bucket, `expireOffers()` reschedules it anyway.
+  if (offerExpirationTimer.isSome()) {
+    if (offerExpirationTimer.get().timeout().time() <= next) {
+      return;
+    }
+
+    Clock::cancel(offerExpirationTimer.get());
+  }
+
+  offerExpirationTimer =
+    delay(next - Clock::now(), self(), &Self::expireOffers);
+}
+
+
 // TODO(vinod): Instead of 'removeOffer()', consider implementing
 // 'useOffer()', 'discardOffer()' and 'rescindOffer()' for clarity.
 void Master::removeOffer(Offer* offer, bool rescind)
@@ -6643,14 +6712,11 @@ void Master::removeOffer(Offer* offer, bool rescind)
     framework->send(message);
   }
 
-  // Remove and cancel offer removal timers. Canceling the Timers is
-  // only done to avoid having too many active Timers in libprocess.
-  if (offerTimers.contains(offer->id())) {
-    Clock::cancel(offerTimers[offer->id()]);
-    offerTimers.erase(offer->id());
-  }
+  // NOTE: The offer is left in its expiration bucket (if any), it is
+  // skipped when the bucket expires.
 
   // Delete it.
+  offersBytes -= offer->SpaceUsed();
   offers.erase(offer->id());
   delete offer;
 }
@@ -20,6 +20,7 @@
 #include <stdint.h>
 
 #include <list>
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
@@ -45,6 +46,7 @@
 #include <process/owned.hpp>
 #include <process/process.hpp>
 #include <process/protobuf.hpp>
+#include <process/shared.hpp>
 #include <process/timer.hpp>
 
 #include <process/metrics/counter.hpp>
@@ -73,6 +75,7 @@
 #include "master/machine.hpp"
 #include "master/metrics.hpp"
 #include "master/registrar.hpp"
+#include "master/state_snapshot.hpp"
 #include "master/validation.hpp"
 
 #include "messages/messages.hpp"
@@ -333,6 +336,14 @@ struct Slave
   // Active offers on this slave.
   hashset<Offer*> offers;
 
+  // The parts of an offer that are the same for all offers on this
+  // slave (i.e., the URL and attributes of the slave). Rather than
+  // copying them into each outstanding offer, the offers share this
+  // block and it is only copied into the offers that are sent to the
+  // frameworks. Built by the first offer on the slave and reset when
+  // the slave's pid changes.
+  process::Shared<Offer> offerInfo;
+
   // Active inverse offers on this slave.
   hashset<InverseOffer*> inverseOffers;
 
@@ -813,6 +824,12 @@ protected:
   // Remove an offer after specified timeout
   void offerTimeout(const OfferID& offerId);
 
+  // Removes the offers whose timeout elapsed, see `offerExpirations`.
+  void expireOffers();
+
+  // Arms the timer for the earliest expiration bucket, if needed.
+  void scheduleOfferExpiration();
+
   // Remove an offer and optionally rescind the offer as well.
   void removeOffer(Offer* offer, bool rescind = false);
 
@@ -1023,7 +1040,8 @@ private:
   class Http
   {
   public:
-    explicit Http(Master* _master) : master(_master), quotaHandler(_master) {}
+    explicit Http(Master* _master);
+    ~Http();
 
     // Logs the request, route handlers can compose this with the
     // desired request handler to get consistent request logging.
@@ -1142,6 +1160,26 @@ private:
     static std::string QUOTA_HELP();
 
   private:
+    // Returns the response to a request for a read-only state endpoint,
+    // which is rendered by 'render', from the snapshots if enabled
+    // (see `StateSnapshotProcess`) and not bypassed with `fresh=true`.
+    process::Future<process::http::Response> snapshot(
+        const process::http::Request& request,
+        const StateSnapshotProcess::Render& render) const;
+
+    // Render the responses of the endpoints served from snapshots.
+    process::Future<process::http::Response> _roles(
+        const process::http::Request& request) const;
+
+    process::Future<process::http::Response> _state(
+        const process::http::Request& request) const;
+
+    process::Future<process::http::Response> _stateSummary(
+        const process::http::Request& request) const;
+
+    process::Future<process::http::Response> _tasks(
+        const process::http::Request& request) const;
+
     // Continuations.
     process::Future<process::http::Response> _teardown(
         const FrameworkID& id) const;
@@ -1175,6 +1213,10 @@ private:
     // NOTE: The quota specific pieces of the Operator API are factored
     // out into this separate class.
     QuotaHandler quotaHandler;
+
+    // NULL if `--max_state_staleness` is zero, i.e., the state
+    // endpoints are always served from the master's current state.
+    StateSnapshotProcess* snapshots;
   };
 
   Master(const Master&);              // No copying.
@@ -1376,7 +1418,20 @@ private:
   } frameworks;
 
   hashmap<OfferID, Offer*> offers;
-  hashmap<OfferID, process::Timer> offerTimers;
+
+  // The memory used by the outstanding offers, not including the
+  // parts they share with the other offers on the slave.
+  size_t offersBytes;
+
+  // The outstanding offers by the time when they expire, i.e., when
+  // `--offer_timeout` elapses. The offers that were made at the same
+  // time (e.g., all the offers of an allocation to a framework) share
+  // an expiration bucket, and there is only a single timer, for the
+  // earliest bucket, instead of a timer per offer. The offers that are
+  // removed before they expire are not removed from their bucket, but
+  // skipped when the bucket expires.
+  std::map<process::Time, std::vector<OfferID>> offerExpirations;
+  Option<process::Timer> offerExpirationTimer;
 
   hashmap<OfferID, InverseOffer*> inverseOffers;
   hashmap<OfferID, process::Timer> inverseOfferTimers;
@@ -1446,6 +1501,16 @@ private:
     return offers.size();
   }
 
+  double _outstanding_offers_bytes()
+  {
+    return offersBytes;
+  }
+
+  double _offer_expiration_buckets()
+  {
+    return offerExpirations.size();
+  }
+
   double _event_queue_messages()
   {
     return static_cast<double>(eventCount<process::MessageEvent>());
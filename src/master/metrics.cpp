@@ -71,6 +71,12 @@ Metrics::Metrics(const Master& master)
     outstanding_offers(
         "master/outstanding_offers",
         defer(master, &Master::_outstanding_offers)),
+    outstanding_offers_bytes(
+        "master/outstanding_offers_bytes",
+        defer(master, &Master::_outstanding_offers_bytes)),
+    offer_expiration_buckets(
+        "master/offer_expiration_buckets",
+        defer(master, &Master::_offer_expiration_buckets)),
     tasks_staging(
         "master/tasks_staging",
         defer(master, &Master::_tasks_staging)),
@@ -195,6 +201,8 @@ Metrics::Metrics(const Master& master)
   process::metrics::add(frameworks_inactive);
 
   process::metrics::add(outstanding_offers);
+  process::metrics::add(outstanding_offers_bytes);
+  process::metrics::add(offer_expiration_buckets);
 
   process::metrics::add(tasks_staging);
   process::metrics::add(tasks_starting);
@@ -331,6 +339,8 @@ Metrics::~Metrics()
   process::metrics::remove(frameworks_inactive);
 
   process::metrics::remove(outstanding_offers);
+  process::metrics::remove(outstanding_offers_bytes);
+  process::metrics::remove(offer_expiration_buckets);
 
   process::metrics::remove(tasks_staging);
   process::metrics::remove(tasks_starting);
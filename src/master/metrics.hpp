@@ -55,6 +55,8 @@ struct Metrics
   process::metrics::Gauge frameworks_inactive;
 
   process::metrics::Gauge outstanding_offers;
+  process::metrics::Gauge outstanding_offers_bytes;
+  process::metrics::Gauge offer_expiration_buckets;
 
   // Task state metrics.
   process::metrics::Gauge tasks_staging;
@@ -15,10 +15,14 @@
 // limitations under the License.
 
 #include <deque>
+#include <list>
+#include <map>
+#include <set>
 #include <string>
 
 #include <mesos/type_utils.hpp>
 
+#include <process/collect.hpp>
 #include <process/defer.hpp>
 #include <process/dispatch.hpp>
 #include <process/future.hpp>
@@ -32,12 +36,16 @@
 #include <process/metrics/metrics.hpp>
 #include <process/metrics/timer.hpp>
 
+#include <stout/bytes.hpp>
 #include <stout/lambda.hpp>
+#include <stout/linkedhashmap.hpp>
 #include <stout/none.hpp>
 #include <stout/nothing.hpp>
+#include <stout/numify.hpp>
 #include <stout/option.hpp>
 #include <stout/protobuf.hpp>
 #include <stout/stopwatch.hpp>
+#include <stout/strings.hpp>
 
 #include "master/registrar.hpp"
 #include "master/registry.hpp"
@@ -68,6 +76,7 @@ using process::metrics::Gauge;
 using process::metrics::Timer;
 
 using std::deque;
+using std::list;
 using std::string;
 
 namespace mesos {
@@ -84,6 +93,7 @@ public:
     : ProcessBase(process::ID::generate("registrar")),
       metrics(*this),
       updating(false),
+      nextDelta(1),
       flags(_flags),
       state(_state) {}
 
@@ -169,33 +179,65 @@ private:
 
   Future<double> _registry_size_bytes()
   {
-    if (variable.isSome()) {
-      return variable.get().get().ByteSize();
+    if (current.isSome()) {
+      return current.get().ByteSize();
     }
 
     return Failure("Not recovered yet");
   }
 
+  // What is fetched from the state when recovering: the last snapshot
+  // of the registry and the deltas stored since, in order.
+  struct Recovery
+  {
+    Variable<Registry> snapshot;
+    list<Variable<RegistryDelta>> deltas;
+    uint64_t nextDelta;
+  };
+
   // Continuations.
   void _recover(
       const MasterInfo& info,
-      const Future<Variable<Registry> >& recovery);
+      const Future<Recovery>& recovery);
   void __recover(const Future<bool>& recover);
   Future<bool> _apply(Owned<Operation> operation);
 
   // Helper for updating state (performing store).
   void update();
   void _update(
-      const Future<Option<Variable<Registry> > >& store,
+      const Future<bool>& store,
+      const Registry& registry,
       deque<Owned<Operation> > operations);
 
+  // Stores the registry as a snapshot or the change to it as a delta,
+  // returning false if the version of the snapshot was no longer valid.
+  Future<bool> storeSnapshot(const Registry& registry);
+  Future<bool> storeDelta(const RegistryDelta& delta);
+
+  // Expunges the deltas, which are included in a stored snapshot. The
+  // deltas are expunged one at a time, in order, so that the remaining
+  // ones are always the latest and can be safely replayed on top of the
+  // snapshot (again) upon recovery.
+  void expunge(deque<Variable<RegistryDelta>> deltas);
+
   // Fails all pending operations and transitions the Registrar
   // into an error state in which all subsequent operations will fail.
   // This ensures we don't attempt to re-acquire log leadership by
   // performing more State storage operations.
   void abort(const string& message);
 
+  // The last stored snapshot of the registry.
   Option<Variable<Registry> > variable;
+
+  // The deltas stored since the snapshot, in order.
+  deque<Variable<RegistryDelta>> deltas;
+
+  // The sequence number of the next delta stored, see `deltaName()`.
+  uint64_t nextDelta;
+
+  // The current registry, i.e., the snapshot with the deltas applied.
+  Option<Registry> current;
+
   deque<Owned<Operation> > operations;
   bool updating; // Used to signify fetching (recovering) or storing.
 
@@ -225,6 +267,140 @@ Future<T> timeout(
 }
 
 
+// The name of the variable the registry snapshot is stored in.
+static const string SNAPSHOT = "registry";
+
+
+// The deltas are stored in variables named by their sequence number,
+// e.g., "registry.delta.1".
+static const string DELTA_PREFIX = "registry.delta.";
+
+
+static string deltaName(uint64_t sequence)
+{
+  return DELTA_PREFIX + stringify(sequence);
+}
+
+
+// Returns the registry without its slaves, i.e., the part of the
+// registry that a delta holds whole if it changed.
+//
+// NOTE: The slaves are swapped out (and back in) to avoid copying
+// them, which is why this takes a mutable registry.
+static Registry withoutSlaves(Registry* registry)
+{
+  const bool hasSlaves = registry->has_slaves();
+
+  Registry::Slaves slaves;
+  slaves.Swap(registry->mutable_slaves());
+
+  Registry result = *registry;
+  result.clear_slaves();
+
+  registry->mutable_slaves()->Swap(&slaves);
+
+  if (!hasSlaves) {
+    registry->clear_slaves();
+  }
+
+  return result;
+}
+
+
+// Returns the change from the registry 'from' to the registry 'to'.
+//
+// NOTE: This assumes that slaves are only ever admitted to or removed
+// from the registry, never updated in place, which is the case for
+// all of the operations.
+static RegistryDelta diff(Registry* from, Registry* to)
+{
+  RegistryDelta delta;
+
+  hashset<SlaveID> fromIDs;
+  foreach (const Registry::Slave& slave, from->slaves().slaves()) {
+    fromIDs.insert(slave.info().id());
+  }
+
+  hashset<SlaveID> toIDs;
+  foreach (const Registry::Slave& slave, to->slaves().slaves()) {
+    toIDs.insert(slave.info().id());
+
+    if (!fromIDs.contains(slave.info().id())) {
+      delta.add_added_slaves()->CopyFrom(slave);
+    }
+  }
+
+  foreach (const SlaveID& slaveId, fromIDs) {
+    if (!toIDs.contains(slaveId)) {
+      delta.add_removed_slaves()->CopyFrom(slaveId);
+    }
+  }
+
+  const Registry rest = withoutSlaves(to);
+  if (withoutSlaves(from).SerializeAsString() != rest.SerializeAsString()) {
+    delta.mutable_registry()->CopyFrom(rest);
+  }
+
+  return delta;
+}
+
+
+// Applies the deltas to the registry, in order. A slave is admitted
+// (or removed) unless it already is, so replaying deltas that are
+// already included in the registry (as long as they are followed by
+// all of the later deltas) leaves it unchanged.
+static void replay(
+    Registry* registry,
+    const list<Variable<RegistryDelta>>& deltas)
+{
+  // The last change to each slave, i.e., whether it was admitted
+  // (with its info) or removed (none), in the order they were made.
+  LinkedHashMap<SlaveID, Option<Registry::Slave>> changes;
+
+  foreach (const Variable<RegistryDelta>& variable, deltas) {
+    const RegistryDelta delta = variable.get();
+
+    foreach (const SlaveID& slaveId, delta.removed_slaves()) {
+      changes.erase(slaveId);
+      changes[slaveId] = None();
+    }
+
+    foreach (const Registry::Slave& slave, delta.added_slaves()) {
+      changes.erase(slave.info().id());
+      changes[slave.info().id()] = slave;
+    }
+
+    if (delta.has_registry()) {
+      Registry::Slaves slaves;
+      slaves.Swap(registry->mutable_slaves());
+
+      registry->CopyFrom(delta.registry());
+      registry->mutable_slaves()->Swap(&slaves);
+    }
+  }
+
+  if (changes.empty()) {
+    return;
+  }
+
+  Registry::Slaves slaves;
+
+  foreach (const Registry::Slave& slave, registry->slaves().slaves()) {
+    if (!changes.contains(slave.info().id())) {
+      slaves.add_slaves()->CopyFrom(slave);
+    }
+  }
+
+  foreach (const Option<Registry::Slave>& slave, changes.values()) {
+    if (slave.isSome()) {
+      slaves.add_slaves()->CopyFrom(slave.get());
+    }
+  }
+
+  registry->mutable_slaves()->Swap(&slaves);
+}
+
+
 // Helper for failing a deque of operations.
 void fail(deque<Owned<Operation>>* operations, const string& message)
 {
@@ -239,8 +415,8 @@ Future<Response> RegistrarProcess::registry(const Request& request)
 {
   JSON::Object result;
 
-  if (variable.isSome()) {
-    result = JSON::protobuf(variable.get().get());
+  if (current.isSome()) {
+    result = JSON::protobuf(current.get());
   }
 
   return OK(result, request.url.query.get("jsonp"));
@@ -306,11 +482,49 @@ Future<Registry> RegistrarProcess::recover(const MasterInfo& info)
   if (recovered.isNone()) {
     LOG(INFO) << "Recovering registrar";
 
+    State* state = this->state;
+
+    // Fetch the snapshot, and then the deltas stored since, which
+    // are ordered by their sequence numbers.
     metrics.state_fetch.start();
-    state->fetch<Registry>("registry")
+    state->fetch<Registry>(SNAPSHOT)
+      .then([state](const Variable<Registry>& snapshot) {
+        return state->names()
+          .then([state, snapshot](const std::set<string>& names) {
+            std::map<uint64_t, string> sequences;
+            foreach (const string& name, names) {
+              if (strings::startsWith(name, DELTA_PREFIX)) {
+                Try<uint64_t> sequence =
+                  numify<uint64_t>(name.substr(DELTA_PREFIX.size()));
+
+                if (sequence.isError()) {
+                  return Future<Recovery>(Failure(
+                      "Failed to parse the sequence number of delta '" +
+                      name + "': " + sequence.error()));
+                }
+
+                sequences[sequence.get()] = name;
+              }
+            }
+
+            const uint64_t nextDelta =
+              sequences.empty() ? 1 : sequences.rbegin()->first + 1;
+
+            list<Future<Variable<RegistryDelta>>> deltas;
+            foreachvalue (const string& name, sequences) {
+              deltas.push_back(state->fetch<RegistryDelta>(name));
+            }
+
+            return process::collect(deltas)
+              .then([snapshot, nextDelta](
+                  const list<Variable<RegistryDelta>>& deltas) {
+                return Recovery{snapshot, deltas, nextDelta};
+              });
+          });
+      })
       .after(flags.registry_fetch_timeout,
              lambda::bind(
-                 &timeout<Variable<Registry> >,
+                 &timeout<Recovery>,
                  "fetch",
                  flags.registry_fetch_timeout,
                  lambda::_1))
@@ -325,7 +539,7 @@ Future<Registry> RegistrarProcess::recover(const MasterInfo& info)
 
 void RegistrarProcess::_recover(
     const MasterInfo& info,
-    const Future<Variable<Registry> >& recovery)
+    const Future<Recovery>& recovery)
 {
   updating = false;
 
@@ -337,12 +551,25 @@ void RegistrarProcess::_recover(
   } else {
     Duration elapsed = metrics.state_fetch.stop();
 
+    const Variable<Registry>& snapshot = recovery.get().snapshot;
+
     LOG(INFO) << "Successfully fetched the registry"
-              << " (" << Bytes(recovery.get().get().ByteSize()) << ")"
+              << " (" << Bytes(snapshot.get().ByteSize()) << ")"
+              << " and " << recovery.get().deltas.size() << " deltas"
               << " in " << elapsed;
 
     // Save the registry.
-    variable = recovery.get();
+    variable = snapshot;
+
+    Registry registry = snapshot.get();
+    replay(&registry, recovery.get().deltas);
+    current = registry;
+
+    deltas = deque<Variable<RegistryDelta>>(
+        recovery.get().deltas.begin(),
+        recovery.get().deltas.end());
+
+    nextDelta = recovery.get().nextDelta;
 
     // Perform the Recover operation to add the new MasterInfo.
     Owned<Operation> operation(new Recover(info));
@@ -369,11 +596,11 @@ void RegistrarProcess::__recover(const Future<bool>& recover)
   } else {
     LOG(INFO) << "Successfully recovered registrar";
 
-    // At this point _update() has updated 'variable' to contain
+    // At this point _update() has updated 'current' to contain
     // the Registry with the latest MasterInfo.
     // Set the promise and un-gate any pending operations.
-    CHECK_SOME(variable);
-    recovered.get()->set(variable.get().get());
+    CHECK_SOME(current);
+    recovered.get()->set(current.get());
   }
 }
 
@@ -415,6 +642,7 @@ void RegistrarProcess::update()
   CHECK(!updating);
   CHECK_NONE(error);
   CHECK_SOME(variable);
+  CHECK_SOME(current);
 
   // Time how long it takes to apply the operations.
   Stopwatch stopwatch;
@@ -423,7 +651,7 @@ void RegistrarProcess::update()
   updating = true;
 
   // Create a snapshot of the current registry.
-  Registry registry = variable.get().get();
+  Registry registry = current.get();
 
   // Create the 'slaveIDs' accumulator.
   hashset<SlaveID> slaveIDs;
@@ -436,33 +664,116 @@ void RegistrarProcess::update()
     (*operation)(&registry, &slaveIDs, flags.registry_strict);
   }
 
-  LOG(INFO) << "Applied " << operations.size() << " operations in "
-            << stopwatch.elapsed() << "; attempting to update the 'registry'";
+  // Store a snapshot of the whole registry once there are as many
+  // deltas as allowed, and a delta otherwise.
+  Future<bool> store;
+
+  if (deltas.size() >= flags.registry_max_deltas) {
+    LOG(INFO) << "Applied " << operations.size() << " operations in "
+              << stopwatch.elapsed()
+              << "; attempting to update the 'registry'";
+
+    metrics.state_store.start();
+    store = storeSnapshot(registry);
+  } else {
+    const RegistryDelta delta = diff(&current.get(), &registry);
+
+    LOG(INFO) << "Applied " << operations.size() << " operations in "
+              << stopwatch.elapsed() << "; attempting to store a delta ("
+              << Bytes(delta.ByteSize()) << ") of the 'registry'";
+
+    metrics.state_store.start();
+    store = storeDelta(delta);
+  }
 
   // Perform the store, and time the operation.
-  metrics.state_store.start();
-  state->store(variable.get().mutate(registry))
+  store
     .after(flags.registry_store_timeout,
            lambda::bind(
-               &timeout<Option<Variable<Registry> > >,
+               &timeout<bool>,
                "store",
                flags.registry_store_timeout,
                lambda::_1))
-    .onAny(defer(self(), &Self::_update, lambda::_1, operations));
+    .onAny(defer(self(), &Self::_update, lambda::_1, registry, operations));
 
   // Clear the operations, _update will transition the Promises!
   operations.clear();
 }
 
 
+Future<bool> RegistrarProcess::storeSnapshot(const Registry& registry)
+{
+  return state->store(variable.get().mutate(registry))
+    .then(defer(self(), [this](const Option<Variable<Registry>>& snapshot) {
+      if (snapshot.isNone()) {
+        return false;
+      }
+
+      variable = snapshot.get();
+
+      // The deltas are now included in the snapshot.
+      expunge(deltas);
+      deltas.clear();
+
+      return true;
+    }));
+}
+
+
+Future<bool> RegistrarProcess::storeDelta(const RegistryDelta& delta)
+{
+  State* state = this->state;
+
+  // NOTE: The delta is stored in a new variable, so the store can only
+  // fail due to an error (i.e., not due to a version mismatch).
+  return state->fetch<RegistryDelta>(deltaName(nextDelta++))
+    .then([state, delta](const Variable<RegistryDelta>& variable) {
+      return state->store(variable.mutate(delta));
+    })
+    .then(defer(self(), [this](const Option<Variable<RegistryDelta>>& delta) {
+      if (delta.isNone()) {
+        return false;
+      }
+
+      deltas.push_back(delta.get());
+
+      return true;
+    }));
+}
+
+
+void RegistrarProcess::expunge(deque<Variable<RegistryDelta>> deltas)
+{
+  if (deltas.empty()) {
+    return;
+  }
+
+  state->expunge(deltas.front())
+    .onAny(defer(self(), [this, deltas](const Future<bool>& expunge) {
+      if (!expunge.isReady() || !expunge.get()) {
+        // The remaining deltas are replayed upon recovery, and expunged
+        // after the next snapshot is stored.
+        LOG(WARNING) << "Failed to expunge a delta of the 'registry': "
+                     << (expunge.isFailed() ? expunge.failure() :
+                         expunge.isDiscarded() ? "discarded" : "not found");
+        return;
+      }
+
+      this->expunge(deque<Variable<RegistryDelta>>(
+          deltas.begin() + 1, deltas.end()));
+    }));
+}
+
+
 void RegistrarProcess::_update(
-    const Future<Option<Variable<Registry> > >& store,
+    const Future<bool>& store,
+    const Registry& registry,
     deque<Owned<Operation> > applied)
 {
   updating = false;
 
   // Abort if the storage operation did not succeed.
-  if (!store.isReady() || store.get().isNone()) {
+  if (!store.isReady() || !store.get()) {
     string message = "Failed to update 'registry': ";
 
     if (store.isFailed()) {
@@ -483,7 +794,7 @@ void RegistrarProcess::_update(
 
   LOG(INFO) << "Successfully updated the 'registry' in " << elapsed;
 
-  variable = store.get().get();
+  current = registry;
 
   // Remove the operations.
   while (!applied.empty()) {
@@ -0,0 +1,182 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include <process/clock.hpp>
+#include <process/dispatch.hpp>
+#include <process/id.hpp>
+
+#include <stout/foreach.hpp>
+#include <stout/stringify.hpp>
+
+#include "master/state_snapshot.hpp"
+
+using process::Clock;
+using process::Future;
+using process::Time;
+using process::UPID;
+
+using process::http::OK;
+using process::http::Pipe;
+using process::http::Request;
+using process::http::Response;
+
+using std::string;
+
+namespace mesos {
+namespace internal {
+namespace master {
+
+// Returns the response once its body is read, if it is streamed
+// through a pipe, so that it can be served more than once.
+static Future<Response> read(const Response& response);
+
+
+static Future<string> _read(
+    Pipe::Reader reader,
+    const std::shared_ptr<string>& body,
+    const string& data);
+
+
+static Response __read(const Response& response, const string& body);
+
+
+StateSnapshotProcess::StateSnapshotProcess(
+    const UPID& _master,
+    const Duration& _maxStaleness)
+  : ProcessBase(process::ID::generate("state-snapshot")),
+    master(_master),
+    maxStaleness(_maxStaleness) {}
+
+
+Future<Response> StateSnapshotProcess::get(
+    const Request& request,
+    const Render& render)
+{
+  const Option<string> jsonp = request.url.query.get("jsonp");
+
+  Request snapshotRequest = request;
+  snapshotRequest.url.query.erase("jsonp");
+
+  // NOTE: The query is sorted so that the order of its parameters
+  // doesn't matter.
+  const std::map<string, string> query(
+      snapshotRequest.url.query.begin(),
+      snapshotRequest.url.query.end());
+
+  string key = request.url.path;
+  foreachpair (const string& name, const string& value, query) {
+    key += "&" + name + "=" + value;
+  }
+
+  const Time now = Clock::now();
+
+  // Remove the stale (and failed) snapshots, so that the snapshots of
+  // queries that are no longer requested don't accumulate.
+  hashmap<string, Snapshot>::iterator it = snapshots.begin();
+  while (it != snapshots.end()) {
+    const Snapshot& snapshot = it->second;
+
+    if (!snapshot.response.isPending() &&
+        (!snapshot.response.isReady() || now - snapshot.time > maxStaleness)) {
+      it = snapshots.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  if (!snapshots.contains(key)) {
+    VLOG(2) << "Taking a snapshot for '" << key << "'";
+
+    Snapshot snapshot;
+    snapshot.time = now;
+    snapshot.response = process::dispatch(
+        master,
+        std::function<Future<Response>()>([=]() {
+          return render(snapshotRequest);
+        }))
+      .then(&read);
+
+    snapshots[key] = snapshot;
+  }
+
+  return snapshots[key].response
+    .then([jsonp](const Response& response) -> Response {
+      if (jsonp.isNone() || response.status != OK().status) {
+        return response;
+      }
+
+      // Wrap the body for JSONP, as `OK()` does.
+      Response result = response;
+      result.body = jsonp.get() + "(" + response.body + ");";
+      result.headers["Content-Type"] = "text/javascript";
+      result.headers["Content-Length"] = stringify(result.body.size());
+
+      return result;
+    });
+}
+
+
+static Future<Response> read(const Response& response)
+{
+  if (response.type != Response::PIPE) {
+    return response;
+  }
+
+  CHECK_SOME(response.reader);
+
+  Pipe::Reader reader = response.reader.get();
+  std::shared_ptr<string> body(new string());
+
+  return reader.read()
+    .then(lambda::bind(&_read, reader, body, lambda::_1))
+    .then(lambda::bind(&__read, response, lambda::_1));
+}
+
+
+static Future<string> _read(
+    Pipe::Reader reader,
+    const std::shared_ptr<string>& body,
+    const string& data)
+{
+  if (data.empty()) { // EOF.
+    return *body;
+  }
+
+  body->append(data);
+
+  return reader.read()
+    .then(lambda::bind(&_read, reader, body, lambda::_1));
+}
+
+
+static Response __read(const Response& response, const string& body)
+{
+  Response result = response;
+  result.type = Response::BODY;
+  result.body = body;
+  result.reader = None();
+  result.headers["Content-Length"] = stringify(body.size());
+
+  return result;
+}
+
+} // namespace master {
+} // namespace internal {
+} // namespace mesos {
@@ -0,0 +1,88 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __MASTER_STATE_SNAPSHOT_HPP__
+#define __MASTER_STATE_SNAPSHOT_HPP__
+
+#include <string>
+
+#include <process/future.hpp>
+#include <process/http.hpp>
+#include <process/pid.hpp>
+#include <process/process.hpp>
+#include <process/time.hpp>
+
+#include <stout/duration.hpp>
+#include <stout/hashmap.hpp>
+#include <stout/lambda.hpp>
+
+namespace mesos {
+namespace internal {
+namespace master {
+
+// Serves the master's read-only state endpoints (e.g., `/state`) from
+// snapshots of their responses, so that clients polling them (e.g.,
+// dashboards) don't have the master render a response for each of
+// their requests, competing with the schedulers and agents.
+//
+// A snapshot is taken, i.e., the endpoint's response is rendered on
+// the master, when a request arrives and the last snapshot is older
+// than the maximum staleness. Requests arriving while a snapshot is
+// being taken wait for (and share) it. Snapshots are immutable and
+// served from this process, so the master is only involved in taking
+// them. They are taken per endpoint and query (e.g., `/tasks?limit=10`
+// and `/tasks?limit=20` are separate snapshots), except for the `jsonp`
+// parameter, which is applied when responding.
+class StateSnapshotProcess : public process::Process<StateSnapshotProcess>
+{
+public:
+  // Renders the response of an endpoint from the master's state.
+  typedef lambda::function<process::Future<process::http::Response>(
+      const process::http::Request&)> Render;
+
+  StateSnapshotProcess(
+      const process::UPID& master,
+      const Duration& maxStaleness);
+
+  // Returns the response to the request from a snapshot that is at
+  // most `maxStaleness` old, taking a new one by running 'render' on
+  // the master if there is none.
+  process::Future<process::http::Response> get(
+      const process::http::Request& request,
+      const Render& render);
+
+private:
+  struct Snapshot
+  {
+    process::Time time; // When the snapshot was taken.
+
+    // The response (with the body read from its pipe, if the endpoint
+    // is streamed) to the request without the `jsonp` parameter.
+    process::Future<process::http::Response> response;
+  };
+
+  const process::UPID master;
+  const Duration maxStaleness;
+
+  // Keyed by the path and (sorted) query of the requests.
+  hashmap<std::string, Snapshot> snapshots;
+};
+
+} // namespace master {
+} // namespace internal {
+} // namespace mesos {
+
+#endif // __MASTER_STATE_SNAPSHOT_HPP__
@@ -21,13 +21,17 @@
 #include <list>
 #include <set>
 #include <string>
+#include <vector>
 
+#include <process/collect.hpp>
 #include <process/defer.hpp>
 #include <process/dispatch.hpp>
 #include <process/future.hpp>
 #include <process/mutex.hpp>
 #include <process/process.hpp>
 
+#include <process/metrics/counter.hpp>
+#include <process/metrics/gauge.hpp>
 #include <process/metrics/metrics.hpp>
 #include <process/metrics/timer.hpp>
 
@@ -52,6 +56,7 @@ using namespace process;
 // 'std::' to disambiguate the 'set' member.
 using std::list;
 using std::string;
+using std::vector;
 
 namespace mesos {
 namespace internal {
@@ -63,8 +68,10 @@ namespace state {
 //
 // All operations are gated by 'start()' which makes sure that a
 // Log::Writer has been started and all positions in the log have been
-// read and cached in memory. All reads are performed by this cache
-// (for now). If the Log::Writer gets demoted (i.e., because another
+// read. Only an index of where each state entry is in the log is kept
+// in memory; the entries themselves are read back from the log when
+// needed, and the most recently used ones are cached (up to a total
+// size). If the Log::Writer gets demoted (i.e., because another
 // writer started) then the current operation will return false
 // implying the operation was not atomic and subsequent operations
 // will re-'start()' which will again read all positions to make sure
@@ -76,7 +83,10 @@ namespace state {
 class LogStorageProcess : public Process<LogStorageProcess>
 {
 public:
-  LogStorageProcess(Log* log, size_t diffsBetweenSnapshots);
+  LogStorageProcess(
+      Log* log,
+      size_t diffsBetweenSnapshots,
+      const Bytes& cacheSize);
 
   virtual ~LogStorageProcess();
 
@@ -99,6 +109,17 @@ private:
   // Helper for applying log entries.
   Future<Nothing> apply(const list<Log::Entry>& entries);
 
+  // Forward declaration.
+  struct Snapshot;
+
+  // Helper for getting the entry of a snapshot, either from the
+  // cache or by reading the snapshot and its diffs from the log.
+  Future<state::Entry> fetch(const string& name, const Snapshot& snapshot);
+  Future<state::Entry> _fetch(
+      const string& name,
+      const Snapshot& snapshot,
+      const list<list<Log::Entry>>& entries);
+
   // Helper for performing truncation.
   void truncate();
   Future<Nothing> _truncate();
@@ -108,14 +129,25 @@ private:
 
   // Continuations.
   Future<Option<state::Entry> > _get(const string& name);
+  Future<Option<state::Entry> > __get(
+      const string& name,
+      const string& uuid,
+      const Future<Option<state::Entry>>& future);
 
   Future<bool> _set(const state::Entry& entry, const UUID& uuid);
   Future<bool> __set(const state::Entry& entry, const UUID& uuid);
   Future<bool> ___set(
       const state::Entry& entry,
-      size_t diff,
+      bool diff,
       Option<Log::Position> position);
 
+  // Helpers for appending an entry to the log, either as a diff of
+  // the previous entry (if that is smaller) or as a full snapshot.
+  Future<bool> appendDiff(
+      const state::Entry& entry,
+      const state::Entry& previous);
+  Future<bool> appendSnapshot(const state::Entry& entry);
+
   Future<bool> _expunge(const state::Entry& entry);
   Future<bool> __expunge(const state::Entry& entry);
   Future<bool> ___expunge(
@@ -124,6 +156,10 @@ private:
 
   Future<std::set<string> > _names();
 
+  // Metrics.
+  double _cache_entries() { return cache.size(); }
+  double _cache_size_bytes() { return cache.bytes().bytes(); }
+
   Log::Reader reader;
   Log::Writer writer;
 
@@ -145,79 +181,148 @@ private:
   // modified to include a required field called 'position' we don't
   // know the position (nor can we determine it) before we've done the
   // actual appending of the data.
+  //
+  // A snapshot only holds where the entry is in the log (and its
+  // version), not the entry itself, so that the memory used by the
+  // snapshots stays small regardless of the size of the entries.
   struct Snapshot
   {
-    Snapshot(const Log::Position& position,
-             const state::Entry& entry,
-             size_t diffs = 0)
+    Snapshot(const Log::Position& position, const string& uuid)
       : position(position),
-        entry(entry),
-        diffs(diffs) {}
+        uuid(uuid) {}
+
+    // Position in the log where this snapshot is located.
+    Log::Position position;
 
-    // Returns a snapshot after having applied the specified diff.
-    Try<Snapshot> patch(const Operation::Diff& diff) const
+    // The UUID of the entry, i.e., after applying the diffs.
+    string uuid;
+
+    // Positions in the log of the Operation::DIFFs that need to be
+    // applied (in order) to the snapshot to get the entry. If the
+    // entry is represented by the snapshot alone this is empty.
+    vector<Log::Position> diffs;
+  };
+
+  // All known snapshots indexed by name. Note that 'hashmap::get'
+  // must be used instead of 'operator[]' since Snapshot doesn't have
+  // a default/empty constructor.
+  hashmap<string, Snapshot> snapshots;
+
+  // A least-recently used cache of entries (i.e., including their
+  // values) indexed by name, bounded by the total size of the
+  // entries. An entry that is larger than the cache is not cached.
+  class Cache
+  {
+  public:
+    explicit Cache(const Bytes& _capacity) : capacity(_capacity) {}
+
+    Option<state::Entry> get(const string& name)
     {
-      if (diff.entry().name() != entry.name()) {
-        return Error("Attempted to patch the wrong snapshot");
+      Option<list<state::Entry>::iterator> entry = index.get(name);
+
+      if (entry.isNone()) {
+        return None();
       }
 
-      Try<string> patch = svn::patch(
-          entry.value(),
-          svn::Diff(diff.entry().value()));
+      // Move the entry to the back (i.e., the most recently used).
+      entries.splice(entries.end(), entries, entry.get());
+
+      return *entry.get();
+    }
+
+    void put(const state::Entry& entry)
+    {
+      erase(entry.name());
+
+      const Bytes size(entry.ByteSize());
 
-      if (patch.isError()) {
-        return Error(patch.error());
+      if (size > capacity) {
+        return;
       }
 
-      Entry entry(diff.entry());
-      entry.set_value(patch.get());
+      index.put(entry.name(), entries.insert(entries.end(), entry));
+      total += size;
 
-      return Snapshot(position, entry, diffs + 1);
+      // Evict the least recently used entries.
+      while (total > capacity) {
+        erase(entries.front().name());
+      }
     }
 
-    // Position in the log where this snapshot is located. NOTE: if
-    // 'diffs' is greater than 0 this still represents the location of
-    // the snapshot, not the last DIFF record in the log.
-    const Log::Position position;
+    void erase(const string& name)
+    {
+      Option<list<state::Entry>::iterator> entry = index.get(name);
 
-    // TODO(benh): Rather than storing the entire state::Entry we
-    // should just store the position, name, and UUID and cache the
-    // data so we don't use too much memory.
-    const state::Entry entry;
+      if (entry.isSome()) {
+        total -= Bytes(entry.get()->ByteSize());
+        entries.erase(entry.get());
+        index.erase(name);
+      }
+    }
 
-    // This value represents the number of Operation::DIFFs in the
-    // underlying log that make up this "snapshot". If this snapshot
-    // is actually represented in the log this value is 0.
-    const size_t diffs;
-  };
+    size_t size() const { return entries.size(); }
+    Bytes bytes() const { return total; }
 
-  // All known snapshots indexed by name. Note that 'hashmap::get'
-  // must be used instead of 'operator[]' since Snapshot doesn't have
-  // a default/empty constructor.
-  hashmap<string, Snapshot> snapshots;
+  private:
+    const Bytes capacity;
+
+    // Total size of the cached entries.
+    Bytes total;
+
+    // Entries ordered from the least to the most recently used.
+    list<state::Entry> entries;
+    hashmap<string, list<state::Entry>::iterator> index;
+  } cache;
 
   struct Metrics
   {
-    Metrics()
-      : diff("log_storage/diff")
+    explicit Metrics(const LogStorageProcess& process)
+      : diff("log_storage/diff"),
+        cache_hits("log_storage/cache_hits"),
+        cache_misses("log_storage/cache_misses"),
+        cache_entries(
+            "log_storage/cache_entries",
+            defer(process, &LogStorageProcess::_cache_entries)),
+        cache_size_bytes(
+            "log_storage/cache_size_bytes",
+            defer(process, &LogStorageProcess::_cache_size_bytes))
     {
       process::metrics::add(diff);
+      process::metrics::add(cache_hits);
+      process::metrics::add(cache_misses);
+      process::metrics::add(cache_entries);
+      process::metrics::add(cache_size_bytes);
     }
 
     ~Metrics()
     {
       process::metrics::remove(diff);
+      process::metrics::remove(cache_hits);
+      process::metrics::remove(cache_misses);
+      process::metrics::remove(cache_entries);
+      process::metrics::remove(cache_size_bytes);
     }
 
     process::metrics::Timer<Milliseconds> diff;
+
+    process::metrics::Counter cache_hits;
+    process::metrics::Counter cache_misses;
+
+    process::metrics::Gauge cache_entries;
+    process::metrics::Gauge cache_size_bytes;
   } metrics;
 };
 
 
-LogStorageProcess::LogStorageProcess(Log* log, size_t diffsBetweenSnapshots)
+LogStorageProcess::LogStorageProcess(
+    Log* log,
+    size_t diffsBetweenSnapshots,
+    const Bytes& cacheSize)
   : reader(log),
     writer(log),
-    diffsBetweenSnapshots(diffsBetweenSnapshots) {}
+    diffsBetweenSnapshots(diffsBetweenSnapshots),
+    cache(cacheSize),
+    metrics(*this) {}
 
 
 LogStorageProcess::~LogStorageProcess() {}
@@ -298,6 +403,23 @@ Future<Nothing> LogStorageProcess::__start(
 }
 
 
+// Parses the Operation from a Log::Entry.
+static Try<Operation> parse(const Log::Entry& entry)
+{
+  Operation operation;
+
+  google::protobuf::io::ArrayInputStream stream(
+      entry.data.data(),
+      entry.data.size());
+
+  if (!operation.ParseFromZeroCopyStream(&stream)) {
+    return Error("Failed to deserialize Operation");
+  }
+
+  return operation;
+}
+
+
 Future<Nothing> LogStorageProcess::apply(const list<Log::Entry>& entries)
 {
   VLOG(2) << "Applying operations (" << entries.size() << " entries)";
@@ -305,54 +427,54 @@ Future<Nothing> LogStorageProcess::apply(const list<Log::Entry>& entries)
   // Only read and apply entries past our index.
   foreach (const Log::Entry& entry, entries) {
     if (index.isNone() || index.get() < entry.position) {
-      // Parse the Operation from the Log::Entry.
-      Operation operation;
-
-      google::protobuf::io::ArrayInputStream stream(
-          entry.data.data(),
-          entry.data.size());
+      Try<Operation> operation = parse(entry);
 
-      if (!operation.ParseFromZeroCopyStream(&stream)) {
-        return Failure("Failed to deserialize Operation");
+      if (operation.isError()) {
+        return Failure(operation.error());
       }
 
-      switch (operation.type()) {
+      // Note that the diffs are only applied when the entry is needed
+      // (see 'fetch'); here we just index where they are in the log.
+      // Any cached entry is outdated by the operation.
+      switch (operation.get().type()) {
         case Operation::SNAPSHOT: {
-          CHECK(operation.has_snapshot());
+          CHECK(operation.get().has_snapshot());
+
+          const state::Entry& entry_ = operation.get().snapshot().entry();
 
           // Add or update (override) the snapshot.
-          Snapshot snapshot(entry.position, operation.snapshot().entry());
-          snapshots.put(snapshot.entry.name(), snapshot);
+          snapshots.put(entry_.name(), Snapshot(entry.position, entry_.uuid()));
+          cache.erase(entry_.name());
           break;
         }
 
         case Operation::DIFF: {
-          CHECK(operation.has_diff());
+          CHECK(operation.get().has_diff());
 
-          Option<Snapshot> snapshot =
-            snapshots.get(operation.diff().entry().name());
+          const state::Entry& entry_ = operation.get().diff().entry();
 
-          CHECK_SOME(snapshot);
+          Option<Snapshot> snapshot = snapshots.get(entry_.name());
 
-          Try<Snapshot> patched = snapshot.get().patch(operation.diff());
+          CHECK_SOME(snapshot);
 
-          if (patched.isError()) {
-            return Failure("Failed to apply the diff: " + patched.error());
-          }
+          snapshot.get().uuid = entry_.uuid();
+          snapshot.get().diffs.push_back(entry.position);
 
-          // Replace the snapshot with the patched snapshot.
-          snapshots.put(patched.get().entry.name(), patched.get());
+          snapshots.put(entry_.name(), snapshot.get());
+          cache.erase(entry_.name());
           break;
         }
 
         case Operation::EXPUNGE: {
-          CHECK(operation.has_expunge());
-          snapshots.erase(operation.expunge().name());
+          CHECK(operation.get().has_expunge());
+          snapshots.erase(operation.get().expunge().name());
+          cache.erase(operation.get().expunge().name());
           break;
         }
 
         default:
-          return Failure("Unknown operation: " + stringify(operation.type()));
+          return Failure(
+              "Unknown operation: " + stringify(operation.get().type()));
       }
 
       index = entry.position;
@@ -446,7 +568,120 @@ Future<Option<state::Entry> > LogStorageProcess::_get(const string& name)
     return None();
   }
 
-  return snapshot.get().entry;
+  return fetch(name, snapshot.get())
+    .then([](const state::Entry& entry) -> Option<state::Entry> {
+      return entry;
+    })
+    .repair(defer(self(), &Self::__get, name, snapshot.get().uuid, lambda::_1));
+}
+
+
+Future<Option<state::Entry> > LogStorageProcess::__get(
+    const string& name,
+    const string& uuid,
+    const Future<Option<state::Entry>>& future)
+{
+  // Since reads are not serialized with writes, the entry might have
+  // been updated (and the log truncated) while we were reading it, in
+  // which case we retry with the latest snapshot.
+  Option<Snapshot> snapshot = snapshots.get(name);
+
+  if (snapshot.isSome() && snapshot.get().uuid == uuid) {
+    return future;
+  }
+
+  return _get(name);
+}
+
+
+Future<state::Entry> LogStorageProcess::fetch(
+    const string& name,
+    const Snapshot& snapshot)
+{
+  Option<state::Entry> entry = cache.get(name);
+
+  if (entry.isSome() && entry.get().uuid() == snapshot.uuid) {
+    ++metrics.cache_hits;
+    return entry.get();
+  }
+
+  ++metrics.cache_misses;
+
+  // Read the snapshot and each of the diffs separately, as there may
+  // be many entries for other names in between.
+  list<Future<list<Log::Entry>>> reads;
+
+  reads.push_back(reader.read(snapshot.position, snapshot.position));
+
+  foreach (const Log::Position& position, snapshot.diffs) {
+    reads.push_back(reader.read(position, position));
+  }
+
+  return collect(reads)
+    .then(defer(self(), &Self::_fetch, name, snapshot, lambda::_1));
+}
+
+
+Future<state::Entry> LogStorageProcess::_fetch(
+    const string& name,
+    const Snapshot& snapshot,
+    const list<list<Log::Entry>>& entries)
+{
+  Option<state::Entry> entry;
+
+  foreach (const list<Log::Entry>& read, entries) {
+    if (read.size() != 1) {
+      return Failure("Failed to read '" + name + "' from the log");
+    }
+
+    Try<Operation> operation = parse(read.front());
+
+    if (operation.isError()) {
+      return Failure(operation.error());
+    }
+
+    if (entry.isNone()) {
+      // The first entry is the snapshot.
+      if (operation.get().type() != Operation::SNAPSHOT ||
+          operation.get().snapshot().entry().name() != name) {
+        return Failure("Expecting a snapshot of '" + name + "' in the log");
+      }
+
+      entry = operation.get().snapshot().entry();
+      continue;
+    }
+
+    if (operation.get().type() != Operation::DIFF ||
+        operation.get().diff().entry().name() != name) {
+      return Failure("Expecting a diff of '" + name + "' in the log");
+    }
+
+    Try<string> patch = svn::patch(
+        entry.get().value(),
+        svn::Diff(operation.get().diff().entry().value()));
+
+    if (patch.isError()) {
+      return Failure("Failed to apply the diff: " + patch.error());
+    }
+
+    entry = operation.get().diff().entry();
+    entry.get().set_value(patch.get());
+  }
+
+  CHECK_SOME(entry);
+
+  if (entry.get().uuid() != snapshot.uuid) {
+    return Failure("Read an unexpected version of '" + name + "'");
+  }
+
+  // Only cache the entry if it hasn't been updated in the meantime.
+  Option<Snapshot> latest = snapshots.get(name);
+
+  if (latest.isSome() && latest.get().uuid == snapshot.uuid) {
+    cache.put(entry.get());
+  }
+
+  return entry.get();
 }
 
 
@@ -476,55 +711,67 @@ Future<bool> LogStorageProcess::__set(
   Option<Snapshot> snapshot = snapshots.get(entry.name());
 
   // Check the version first (if we've already got a snapshot).
-  if (snapshot.isSome() &&
-      UUID::fromBytes(snapshot.get().entry.uuid()) != uuid) {
+  if (snapshot.isSome() && UUID::fromBytes(snapshot.get().uuid) != uuid) {
     return false;
   }
 
-  // Check if we should try to compute a diff.
-  if (snapshot.isSome() && snapshot.get().diffs < diffsBetweenSnapshots) {
-    // Keep metrics for the time to calculate diffs.
-    metrics.diff.start();
+  // Check if we should try to compute a diff, which needs the
+  // previous entry.
+  if (snapshot.isSome() &&
+      snapshot.get().diffs.size() < diffsBetweenSnapshots) {
+    return fetch(entry.name(), snapshot.get())
+      .then(defer(self(), &Self::appendDiff, entry, lambda::_1));
+  }
+
+  return appendSnapshot(entry);
+}
 
-    // Construct the diff of the last snapshot.
-    Try<svn::Diff> diff = svn::diff(
-        snapshot.get().entry.value(),
-        entry.value());
 
-    Duration elapsed = metrics.diff.stop();
+Future<bool> LogStorageProcess::appendDiff(
+    const state::Entry& entry,
+    const state::Entry& previous)
+{
+  // Keep metrics for the time to calculate diffs.
+  metrics.diff.start();
 
-    if (diff.isError()) {
-      // TODO(benh): Fallback and try and write a whole snapshot?
-      return Failure("Failed to construct diff: " + diff.error());
-    }
+  // Construct the diff of the previous entry.
+  Try<svn::Diff> diff = svn::diff(previous.value(), entry.value());
 
-    VLOG(1) << "Created an SVN diff in " << elapsed
-            << " of size " << Bytes(diff.get().data.size()) << " which is "
-            << (diff.get().data.size() / (double) entry.value().size()) * 100.0
-            << "% the original size (" << Bytes(entry.value().size()) << ")";
-
-    // Only write the diff if it provides a reduction in size.
-    if (diff.get().data.size() < entry.value().size()) {
-      // Append a diff operation.
-      Operation operation;
-      operation.set_type(Operation::DIFF);
-      operation.mutable_diff()->mutable_entry()->CopyFrom(entry);
-      operation.mutable_diff()->mutable_entry()->set_value(diff.get().data);
-
-      string value;
-      if (!operation.SerializeToString(&value)) {
-        return Failure("Failed to serialize DIFF Operation");
-      }
+  Duration elapsed = metrics.diff.stop();
+
+  if (diff.isError()) {
+    // TODO(benh): Fallback and try and write a whole snapshot?
+    return Failure("Failed to construct diff: " + diff.error());
+  }
 
-      return writer.append(value)
-        .then(defer(self(),
-                    &Self::___set,
-                    entry,
-                    snapshot.get().diffs + 1,
-                    lambda::_1));
+  VLOG(1) << "Created an SVN diff in " << elapsed
+          << " of size " << Bytes(diff.get().data.size()) << " which is "
+          << (diff.get().data.size() / (double) entry.value().size()) * 100.0
+          << "% the original size (" << Bytes(entry.value().size()) << ")";
+
+  // Only write the diff if it provides a reduction in size.
+  if (diff.get().data.size() < entry.value().size()) {
+    // Append a diff operation.
+    Operation operation;
+    operation.set_type(Operation::DIFF);
+    operation.mutable_diff()->mutable_entry()->CopyFrom(entry);
+    operation.mutable_diff()->mutable_entry()->set_value(diff.get().data);
+
+    string value;
+    if (!operation.SerializeToString(&value)) {
+      return Failure("Failed to serialize DIFF Operation");
     }
+
+    return writer.append(value)
+      .then(defer(self(), &Self::___set, entry, true, lambda::_1));
   }
 
+  return appendSnapshot(entry);
+}
+
+
+Future<bool> LogStorageProcess::appendSnapshot(const state::Entry& entry)
+{
   // Write the full snapshot.
   Operation operation;
   operation.set_type(Operation::SNAPSHOT);
@@ -536,13 +783,13 @@ Future<bool> LogStorageProcess::__set(
   }
 
   return writer.append(value)
-    .then(defer(self(), &Self::___set, entry, 0, lambda::_1));
+    .then(defer(self(), &Self::___set, entry, false, lambda::_1));
 }
 
 
 Future<bool> LogStorageProcess::___set(
     const state::Entry& entry,
-    size_t diffs,
+    bool diff,
     Option<Log::Position> position)
 {
   if (position.isNone()) {
@@ -554,17 +801,23 @@ Future<bool> LogStorageProcess::___set(
   // position again (if we don't have to).
   index = max(index, position);
 
-  // Determine the position that represents the snapshot: if we just
-  // wrote a diff then we want to use the existing position of the
-  // snapshot, otherwise we just overwrote the snapshot so we should
-  // use the returned position (i.e., do nothing).
-  if (diffs > 0) {
-    CHECK(snapshots.contains(entry.name()));
-    position = snapshots.get(entry.name()).get().position;
+  // If we just wrote a diff then the snapshot stays at its existing
+  // position and the diff gets added to it, otherwise we just
+  // overwrote the snapshot with one at the returned position.
+  if (diff) {
+    Option<Snapshot> snapshot = snapshots.get(entry.name());
+    CHECK_SOME(snapshot);
+
+    snapshot.get().uuid = entry.uuid();
+    snapshot.get().diffs.push_back(position.get());
+
+    snapshots.put(entry.name(), snapshot.get());
+  } else {
+    snapshots.put(entry.name(), Snapshot(position.get(), entry.uuid()));
   }
 
-  Snapshot snapshot(position.get(), entry, diffs);
-  snapshots.put(snapshot.entry.name(), snapshot);
+  // Cache the entry as it is the one that the next diff is made from.
+  cache.put(entry);
 
   // And truncate the log if necessary.
   truncate();
@@ -597,8 +850,7 @@ Future<bool> LogStorageProcess::__expunge(const state::Entry& entry)
   }
 
   // Check the version first.
-  if (UUID::fromBytes(snapshot.get().entry.uuid()) !=
-      UUID::fromBytes(entry.uuid())) {
+  if (UUID::fromBytes(snapshot.get().uuid) != UUID::fromBytes(entry.uuid())) {
     return false;
   }
 
@@ -629,6 +881,7 @@ Future<bool> LogStorageProcess::___expunge(
   // Remove from snapshots and truncate the log if possible.
   CHECK(snapshots.contains(entry.name()));
   snapshots.erase(entry.name());
+  cache.erase(entry.name());
   truncate();
 
   return true;
@@ -649,9 +902,12 @@ Future<std::set<string> > LogStorageProcess::_names()
 }
 
 
-LogStorage::LogStorage(Log* log, size_t diffsBetweenSnapshots)
+LogStorage::LogStorage(
+    Log* log,
+    size_t diffsBetweenSnapshots,
+    const Bytes& cacheSize)
 {
-  process = new LogStorageProcess(log, diffsBetweenSnapshots);
+  process = new LogStorageProcess(log, diffsBetweenSnapshots, cacheSize);
   spawn(process);
 }
 
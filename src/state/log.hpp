@@ -22,6 +22,7 @@
 
 #include <process/future.hpp>
 
+#include <stout/bytes.hpp>
 #include <stout/option.hpp>
 #include <stout/uuid.hpp>
 
@@ -39,10 +40,22 @@ namespace state {
 class LogStorageProcess;
 
 
+// The default maximum total size of the entries that a LogStorage
+// caches in memory.
+const Bytes DEFAULT_LOG_STORAGE_CACHE_SIZE = Megabytes(64);
+
+
+// A storage implementation on top of the replicated log. Only the
+// positions of the entries in the log are kept in memory; the entries
+// themselves are read back from the log when needed, and the most
+// recently used ones are cached up to a total size of 'cacheSize'.
 class LogStorage : public Storage
 {
 public:
-  LogStorage(log::Log* log, size_t diffsBetweenSnapshots = 0);
+  LogStorage(
+      log::Log* log,
+      size_t diffsBetweenSnapshots = 0,
+      const Bytes& cacheSize = DEFAULT_LOG_STORAGE_CACHE_SIZE);
 
   virtual ~LogStorage();
 
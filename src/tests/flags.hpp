@@ -149,6 +149,12 @@ public:
         "Use the default '" + master::DEFAULT_AUTHENTICATOR + "', or\n"
         "load an alternate authenticator module using --modules.",
         master::DEFAULT_AUTHENTICATOR);
+
+    add(&Flags::allocator_trace,
+        "allocator_trace",
+        "Path of an allocator trace (see the master's --allocator_trace\n"
+        "flag) to replay in the allocator trace replay benchmark, instead\n"
+        "of a trace of a synthetic workload.");
   }
 
   bool verbose;
@@ -160,6 +166,7 @@ public:
   Option<Modules> modules;
   Option<std::string> isolation;
   std::string authenticators;
+  Option<std::string> allocator_trace;
 };
 
 // Global flags for running the tests.
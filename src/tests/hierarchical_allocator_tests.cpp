@@ -16,6 +16,7 @@
 
 #include <atomic>
 #include <iostream>
+#include <mutex>
 #include <string>
 #include <utility>
 #include <vector>
@@ -34,21 +35,27 @@
 #include <stout/hashmap.hpp>
 #include <stout/hashset.hpp>
 #include <stout/os.hpp>
+#include <stout/protobuf.hpp>
 #include <stout/stopwatch.hpp>
+#include <stout/synchronized.hpp>
 #include <stout/utils.hpp>
 
 #include "master/constants.hpp"
 #include "master/flags.hpp"
 
+#include "master/allocator/trace.hpp"
+
 #include "master/allocator/mesos/hierarchical.hpp"
 
 #include "tests/allocator.hpp"
+#include "tests/flags.hpp"
 #include "tests/mesos.hpp"
 
 using mesos::internal::master::MIN_CPUS;
 using mesos::internal::master::MIN_MEM;
 
 using mesos::internal::master::allocator::HierarchicalDRFAllocator;
+using mesos::internal::master::allocator::TracingAllocator;
 
 using mesos::master::allocator::Allocator;
 
@@ -173,7 +180,10 @@ protected:
         flags.allocation_interval,
         offerCallback.get(),
         inverseOfferCallback.get(),
-        hashmap<string, double>());
+        hashmap<string, double>(),
+        flags.allocation_shards,
+        flags.min_allocation_interval,
+        flags.agent_ordering);
   }
 
   SlaveInfo createSlaveInfo(const string& resources)
@@ -517,6 +527,75 @@ TEST_F(HierarchicalAllocatorTest, OfferFilter)
 }
 
 
+// This test ensures that the offer filters on multiple agents expire
+// together, and that the offer filter metrics are reported.
+TEST_F(HierarchicalAllocatorTest, OfferFilterExpiration)
+{
+  Clock::pause();
+
+  hashmap<FrameworkID, Resources> EMPTY;
+
+  initialize();
+
+  SlaveInfo agent1 = createSlaveInfo("cpus:1;mem:512;disk:0");
+  allocator->addSlave(agent1.id(), agent1, None(), agent1.resources(), EMPTY);
+
+  SlaveInfo agent2 = createSlaveInfo("cpus:1;mem:512;disk:0");
+  allocator->addSlave(agent2.id(), agent2, None(), agent2.resources(), EMPTY);
+
+  // Ensure the agents are added before the framework, so that both
+  // agents are offered in a single allocation.
+  Clock::settle();
+
+  FrameworkInfo framework = createFrameworkInfo("role1");
+  allocator->addFramework(
+      framework.id(), framework, hashmap<SlaveID, Resources>());
+
+  Future<Allocation> allocation = allocations.get();
+  AWAIT_READY(allocation);
+  EXPECT_EQ(framework.id(), allocation.get().frameworkId);
+  EXPECT_EQ(2u, allocation.get().resources.size());
+
+  // The framework declines both offers.
+  Duration filterTimeout = flags.allocation_interval * 2;
+  Filters offerFilter;
+  offerFilter.set_refuse_seconds(filterTimeout.secs());
+
+  allocator->recoverResources(
+      framework.id(), agent1.id(), agent1.resources(), offerFilter);
+  allocator->recoverResources(
+      framework.id(), agent2.id(), agent2.resources(), offerFilter);
+
+  Clock::settle();
+
+  JSON::Object metrics = Metrics();
+  EXPECT_EQ(2u, metrics.values["allocator/offer_filters/active"]);
+  EXPECT_EQ(2u, metrics.values["allocator/offer_filters/slaves"]);
+  EXPECT_EQ(0u, metrics.values["allocator/offer_filters/expired"]);
+
+  // There should be no allocation due to the offer filters.
+  Clock::advance(flags.allocation_interval);
+  Clock::settle();
+
+  allocation = allocations.get();
+  EXPECT_TRUE(allocation.isPending());
+
+  // Both offer filters expire, and both agents are offered in the
+  // next batch allocation.
+  Clock::advance(flags.allocation_interval);
+  Clock::settle();
+
+  AWAIT_READY(allocation);
+  EXPECT_EQ(framework.id(), allocation.get().frameworkId);
+  EXPECT_EQ(2u, allocation.get().resources.size());
+
+  metrics = Metrics();
+  EXPECT_EQ(0u, metrics.values["allocator/offer_filters/active"]);
+  EXPECT_EQ(0u, metrics.values["allocator/offer_filters/slaves"]);
+  EXPECT_EQ(2u, metrics.values["allocator/offer_filters/expired"]);
+}
+
+
 // This test ensures that an offer filter is not removed earlier than
 // the next batch allocation. See MESOS-4302 for more information.
 //
@@ -806,6 +885,75 @@ TEST_F(HierarchicalAllocatorTest, CoarseGrained)
 }
 
 
+// This test ensures that when the slaves are evaluated in shards,
+// allocations still respect offer filters and that slaves that were
+// filtered by one framework are offered to another.
+TEST_F(HierarchicalAllocatorTest, AllocationShards)
+{
+  // Pausing the clock ensures that the batch allocation does not
+  // influence this test.
+  Clock::pause();
+
+  master::Flags flags;
+  flags.allocation_shards = 3;
+
+  initialize(flags);
+
+  hashmap<FrameworkID, Resources> EMPTY;
+
+  vector<SlaveInfo> slaves;
+  for (int i = 0; i < 4; i++) {
+    slaves.push_back(createSlaveInfo("cpus:2;mem:1024;disk:0"));
+    allocator->addSlave(
+        slaves[i].id(), slaves[i], None(), slaves[i].resources(), EMPTY);
+  }
+
+  FrameworkInfo framework1 = createFrameworkInfo("role1");
+  allocator->addFramework(
+      framework1.id(), framework1, hashmap<SlaveID, Resources>());
+
+  Future<Allocation> allocation = allocations.get();
+  AWAIT_READY(allocation);
+  EXPECT_EQ(framework1.id(), allocation.get().frameworkId);
+  EXPECT_EQ(4u, allocation.get().resources.size());
+
+  // framework1 declines the first two slaves for a long time, and
+  // the other two without a filter.
+  Filters filters;
+  filters.set_refuse_seconds(Hours(1).secs());
+
+  for (int i = 0; i < 4; i++) {
+    allocator->recoverResources(
+        framework1.id(),
+        slaves[i].id(),
+        allocation.get().resources.get(slaves[i].id()).get(),
+        i < 2 ? filters : Option<Filters>::none());
+  }
+
+  // framework1 is only offered the slaves it did not filter.
+  Clock::advance(flags.allocation_interval);
+
+  allocation = allocations.get();
+  AWAIT_READY(allocation);
+  EXPECT_EQ(framework1.id(), allocation.get().frameworkId);
+  ASSERT_EQ(2u, allocation.get().resources.size());
+  EXPECT_TRUE(allocation.get().resources.contains(slaves[2].id()));
+  EXPECT_TRUE(allocation.get().resources.contains(slaves[3].id()));
+
+  // The filtered slaves are offered to framework2.
+  FrameworkInfo framework2 = createFrameworkInfo("role2");
+  allocator->addFramework(
+      framework2.id(), framework2, hashmap<SlaveID, Resources>());
+
+  allocation = allocations.get();
+  AWAIT_READY(allocation);
+  EXPECT_EQ(framework2.id(), allocation.get().frameworkId);
+  ASSERT_EQ(2u, allocation.get().resources.size());
+  EXPECT_TRUE(allocation.get().resources.contains(slaves[0].id()));
+  EXPECT_TRUE(allocation.get().resources.contains(slaves[1].id()));
+}
+
+
 // This test ensures that frameworks that have the same share get an
 // equal number of allocations over time (rather than the same
 // framework getting all the allocations because it's name is
@@ -2366,6 +2514,237 @@ TEST_F(HierarchicalAllocatorTest, DeactivateAndReactivateFramework)
 }
 
 
+// This test ensures that a batch allocation is skipped when nothing
+// has changed since the last allocation, and is performed once
+// resources are recovered.
+TEST_F(HierarchicalAllocatorTest, SkipIdleBatchAllocation)
+{
+  Clock::pause();
+
+  initialize();
+
+  hashmap<FrameworkID, Resources> EMPTY;
+
+  SlaveInfo agent = createSlaveInfo("cpus:2;mem:1024;disk:0");
+  allocator->addSlave(agent.id(), agent, None(), agent.resources(), EMPTY);
+
+  FrameworkInfo framework = createFrameworkInfo("role1");
+  allocator->addFramework(
+      framework.id(), framework, hashmap<SlaveID, Resources>());
+
+  Future<Allocation> allocation = allocations.get();
+  AWAIT_READY(allocation);
+  EXPECT_EQ(framework.id(), allocation.get().frameworkId);
+  EXPECT_EQ(agent.resources(), Resources::sum(allocation.get().resources));
+
+  Clock::settle();
+
+  JSON::Object metrics = Metrics();
+  EXPECT_EQ(1u, metrics.values.count("allocator/allocation_runs_skipped"));
+  EXPECT_EQ(0u, metrics.values["allocator/allocation_runs_skipped"]);
+
+  // Nothing has changed, so the batch allocation is skipped.
+  Clock::advance(flags.allocation_interval);
+  Clock::settle();
+
+  allocation = allocations.get();
+  EXPECT_TRUE(allocation.isPending());
+
+  metrics = Metrics();
+  EXPECT_EQ(1u, metrics.values["allocator/allocation_runs_skipped"]);
+
+  // The recovered resources are offered in the next batch allocation.
+  allocator->recoverResources(
+      framework.id(),
+      agent.id(),
+      agent.resources(),
+      None());
+
+  Clock::settle();
+  EXPECT_TRUE(allocation.isPending());
+
+  Clock::advance(flags.allocation_interval);
+
+  AWAIT_READY(allocation);
+  EXPECT_EQ(framework.id(), allocation.get().frameworkId);
+  EXPECT_EQ(agent.resources(), Resources::sum(allocation.get().resources));
+
+  Clock::settle();
+
+  metrics = Metrics();
+  EXPECT_EQ(1u, metrics.values["allocator/allocation_runs_skipped"]);
+}
+
+
+// This test ensures that event-triggered allocations are performed
+// no sooner than `--min_allocation_interval` after the previous one.
+TEST_F(HierarchicalAllocatorTest, MinAllocationInterval)
+{
+  Clock::pause();
+
+  master::Flags flags_;
+  flags_.allocation_interval = Seconds(1);
+  flags_.min_allocation_interval = Milliseconds(500);
+
+  initialize(flags_);
+
+  // Adding the framework triggers an allocation (with no slaves).
+  FrameworkInfo framework = createFrameworkInfo("role1");
+  allocator->addFramework(
+      framework.id(), framework, hashmap<SlaveID, Resources>());
+
+  Clock::settle();
+
+  hashmap<FrameworkID, Resources> EMPTY;
+
+  // Adding the slaves triggers a single allocation, but not before
+  // the minimum allocation interval has elapsed.
+  SlaveInfo agent1 = createSlaveInfo("cpus:2;mem:1024;disk:0");
+  allocator->addSlave(agent1.id(), agent1, None(), agent1.resources(), EMPTY);
+
+  SlaveInfo agent2 = createSlaveInfo("cpus:2;mem:1024;disk:0");
+  allocator->addSlave(agent2.id(), agent2, None(), agent2.resources(), EMPTY);
+
+  Clock::settle();
+
+  Future<Allocation> allocation = allocations.get();
+  EXPECT_TRUE(allocation.isPending());
+
+  Clock::advance(flags_.min_allocation_interval);
+
+  AWAIT_READY(allocation);
+  EXPECT_EQ(framework.id(), allocation.get().frameworkId);
+  EXPECT_EQ(2u, allocation.get().resources.size());
+  EXPECT_TRUE(allocation.get().resources.contains(agent1.id()));
+  EXPECT_TRUE(allocation.get().resources.contains(agent2.id()));
+}
+
+
+// This test ensures that with the "binpack" agent ordering, the
+// resources of the most utilized agent are allocated first.
+TEST_F(HierarchicalAllocatorTest, BinPackAgentOrdering)
+{
+  Clock::pause();
+
+  master::Flags flags_;
+  flags_.agent_ordering = "binpack";
+
+  // Delay the event-triggered allocations, so that both agents are
+  // allocated in the next batch allocation.
+  flags_.min_allocation_interval = Seconds(10);
+
+  initialize(flags_);
+
+  hashmap<FrameworkID, Resources> EMPTY;
+
+  FrameworkInfo framework1 = createFrameworkInfo("role1");
+  allocator->addFramework(
+      framework1.id(), framework1, hashmap<SlaveID, Resources>());
+
+  FrameworkInfo framework2 = createFrameworkInfo("role2");
+  allocator->addFramework(
+      framework2.id(), framework2, hashmap<SlaveID, Resources>());
+
+  Clock::settle();
+
+  // The first agent is partially used by the first framework, so
+  // its resources go to the second framework, which has the lower
+  // share. The resources of the second agent then go to the first
+  // framework.
+  hashmap<FrameworkID, Resources> used;
+  used[framework1.id()] = Resources::parse("cpus:1;mem:512").get();
+
+  SlaveInfo agent1 = createSlaveInfo("cpus:4;mem:2048;disk:0");
+  allocator->addSlave(agent1.id(), agent1, None(), agent1.resources(), used);
+
+  SlaveInfo agent2 = createSlaveInfo("cpus:4;mem:2048;disk:0");
+  allocator->addSlave(agent2.id(), agent2, None(), agent2.resources(), EMPTY);
+
+  Clock::settle();
+
+  Clock::advance(flags_.allocation_interval);
+
+  hashmap<FrameworkID, Allocation> allocated;
+
+  for (int i = 0; i < 2; i++) {
+    Future<Allocation> allocation = allocations.get();
+    AWAIT_READY(allocation);
+    allocated[allocation.get().frameworkId] = allocation.get();
+  }
+
+  ASSERT_TRUE(allocated.contains(framework1.id()));
+  EXPECT_EQ(1u, allocated[framework1.id()].resources.size());
+  EXPECT_TRUE(allocated[framework1.id()].resources.contains(agent2.id()));
+
+  ASSERT_TRUE(allocated.contains(framework2.id()));
+  EXPECT_EQ(1u, allocated[framework2.id()].resources.size());
+  EXPECT_TRUE(allocated[framework2.id()].resources.contains(agent1.id()));
+}
+
+
+// This test ensures that with the "attribute:<name>" agent ordering,
+// the agents are allocated in the order of their attribute values.
+TEST_F(HierarchicalAllocatorTest, AttributeAgentOrdering)
+{
+  Clock::pause();
+
+  master::Flags flags_;
+  flags_.agent_ordering = "attribute:rack";
+
+  // Delay the event-triggered allocations, so that both agents are
+  // allocated in the next batch allocation.
+  flags_.min_allocation_interval = Seconds(10);
+
+  initialize(flags_);
+
+  hashmap<FrameworkID, Resources> EMPTY;
+
+  FrameworkInfo framework1 = createFrameworkInfo("role1");
+  allocator->addFramework(
+      framework1.id(), framework1, hashmap<SlaveID, Resources>());
+
+  FrameworkInfo framework2 = createFrameworkInfo("role2");
+  allocator->addFramework(
+      framework2.id(), framework2, hashmap<SlaveID, Resources>());
+
+  Clock::settle();
+
+  // Unlike with "binpack", the second agent comes first since it is
+  // in rack "a", so its resources go to the second framework, which
+  // has the lower share.
+  hashmap<FrameworkID, Resources> used;
+  used[framework1.id()] = Resources::parse("cpus:1;mem:512").get();
+
+  SlaveInfo agent1 = createSlaveInfo("cpus:4;mem:2048;disk:0");
+  agent1.add_attributes()->CopyFrom(Attributes::parse("rack", "b"));
+  allocator->addSlave(agent1.id(), agent1, None(), agent1.resources(), used);
+
+  SlaveInfo agent2 = createSlaveInfo("cpus:4;mem:2048;disk:0");
+  agent2.add_attributes()->CopyFrom(Attributes::parse("rack", "a"));
+  allocator->addSlave(agent2.id(), agent2, None(), agent2.resources(), EMPTY);
+
+  Clock::settle();
+
+  Clock::advance(flags_.allocation_interval);
+
+  hashmap<FrameworkID, Allocation> allocated;
+
+  for (int i = 0; i < 2; i++) {
+    Future<Allocation> allocation = allocations.get();
+    AWAIT_READY(allocation);
+    allocated[allocation.get().frameworkId] = allocation.get();
+  }
+
+  ASSERT_TRUE(allocated.contains(framework1.id()));
+  EXPECT_EQ(1u, allocated[framework1.id()].resources.size());
+  EXPECT_TRUE(allocated[framework1.id()].resources.contains(agent1.id()));
+
+  ASSERT_TRUE(allocated.contains(framework2.id()));
+  EXPECT_EQ(1u, allocated[framework2.id()].resources.size());
+  EXPECT_TRUE(allocated[framework2.id()].resources.contains(agent2.id()));
+}
+
+
 class HierarchicalAllocator_BENCHMARK_Test
   : public HierarchicalAllocatorTestBase,
     public WithParamInterface<std::tr1::tuple<size_t, size_t>> {};
@@ -2594,6 +2973,798 @@ TEST_F(HierarchicalAllocator_BENCHMARK_Test, DeclineOffers)
   Clock::resume();
 }
 
+
+// This benchmark measures the cost of allocating the resources of an
+// agent with a large number of frameworks that all have resources
+// allocated, when the total resources change before each allocation
+// (i.e., each agent that gets added), which changes the shares of
+// all of the frameworks.
+TEST_F(HierarchicalAllocator_BENCHMARK_Test, ManyFrameworks)
+{
+  const size_t frameworkCount = 10000;
+  const size_t slaveCount = 1000;
+  const size_t allocationCount = 100;
+
+  master::Flags flags;
+
+  // Only allocate when agents are added.
+  flags.allocation_interval = Hours(1);
+
+  Clock::pause();
+
+  atomic<size_t> offerCount(0);
+
+  auto offerCallback = [&offerCount](
+      const FrameworkID& frameworkId,
+      const hashmap<SlaveID, Resources>& resources) {
+    offerCount++;
+  };
+
+  cout << "Using " << slaveCount << " slaves and "
+       << frameworkCount << " frameworks" << endl;
+
+  initialize(flags, offerCallback);
+
+  vector<FrameworkInfo> frameworks;
+  frameworks.reserve(frameworkCount);
+
+  for (unsigned i = 0; i < frameworkCount; ++i) {
+    frameworks.push_back(createFrameworkInfo("*"));
+    allocator->addFramework(frameworks[i].id(), frameworks[i], {});
+  }
+
+  // Each agent runs tasks of 10 frameworks, so that all of the
+  // frameworks have resources allocated.
+  const Resources resources = Resources::parse("cpus:2;mem:1024").get();
+
+  for (unsigned i = 0; i < slaveCount; ++i) {
+    SlaveInfo slave = createSlaveInfo("cpus:24;mem:12288;disk:4096");
+
+    hashmap<FrameworkID, Resources> used;
+    for (unsigned j = 0; j < 10; ++j) {
+      used[frameworks[(i * 10 + j) % frameworkCount].id()] = resources;
+    }
+
+    allocator->addSlave(slave.id(), slave, None(), slave.resources(), used);
+  }
+
+  // Wait for all the 'addSlave' operations to be processed.
+  Clock::settle();
+
+  Stopwatch watch;
+  watch.start();
+
+  for (unsigned i = 0; i < allocationCount; ++i) {
+    SlaveInfo slave = createSlaveInfo("cpus:24;mem:12288;disk:4096");
+    allocator->addSlave(slave.id(), slave, None(), slave.resources(), {});
+  }
+
+  // Wait for all the allocations to be made.
+  Clock::settle();
+
+  cout << "Made " << allocationCount << " allocations after adding agents"
+       << " in " << watch.elapsed()
+       << " (" << watch.elapsed() / allocationCount << " per allocation)"
+       << endl;
+
+  Clock::resume();
+}
+
+
+// This benchmark replays an allocator trace (see the master's
+// `--allocator_trace` flag) against the allocator, and reports the
+// latency of the allocation runs, the offer rate and the memory used.
+// The trace to replay is specified with the `--allocator_trace` test
+// flag, otherwise a trace of a synthetic workload is recorded first.
+//
+// NOTE: The replay is approximate: the allocator makes its own
+// allocation decisions during the replay, which can differ from the
+// recorded ones (e.g., the slaves are shuffled in each allocation).
+// The recorded calls that refer to allocated resources (i.e., the
+// recovered resources and the offer operations) are thus applied to
+// the resources the allocator allocated during the replay, and are
+// skipped if they don't apply.
+TEST_F(HierarchicalAllocator_BENCHMARK_Test, ReplayTrace)
+{
+  master::Flags flags;
+
+  Clock::pause();
+
+  string path;
+
+  if (tests::flags.allocator_trace.isSome()) {
+    path = tests::flags.allocator_trace.get();
+  } else {
+    const size_t frameworkCount = 100;
+    const size_t slaveCount = 1000;
+    const size_t roundCount = 20;
+
+    Try<string> mktemp = os::mktemp();
+    ASSERT_SOME(mktemp);
+
+    path = mktemp.get();
+
+    cout << "Recording a trace of " << roundCount << " allocation rounds"
+         << " using " << slaveCount << " slaves"
+         << " and " << frameworkCount << " frameworks" << endl;
+
+    Try<Allocator*> tracing = TracingAllocator::create(allocator, path);
+    ASSERT_SOME(tracing);
+
+    allocator = tracing.get();
+
+    struct OfferedResources {
+      FrameworkID   frameworkId;
+      SlaveID       slaveId;
+      Resources     resources;
+    };
+
+    vector<OfferedResources> offers;
+
+    auto offerCallback = [&offers](
+        const FrameworkID& frameworkId,
+        const hashmap<SlaveID, Resources>& resources_)
+    {
+      for (auto resources : resources_) {
+        offers.push_back(
+            OfferedResources{frameworkId, resources.first, resources.second});
+      }
+    };
+
+    initialize(flags, offerCallback);
+
+    for (unsigned i = 0; i < frameworkCount; ++i) {
+      FrameworkInfo framework = createFrameworkInfo("*");
+      allocator->addFramework(framework.id(), framework, {});
+    }
+
+    for (unsigned i = 0; i < slaveCount; ++i) {
+      SlaveInfo slave = createSlaveInfo("cpus:24;mem:4096;disk:4096");
+      allocator->addSlave(slave.id(), slave, None(), slave.resources(), {});
+    }
+
+    Clock::settle();
+
+    // The frameworks launch a task on half of the offers, which runs
+    // for a few rounds, and decline the rest of the offered resources.
+    const Resources task = Resources::parse("cpus:2;mem:256").get();
+
+    vector<vector<OfferedResources>> tasks(roundCount);
+
+    Filters filters;
+    filters.set_refuse_seconds(5);
+
+    for (unsigned round = 0; round < roundCount; ++round) {
+      for (unsigned i = 0; i < offers.size(); ++i) {
+        Resources resources = offers[i].resources;
+
+        if (i % 2 == 0 && resources.contains(task)) {
+          resources -= task;
+
+          const unsigned finish = round + 1 + (i % 5);
+          if (finish < roundCount) {
+            tasks[finish].push_back(
+                OfferedResources{offers[i].frameworkId,
+                                 offers[i].slaveId,
+                                 task});
+          }
+        }
+
+        allocator->recoverResources(
+            offers[i].frameworkId, offers[i].slaveId, resources, filters);
+      }
+
+      offers.clear();
+
+      foreach (const OfferedResources& finished, tasks[round]) {
+        allocator->recoverResources(
+            finished.frameworkId,
+            finished.slaveId,
+            finished.resources,
+            None());
+      }
+
+      Clock::settle();
+      Clock::advance(flags.allocation_interval);
+      Clock::settle();
+    }
+
+    // Replay the trace against a new allocator.
+    delete allocator;
+    allocator = createAllocator<HierarchicalDRFAllocator>();
+  }
+
+  vector<AllocatorTraceEvent> events;
+
+  {
+    Try<int> fd = os::open(path, O_RDONLY | O_CLOEXEC);
+    ASSERT_SOME(fd);
+
+    while (true) {
+      // NOTE: We ignore a partially written event at the end, which
+      // is expected if the master was still recording the trace.
+      Result<AllocatorTraceEvent> event =
+        ::protobuf::read<AllocatorTraceEvent>(fd.get(), true);
+
+      ASSERT_FALSE(event.isError()) << event.error();
+
+      if (event.isNone()) {
+        break;
+      }
+
+      events.push_back(event.get());
+    }
+
+    os::close(fd.get());
+  }
+
+  if (tests::flags.allocator_trace.isNone()) {
+    ASSERT_SOME(os::rm(path));
+  }
+
+  ASSERT_FALSE(events.empty());
+
+  // The resources the allocator allocated during the replay.
+  hashmap<FrameworkID, hashmap<SlaveID, Resources>> allocated;
+  std::mutex mutex;
+
+  atomic<size_t> offerCount(0);
+
+  auto offerCallback = [&allocated, &mutex, &offerCount](
+      const FrameworkID& frameworkId,
+      const hashmap<SlaveID, Resources>& resources)
+  {
+    synchronized (mutex) {
+      foreachpair (const SlaveID& slaveId,
+                   const Resources& resources_,
+                   resources) {
+        allocated[frameworkId][slaveId] += resources_;
+      }
+    }
+
+    offerCount += resources.size();
+  };
+
+  Result<os::Process> process = os::process(::getpid());
+  Option<Bytes> rss = process.isSome() ? process.get().rss : None();
+
+  initialize(flags, offerCallback);
+
+  size_t skipped = 0;
+
+  // The time into the trace that has been replayed, the clock is
+  // advanced to the time of each event before replaying it. The
+  // clock is also settled whenever a batch allocation is due, so
+  // that they are performed at the same points in the replay as
+  // in the trace.
+  Duration elapsed = Duration::zero();
+  Duration batch = flags.allocation_interval;
+
+  Stopwatch watch;
+  watch.start();
+
+  foreach (const AllocatorTraceEvent& event, events) {
+    const Duration time = Nanoseconds(event.nanoseconds());
+
+    if (time > elapsed) {
+      Clock::advance(time - elapsed);
+      elapsed = time;
+
+      if (elapsed >= batch) {
+        Clock::settle();
+
+        while (batch <= elapsed) {
+          batch += flags.allocation_interval;
+        }
+      }
+    }
+
+    const vector<Offer::Operation> operations(
+        event.operations().begin(),
+        event.operations().end());
+
+    switch (event.type()) {
+      case AllocatorTraceEvent::ADD_FRAMEWORK: {
+        hashmap<SlaveID, Resources> used;
+        foreach (const AllocatorTraceEvent::Used& used_, event.used()) {
+          used[used_.slave_id()] += used_.resources();
+        }
+
+        synchronized (mutex) {
+          foreachpair (const SlaveID& slaveId,
+                       const Resources& resources,
+                       used) {
+            allocated[event.framework_id()][slaveId] += resources;
+          }
+        }
+
+        allocator->addFramework(
+            event.framework_id(), event.framework_info(), used);
+        break;
+      }
+      case AllocatorTraceEvent::REMOVE_FRAMEWORK: {
+        synchronized (mutex) {
+          allocated.erase(event.framework_id());
+        }
+
+        allocator->removeFramework(event.framework_id());
+        break;
+      }
+      case AllocatorTraceEvent::ACTIVATE_FRAMEWORK: {
+        allocator->activateFramework(event.framework_id());
+        break;
+      }
+      case AllocatorTraceEvent::DEACTIVATE_FRAMEWORK: {
+        allocator->deactivateFramework(event.framework_id());
+        break;
+      }
+      case AllocatorTraceEvent::UPDATE_FRAMEWORK: {
+        allocator->updateFramework(
+            event.framework_id(), event.framework_info());
+        break;
+      }
+      case AllocatorTraceEvent::ADD_SLAVE: {
+        hashmap<FrameworkID, Resources> used;
+        foreach (const AllocatorTraceEvent::Used& used_, event.used()) {
+          used[used_.framework_id()] += used_.resources();
+        }
+
+        synchronized (mutex) {
+          foreachpair (const FrameworkID& frameworkId,
+                       const Resources& resources,
+                       used) {
+            allocated[frameworkId][event.slave_id()] += resources;
+          }
+        }
+
+        allocator->addSlave(
+            event.slave_id(),
+            event.slave_info(),
+            event.has_unavailability()
+              ? Option<Unavailability>(event.unavailability())
+              : None(),
+            event.resources(),
+            used);
+        break;
+      }
+      case AllocatorTraceEvent::REMOVE_SLAVE: {
+        synchronized (mutex) {
+          foreachkey (const FrameworkID& frameworkId, allocated) {
+            allocated[frameworkId].erase(event.slave_id());
+          }
+        }
+
+        allocator->removeSlave(event.slave_id());
+        break;
+      }
+      case AllocatorTraceEvent::UPDATE_SLAVE: {
+        allocator->updateSlave(event.slave_id(), event.resources());
+        break;
+      }
+      case AllocatorTraceEvent::ACTIVATE_SLAVE: {
+        allocator->activateSlave(event.slave_id());
+        break;
+      }
+      case AllocatorTraceEvent::DEACTIVATE_SLAVE: {
+        allocator->deactivateSlave(event.slave_id());
+        break;
+      }
+      case AllocatorTraceEvent::UPDATE_ALLOCATION: {
+        bool applied = false;
+
+        synchronized (mutex) {
+          Resources& resources =
+            allocated[event.framework_id()][event.slave_id()];
+
+          Try<Resources> updated = resources.apply(operations);
+          if (updated.isSome()) {
+            resources = updated.get();
+            applied = true;
+          }
+        }
+
+        if (!applied) {
+          skipped++;
+          break;
+        }
+
+        allocator->updateAllocation(
+            event.framework_id(), event.slave_id(), operations);
+        break;
+      }
+      case AllocatorTraceEvent::UPDATE_AVAILABLE: {
+        allocator->updateAvailable(event.slave_id(), operations);
+        break;
+      }
+      case AllocatorTraceEvent::RECOVER_RESOURCES: {
+        // If the resources were not allocated during the replay, we
+        // recover what was allocated instead, e.g., the resources
+        // that were offered instead of the declined ones.
+        Resources recovered = event.resources();
+
+        synchronized (mutex) {
+          Resources& resources =
+            allocated[event.framework_id()][event.slave_id()];
+
+          if (!resources.contains(recovered)) {
+            recovered = resources;
+          }
+
+          resources -= recovered;
+        }
+
+        if (recovered.empty()) {
+          skipped++;
+          break;
+        }
+
+        allocator->recoverResources(
+            event.framework_id(),
+            event.slave_id(),
+            recovered,
+            event.has_filters() ? Option<Filters>(event.filters()) : None());
+        break;
+      }
+      case AllocatorTraceEvent::SUPPRESS_OFFERS: {
+        allocator->suppressOffers(event.framework_id());
+        break;
+      }
+      case AllocatorTraceEvent::REVIVE_OFFERS: {
+        allocator->reviveOffers(event.framework_id());
+        break;
+      }
+      case AllocatorTraceEvent::SET_QUOTA: {
+        Quota quota;
+        quota.info = event.quota();
+
+        allocator->setQuota(event.role(), quota);
+        break;
+      }
+      case AllocatorTraceEvent::REMOVE_QUOTA: {
+        allocator->removeQuota(event.role());
+        break;
+      }
+      case AllocatorTraceEvent::UNKNOWN: {
+        skipped++;
+        break;
+      }
+    }
+  }
+
+  // Wait for all the calls to be processed.
+  Clock::settle();
+
+  const Duration duration = watch.elapsed();
+
+  cout << "Replayed " << events.size() << " calls (" << skipped
+       << " skipped) spanning " << elapsed << " in " << duration << endl;
+
+  cout << "Made " << offerCount.load() << " offers ("
+       << offerCount.load() / duration.secs() << " per second)" << endl;
+
+  JSON::Object metrics = Metrics();
+
+  cout << "Performed " << metrics.values["allocator/allocation_runs"]
+       << " allocation runs, taking";
+
+  foreach (const string& statistic,
+           vector<string>({"p50", "p90", "p99", "max"})) {
+    const string key = "allocator/allocation_run_ms/" + statistic;
+    if (metrics.values.count(key) > 0) {
+      cout << " " << metrics.values[key] << "ms (" << statistic << ")";
+    }
+  }
+
+  cout << endl;
+
+  process = os::process(::getpid());
+  if (rss.isSome() && process.isSome() && process.get().rss.isSome()) {
+    cout << "Resident memory grew from " << rss.get()
+         << " to " << process.get().rss.get() << " during the replay" << endl;
+  }
+
+  Clock::resume();
+}
+
+
+class HierarchicalAllocatorShards_BENCHMARK_Test
+  : public HierarchicalAllocatorTestBase,
+    public WithParamInterface<size_t> {};
+
+
+// The sharded allocation benchmark is parameterized by the number
+// of allocation shards.
+INSTANTIATE_TEST_CASE_P(
+    ShardCount,
+    HierarchicalAllocatorShards_BENCHMARK_Test,
+    ::testing::Values(1U, 2U, 4U, 8U));
+
+
+// This benchmark measures allocation cycles over a large cluster in
+// which frameworks have filtered most of the agents, so that every
+// cycle evaluates every agent, depending on the number of shards the
+// agents are evaluated in.
+TEST_P(HierarchicalAllocatorShards_BENCHMARK_Test, FilteredAgents)
+{
+  const size_t shardCount = GetParam();
+  const size_t frameworkCount = 200;
+  const size_t slaveCount = 10000;
+  const size_t roundCount = 5;
+
+  master::Flags flags;
+  flags.allocation_shards = shardCount;
+
+  // Choose an interval longer than the time we expect a single cycle
+  // to take so that we don't back up the process queue.
+  flags.allocation_interval = Hours(1);
+
+  Clock::pause();
+
+  struct OfferedResources {
+    FrameworkID   frameworkId;
+    SlaveID       slaveId;
+    Resources     resources;
+  };
+
+  vector<OfferedResources> offers;
+
+  auto offerCallback = [&offers](
+      const FrameworkID& frameworkId,
+      const hashmap<SlaveID, Resources>& resources_)
+  {
+    for (auto resources : resources_) {
+      offers.push_back(
+          OfferedResources{frameworkId, resources.first, resources.second});
+    }
+  };
+
+  cout << "Using " << slaveCount << " slaves, "
+       << frameworkCount << " frameworks and "
+       << shardCount << " shard(s)" << endl;
+
+  initialize(flags, offerCallback);
+
+  vector<FrameworkInfo> frameworks;
+  frameworks.reserve(frameworkCount);
+
+  for (unsigned i = 0; i < frameworkCount; ++i) {
+    frameworks.push_back(createFrameworkInfo("role" + stringify(i % 10)));
+    allocator->addFramework(frameworks[i].id(), frameworks[i], {});
+  }
+
+  for (unsigned i = 0; i < slaveCount; ++i) {
+    SlaveInfo slave = createSlaveInfo(
+        "cpus:24;mem:4096;disk:4096;ports:[31000-32000]");
+
+    allocator->addSlave(slave.id(), slave, None(), slave.resources(), {});
+  }
+
+  // Wait for all the 'addSlave' operations to be processed.
+  Clock::settle();
+
+  for (unsigned round = 0; round < roundCount; ++round) {
+    // Permanently decline any offered resources.
+    foreach (const OfferedResources& offer, offers) {
+      Filters filters;
+      filters.set_refuse_seconds(INT_MAX);
+
+      allocator->recoverResources(
+          offer.frameworkId, offer.slaveId, offer.resources, filters);
+    }
+
+    // Wait for the declined offers.
+    Clock::settle();
+    offers.clear();
+
+    Stopwatch watch;
+    watch.start();
+
+    // Advance the clock and trigger a background allocation cycle.
+    Clock::advance(flags.allocation_interval);
+    Clock::settle();
+
+    cout << "round " << round
+         << " allocate took " << watch.elapsed()
+         << " to make " << offers.size() << " offers"
+         << endl;
+  }
+
+  Clock::resume();
+}
+
+
+class HierarchicalAllocatorOrdering_BENCHMARK_Test
+  : public HierarchicalAllocatorTestBase,
+    public WithParamInterface<string> {};
+
+
+// The agent ordering benchmark is parameterized by the ordering.
+INSTANTIATE_TEST_CASE_P(
+    AgentOrdering,
+    HierarchicalAllocatorOrdering_BENCHMARK_Test,
+    ::testing::Values("random", "spread", "binpack"));
+
+
+// This benchmark measures how well the tasks of the frameworks fit
+// into their offers, depending on the agent ordering. Some frameworks
+// launch small tasks and some launch large tasks, a number of them
+// every round. Each framework launches as many of its pending tasks
+// as fit into an offer and declines the rest of it; an offer is
+// accepted if at least one task is launched. The tasks finish after
+// a few rounds.
+TEST_P(HierarchicalAllocatorOrdering_BENCHMARK_Test, TaskPlacement)
+{
+  const string agentOrdering = GetParam();
+  const size_t smallFrameworkCount = 40;
+  const size_t largeFrameworkCount = 10;
+  const size_t slaveCount = 200;
+  const size_t roundCount = 50;
+  const size_t taskRounds = 5;
+
+  master::Flags flags;
+  flags.agent_ordering = agentOrdering;
+
+  // Choose an interval longer than the time we expect a single cycle
+  // to take so that we don't back up the process queue.
+  flags.allocation_interval = Hours(1);
+
+  Clock::pause();
+
+  struct OfferedResources {
+    FrameworkID   frameworkId;
+    SlaveID       slaveId;
+    Resources     resources;
+  };
+
+  vector<OfferedResources> offers;
+
+  auto offerCallback = [&offers](
+      const FrameworkID& frameworkId,
+      const hashmap<SlaveID, Resources>& resources_)
+  {
+    for (auto resources : resources_) {
+      offers.push_back(
+          OfferedResources{frameworkId, resources.first, resources.second});
+    }
+  };
+
+  cout << "Using " << slaveCount << " slaves, "
+       << smallFrameworkCount + largeFrameworkCount << " frameworks and "
+       << "'" << agentOrdering << "' agent ordering" << endl;
+
+  initialize(flags, offerCallback);
+
+  struct Framework
+  {
+    bool large;
+    Resources task;
+    size_t tasksPerRound;
+    size_t pending;
+    size_t launched;
+  };
+
+  hashmap<FrameworkID, Framework> frameworks;
+
+  for (size_t i = 0; i < smallFrameworkCount + largeFrameworkCount; i++) {
+    const bool large = i >= smallFrameworkCount;
+
+    FrameworkInfo framework = createFrameworkInfo(large ? "large" : "small");
+
+    frameworks[framework.id()] = large
+      ? Framework{true, Resources::parse("cpus:12;mem:24576").get(), 2, 0, 0}
+      : Framework{false, Resources::parse("cpus:1;mem:2048").get(), 10, 0, 0};
+
+    allocator->addFramework(framework.id(), framework, {});
+  }
+
+  for (size_t i = 0; i < slaveCount; i++) {
+    SlaveInfo slave = createSlaveInfo("cpus:16;mem:32768;disk:4096");
+
+    allocator->addSlave(slave.id(), slave, None(), slave.resources(), {});
+  }
+
+  // Wait for all the 'addSlave' operations to be processed.
+  Clock::settle();
+
+  struct Task
+  {
+    FrameworkID frameworkId;
+    SlaveID slaveId;
+    Resources resources;
+    size_t finished;
+  };
+
+  vector<Task> tasks;
+
+  size_t offerCount = 0;
+  size_t acceptedCount = 0;
+  Duration elapsed;
+
+  for (size_t round = 0; round < roundCount; round++) {
+    // Finish the tasks that have been running long enough.
+    vector<Task> running;
+
+    foreach (const Task& task, tasks) {
+      if (task.finished <= round) {
+        allocator->recoverResources(
+            task.frameworkId, task.slaveId, task.resources, None());
+      } else {
+        running.push_back(task);
+      }
+    }
+
+    tasks.swap(running);
+
+    foreachvalue (Framework& framework, frameworks) {
+      framework.pending += framework.tasksPerRound;
+    }
+
+    // Wait for the recovered resources.
+    Clock::settle();
+
+    Stopwatch watch;
+    watch.start();
+
+    // Advance the clock and trigger a background allocation cycle.
+    Clock::advance(flags.allocation_interval);
+    Clock::settle();
+
+    elapsed += watch.elapsed();
+
+    // Launch the pending tasks that fit and decline the rest.
+    foreach (const OfferedResources& offer, offers) {
+      Framework& framework = frameworks[offer.frameworkId];
+
+      Resources remaining = offer.resources;
+      bool accepted = false;
+
+      while (framework.pending > 0 && remaining.contains(framework.task)) {
+        remaining -= framework.task;
+
+        tasks.push_back(Task{
+            offer.frameworkId,
+            offer.slaveId,
+            framework.task,
+            round + taskRounds});
+
+        framework.pending--;
+        framework.launched++;
+        accepted = true;
+      }
+
+      offerCount++;
+      if (accepted) {
+        acceptedCount++;
+      }
+
+      allocator->recoverResources(
+          offer.frameworkId, offer.slaveId, remaining, None());
+    }
+
+    offers.clear();
+  }
+
+  size_t launched[2] = {0, 0};
+  size_t pending[2] = {0, 0};
+
+  foreachvalue (const Framework& framework, frameworks) {
+    launched[framework.large] += framework.launched;
+    pending[framework.large] += framework.pending;
+  }
+
+  cout << roundCount << " allocations took " << elapsed
+       << " to make " << offerCount << " offers, of which "
+       << acceptedCount << " ("
+       << (offerCount > 0 ? 100.0 * acceptedCount / offerCount : 0.0)
+       << "%) were accepted" << endl;
+
+  cout << "Launched " << launched[0] << " small tasks ("
+       << pending[0] << " pending) and " << launched[1] << " large tasks ("
+       << pending[1] << " pending)" << endl;
+
+  Clock::resume();
+}
+
 } // namespace tests {
 } // namespace internal {
 } // namespace mesos {
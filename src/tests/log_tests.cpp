@@ -16,9 +16,12 @@
 
 #include <stdint.h>
 
+#include <algorithm>
+#include <iostream>
 #include <list>
 #include <set>
 #include <string>
+#include <vector>
 
 #include <gmock/gmock.h>
 
@@ -32,12 +35,14 @@
 #include <process/protobuf.hpp>
 #include <process/shared.hpp>
 
+#include <stout/bytes.hpp>
 #include <stout/gtest.hpp>
 #include <stout/none.hpp>
 #include <stout/option.hpp>
 #include <stout/os.hpp>
 #include <stout/path.hpp>
 #include <stout/stopwatch.hpp>
+#include <stout/strings.hpp>
 #include <stout/try.hpp>
 
 #include <stout/tests/utils.hpp>
@@ -62,14 +67,18 @@ using namespace mesos::internal::log;
 
 using namespace process;
 
+using std::cout;
+using std::endl;
 using std::list;
 using std::set;
 using std::string;
+using std::vector;
 
 using testing::_;
 using testing::Eq;
 using testing::Invoke;
 using testing::Return;
+using testing::WithParamInterface;
 
 namespace mesos {
 namespace internal {
@@ -316,6 +325,158 @@ TYPED_TEST(LogStorageTest, TruncateWithManyHoles)
 }
 
 
+// Verifies that metadata and actions persisted with a single write
+// (including a truncation) are all restored.
+TYPED_TEST(LogStorageTest, PersistBatch)
+{
+  const string path = os::getcwd() + "/.log";
+
+  {
+    TypeParam storage;
+
+    Try<Storage::State> state = storage.restore(path);
+    ASSERT_SOME(state);
+
+    Metadata metadata;
+    metadata.set_status(Metadata::VOTING);
+    metadata.set_promised(2);
+
+    list<Action> actions;
+
+    for (uint64_t i = 0; i < 10; i++) {
+      Action action;
+      action.set_position(i);
+      action.set_promised(2);
+      action.set_performed(2);
+      action.set_learned(true);
+      action.set_type(Action::APPEND);
+      action.mutable_append()->set_bytes(stringify(i));
+      actions.push_back(action);
+    }
+
+    // Truncate to position 3 (at position 10).
+    Action truncate;
+    truncate.set_position(10);
+    truncate.set_promised(2);
+    truncate.set_performed(2);
+    truncate.set_learned(true);
+    truncate.set_type(Action::TRUNCATE);
+    truncate.mutable_truncate()->set_to(3);
+    actions.push_back(truncate);
+
+    ASSERT_SOME(storage.persist(metadata, actions));
+  }
+
+  TypeParam storage;
+
+  Try<Storage::State> state = storage.restore(path);
+  ASSERT_SOME(state);
+
+  EXPECT_EQ(Metadata::VOTING, state.get().metadata.status());
+  EXPECT_EQ(2u, state.get().metadata.promised());
+  EXPECT_EQ(3u, state.get().begin);
+  EXPECT_EQ(10u, state.get().end);
+
+  for (uint64_t i = 0; i < 10; i++) {
+    Try<Action> action = storage.read(i);
+
+    if (i < 3) {
+      EXPECT_ERROR(action);
+    } else {
+      ASSERT_SOME(action);
+      EXPECT_EQ(i, action.get().position());
+      ASSERT_TRUE(action.get().has_append());
+      EXPECT_EQ(stringify(i), action.get().append().bytes());
+    }
+  }
+}
+
+
+class LevelDBStorageTest : public TemporaryDirectoryTest {};
+
+
+// Verifies that a log written with the zero-padded decimal keys used
+// by earlier versions gets migrated to binary keys when restored.
+TEST_F(LevelDBStorageTest, MigrateKeys)
+{
+  const string path = os::getcwd() + "/.log";
+
+  {
+    leveldb::Options options;
+    options.create_if_missing = true;
+
+    leveldb::DB* db;
+    ASSERT_TRUE(leveldb::DB::Open(options, path, &db).ok());
+
+    Record record;
+    record.set_type(Record::METADATA);
+    record.mutable_metadata()->set_status(Metadata::VOTING);
+    record.mutable_metadata()->set_promised(1);
+
+    string value;
+    ASSERT_TRUE(record.SerializeToString(&value));
+    ASSERT_TRUE(db->Put(leveldb::WriteOptions(), "0000000000", value).ok());
+
+    // The keys are the positions plus 1.
+    for (uint64_t i = 0; i < 2000; i++) {
+      Record record;
+      record.set_type(Record::ACTION);
+
+      Action* action = record.mutable_action();
+      action->set_position(i);
+      action->set_promised(1);
+      action->set_performed(1);
+      action->set_learned(true);
+      action->set_type(Action::APPEND);
+      action->mutable_append()->set_bytes(stringify(i));
+
+      Try<string> key = strings::format("%010d", static_cast<int>(i + 1));
+      ASSERT_SOME(key);
+
+      ASSERT_TRUE(record.SerializeToString(&value));
+      ASSERT_TRUE(db->Put(leveldb::WriteOptions(), key.get(), value).ok());
+    }
+
+    delete db;
+  }
+
+  {
+    LevelDBStorage storage;
+
+    Try<Storage::State> state = storage.restore(path);
+    ASSERT_SOME(state);
+
+    EXPECT_EQ(Metadata::VOTING, state.get().metadata.status());
+    EXPECT_EQ(1u, state.get().metadata.promised());
+    EXPECT_EQ(0u, state.get().begin);
+    EXPECT_EQ(1999u, state.get().end);
+
+    for (uint64_t i = 0; i < 2000; i++) {
+      Try<Action> action = storage.read(i);
+      ASSERT_SOME(action);
+      EXPECT_EQ(stringify(i), action.get().append().bytes());
+    }
+  }
+
+  // All the keys must have been migrated.
+  leveldb::DB* db;
+  ASSERT_TRUE(leveldb::DB::Open(leveldb::Options(), path, &db).ok());
+
+  leveldb::Iterator* iterator = db->NewIterator(leveldb::ReadOptions());
+
+  size_t keys = 0;
+  for (iterator->SeekToFirst(); iterator->Valid(); iterator->Next()) {
+    EXPECT_EQ(sizeof(uint64_t), iterator->key().size());
+    keys++;
+  }
+
+  EXPECT_EQ(2001u, keys);
+
+  delete iterator;
+  delete db;
+}
+
+
 class ReplicaTest : public TemporaryDirectoryTest
 {
 protected:
@@ -437,6 +598,65 @@ TEST_F(ReplicaTest, Append)
 }
 
 
+// Verifies that a burst of writes to a replica that writes to its
+// storage from a separate process are all persisted (and survive a
+// restart).
+TEST_F(ReplicaTest, AsyncIO)
+{
+  const string path = os::getcwd() + "/.log";
+  initializer.flags.path = path;
+  initializer.execute();
+
+  const uint64_t proposal = 1;
+
+  {
+    Replica replica(path, true);
+
+    PromiseRequest request;
+    request.set_proposal(proposal);
+
+    Future<PromiseResponse> promising =
+      protocol::promise(replica.pid(), request);
+
+    AWAIT_READY(promising);
+    EXPECT_TRUE(promising.get().okay());
+
+    list<Future<WriteResponse> > writings;
+
+    for (uint64_t position = 1; position <= 10; position++) {
+      WriteRequest request;
+      request.set_proposal(proposal);
+      request.set_position(position);
+      request.set_learned(true);
+      request.set_type(Action::APPEND);
+      request.mutable_append()->set_bytes(stringify(position));
+
+      writings.push_back(protocol::write(replica.pid(), request));
+    }
+
+    uint64_t position = 1;
+    foreach (const Future<WriteResponse>& writing, writings) {
+      AWAIT_READY(writing);
+      EXPECT_TRUE(writing.get().okay());
+      EXPECT_EQ(position++, writing.get().position());
+    }
+  }
+
+  Replica replica(path, true);
+
+  Future<list<Action> > actions = replica.read(1, 10);
+
+  AWAIT_READY(actions);
+  ASSERT_EQ(10u, actions.get().size());
+
+  foreach (const Action& action, actions.get()) {
+    EXPECT_TRUE(action.learned());
+    ASSERT_EQ(Action::APPEND, action.type());
+    EXPECT_EQ(stringify(action.position()), action.append().bytes());
+  }
+}
+
+
 TEST_F(ReplicaTest, Restore)
 {
   const string path = os::getcwd() + "/.log";
@@ -1270,6 +1490,120 @@ TEST_F(CoordinatorTest, MultipleAppendsNotLearnedFill)
 }
 
 
+// Verifies that appends can be pipelined: the appends are made
+// without waiting for the previous ones to finish, more than the
+// coordinator keeps pending at a time, and they are still written to
+// consecutive positions and returned in order.
+TEST_F(CoordinatorTest, PipelinedAppends)
+{
+  const string path1 = os::getcwd() + "/.log1";
+  initializer.flags.path = path1;
+  initializer.execute();
+
+  const string path2 = os::getcwd() + "/.log2";
+  initializer.flags.path = path2;
+  initializer.execute();
+
+  Shared<Replica> replica1(new Replica(path1));
+  Shared<Replica> replica2(new Replica(path2));
+
+  set<UPID> pids;
+  pids.insert(replica1->pid());
+  pids.insert(replica2->pid());
+
+  Shared<Network> network(new Network(pids));
+
+  Coordinator coord(2, replica1, network, 3);
+
+  {
+    Future<Option<uint64_t> > electing = coord.elect();
+    AWAIT_READY(electing);
+    EXPECT_SOME_EQ(0u, electing.get());
+  }
+
+  list<Future<Option<uint64_t> > > appendings;
+  for (uint64_t position = 1; position <= 10; position++) {
+    appendings.push_back(coord.append(stringify(position)));
+  }
+
+  uint64_t position = 1;
+  foreach (const Future<Option<uint64_t> >& appending, appendings) {
+    AWAIT_READY(appending);
+    EXPECT_SOME_EQ(position++, appending.get());
+  }
+
+  {
+    Future<list<Action> > actions = replica1->read(1, 10);
+    AWAIT_READY(actions);
+    EXPECT_EQ(10u, actions.get().size());
+    foreach (const Action& action, actions.get()) {
+      ASSERT_TRUE(action.has_type());
+      ASSERT_EQ(Action::APPEND, action.type());
+      EXPECT_EQ(stringify(action.position()), action.append().bytes());
+    }
+  }
+
+  // All the writes are done, so the coordinator can be demoted.
+  AWAIT_EXPECT_EQ(10u, coord.demote());
+}
+
+
+// Verifies that once a pipelined append is discarded, the appends
+// after it return none and the coordinator is demoted.
+TEST_F(CoordinatorTest, PipelinedAppendsDiscarded)
+{
+  const string path1 = os::getcwd() + "/.log1";
+  initializer.flags.path = path1;
+  initializer.execute();
+
+  const string path2 = os::getcwd() + "/.log2";
+  initializer.flags.path = path2;
+  initializer.execute();
+
+  Shared<Replica> replica1(new Replica(path1));
+  Shared<Replica> replica2(new Replica(path2));
+
+  set<UPID> pids;
+  pids.insert(replica1->pid());
+  pids.insert(replica2->pid());
+
+  Shared<Network> network(new Network(pids));
+
+  Coordinator coord(2, replica1, network, 2);
+
+  {
+    Future<Option<uint64_t> > electing = coord.elect();
+    AWAIT_READY(electing);
+    EXPECT_SOME_EQ(0u, electing.get());
+  }
+
+  process::terminate(replica2->pid());
+  process::wait(replica2->pid());
+  replica2.reset();
+
+  Future<Option<uint64_t> > appending1 = coord.append("hello");
+  Future<Option<uint64_t> > appending2 = coord.append("world");
+  Future<Option<uint64_t> > appending3 = coord.append("!");
+
+  ASSERT_TRUE(appending1.isPending());
+
+  appending1.discard();
+  AWAIT_DISCARDED(appending1);
+
+  AWAIT_READY(appending2);
+  EXPECT_NONE(appending2.get());
+
+  AWAIT_READY(appending3);
+  EXPECT_NONE(appending3.get());
+
+  {
+    Future<Option<uint64_t> > appending = coord.append("hello moto");
+    AWAIT_READY(appending);
+    EXPECT_NONE(appending.get());
+  }
+}
+
+
 TEST_F(CoordinatorTest, Truncate)
 {
   const string path1 = os::getcwd() + "/.log1";
@@ -1638,6 +1972,88 @@ TEST_F(CoordinatorTest, RecoveryRace)
 }
 
 
+class Coordinator_BENCHMARK_Test
+  : public TemporaryDirectoryTest,
+    public WithParamInterface<size_t>
+{
+protected:
+  // For initializing the log.
+  tool::Initialize initializer;
+};
+
+
+// The coordinator benchmark tests are parameterized by the maximum
+// number of pending writes, where 1 means no pipelining.
+INSTANTIATE_TEST_CASE_P(
+    MaxPendingWrites,
+    Coordinator_BENCHMARK_Test,
+    ::testing::Values(1U, 8U, 32U, 128U));
+
+
+// Measures the throughput and the latency of appends to a log with
+// three in-process replicas, when the appends are made all at once.
+TEST_P(Coordinator_BENCHMARK_Test, Append)
+{
+  set<UPID> pids;
+  vector<Shared<Replica> > replicas;
+
+  for (size_t i = 0; i < 3; i++) {
+    const string path = os::getcwd() + "/.log" + stringify(i);
+    initializer.flags.path = path;
+    initializer.execute();
+
+    Shared<Replica> replica(new Replica(path));
+    replicas.push_back(replica);
+    pids.insert(replica->pid());
+  }
+
+  Shared<Network> network(new Network(pids));
+
+  Coordinator coord(2, replicas[0], network, GetParam());
+
+  {
+    Future<Option<uint64_t> > electing = coord.elect();
+    AWAIT_READY(electing);
+    EXPECT_SOME_EQ(0u, electing.get());
+  }
+
+  const size_t count = 1000;
+  const string bytes(1024, 'x');
+
+  // The latencies are only written by the callbacks of the appends,
+  // each to its own element.
+  vector<Duration> latencies(count);
+
+  Stopwatch watch;
+  watch.start();
+
+  Future<Option<uint64_t> > appending;
+  for (size_t i = 0; i < count; i++) {
+    const Duration started = watch.elapsed();
+
+    appending = coord.append(bytes)
+      .onReady([&latencies, &watch, started, i]() {
+        latencies[i] = watch.elapsed() - started;
+      });
+  }
+
+  AWAIT_READY_FOR(appending, Minutes(5));
+  EXPECT_SOME_EQ(count, appending.get());
+
+  const Duration elapsed = watch.elapsed();
+
+  std::sort(latencies.begin(), latencies.end());
+
+  cout << "Appended " << count << " entries of " << Bytes(bytes.size())
+       << " with at most " << GetParam() << " pending writes in " << elapsed
+       << " (" << count / elapsed.secs() << " appends/s)" << endl;
+
+  cout << "Append latency: median " << latencies[count / 2]
+       << ", 99th percentile " << latencies[count * 99 / 100]
+       << ", max " << latencies.back() << endl;
+}
+
+
 class RecoverTest : public TemporaryDirectoryTest
 {
 protected:
@@ -1832,6 +2248,88 @@ TEST_F(RecoverTest, CatchupRetry)
 }
 
 
+// Verifies that the learned actions get transferred in bulk from the
+// VOTING replicas (skipping the replicas that are not VOTING), and
+// that the positions that have not been learned are left missing.
+TEST_F(RecoverTest, Transfer)
+{
+  const string path1 = os::getcwd() + "/.log1";
+  initializer.flags.path = path1;
+  initializer.execute();
+
+  const string path2 = os::getcwd() + "/.log2";
+  initializer.flags.path = path2;
+  initializer.execute();
+
+  const string path3 = os::getcwd() + "/.log3";
+  const string path4 = os::getcwd() + "/.log4";
+
+  Shared<Replica> replica1(new Replica(path1));
+  Shared<Replica> replica2(new Replica(path2));
+
+  set<UPID> pids;
+  pids.insert(replica1->pid());
+  pids.insert(replica2->pid());
+
+  Shared<Network> network1(new Network(pids));
+
+  Coordinator coord(2, replica1, network1);
+
+  {
+    Future<Option<uint64_t> > electing = coord.elect();
+    AWAIT_READY(electing);
+    EXPECT_SOME_EQ(0u, electing.get());
+  }
+
+  for (uint64_t position = 1; position <= 10; position++) {
+    Future<Option<uint64_t> > appending = coord.append(stringify(position));
+    AWAIT_READY(appending);
+    EXPECT_SOME_EQ(position, appending.get());
+  }
+
+  // Make sure that no replica learns the last append.
+  DROP_MESSAGES(Eq(LearnedMessage().GetTypeName()), _, _);
+
+  {
+    Future<Option<uint64_t> > appending = coord.append("11");
+    AWAIT_READY(appending);
+    EXPECT_SOME_EQ(11u, appending.get());
+  }
+
+  // Replica3 has an empty log, so it is not VOTING.
+  Shared<Replica> replica3(new Replica(path3));
+  Shared<Replica> replica4(new Replica(path4));
+
+  pids.insert(replica3->pid());
+  pids.insert(replica4->pid());
+
+  Shared<Network> network2(new Network(pids));
+
+  IntervalSet<uint64_t> positions(
+      Bound<uint64_t>::closed(0),
+      Bound<uint64_t>::closed(11));
+
+  // Use small ranges and a small window so that it takes a number of
+  // requests to transfer the actions.
+  Future<Nothing> transferring = transfer(replica4, network2, positions, 3, 2);
+  AWAIT_READY(transferring);
+
+  Future<IntervalSet<uint64_t> > missing = replica4->missing(0, 11);
+  AWAIT_READY(missing);
+  EXPECT_EQ(1u, missing.get().size());
+  EXPECT_TRUE(missing.get().contains(11));
+
+  Future<list<Action> > actions = replica4->read(1, 10);
+  AWAIT_READY(actions);
+  ASSERT_EQ(10u, actions.get().size());
+  foreach (const Action& action, actions.get()) {
+    EXPECT_TRUE(action.learned());
+    ASSERT_EQ(Action::APPEND, action.type());
+    EXPECT_EQ(stringify(action.position()), action.append().bytes());
+  }
+}
+
+
 TEST_F(RecoverTest, AutoInitialization)
 {
   const string path1 = os::getcwd() + "/.log1";
@@ -1970,6 +2468,90 @@ TEST_F(RecoverTest, AutoInitializationRetry)
 }
 
 
+class Recover_BENCHMARK_Test
+  : public TemporaryDirectoryTest,
+    public WithParamInterface<size_t> {};
+
+
+// The recover benchmark tests are parameterized by the number of
+// positions to catch-up.
+INSTANTIATE_TEST_CASE_P(
+    Positions,
+    Recover_BENCHMARK_Test,
+    ::testing::Values(10000U, 100000U, 1000000U));
+
+
+// Measures how long it takes a replica with an empty log to recover
+// (i.e., catch-up) a log that the two other replicas have learned.
+TEST_P(Recover_BENCHMARK_Test, Catchup)
+{
+  const size_t count = GetParam();
+  const string bytes(100, 'x');
+
+  set<UPID> pids;
+  vector<Shared<Replica> > replicas;
+
+  for (size_t i = 1; i <= 2; i++) {
+    const string path = os::getcwd() + "/.log" + stringify(i);
+
+    // Write the log to storage directly, as appending that many
+    // entries through a coordinator would take much longer than the
+    // recovery that we want to measure.
+    {
+      LevelDBStorage storage;
+      ASSERT_SOME(storage.restore(path));
+
+      Metadata metadata;
+      metadata.set_status(Metadata::VOTING);
+      metadata.set_promised(1);
+
+      list<Action> actions;
+
+      for (uint64_t position = 0; position < count; position++) {
+        Action action;
+        action.set_position(position);
+        action.set_promised(1);
+        action.set_performed(1);
+        action.set_learned(true);
+        action.set_type(Action::APPEND);
+        action.mutable_append()->set_bytes(bytes);
+
+        actions.push_back(action);
+
+        if (actions.size() == 10000 || position + 1 == count) {
+          ASSERT_SOME(storage.persist(metadata, actions));
+          actions.clear();
+        }
+      }
+    }
+
+    Shared<Replica> replica(new Replica(path));
+    pids.insert(replica->pid());
+    replicas.push_back(replica);
+  }
+
+  Owned<Replica> replica(new Replica(os::getcwd() + "/.log3"));
+  pids.insert(replica->pid());
+
+  Shared<Network> network(new Network(pids));
+
+  Stopwatch watch;
+  watch.start();
+
+  Future<Owned<Replica> > recovering = recover(2, replica, network);
+  AWAIT_READY_FOR(recovering, Minutes(30));
+
+  cout << "Recovered " << count << " positions in " << watch.elapsed()
+       << endl;
+
+  Future<IntervalSet<uint64_t> > missing =
+    recovering.get()->missing(0, count - 1);
+
+  AWAIT_READY(missing);
+  EXPECT_TRUE(missing.get().empty());
+}
+
+
 class LogTest : public TemporaryDirectoryTest
 {
 protected:
@@ -2541,6 +2541,84 @@ TEST_F(MasterTest, OfferTimeout)
 }
 
 
+// This test verifies that the offers include the URL and attributes
+// of the slave (which the outstanding offers on the slave share), and
+// that the metrics about the outstanding offers are updated as offers
+// are made and expire.
+TEST_F(MasterTest, OfferTimeoutMetrics)
+{
+  master::Flags masterFlags = MesosTest::CreateMasterFlags();
+  masterFlags.offer_timeout = Seconds(30);
+  Try<PID<Master>> master = StartMaster(masterFlags);
+  ASSERT_SOME(master);
+
+  slave::Flags slaveFlags = CreateSlaveFlags();
+  slaveFlags.attributes = "rack:abc";
+
+  Try<PID<Slave>> slave = StartSlave(slaveFlags);
+  ASSERT_SOME(slave);
+
+  MockScheduler sched;
+  MesosSchedulerDriver driver(
+    &sched, DEFAULT_FRAMEWORK_INFO, master.get(), DEFAULT_CREDENTIAL);
+
+  EXPECT_CALL(sched, registered(&driver, _, _));
+
+  Future<vector<Offer>> offers1;
+  Future<vector<Offer>> offers2;
+  EXPECT_CALL(sched, resourceOffers(&driver, _))
+    .WillOnce(FutureArg<1>(&offers1))
+    .WillOnce(FutureArg<1>(&offers2));
+
+  Future<Nothing> offerRescinded;
+  EXPECT_CALL(sched, offerRescinded(&driver, _))
+    .WillOnce(FutureSatisfy(&offerRescinded));
+
+  driver.start();
+
+  AWAIT_READY(offers1);
+  ASSERT_EQ(1u, offers1.get().size());
+
+  const Offer& offer = offers1.get()[0];
+  EXPECT_TRUE(offer.has_url());
+  EXPECT_EQ(slave.get().id, offer.url().path().substr(1));
+  ASSERT_EQ(1, offer.attributes_size());
+  EXPECT_EQ("rack", offer.attributes(0).name());
+  EXPECT_EQ("abc", offer.attributes(0).text().value());
+
+  JSON::Object stats = Metrics();
+  EXPECT_EQ(1u, stats.values["master/outstanding_offers"]);
+  EXPECT_EQ(1u, stats.values["master/offer_expiration_buckets"]);
+  EXPECT_LT(
+      0,
+      stats.values["master/outstanding_offers_bytes"]
+        .as<JSON::Number>().as<int64_t>());
+
+  Clock::pause();
+  Clock::advance(masterFlags.offer_timeout.get());
+  Clock::resume();
+
+  AWAIT_READY(offerRescinded);
+
+  // The resources are offered again after the rescind, in a new
+  // expiration bucket.
+  AWAIT_READY(offers2);
+  ASSERT_EQ(1u, offers2.get().size());
+  EXPECT_EQ(
+      Attributes(offers1.get()[0].attributes()),
+      Attributes(offers2.get()[0].attributes()));
+
+  stats = Metrics();
+  EXPECT_EQ(1u, stats.values["master/outstanding_offers"]);
+  EXPECT_EQ(1u, stats.values["master/offer_expiration_buckets"]);
+
+  driver.stop();
+  driver.join();
+
+  Shutdown();
+}
+
+
 // Offer should not be rescinded if it's accepted.
 TEST_F(MasterTest, OfferNotRescindedOnceUsed)
 {
@@ -2903,6 +2981,128 @@ TEST_F(MasterTest, StateEndpoint)
 }
 
 
+// This test verifies that the '/state' and '/slaves' endpoints are
+// streamed with a chunked 'Transfer-Encoding', including when the
+// response is wrapped for JSONP.
+TEST_F(MasterTest, StateEndpointStreaming)
+{
+  Try<PID<Master>> master = StartMaster();
+  ASSERT_SOME(master);
+
+  Future<SlaveRegisteredMessage> slaveRegisteredMessage =
+    FUTURE_PROTOBUF(SlaveRegisteredMessage(), _, _);
+
+  Try<PID<Slave>> slave = StartSlave();
+  ASSERT_SOME(slave);
+
+  AWAIT_READY(slaveRegisteredMessage);
+
+  {
+    Future<Response> response = process::http::get(master.get(), "state");
+
+    AWAIT_EXPECT_RESPONSE_STATUS_EQ(OK().status, response);
+    AWAIT_EXPECT_RESPONSE_HEADER_EQ(APPLICATION_JSON, "Content-Type", response);
+    AWAIT_EXPECT_RESPONSE_HEADER_EQ("chunked", "Transfer-Encoding", response);
+
+    Try<JSON::Object> parse = JSON::parse<JSON::Object>(response.get().body);
+    ASSERT_SOME(parse);
+
+    Result<JSON::Array> slaves = parse.get().find<JSON::Array>("slaves");
+    ASSERT_SOME(slaves);
+    ASSERT_EQ(1u, slaves.get().values.size());
+
+    EXPECT_SOME_EQ(
+        JSON::String(slaveRegisteredMessage.get().slave_id().value()),
+        slaves.get().values[0].as<JSON::Object>().find<JSON::String>("id"));
+  }
+
+  {
+    Future<Response> response =
+      process::http::get(master.get(), "slaves", "jsonp=callback");
+
+    AWAIT_EXPECT_RESPONSE_STATUS_EQ(OK().status, response);
+    AWAIT_EXPECT_RESPONSE_HEADER_EQ(
+        "text/javascript", "Content-Type", response);
+    AWAIT_EXPECT_RESPONSE_HEADER_EQ("chunked", "Transfer-Encoding", response);
+
+    const string& body = response.get().body;
+
+    ASSERT_TRUE(strings::startsWith(body, "callback("));
+    ASSERT_TRUE(strings::endsWith(body, ");"));
+
+    Try<JSON::Object> parse = JSON::parse<JSON::Object>(
+        body.substr(strlen("callback("), body.size() - strlen("callback();")));
+    ASSERT_SOME(parse);
+
+    Result<JSON::Array> slaves = parse.get().find<JSON::Array>("slaves");
+    ASSERT_SOME(slaves);
+    EXPECT_EQ(1u, slaves.get().values.size());
+  }
+
+  Shutdown();
+}
+
+
+// This test verifies that the state endpoints are served from
+// snapshots that are at most `--max_state_staleness` old, unless the
+// snapshots are bypassed with `fresh=true`.
+TEST_F(MasterTest, StateSnapshot)
+{
+  Clock::pause();
+
+  master::Flags flags = CreateMasterFlags();
+  flags.max_state_staleness = Seconds(10);
+
+  Try<PID<Master>> master = StartMaster(flags);
+  ASSERT_SOME(master);
+
+  // Returns the number of frameworks in the master's state.
+  auto frameworks = [&master](const Option<string>& query) -> size_t {
+    Future<Response> response =
+      process::http::get(master.get(), "state", query);
+
+    AWAIT_EXPECT_RESPONSE_STATUS_EQ(OK().status, response);
+
+    Try<JSON::Object> parse = JSON::parse<JSON::Object>(response.get().body);
+    CHECK_SOME(parse);
+
+    Result<JSON::Array> frameworks =
+      parse.get().find<JSON::Array>("frameworks");
+    CHECK_SOME(frameworks);
+
+    return frameworks.get().values.size();
+  };
+
+  // Take a snapshot without any frameworks.
+  EXPECT_EQ(0u, frameworks(None()));
+
+  MockScheduler sched;
+  MesosSchedulerDriver driver(
+      &sched, DEFAULT_FRAMEWORK_INFO, master.get(), DEFAULT_CREDENTIAL);
+
+  Future<Nothing> registered;
+  EXPECT_CALL(sched, registered(&driver, _, _))
+    .WillOnce(FutureSatisfy(&registered));
+
+  driver.start();
+
+  AWAIT_READY(registered);
+
+  // The snapshot is served until it is stale, unless bypassed.
+  EXPECT_EQ(0u, frameworks(None()));
+  EXPECT_EQ(1u, frameworks(string("fresh=true")));
+
+  Clock::advance(flags.max_state_staleness + Seconds(1));
+
+  EXPECT_EQ(1u, frameworks(None()));
+
+  driver.stop();
+  driver.join();
+
+  Shutdown();
+}
+
+
 TEST_F(MasterTest, StateSummaryEndpoint)
 {
   master::Flags flags = CreateMasterFlags();
@@ -15,6 +15,7 @@
 // limitations under the License.
 
 #include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <map>
 #include <set>
@@ -914,6 +915,63 @@ TEST_P(RegistrarTest, Bootstrap)
 }
 
 
+// This test verifies that the changes to the registry that are
+// stored as deltas, and the snapshots they are compacted into, are
+// recovered, including after disabling the deltas.
+TEST_P(RegistrarTest, Deltas)
+{
+  flags.registry_max_deltas = 2;
+
+  vector<SlaveInfo> infos;
+  for (int i = 0; i < 5; i++) {
+    SlaveInfo info = slave;
+    info.mutable_id()->set_value("slave" + stringify(i));
+    infos.push_back(info);
+  }
+
+  {
+    Registrar registrar(flags, state);
+    AWAIT_READY(registrar.recover(master));
+
+    // Admit the slaves one at a time, so that there are (compacted)
+    // deltas for each of them.
+    foreach (const SlaveInfo& info, infos) {
+      AWAIT_EQ(true, registrar.apply(Owned<Operation>(new AdmitSlave(info))));
+    }
+
+    AWAIT_EQ(true,
+             registrar.apply(Owned<Operation>(new RemoveSlave(infos[0]))));
+  }
+
+  {
+    Registrar registrar(flags, state);
+    Future<Registry> registry = registrar.recover(master);
+    AWAIT_READY(registry);
+
+    ASSERT_EQ(4, registry.get().slaves().slaves().size());
+    for (int i = 1; i < 5; i++) {
+      EXPECT_EQ(infos[i], registry.get().slaves().slaves(i - 1).info());
+    }
+
+    AWAIT_EQ(true,
+             registrar.apply(Owned<Operation>(new RemoveSlave(infos[1]))));
+  }
+
+  flags.registry_max_deltas = 0;
+
+  {
+    Registrar registrar(flags, state);
+    Future<Registry> registry = registrar.recover(master);
+    AWAIT_READY(registry);
+
+    ASSERT_EQ(3, registry.get().slaves().slaves().size());
+    for (int i = 2; i < 5; i++) {
+      EXPECT_EQ(infos[i], registry.get().slaves().slaves(i - 2).info());
+    }
+  }
+}
+
+
 class MockStorage : public Storage
 {
 public:
@@ -965,6 +1023,9 @@ TEST_P(RegistrarTest, StoreTimeout)
   EXPECT_CALL(storage, get(_))
     .WillOnce(Return(None()));
 
+  EXPECT_CALL(storage, names())
+    .WillOnce(Return(std::set<string>()));
+
   Future<Nothing> set;
   EXPECT_CALL(storage, set(_, _))
     .WillOnce(DoAll(FutureSatisfy(&set),
@@ -995,6 +1056,9 @@ TEST_P(RegistrarTest, Abort)
   EXPECT_CALL(storage, get(_))
     .WillOnce(Return(None()));
 
+  EXPECT_CALL(storage, names())
+    .WillOnce(Return(std::set<string>()));
+
   EXPECT_CALL(storage, set(_, _))
     .WillOnce(Return(Future<bool>(true)))              // Recovery.
     .WillOnce(Return(Future<bool>::failed("failure"))) // Failure.
@@ -1015,6 +1079,39 @@ class Registrar_BENCHMARK_Test
     public WithParamInterface<size_t> {};
 
 
+// A storage that counts the bytes that are stored through it.
+class CountingStorage : public Storage
+{
+public:
+  explicit CountingStorage(Storage* _storage)
+    : storage(_storage), bytes(0) {}
+
+  virtual Future<Option<Entry>> get(const string& name)
+  {
+    return storage->get(name);
+  }
+
+  virtual Future<bool> set(const Entry& entry, const UUID& uuid)
+  {
+    bytes += entry.ByteSize();
+    return storage->set(entry, uuid);
+  }
+
+  virtual Future<bool> expunge(const Entry& entry)
+  {
+    return storage->expunge(entry);
+  }
+
+  virtual Future<std::set<string>> names()
+  {
+    return storage->names();
+  }
+
+  Storage* storage;
+  std::atomic<uint64_t> bytes;
+};
+
+
 // The Registrar benchmark tests are parameterized by the number of slaves.
 INSTANTIATE_TEST_CASE_P(
     SlaveCount,
@@ -1094,6 +1191,86 @@ TEST_P(Registrar_BENCHMARK_Test, Performance)
   cout << "Removed " << slaveCount << " slaves in " << watch.elapsed() << endl;
 }
 
+
+// Measures the bytes stored per operation (i.e., the write
+// amplification) and the latency of the operations, when they are
+// applied one at a time (e.g., agents registering after a partition)
+// and either the whole registry or a delta is stored for each of them.
+TEST_P(Registrar_BENCHMARK_Test, Deltas)
+{
+  CountingStorage counting(storage);
+  State state(&counting);
+
+  Resources resources =
+    Resources::parse("cpus(*):1.0;mem(*):512;disk(*):2048").get();
+
+  auto createSlaveInfo = [&resources](const string& id) {
+    SlaveInfo info;
+    info.set_hostname("localhost");
+    info.mutable_id()->set_value(id);
+    info.mutable_resources()->MergeFrom(resources);
+    info.mutable_attributes()->MergeFrom(
+        Attributes::parse("foo:bar;baz:quux"));
+    return info;
+  };
+
+  size_t slaveCount = GetParam();
+
+  // Admit the slaves in bulk.
+  {
+    Registrar registrar(flags, &state);
+    AWAIT_READY(registrar.recover(master));
+
+    Future<bool> result;
+    for (size_t i = 0; i < slaveCount; i++) {
+      result = registrar.apply(Owned<Operation>(new AdmitSlave(
+          createSlaveInfo("201310101658-2280333834-5050-48574-" +
+                          stringify(i)))));
+    }
+    AWAIT_READY_FOR(result, Minutes(5));
+  }
+
+  const size_t operationCount = 100;
+
+  foreach (size_t maxDeltas, vector<size_t>({0, 100})) {
+    flags.registry_max_deltas = maxDeltas;
+
+    Registrar registrar(flags, &state);
+    AWAIT_READY(registrar.recover(master));
+
+    counting.bytes = 0;
+
+    Stopwatch watch;
+    watch.start();
+
+    // Admit, and then remove, slaves one at a time.
+    vector<SlaveInfo> infos;
+    for (size_t i = 0; i < operationCount; i++) {
+      infos.push_back(createSlaveInfo(
+          "registering-" + stringify(maxDeltas) + "-" + stringify(i)));
+
+      AWAIT_READY_FOR(
+          registrar.apply(Owned<Operation>(new AdmitSlave(infos.back()))),
+          Minutes(5));
+    }
+
+    foreach (const SlaveInfo& info, infos) {
+      AWAIT_READY_FOR(
+          registrar.apply(Owned<Operation>(new RemoveSlave(info))),
+          Minutes(5));
+    }
+
+    const Duration elapsed = watch.elapsed();
+
+    cout << "Applied " << 2 * operationCount << " operations on "
+         << slaveCount << " slaves with --registry_max_deltas="
+         << maxDeltas << " in " << elapsed << " ("
+         << elapsed / (2 * operationCount) << " per operation), storing "
+         << Bytes(counting.bytes / (2 * operationCount))
+         << " per operation" << endl;
+  }
+}
+
 } // namespace tests {
 } // namespace internal {
 } // namespace mesos {
@@ -25,6 +25,9 @@
 #include <stout/gtest.hpp>
 #include <stout/json.hpp>
 #include <stout/protobuf.hpp>
+#include <stout/stopwatch.hpp>
+
+#include "common/resource_quantities.hpp"
 
 #include "master/master.hpp"
 
@@ -32,6 +35,8 @@
 
 using namespace mesos::internal::master;
 
+using std::cout;
+using std::endl;
 using std::map;
 using std::ostringstream;
 using std::pair;
@@ -2150,6 +2155,168 @@ TEST(RevocableResourceTest, Filter)
   EXPECT_EQ(r2, (r1 + r2).nonRevocable());
 }
 
+
+TEST(ResourceQuantitiesTest, FromScalarResources)
+{
+  Resources resources = Resources::parse(
+      "cpus:1;mem:512;cpus(role1):2;ports:[1-10];disk:0").get();
+
+  ResourceQuantities quantities =
+    ResourceQuantities::fromScalarResources(resources);
+
+  // Only scalars with a positive quantity are kept, regardless of
+  // the role (or any other metadata) of the resource.
+  EXPECT_EQ(2u, quantities.size());
+  EXPECT_DOUBLE_EQ(3, quantities.get("cpus"));
+  EXPECT_DOUBLE_EQ(512, quantities.get("mem"));
+  EXPECT_DOUBLE_EQ(0, quantities.get("ports"));
+  EXPECT_DOUBLE_EQ(0, quantities.get("disk"));
+
+  EXPECT_TRUE(ResourceQuantities::fromScalarResources(Resources()).empty());
+}
+
+
+TEST(ResourceQuantitiesTest, Arithmetic)
+{
+  ResourceQuantities left = ResourceQuantities::fromScalarResources(
+      Resources::parse("cpus:1;mem:512").get());
+
+  ResourceQuantities right = ResourceQuantities::fromScalarResources(
+      Resources::parse("cpus:2;disk:1024").get());
+
+  ResourceQuantities sum = left + right;
+  EXPECT_DOUBLE_EQ(3, sum.get("cpus"));
+  EXPECT_DOUBLE_EQ(512, sum.get("mem"));
+  EXPECT_DOUBLE_EQ(1024, sum.get("disk"));
+
+  EXPECT_EQ(left, sum - right);
+  EXPECT_EQ(right, sum - left);
+
+  // Names that drop to zero (or below) are removed.
+  ResourceQuantities difference = left - right;
+  EXPECT_EQ(1u, difference.size());
+  EXPECT_DOUBLE_EQ(512, difference.get("mem"));
+
+  ResourceQuantities quantities;
+  quantities += left;
+  quantities += right;
+  EXPECT_EQ(sum, quantities);
+
+  quantities -= sum;
+  EXPECT_TRUE(quantities.empty());
+}
+
+
+TEST(ResourceQuantitiesTest, Contains)
+{
+  ResourceQuantities small = ResourceQuantities::fromScalarResources(
+      Resources::parse("cpus:1;mem:512").get());
+
+  ResourceQuantities large = ResourceQuantities::fromScalarResources(
+      Resources::parse("cpus:2;mem:1024;disk:1").get());
+
+  EXPECT_TRUE(large.contains(small));
+  EXPECT_FALSE(small.contains(large));
+  EXPECT_TRUE(small.contains(small));
+  EXPECT_TRUE(small.contains(ResourceQuantities()));
+  EXPECT_FALSE(ResourceQuantities().contains(small));
+}
+
+
+TEST(ResourceQuantitiesTest, ToUnreservedResources)
+{
+  Resources resources = Resources::parse(
+      "cpus:1;mem(role1):512;disk(role1):1024;ports:[1-10]").get();
+
+  ResourceQuantities quantities =
+    ResourceQuantities::fromScalarResources(resources);
+
+  // The roles are dropped and non-scalars are not kept.
+  EXPECT_EQ(Resources::parse("cpus:1;mem:512;disk:1024").get(),
+            quantities.toUnreservedResources());
+
+  EXPECT_TRUE(ResourceQuantities().toUnreservedResources().empty());
+}
+
+
+TEST(ResourceQuantitiesTest, Printing)
+{
+  ResourceQuantities quantities;
+  quantities.set("mem", 512);
+  quantities.set("cpus", 1.5);
+
+  ostringstream stream;
+  stream << quantities;
+
+  // The quantities are sorted by name.
+  EXPECT_EQ("cpus:1.5;mem:512", stream.str());
+}
+
+
+// Compares the cost of the arithmetic the allocator and sorter do on
+// every allocation when it is done with 'Resources' versus when it
+// is done with 'ResourceQuantities'.
+TEST(Resources_BENCHMARK_Test, Arithmetic)
+{
+  const size_t iterations = 100000;
+
+  const Resources total = Resources::parse(
+      "cpus:24;mem:65536;disk:1048576;ports:[31000-32000]").get();
+
+  const Resources allocation = Resources::parse(
+      "cpus:0.1;mem:32;disk:64;ports:[31000-31001]").get();
+
+  Stopwatch watch;
+
+  Resources resources;
+
+  watch.start();
+  for (size_t i = 0; i < iterations; i++) {
+    resources += allocation;
+    resources -= allocation;
+  }
+  watch.stop();
+
+  cout << "Took " << watch.elapsed() << " to add and subtract "
+       << iterations << " times using Resources" << endl;
+
+  watch.start();
+  for (size_t i = 0; i < iterations; i++) {
+    EXPECT_TRUE(total.contains(allocation));
+  }
+  watch.stop();
+
+  cout << "Took " << watch.elapsed() << " to check containment "
+       << iterations << " times using Resources" << endl;
+
+  const ResourceQuantities totalQuantities =
+    ResourceQuantities::fromScalarResources(total);
+
+  const ResourceQuantities allocationQuantities =
+    ResourceQuantities::fromScalarResources(allocation);
+
+  ResourceQuantities quantities;
+
+  watch.start();
+  for (size_t i = 0; i < iterations; i++) {
+    quantities += allocationQuantities;
+    quantities -= allocationQuantities;
+  }
+  watch.stop();
+
+  cout << "Took " << watch.elapsed() << " to add and subtract "
+       << iterations << " times using ResourceQuantities" << endl;
+
+  watch.start();
+  for (size_t i = 0; i < iterations; i++) {
+    EXPECT_TRUE(totalQuantities.contains(allocationQuantities));
+  }
+  watch.stop();
+
+  cout << "Took " << watch.elapsed() << " to check containment "
+       << iterations << " times using ResourceQuantities" << endl;
+}
+
 } // namespace tests {
 } // namespace internal {
 } // namespace mesos {
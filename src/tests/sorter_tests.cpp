@@ -447,6 +447,60 @@ TEST(SorterTest, RevocableResources)
   EXPECT_EQ("b", sorted.back());
 }
 
+
+// This test verifies that the quantities of a client's allocation
+// are kept up to date, regardless of the roles and disk information
+// of the allocated resources.
+TEST(SorterTest, AllocationQuantities)
+{
+  DRFSorter sorter;
+
+  SlaveID slaveA;
+  slaveA.set_value("slaveA");
+
+  SlaveID slaveB;
+  slaveB.set_value("slaveB");
+
+  sorter.add("a");
+
+  sorter.add(slaveA, Resources::parse("cpus:10;mem:100;disk(role):10").get());
+  sorter.add(slaveB, Resources::parse("cpus:10;mem:100").get());
+
+  EXPECT_TRUE(sorter.allocationQuantities("a").empty());
+
+  sorter.allocated(
+      "a", slaveA, Resources::parse("cpus:2;mem:20;disk(role):10").get());
+  sorter.allocated("a", slaveB, Resources::parse("cpus:3;mem:30").get());
+
+  EXPECT_EQ(
+      ResourceQuantities::fromScalarResources(
+          Resources::parse("cpus:5;mem:50;disk:10").get()),
+      sorter.allocationQuantities("a"));
+
+  // Creating a persistent volume does not change the quantities.
+  Resource volume = Resources::parse("disk", "10", "role").get();
+  volume.mutable_disk()->mutable_persistence()->set_id("ID");
+  volume.mutable_disk()->mutable_volume()->set_container_path("data");
+
+  Resources oldAllocation = sorter.allocation("a", slaveA);
+  Try<Resources> newAllocation = oldAllocation.apply(CREATE(volume));
+  ASSERT_SOME(newAllocation);
+
+  sorter.update("a", slaveA, oldAllocation, newAllocation.get());
+
+  EXPECT_EQ(
+      ResourceQuantities::fromScalarResources(
+          Resources::parse("cpus:5;mem:50;disk:10").get()),
+      sorter.allocationQuantities("a"));
+
+  sorter.unallocated("a", slaveB, Resources::parse("cpus:3;mem:30").get());
+
+  EXPECT_EQ(
+      ResourceQuantities::fromScalarResources(
+          Resources::parse("cpus:2;mem:20;disk:10").get()),
+      sorter.allocationQuantities("a"));
+}
+
 } // namespace tests {
 } // namespace internal {
 } // namespace mesos {
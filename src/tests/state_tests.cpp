@@ -29,6 +29,7 @@
 #include <process/protobuf.hpp>
 #include <process/pid.hpp>
 
+#include <stout/bytes.hpp>
 #include <stout/gtest.hpp>
 #include <stout/option.hpp>
 #include <stout/os.hpp>
@@ -684,6 +685,56 @@ TEST_F(LogStateTest, Diff)
 }
 
 
+// Verifies that entries which are made up of a snapshot and diffs
+// are read back from the log correctly when they are not cached.
+TEST_F(LogStateTest, FetchUncached)
+{
+  // Replace the storage with one that doesn't cache any entries.
+  delete state;
+  delete storage;
+
+  storage = new state::LogStorage(log, 1024, Bytes(0));
+  state = new State(storage);
+
+  Future<Variable<Slaves>> future1 = state->fetch<Slaves>("slaves");
+  AWAIT_READY(future1);
+
+  Variable<Slaves> variable = future1.get();
+
+  Slaves slaves = variable.get();
+  ASSERT_EQ(0, slaves.slaves().size());
+
+  for (size_t i = 0; i < 1024; i++) {
+    Slave* slave = slaves.add_slaves();
+    slave->mutable_info()->set_hostname("localhost" + stringify(i));
+  }
+
+  // The first store writes a snapshot, and the following ones write
+  // diffs, each of which requires reading the previous entry back
+  // from the log.
+  for (size_t i = 1024; i < 1027; i++) {
+    variable = variable.mutate(slaves);
+
+    Future<Option<Variable<Slaves>>> future2 = state->store(variable);
+    AWAIT_READY(future2);
+    ASSERT_SOME(future2.get());
+
+    variable = future2.get().get();
+
+    Slave* slave = slaves.add_slaves();
+    slave->mutable_info()->set_hostname("localhost" + stringify(i));
+  }
+
+  Future<Variable<Slaves>> future3 = state->fetch<Slaves>("slaves");
+  AWAIT_READY(future3);
+
+  Slaves fetched = future3.get().get();
+  ASSERT_EQ(1026, fetched.slaves().size());
+  EXPECT_EQ("localhost0", fetched.slaves(0).info().hostname());
+  EXPECT_EQ("localhost1025", fetched.slaves(1025).info().hostname());
+}
+
+
 #ifdef MESOS_HAS_JAVA
 class ZooKeeperStateTest : public tests::ZooKeeperTest
 {